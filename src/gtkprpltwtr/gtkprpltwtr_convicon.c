@@ -24,6 +24,7 @@
  */
 #include "prpltwtr_conn.h"
 #include "prpltwtr_request.h"
+#include "prpltwtr_stats.h"
 #include "gtkprpltwtr.h"
 #include "gtkprpltwtr_prefs.h"
 
@@ -31,6 +32,8 @@ typedef struct {
     PurpleAccount  *account;
     gchar          *buddy_name;
     gchar          *url;
+    TwitterSchedulerJob *job;
+    TwitterConnPoolRequest *request;             /* NULL while the job is queued */
 } BuddyIconContext;
 static void     insert_requested_icon(TwitterConvIcon * conv_icon);
 
@@ -54,6 +57,29 @@ static void twitter_buddy_icon_context_free(BuddyIconContext * ctx)
     g_free(ctx);
 }
 
+/* Cancels the icon fetch, if there is one. One that was sent is counted as
+ * saving what an icon from that host usually takes */
+static void conv_icon_cancel_fetch(TwitterConvIcon * conv_icon)
+{
+    BuddyIconContext *ctx = conv_icon->fetch_context;
+
+    if (!ctx)
+        return;
+    if (!ctx->request) {
+        prpltwtr_scheduler_job_cancel(ctx->job);
+    } else {
+        gchar          *host = NULL;
+
+        if (purple_url_parse(ctx->url, &host, NULL, NULL, NULL, NULL))
+            prpltwtr_stats_add_cancelled(host);
+        g_free(host);
+        prpltwtr_connpool_request_cancel(ctx->request);
+        prpltwtr_scheduler_job_done(ctx->job);
+    }
+    twitter_buddy_icon_context_free(ctx);
+    conv_icon->fetch_context = NULL;
+}
+
 static TwitterConvIcon *twitter_conv_icon_new(PurpleAccount * account, const gchar * username)
 {
     TwitterConvIcon *conv_icon = g_new0(TwitterConvIcon, 1);
@@ -311,19 +337,24 @@ static void insert_requested_icon(TwitterConvIcon * conv_icon)
 
 }
 
-static void got_page_cb(PurpleUtilFetchUrlData * url_data, gpointer user_data, const gchar * url_text, gsize len, const gchar * error_message)
+static void got_page_cb(TwitterConnPoolRequest * conn_request, gpointer user_data, const gchar * url_text, gsize len, const gchar * error_message)
 {
     BuddyIconContext *ctx = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(ctx->account);
     TwitterConvIcon *conv_icon;
     const gchar    *pic_data;
 
+    /* Only the response is counted, the request is a short GET */
+    if (r && url_text)
+        prpltwtr_usage_add_request(twitter_requestor_get_usage(r), TWITTER_USAGE_ICONS, NULL, 0, len);
+    prpltwtr_scheduler_job_done(ctx->job);
     conv_icon = twitter_conv_icon_find(ctx->account, ctx->buddy_name);
     twitter_buddy_icon_context_free(ctx);
 
     g_return_if_fail(conv_icon != NULL);
 
     conv_icon->requested = FALSE;
-    conv_icon->fetch_data = NULL;
+    conv_icon->fetch_context = NULL;
 
     if (len && !error_message && twitter_response_text_status_code(url_text) == 200 && (pic_data = twitter_response_text_data(url_text, len))) {
         purple_debug_info(PLUGIN_ID, "Attempting to create pixbuf\n");
@@ -336,6 +367,45 @@ static void got_page_cb(PurpleUtilFetchUrlData * url_data, gpointer user_data, c
     }
 }
 
+/* The icon whose fetch this is, if it's still waiting for it */
+static TwitterConvIcon *conv_icon_for_fetch(BuddyIconContext * ctx)
+{
+    PurpleConnection *gc = purple_account_get_connection(ctx->account);
+    TwitterConnectionData *twitter = gc ? gc->proto_data : NULL;
+    TwitterConvIcon *conv_icon;
+
+    if (!twitter || !twitter->icons)
+        return NULL;
+    conv_icon = g_hash_table_lookup(twitter->icons, ctx->buddy_name);
+    return conv_icon && conv_icon->fetch_context == ctx ? conv_icon : NULL;
+}
+
+/* Scheduler drop function: the account's queue went away */
+static void conv_icon_fetch_drop(gpointer user_data)
+{
+    BuddyIconContext *ctx = user_data;
+    TwitterConvIcon *conv_icon = conv_icon_for_fetch(ctx);
+
+    if (conv_icon) {
+        conv_icon->requested = FALSE;
+        conv_icon->fetch_context = NULL;
+    }
+    twitter_buddy_icon_context_free(ctx);
+}
+
+/* Scheduler start function: fetches the icon */
+static void conv_icon_fetch_start(TwitterSchedulerJob * job, gpointer user_data)
+{
+    BuddyIconContext *ctx = user_data;
+
+    ctx->job = job;
+    ctx->request = prpltwtr_connpool_fetch_url(ctx->account, ctx->url, got_page_cb, ctx);
+    if (!ctx->request) {
+        prpltwtr_scheduler_job_done(job);
+        conv_icon_fetch_drop(ctx);
+    }
+}
+
 void twitter_conv_icon_got_user_icon(PurpleAccount * account, const char *user_name, const gchar * url, time_t icon_time)
 {
     /* look local icon cache for the requested icon */
@@ -343,6 +413,7 @@ void twitter_conv_icon_got_user_icon(PurpleAccount * account, const char *user_n
     TwitterConnectionData *twitter = gc->proto_data;
     TwitterConvIcon *conv_icon = NULL;
     GHashTable     *hash = twitter->icons;
+    TwitterRequestor *r;
 
     if (!hash)
         return;
@@ -373,8 +444,7 @@ void twitter_conv_icon_got_user_icon(PurpleAccount * account, const char *user_n
             return;
 
         //If we're already requesting, but it's a different url, cancel the fetch
-        if (conv_icon->fetch_data)
-            purple_util_fetch_url_cancel(conv_icon->fetch_data);
+        conv_icon_cancel_fetch(conv_icon);
 
         conv_icon_clear(conv_icon);
     }
@@ -386,13 +456,29 @@ void twitter_conv_icon_got_user_icon(PurpleAccount * account, const char *user_n
     if (purple_find_buddy(account, user_name))
         return;
 
+    /* Near the daily budget, icons wait. Left unrequested, it's fetched
+     * when the user next shows up */
+    r = purple_account_get_requestor(account);
+    if (url && r && prpltwtr_usage_is_cut(twitter_requestor_get_usage(r), TWITTER_USAGE_ICONS))
+        return;
+
     conv_icon->requested = TRUE;
 
     /* Create the URL for an user's icon. */
     if (url) {
         BuddyIconContext *ctx = twitter_buddy_icon_context_new(account, user_name, url);
+        gchar          *host = NULL;
+        TwitterSchedulerJob *job;
+
         purple_debug_info(PLUGIN_ID, "requesting %s for %s\n", url, user_name);
-        conv_icon->fetch_data = purple_util_fetch_url_request_len_with_account(account, url, TRUE, NULL, FALSE, NULL, TRUE, -1, got_page_cb, ctx);
+        /* Like buddy icons, these wait for everything else the account
+         * has to fetch. The job may start, and even fail, right away */
+        conv_icon->fetch_context = ctx;
+        purple_url_parse(url, &host, NULL, NULL, NULL, NULL);
+        job = prpltwtr_scheduler_submit(account, host, TWITTER_REQUEST_PRIORITY_BACKGROUND, conv_icon_fetch_start, conv_icon_fetch_drop, ctx);
+        g_free(host);
+        if (conv_icon->fetch_context == ctx)
+            ctx->job = job;
     }
 }
 
@@ -402,10 +488,8 @@ static void twitter_conv_icon_free(TwitterConvIcon * conv_icon)
         return;
     purple_debug_info(PLUGIN_ID, "Freeing icon for %s\n", conv_icon->username);
     if (conv_icon->requested) {
-        if (conv_icon->fetch_data) {
-            purple_util_fetch_url_cancel(conv_icon->fetch_data);
-        }
-        conv_icon->fetch_data = NULL;
+        /* The conversations showing it are gone */
+        conv_icon_cancel_fetch(conv_icon);
         conv_icon->requested = FALSE;
     }
     if (conv_icon->request_list)
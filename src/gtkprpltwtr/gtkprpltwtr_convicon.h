@@ -23,11 +23,13 @@
 #include <gtkimhtml.h>
 #include <core.h>
 
+#include "prpltwtr_connpool.h"
+
 typedef struct {
     GdkPixbuf      *pixbuf;  /* icon pixmap */
     gboolean        requested;  /* TRUE if download icon has been requested */
     GList          *request_list;   /* marker list */
-    PurpleUtilFetchUrlData *fetch_data; /* icon fetch data */
+    gpointer        fetch_context;  /* the icon fetch, queued or sent */
     gchar          *icon_url;   /* url for the user's icon */
     time_t          mtime;   /* mtime of file */
     GList          *convs;   /* list of conversations */
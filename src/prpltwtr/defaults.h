@@ -45,6 +45,8 @@
 #define STATUSNET_PROTOCOL_ID "prpl-statusnet"
 #define GENERIC_PROTOCOL_ID "prpltwtr"
 
+#define TWITTER_USER_AGENT "Mozilla/4.0 (compatible; MSIE 5.5)"
+
 #define TWITTER_OAUTH_KEY "9hDKG0Lty62lPca2XoA"
 #define TWITTER_OAUTH_SECRET "WmCXa0M1Q5k89WTZhnqUhxaebvF3faVkzGWGiwpoZkc"
 
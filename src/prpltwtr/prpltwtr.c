@@ -26,6 +26,13 @@
 
 #include "prpltwtr.h"
 #include "prpltwtr_mbprefs.h"
+#include "prpltwtr_connpool.h"
+#include "prpltwtr_gio.h"
+#include "prpltwtr_stats.h"
+#include "prpltwtr_scheduler.h"
+#ifdef HAVE_NGHTTP2
+#include "prpltwtr_h2.h"
+#endif
 
 #if !PURPLE_VERSION_CHECK(2, 6, 0)
 #define PURPLE_CHAT(obj) ((PurpleChat *)(obj))
@@ -238,7 +245,21 @@ struct buddies_data {
     gchar          *protocol_data;
 };
 
-static void twitter_get_friends_cb(TwitterRequestor * r, GList * nodes, gpointer user_data)
+/// Looks up the friends on a page of ids, a hundred at a time, so the
+/// ones who haven't tweeted lately get their profiles too
+static gboolean twitter_get_friends_page_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
+{
+    GList          *ids = twitter_users_ids_node_parse(r, node);
+    GList          *l;
+
+    for (l = ids; l; l = l->next)
+        prpltwtr_userlookup_by_id(prpltwtr_userlookup_get(r->account), l->data, twitter_option_get_following(r->account), NULL, NULL);
+    g_list_foreach(ids, (GFunc) g_free, NULL);
+    g_list_free(ids);
+    return TRUE;
+}
+
+static void twitter_get_friends_cb(TwitterRequestor * r, gpointer user_data)
 {
 }
 
@@ -246,7 +267,7 @@ static gboolean twitter_get_friends_timeout(gpointer data)
 {
     PurpleAccount  *account = data;
     //TODO handle errors
-    twitter_api_get_friends(purple_account_get_requestor(account), twitter_get_friends_cb, NULL, NULL);
+    twitter_api_get_friends(purple_account_get_requestor(account), twitter_get_friends_page_cb, twitter_get_friends_cb, NULL, NULL);
     return TRUE;
 }
 
@@ -506,6 +527,14 @@ static void twitter_connected(PurpleAccount * account)
     /* Install periodic timers to retrieve replies and dms */
     twitter_connection_foreach_endpoint_im(twitter, twitter_endpoint_im_start_foreach, NULL);
 
+    /* Polled only while it's down, if the account has one */
+    twitter->user_stream = twitter_endpoint_userstream_start(account);
+    /* Before any search chat starts, so they can all share it */
+    twitter->search_stream = twitter_endpoint_search_stream_new(account);
+    /* Sends what an earlier session left unsent */
+    if (!twitter->outbox)
+        twitter->outbox = prpltwtr_outbox_new(account);
+
     /* Immediately retrieve replies */
 
     get_friends_timer_timeout = twitter_option_user_status_timeout(account);
@@ -523,7 +552,7 @@ static void twitter_connected(PurpleAccount * account)
     twitter_init_auto_open_contexts(account);
 }
 
-static void twitter_get_friends_verify_connection_cb(TwitterRequestor * r, GList * nodes, gpointer user_data)
+static void twitter_get_friends_verify_connection_cb(TwitterRequestor * r, gpointer user_data)
 {
     PurpleConnection *gc = purple_account_get_connection(r->account);
 
@@ -610,9 +639,15 @@ void twitter_tooltip_text(PurpleBuddy * buddy, PurpleNotifyUserInfo * info, gboo
     }
 
     if (full) {
-        /*const char *user_info = purple_account_get_user_info(gc->account);
-           if (user_info)
-           purple_notify_user_info_add_pair(info, _("User info"), user_info); */
+        TwitterUserTweet *data = twitter_buddy_get_buddy_data(buddy);
+
+        if (data && data->user) {
+            if (data->user->description && data->user->description[0])
+                purple_notify_user_info_add_pair(info, _("Description"), data->user->description);
+        } else if (purple_account_is_connected(buddy->account)) {
+            /* For the next time it's shown */
+            prpltwtr_userlookup_by_screen_name(prpltwtr_userlookup_get(buddy->account), buddy->name, FALSE, NULL, NULL);
+        }
     }
 }
 
@@ -659,7 +694,7 @@ static void twitter_action_get_user_info(PurplePluginAction * action)
 {
     PurpleConnection *gc = (PurpleConnection *) action->context;
     PurpleAccount  *account = purple_connection_get_account(gc);
-    twitter_api_get_friends(purple_account_get_requestor(account), twitter_get_friends_cb, NULL, NULL);
+    twitter_api_get_friends(purple_account_get_requestor(account), NULL, twitter_get_friends_cb, NULL, NULL);
 }
 #endif
 
@@ -695,6 +730,131 @@ static void twitter_action_get_rate_limit_status(PurplePluginAction * action)
     twitter_api_get_rate_limit_status(twitter->requestor, twitter_get_rate_limit_status_cb, NULL, NULL);
 }
 
+static void twitter_action_get_connection_stats(PurplePluginAction * action)
+{
+    PurpleConnection *gc = (PurpleConnection *) action->context;
+    TwitterRequestor *r = purple_account_get_requestor(purple_connection_get_account(gc));
+    TwitterConnPoolStats stats;
+    TwitterGioTlsStats tls_stats;
+    GString        *message = g_string_new(NULL);
+    GList          *endpoints;
+    GList          *l;
+    int             priority;
+    guint           cancelled;
+    guint64         saved_bytes;
+    gchar          *saved;
+#ifdef HAVE_NGHTTP2
+    TwitterH2Stats  h2_stats;
+#endif
+
+    prpltwtr_connpool_get_stats(&stats);
+    g_string_append_printf(message, _("Connections opened: %u\nRequests on a reused connection: %u\nRequests that waited for a connection: %u\nIdle connections closed: %u\nConnections idle: %u\nConnections in use: %u"), stats.opened, stats.reused, stats.waited, stats.evicted, stats.idle, stats.active);
+
+    prpltwtr_gio_get_tls_stats(&tls_stats);
+    if (tls_stats.handshakes)
+        g_string_append_printf(message, _("\n\nTLS handshakes: %u\nTLS sessions offered for resumption: %u\nTLS handshakes without a cached session: %u\nHosts with a cached TLS session: %u"), tls_stats.handshakes, tls_stats.offered, tls_stats.misses, tls_stats.sessions);
+
+#ifdef HAVE_NGHTTP2
+    prpltwtr_h2_get_stats(&h2_stats);
+    g_string_append_printf(message, _("\n\nHTTP/2 connections opened: %u\nHTTP/2 connections open: %u\nHTTP/2 streams: %u\nRequests sent over HTTP/1.1 instead: %u"), h2_stats.sessions_opened, h2_stats.sessions, h2_stats.streams, h2_stats.fallbacks);
+#endif
+
+    g_string_append_printf(message, _("\n\nRequests joined to an identical pending one: %u"), r->requests_coalesced);
+    if (r->buffers) {
+        guint           allocated;
+        guint           reused;
+
+        twitter_http_buffer_pool_get_stats(r->buffers, &allocated, &reused);
+        g_string_append_printf(message, _("\nRequest buffers allocated: %u\nRequest buffers reused: %u"), allocated, reused);
+    }
+    prpltwtr_stats_get_cancelled(&cancelled, &saved_bytes);
+    saved = purple_str_size_to_units(saved_bytes);
+    g_string_append_printf(message, _("\nRequests cancelled as their chat or conversation went away: %u (saving about %s)"), cancelled, saved);
+    g_free(saved);
+    if (r->http_cache) {
+        TwitterHttpCacheStats cache_stats;
+        gchar          *size;
+
+        prpltwtr_http_cache_get_stats(r->http_cache, &cache_stats);
+        size = purple_str_size_to_units(cache_stats.bytes);
+        g_string_append_printf(message, _("\nCached responses: %u (%s)\nResponses cached since login: %u\nUnchanged responses served from the cache: %u"), cache_stats.entries, size, cache_stats.stored, cache_stats.revalidated);
+        g_free(size);
+    }
+    if (r->retry) {
+        TwitterRetryStats retry_stats;
+
+        prpltwtr_retry_get_stats(r->retry, &retry_stats);
+        g_string_append_printf(message, _("\nFailed requests sent again: %u\nRequests refused while their endpoint was failing or rate limited: %u\nCircuits opened: %u (%u open now)"), retry_stats.retries, retry_stats.rejected, retry_stats.circuits_opened, retry_stats.circuits_open);
+    }
+    g_string_append(message, _("\nRequests by priority:"));
+    for (priority = 0; priority < TWITTER_REQUEST_PRIORITY_COUNT; priority++) {
+        TwitterSchedulerClassStats class_stats;
+
+        prpltwtr_scheduler_get_stats(priority, &class_stats);
+        g_string_append_printf(message, _("\n%s: %u queued, %u running, %u started, average wait %u ms, longest %u ms"), prpltwtr_scheduler_priority_name(priority), class_stats.queued, class_stats.running, class_stats.started, class_stats.started ? (guint) (class_stats.wait_total_ms / class_stats.started) : 0, class_stats.wait_max_ms);
+    }
+
+    endpoints = prpltwtr_stats_get_endpoints();
+    if (endpoints)
+        g_string_append(message, _("\n\nResponse bytes received (decompressed):"));
+    for (l = endpoints; l; l = l->next) {
+        TwitterEndpointStats *endpoint_stats = l->data;
+        gchar          *wire_size = purple_str_size_to_units(endpoint_stats->wire_bytes);
+        gchar          *size = purple_str_size_to_units(endpoint_stats->bytes);
+        g_string_append_printf(message, "\n%s: %s (%s)", endpoint_stats->endpoint, wire_size, size);
+        g_free(wire_size);
+        g_free(size);
+    }
+    g_list_free(endpoints);
+
+    purple_notify_info(gc, _("Connection Statistics"), _("Connection Statistics"), message->str);
+    g_string_free(message, TRUE);
+}
+
+static void twitter_action_get_data_usage(PurplePluginAction * action)
+{
+    PurpleConnection *gc = (PurpleConnection *) action->context;
+    TwitterUsage   *usage = twitter_requestor_get_usage(purple_account_get_requestor(purple_connection_get_account(gc)));
+    GString        *message = g_string_new(NULL);
+    guint64         budget = prpltwtr_usage_get_budget(usage);
+    gchar          *today = purple_str_size_to_units(prpltwtr_usage_get_today(usage));
+    GList          *entries;
+    GList          *l;
+    int             usage_class;
+
+    if (budget) {
+        gchar          *budget_size = purple_str_size_to_units(budget);
+        g_string_append_printf(message, _("Used today: %s of %s"), today, budget_size);
+        g_free(budget_size);
+        for (usage_class = 0; usage_class < TWITTER_USAGE_CLASS_COUNT; usage_class++)
+            if (prpltwtr_usage_is_cut(usage, usage_class))
+                g_string_append_printf(message, _("\nSaving data on: %s"), prpltwtr_usage_class_name(usage_class));
+    } else {
+        g_string_append_printf(message, _("Used today: %s"), today);
+    }
+    g_free(today);
+
+    entries = prpltwtr_usage_get_entries(usage);
+    if (entries)
+        g_string_append(message, _("\n\nSince login (sent, received):"));
+    for (l = entries; l; l = l->next) {
+        TwitterUsageEntry *entry = l->data;
+        gchar          *sent = purple_str_size_to_units(entry->sent);
+        gchar          *received = purple_str_size_to_units(entry->received);
+
+        if (g_strcmp0(entry->label, prpltwtr_usage_class_name(entry->usage_class)))
+            g_string_append_printf(message, _("\n%s (%s): %u requests, %s, %s"), entry->label, prpltwtr_usage_class_name(entry->usage_class), entry->requests, sent, received);
+        else
+            g_string_append_printf(message, _("\n%s: %u requests, %s, %s"), entry->label, entry->requests, sent, received);
+        g_free(sent);
+        g_free(received);
+    }
+    g_list_free(entries);
+
+    purple_notify_info(gc, _("Data Usage"), _("Data Usage"), message->str);
+    g_string_free(message, TRUE);
+}
+
 /* this is set to the actions member of the PurplePluginInfo struct at the
  * bottom.
  */
@@ -709,6 +869,12 @@ GList          *twitter_actions(PurplePlugin * plugin, gpointer context)
     action = purple_plugin_action_new(_("Rate Limit Status"), twitter_action_get_rate_limit_status);
     l = g_list_append(l, action);
 
+    action = purple_plugin_action_new(_("Connection Statistics"), twitter_action_get_connection_stats);
+    l = g_list_append(l, action);
+
+    action = purple_plugin_action_new(_("Data Usage"), twitter_action_get_data_usage);
+    l = g_list_append(l, action);
+
 #if 0
     action = purple_plugin_action_new(_("Debug - Retrieve users"), twitter_action_get_user_info);
     l = g_list_append(l, action);
@@ -757,7 +923,7 @@ void prpltwtr_verify_connection(PurpleAccount * account)
     }
 
     if (twitter_option_get_following(account)) {
-        twitter_api_get_friends(purple_account_get_requestor(account), twitter_get_friends_verify_connection_cb, twitter_get_friends_verify_error_cb, NULL);
+        twitter_api_get_friends(purple_account_get_requestor(account), NULL, twitter_get_friends_verify_connection_cb, twitter_get_friends_verify_error_cb, NULL);
     } else {
         twitter_connected(account);
         if (twitter_option_cutoff_time(account) <= 0)
@@ -788,6 +954,25 @@ void twitter_close(PurpleConnection * gc)
     PurpleAccount  *account = purple_connection_get_account(gc);
     TwitterConnectionData *twitter = gc->proto_data;
 
+    /* Before the requestor it's connected through */
+    twitter_stream_free(twitter->user_stream);
+    twitter->user_stream = NULL;
+    twitter_endpoint_search_stream_free(twitter->search_stream);
+    twitter->search_stream = NULL;
+    if (twitter->outbox) {
+        prpltwtr_outbox_free(twitter->outbox);
+        twitter->outbox = NULL;
+    }
+    if (twitter->user_lookup) {
+        prpltwtr_userlookup_free(twitter->user_lookup);
+        twitter->user_lookup = NULL;
+    }
+    prpltwtr_sharedfetch_forget_account(account);
+    if (twitter->status_cache) {
+        prpltwtr_statuscache_free(twitter->status_cache);
+        twitter->status_cache = NULL;
+    }
+
     if (twitter->requestor)
         twitter_requestor_free(twitter->requestor);
 
@@ -1224,6 +1409,10 @@ void prpltwtr_plugin_init(PurplePlugin * plugin)
 
         purple_signal_register(purple_conversations_get_handle(), "prpltwtr-changed-attached-search", twitter_marshal_changed_attached_search, NULL, 1, purple_value_new(PURPLE_TYPE_SUBTYPE, PURPLE_SUBTYPE_CONVERSATION)  // conv
             );
+
+        purple_signal_register(purple_conversations_get_handle(), "prpltwtr-status-deleted", purple_marshal_VOID__POINTER_POINTER, NULL, 2, purple_value_new(PURPLE_TYPE_SUBTYPE, PURPLE_SUBTYPE_ACCOUNT),  // account
+                               purple_value_new(PURPLE_TYPE_STRING) // id_str
+            );
     } else {
         plugin->info->summary = _("Status.net for Purple (Twitter API)");
         plugin->info->description = _("Access status.net microblogging servers from within libpurple applications");
@@ -1248,6 +1437,7 @@ void twitter_destroy(PurplePlugin * plugin)
         purple_signal_unregister(purple_buddy_icons_get_handle(), "prpltwtr-update-iconurl");
         purple_signal_unregister(purple_conversations_get_handle(), "prpltwtr-format-tweet");
         purple_signal_unregister(purple_conversations_get_handle(), "prpltwtr-received-im");
+        purple_signal_unregister(purple_conversations_get_handle(), "prpltwtr-status-deleted");
         purple_signals_disconnect_by_handle(plugin);
     }
 }
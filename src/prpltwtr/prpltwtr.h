@@ -64,8 +64,13 @@
 #include "prpltwtr_endpoint_reply.h"
 #include "prpltwtr_endpoint_search.h"
 #include "prpltwtr_endpoint_timeline.h"
+#include "prpltwtr_endpoint_userstream.h"
 #include "prpltwtr_buddy.h"
 #include "prpltwtr_conn.h"
+#include "prpltwtr_outbox.h"
+#include "prpltwtr_sharedfetch.h"
+#include "prpltwtr_statuscache.h"
+#include "prpltwtr_userlookup.h"
 
 #include "prpltwtr_plugin.h"
 
@@ -33,7 +33,10 @@
 #include "prpltwtr_api.h"
 #include "prpltwtr_buddy.h"
 #include "prpltwtr_conn.h"
+#include "prpltwtr_outbox.h"
 #include "prpltwtr_request.h"
+#include "prpltwtr_statuscache.h"
+#include "prpltwtr_userlookup.h"
 
 const gchar    *twitter_api_create_url(PurpleAccount * account, const gchar * endpoint)
 {
@@ -117,24 +120,13 @@ static const gchar *twitter_option_url_delete_status(TwitterRequestor * r, gchar
     return result;
 }
 
-static void prpltwtr_api_refresh_user_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer _ctx)
+static void prpltwtr_api_refresh_user_cb(PurpleAccount * account, TwitterUserData * user, gpointer data)
 {
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
-    purple_debug_error(purple_account_get_protocol_id(r->account), "Couldn't retreive user info: %s", error_data->message ? error_data->message : "unknown error");
-}
-
-static void prpltwtr_api_refresh_user_success_cb(TwitterRequestor * r, gpointer node, gpointer data)
-{
-    TwitterUserData *user = NULL;
-    PurpleConnection *gc = purple_account_get_connection(r->account);
+    PurpleConnection *gc = purple_account_get_connection(account);
     TwitterConnectionData *twitter = gc ? gc->proto_data : NULL;
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
-
-    if (twitter) {
-        user = twitter_user_node_parse(r, node);
-    }
+    purple_debug_info(purple_account_get_protocol_id(account), "%s\n", G_STRFUNC);
 
-    if (user) {
+    if (user && twitter) {
         gchar          *url;
         PurpleNotifyUserInfo *info = purple_notify_user_info_new();
         purple_notify_user_info_add_pair(info, _("Description"), user->description);
@@ -156,8 +148,6 @@ static void prpltwtr_api_refresh_user_success_cb(TwitterRequestor * r, gpointer
         purple_notify_userinfo(gc, user->screen_name, info, NULL, NULL);
         purple_notify_user_info_destroy(info);
     }
-
-    twitter_user_data_free(user);
 }
 
 void twitter_api_get_info(PurpleConnection * gc, const char *username)
@@ -187,6 +177,10 @@ void twitter_api_get_info(PurpleConnection * gc, const char *username)
                 if (user_data->statuses_count) {
                     purple_notify_user_info_add_pair(info, _("Tweets"), user_data->statuses_count);
                 }
+            } else {
+                /* A buddy who hasn't tweeted since we connected */
+                purple_notify_user_info_add_pair(info, _("Description"), _("No user info available. Loading from server..."));
+                prpltwtr_userlookup_by_screen_name(prpltwtr_userlookup_get(purple_connection_get_account(gc)), username, FALSE, prpltwtr_api_refresh_user_cb, NULL);
             }
             if (status_data) {
                 purple_notify_user_info_add_pair(info, _("Last status"), status_data->text);
@@ -195,7 +189,7 @@ void twitter_api_get_info(PurpleConnection * gc, const char *username)
         }
     } else {
         purple_notify_user_info_add_pair(info, _("Description"), _("No user info available. Loading from server..."));
-        prpltwtr_api_refresh_user(purple_account_get_requestor(purple_connection_get_account(gc)), username, prpltwtr_api_refresh_user_success_cb, prpltwtr_api_refresh_user_error_cb);
+        prpltwtr_userlookup_by_screen_name(prpltwtr_userlookup_get(purple_connection_get_account(gc)), username, FALSE, prpltwtr_api_refresh_user_cb, NULL);
     }
     url = twitter_mb_prefs_get_user_profile_url(twitter->mb_prefs, username);
     purple_notify_user_info_add_pair(info, _("Account Link"), url);
@@ -255,7 +249,7 @@ void twitter_api_web_open_retweets_of_mine(PurplePluginAction * action)
     purple_notify_uri(NULL, url);
 }
 
-void twitter_api_get_friends(TwitterRequestor * r, TwitterSendRequestMultiPageAllSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gpointer data)
+void twitter_api_get_friends(TwitterRequestor * r, TwitterSendRequestCursorPageFunc page_func, TwitterSendRequestCursorDoneFunc done_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gpointer data)
 {
 
     TwitterRequestParams *params = twitter_request_params_new();
@@ -263,7 +257,8 @@ void twitter_api_get_friends(TwitterRequestor * r, TwitterSendRequestMultiPageAl
 
     twitter_request_params_add(params, twitter_request_param_new("screen_name", r->account->username));
 
-    twitter_send_format_request_with_cursor(r, r->urls->get_friends, params, 0, success_func, error_func, data);
+    twitter_send_format_request_with_cursor(r, r->urls->get_friends, params, 0, page_func, done_func, error_func, data);
+    twitter_request_params_free(params);
 
 }
 
@@ -374,70 +369,20 @@ void twitter_api_set_status(TwitterRequestor * r, const char *msg, gchar * in_re
     twitter_request_params_free(params);
 }
 
-typedef struct {
-    GArray         *statuses;
-    TwitterApiMultiStatusSuccessFunc success_func;
-    TwitterApiMultiStatusErrorFunc error_func;
-    gpointer        user_data;
-    int             statuses_index;
-
-    //set status only
-    gchar          *in_reply_to_status_id;
-
-    //dm only
-    gchar          *dm_who;
-} TwitterMultiMessageContext;
-
-static void     twitter_api_set_statuses_success_cb(TwitterRequestor * r, gpointer node, gpointer _ctx);
-static void twitter_api_set_statuses_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer _ctx)
+/// The account's outbox, opened on first use
+static TwitterOutbox *twitter_api_get_outbox(TwitterRequestor * r)
 {
-    TwitterMultiMessageContext *ctx = _ctx;
+    TwitterConnectionData *twitter = purple_account_get_connection(r->account)->proto_data;
 
-    if (ctx->error_func && !ctx->error_func(r->account, error_data, ctx->user_data)) {
-        //TODO: verify this doesn't leak
-        g_array_free(ctx->statuses, TRUE);
-        g_free(ctx);
-        return;
-    }
-    //Try again
-    twitter_api_set_status(r, g_array_index(ctx->statuses, gchar *, ctx->statuses_index), ctx->in_reply_to_status_id, twitter_api_set_statuses_success_cb, twitter_api_set_statuses_error_cb, ctx);
-}
-
-static void twitter_api_set_statuses_success_cb(TwitterRequestor * r, gpointer node, gpointer _ctx)
-{
-    TwitterMultiMessageContext *ctx = _ctx;
-    gboolean        last = FALSE;
-
-    if (++ctx->statuses_index >= ctx->statuses->len) {
-        last = TRUE;
-        //TODO: verify this doesn't leak
-        g_array_free(ctx->statuses, TRUE);
-        g_free(ctx);
-        return;
-    }
-
-    if (ctx->success_func)
-        ctx->success_func(r->account, node, last, ctx->user_data);
-
-    if (last)
-        return;
-
-    twitter_api_set_status(r, g_array_index(ctx->statuses, gchar *, ctx->statuses_index), ctx->in_reply_to_status_id, twitter_api_set_statuses_success_cb, twitter_api_set_statuses_error_cb, ctx);
+    if (!twitter->outbox)
+        twitter->outbox = prpltwtr_outbox_new(r->account);
+    return twitter->outbox;
 }
 
 void twitter_api_set_statuses(TwitterRequestor * r, GArray * statuses, gchar * in_reply_to_status_id, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data)
 {
-    TwitterMultiMessageContext *ctx;
     g_return_if_fail(statuses && statuses->len);
-    ctx = g_new0(TwitterMultiMessageContext, 1);
-    ctx->statuses = statuses;
-    ctx->in_reply_to_status_id = in_reply_to_status_id;
-    ctx->success_func = success_func;
-    ctx->error_func = error_func;
-    ctx->user_data = data;
-    ctx->statuses_index = 0;
-
-    twitter_api_set_status(r, g_array_index(statuses, gchar *, 0), in_reply_to_status_id, twitter_api_set_statuses_success_cb, twitter_api_set_statuses_error_cb, ctx);
+    prpltwtr_outbox_send_statuses(twitter_api_get_outbox(r), statuses, in_reply_to_status_id, success_func, error_func, data);
 }
 
 void twitter_api_send_dm(TwitterRequestor * r, const char *user, const char *msg, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data)
@@ -496,6 +441,9 @@ void twitter_api_report_spammer(TwitterRequestor * r, const gchar * user, Twitte
 
 void twitter_api_get_status(TwitterRequestor * r, gchar * id, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data)
 {
+    /* Reply parents are usually fetched ahead */
+    if (prpltwtr_statuscache_get_status(prpltwtr_statuscache_get(r->account), id, success_func, error_func, data))
+        return;
     twitter_send_format_request(r, FALSE, twitter_option_url_get_status(r, id), NULL, success_func, error_func, data);
 }
 
@@ -504,65 +452,11 @@ void twitter_api_delete_status(TwitterRequestor * r, gchar * id, TwitterSendForm
     twitter_send_format_request(r, TRUE, twitter_option_url_delete_status(r, id), NULL, success_func, error_func, data);
 }
 
-static void     twitter_api_send_dms_success_cb(TwitterRequestor * r, gpointer node, gpointer _ctx);
-static void twitter_api_send_dms_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer _ctx)
-{
-    TwitterMultiMessageContext *ctx = _ctx;
-
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
-
-    if (ctx->error_func && !ctx->error_func(r->account, error_data, ctx->user_data)) {
-        //TODO: verify this doesn't leak
-        g_array_free(ctx->statuses, TRUE);
-        g_free(ctx->dm_who);
-        g_free(ctx);
-        return;
-    }
-    //Try again
-    twitter_api_send_dm(r, ctx->dm_who, g_array_index(ctx->statuses, gchar *, ctx->statuses_index), twitter_api_send_dms_success_cb, twitter_api_send_dms_error_cb, ctx);
-}
-
-static void twitter_api_send_dms_success_cb(TwitterRequestor * r, gpointer node, gpointer _ctx)
-{
-    TwitterMultiMessageContext *ctx = _ctx;
-    gboolean        last = FALSE;
-
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
-
-    if (++ctx->statuses_index >= ctx->statuses->len) {
-        //TODO: verify this doesn't leak
-        g_array_free(ctx->statuses, TRUE);
-        g_free(ctx->dm_who);
-        g_free(ctx);
-        last = TRUE;
-        return;
-    }
-
-    if (ctx->success_func)
-        ctx->success_func(r->account, node, last, ctx->user_data);
-
-    if (last)
-        return;
-
-    twitter_api_send_dm(r, ctx->dm_who, g_array_index(ctx->statuses, gchar *, ctx->statuses_index), twitter_api_send_dms_success_cb, twitter_api_send_dms_error_cb, ctx);
-}
-
 void twitter_api_send_dms(TwitterRequestor * r, const gchar * who, GArray * statuses, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data)
 {
-    TwitterMultiMessageContext *ctx;
-
     purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
     g_return_if_fail(statuses && statuses->len);
-
-    ctx = g_new0(TwitterMultiMessageContext, 1);
-    ctx->statuses = statuses;
-    ctx->success_func = success_func;
-    ctx->error_func = error_func;
-    ctx->user_data = data;
-    ctx->statuses_index = 0;
-    ctx->dm_who = g_strdup(who);
-
-    twitter_api_send_dm(r, ctx->dm_who, g_array_index(ctx->statuses, gchar *, ctx->statuses_index), twitter_api_send_dms_success_cb, twitter_api_send_dms_error_cb, ctx);
+    prpltwtr_outbox_send_dms(twitter_api_get_outbox(r), who, statuses, success_func, error_func, data);
 }
 
 void twitter_api_get_personal_lists(TwitterRequestor * r, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data)
@@ -30,7 +30,7 @@ const gchar    *twitter_api_create_url_ext(PurpleAccount * account, const gchar
 typedef void    (*TwitterApiMultiStatusSuccessFunc) (PurpleAccount * account, gpointer node, gboolean last_page, gpointer user_data);
 typedef         gboolean(*TwitterApiMultiStatusErrorFunc) (PurpleAccount * account, const TwitterRequestErrorData * error_data, gpointer user_data);
 
-void            twitter_api_get_friends(TwitterRequestor * r, TwitterSendRequestMultiPageAllSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gpointer data);
+void            twitter_api_get_friends(TwitterRequestor * r, TwitterSendRequestCursorPageFunc page_func, TwitterSendRequestCursorDoneFunc done_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gpointer data);
 
 void            twitter_api_get_home_timeline_all(TwitterRequestor * r, gchar * since_id, TwitterSendRequestMultiPageAllSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gint max_count, gpointer data);
 
@@ -64,8 +64,11 @@ void            twitter_api_get_status(TwitterRequestor * r, gchar * id, Twitter
 
 void            twitter_api_delete_status(TwitterRequestor * r, gchar * id, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data);
 
+/// Sends a status update in parts, through the account's outbox: they're
+/// kept until sent, across reconnects. See prpltwtr_outbox_send_statuses.
 void            twitter_api_set_statuses(TwitterRequestor * r, GArray * statuses, gchar * in_reply_to_status_id, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data);
 
+/// Sends a direct message in parts, through the account's outbox
 void            twitter_api_send_dms(TwitterRequestor * r, const gchar * who, GArray * statuses, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data);
 
 void            twitter_api_set_status(TwitterRequestor * r, const char *msg, gchar * in_reply_to_status_id, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data);
@@ -1,5 +1,9 @@
 #include "prpltwtr_buddy.h"
 #include "prpltwtr_util.h"
+#include "prpltwtr_conn.h"
+#include "prpltwtr_connpool.h"
+#include "prpltwtr_request.h"
+#include "prpltwtr_scheduler.h"
 static void     set_id(PurpleBuddy * b, gchar * id);
 static gchar   *get_id(PurpleBuddy * b);
 
@@ -263,28 +267,57 @@ typedef struct {
     PurpleAccount  *account;
     gchar          *buddy_name;
     gchar          *url;
+    TwitterSchedulerJob *job;
 } BuddyIconContext;
 
-static void twitter_buddy_update_icon_cb(PurpleUtilFetchUrlData * url_data, gpointer user_data, const gchar * url_text, gsize len, const gchar * error_message)
+static void twitter_buddy_icon_context_free(BuddyIconContext * b)
+{
+    g_free(b->buddy_name);
+    g_free(b->url);
+    g_free(b);
+}
+
+static void twitter_buddy_update_icon_cb(TwitterConnPoolRequest * conn_request, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message)
 {
     BuddyIconContext *b = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(b->account);
     PurpleBuddyIcon *buddy_icon;
-    purple_buddy_icons_set_for_user(b->account, b->buddy_name, g_memdup(url_text, len), len, b->url);
+    const gchar    *icon_data = NULL;
+    gsize           icon_len = 0;
+
+    /* Only the response is counted, the request is a short GET */
+    if (r && response_text)
+        prpltwtr_usage_add_request(twitter_requestor_get_usage(r), TWITTER_USAGE_ICONS, NULL, 0, len);
+    if (!error_message && twitter_response_text_status_code(response_text) == 200 && (icon_data = twitter_response_text_data(response_text, len)))
+        icon_len = len - (icon_data - response_text);
+    purple_buddy_icons_set_for_user(b->account, b->buddy_name, g_memdup(icon_data, icon_len), icon_len, b->url);
 
     if ((buddy_icon = purple_buddy_icons_find(b->account, b->buddy_name))) {
         purple_signal_emit(purple_buddy_icons_get_handle(), "prpltwtr-update-buddyicon", b->account, b->buddy_name, buddy_icon);
         purple_buddy_icon_unref(buddy_icon);
     }
 
-    g_free(b->buddy_name);
-    g_free(b->url);
-    g_free(b);
+    prpltwtr_scheduler_job_done(b->job);
+    twitter_buddy_icon_context_free(b);
+}
+
+/// Scheduler start function: fetches the icon
+static void twitter_buddy_update_icon_start(TwitterSchedulerJob * job, gpointer user_data)
+{
+    BuddyIconContext *b = user_data;
+
+    b->job = job;
+    if (!prpltwtr_connpool_fetch_url(b->account, b->url, twitter_buddy_update_icon_cb, b)) {
+        prpltwtr_scheduler_job_done(job);
+        twitter_buddy_icon_context_free(b);
+    }
 }
 
 void twitter_buddy_update_icon_from_username(PurpleAccount * account, const gchar * username, const gchar * url)
 {
     const gchar    *previous_url;
     PurpleBuddyIcon *icon;
+    TwitterRequestor *r;
     if (url == NULL) {
         purple_buddy_icons_set_for_user(account, username, NULL, 0, NULL);
         return;
@@ -298,7 +331,16 @@ void twitter_buddy_update_icon_from_username(PurpleAccount * account, const gcha
     }
 
     if (previous_url == NULL || !g_str_equal(previous_url, url)) {
-        BuddyIconContext *b = g_new0(BuddyIconContext, 1);
+        BuddyIconContext *b;
+        gchar          *host = NULL;
+
+        /* Near the daily budget, icons wait. Left unmarked, they're
+         * fetched when the buddy is next seen */
+        r = purple_account_get_requestor(account);
+        if (r && prpltwtr_usage_is_cut(twitter_requestor_get_usage(r), TWITTER_USAGE_ICONS))
+            return;
+
+        b = g_new0(BuddyIconContext, 1);
         b->account = account;
         b->buddy_name = g_strdup(username);
         b->url = g_strdup(url);
@@ -307,7 +349,10 @@ void twitter_buddy_update_icon_from_username(PurpleAccount * account, const gcha
 
         purple_signal_emit(purple_buddy_icons_get_handle(), "prpltwtr-update-buddyicon", account, username, NULL);
 
-        purple_util_fetch_url_request_len_with_account(account, url, TRUE, NULL, FALSE, NULL, FALSE, -1, twitter_buddy_update_icon_cb, b);
+        /* Icons wait for everything else the account has to fetch */
+        purple_url_parse(url, &host, NULL, NULL, NULL, NULL);
+        prpltwtr_scheduler_submit(account, host, TWITTER_REQUEST_PRIORITY_BACKGROUND, twitter_buddy_update_icon_start, (TwitterSchedulerDropFunc) twitter_buddy_icon_context_free, b);
+        g_free(host);
 
     }
 }
@@ -5,6 +5,16 @@
 #include "prpltwtr_endpoint_im.h"
 #include "prpltwtr_request.h"
 #include "prpltwtr_mbprefs.h"
+#include "prpltwtr_stream.h"
+
+/* the search chats' shared filter stream, see prpltwtr_endpoint_search.c */
+typedef struct _TwitterSearchStream TwitterSearchStream;
+/* messages waiting to be sent, see prpltwtr_outbox.h */
+typedef struct _TwitterOutbox TwitterOutbox;
+/* users looked up in batches, see prpltwtr_userlookup.h */
+typedef struct _TwitterUserLookup TwitterUserLookup;
+/* statuses fetched ahead, see prpltwtr_statuscache.h */
+typedef struct _TwitterStatusCache TwitterStatusCache;
 
 typedef struct {
     TwitterRequestor *requestor;
@@ -16,6 +26,14 @@ typedef struct {
 
     gchar          *last_home_timeline_id;
 
+    /* pushes the timeline, replies and dms while it's live, NULL if the
+     * account polls for them instead */
+    TwitterStream  *user_stream;
+    TwitterSearchStream *search_stream;         /* NULL if searches are only polled */
+    TwitterOutbox  *outbox;
+    TwitterUserLookup *user_lookup;
+    TwitterStatusCache *status_cache;
+
     /* a table of TwitterEndpointChat
      * where the key will be the chat name
      * Alternatively, we only really need chat contexts when
@@ -0,0 +1,1014 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+#include <proxy.h>
+#include <sslconn.h>
+#include <util.h>
+#include <version.h>
+
+#include "prpltwtr_connpool.h"
+#include "prpltwtr_dns.h"
+#include "prpltwtr_http.h"
+#include "prpltwtr_stats.h"
+
+/* Buffers handed to a single writev() */
+#define TWITTER_CONNPOOL_WRITE_VECTORS 8
+
+typedef struct _TwitterConnPoolConn TwitterConnPoolConn;
+
+struct _TwitterConnPoolConn {
+    gchar          *key;
+    gchar          *host;
+    int             port;
+    gboolean        use_https;
+    /* the account of its request, or of the last one; without one yet,
+     * the account that opened it. See prpltwtr_connpool_drop_account */
+    PurpleAccount  *account;
+    /* the cached addresses of host, if any, and the one being tried */
+    gchar         **addresses;
+    guint           address_index;
+
+    TwitterDnsQuery *dns_query;
+    PurpleProxyConnectData *connect_data;
+    PurpleSslConnection *gsc;
+    int             fd;
+    guint           read_watcher;
+    guint           write_watcher;
+    guint           idle_timer;
+    guint           fail_timer;
+
+    gboolean        opening;
+    gboolean        ssl_failed;
+    gboolean        connected;
+    gboolean        idle;
+    gboolean        closed;
+    gint            ref;
+
+    TwitterConnPoolRequest *request;
+
+    TwitterHttpReader reader;
+};
+
+struct _TwitterConnPoolRequest {
+    PurpleAccount  *account;
+    gchar          *key;
+    gchar          *host;
+    int             port;
+    gboolean        use_https;
+    gchar          *endpoint;
+
+    TwitterHttpSegments *segments;
+    gsize           written;
+
+    gboolean        reused;
+    gboolean        retried;
+    gboolean        idempotent;                  /* a GET or HEAD, safe to send twice */
+    gboolean        waiting;
+    gint            redirects;
+    TwitterConnPoolConn *conn;
+
+    TwitterConnPoolCallback callback;
+    gpointer        user_data;
+};
+
+/* key: gchar *, value: GQueue of idle TwitterConnPoolConn, most recently used first */
+static GHashTable *idle_connections = NULL;
+/* connections being opened without a request, warm-ups or cancelled ones */
+static GList   *unclaimed_connections = NULL;
+static guint    open_connections = 0;
+/* key: gchar *, value: number of open connections with that key */
+static GHashTable *host_connections = NULL;
+/* key: gchar *, value: GQueue of TwitterConnPoolRequest waiting for a connection */
+static GHashTable *waiting_requests = NULL;
+static guint    waiting_timer = 0;
+static TwitterConnPoolStats connpool_stats;
+
+static void     connpool_request_start(TwitterConnPoolRequest * req);
+static void     connpool_conn_send(TwitterConnPoolConn * conn);
+static void     connpool_conn_read(TwitterConnPoolConn * conn);
+static void     connpool_conn_write(TwitterConnPoolConn * conn);
+static void     connpool_conn_error(TwitterConnPoolConn * conn, const gchar * error_message);
+static gboolean connpool_conn_connect_next(TwitterConnPoolConn * conn);
+static void     connpool_ssl_connected_cb(gpointer data, PurpleSslConnection * gsc, PurpleInputCondition cond);
+static void     connpool_ssl_error_cb(PurpleSslConnection * gsc, PurpleSslErrorType error, gpointer data);
+
+/* Only direct connections use the DNS cache, a proxy resolves for itself */
+static gboolean connpool_is_direct(PurpleAccount * account)
+{
+    PurpleProxyInfo *gpi = purple_proxy_get_setup(account);
+    return !gpi || purple_proxy_info_get_type(gpi) == PURPLE_PROXY_NONE;
+}
+
+static gchar   *connpool_key(PurpleAccount * account, gboolean use_https, const gchar * host, int port)
+{
+    PurpleProxyInfo *gpi = purple_proxy_get_setup(account);
+    PurpleProxyType type = gpi ? purple_proxy_info_get_type(gpi) : PURPLE_PROXY_NONE;
+    const gchar    *proxy_host = NULL;
+    const gchar    *proxy_user = NULL;
+    int             proxy_port = 0;
+
+    /* Connections are shared between accounts, but only if they go through
+     * the same proxy */
+    if (type != PURPLE_PROXY_NONE && type != PURPLE_PROXY_USE_GLOBAL) {
+        proxy_host = purple_proxy_info_get_host(gpi);
+        proxy_port = purple_proxy_info_get_port(gpi);
+        proxy_user = purple_proxy_info_get_username(gpi);
+    }
+
+    return g_strdup_printf("%s://%s:%d|%d:%s:%d:%s", use_https ? "https" : "http", host, port, type, proxy_host ? proxy_host : "", proxy_port, proxy_user ? proxy_user : "");
+}
+
+static void connpool_request_free(TwitterConnPoolRequest * req)
+{
+    g_free(req->key);
+    g_free(req->host);
+    g_free(req->endpoint);
+    twitter_http_segments_free(req->segments);
+    g_free(req);
+}
+
+static gboolean connpool_request_redirect(TwitterConnPoolRequest * req, const gchar * response_text, gsize len)
+{
+    TwitterHttpHeaders headers;
+    gint            status;
+    gchar          *location;
+    gchar          *new_data;
+
+    if (req->redirects <= 0)
+        return FALSE;
+
+    twitter_http_headers_parse(&headers, response_text, len);
+    status = headers.status_code;
+    location = headers.location;
+    headers.location = NULL;
+    twitter_http_headers_clear(&headers);
+
+    if (!location || (status != 301 && status != 302 && status != 303 && status != 307 && status != 308)) {
+        g_free(location);
+        return FALSE;
+    }
+
+    new_data = prpltwtr_connpool_build_get(location, &req->use_https, &req->host, &req->port);
+    if (!new_data) {
+        g_free(location);
+        return FALSE;
+    }
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Following redirect to %s\n", location);
+    g_free(location);
+    g_free(req->key);
+    twitter_http_segments_free(req->segments);
+    req->segments = twitter_http_segments_new();
+    twitter_http_segments_add_take(req->segments, new_data, strlen(new_data));
+    req->key = connpool_key(req->account, req->use_https, req->host, req->port);
+    req->written = 0;
+    req->retried = FALSE;
+    req->idempotent = TRUE;
+    req->redirects--;
+    connpool_request_start(req);
+    return TRUE;
+}
+
+static void connpool_request_complete(TwitterConnPoolRequest * req, const gchar * response_text, gsize len, const gchar * error_message)
+{
+    if (!error_message && connpool_request_redirect(req, response_text, len))
+        return;
+    if (!error_message)
+        prpltwtr_stats_add_response(req->endpoint);
+    if (req->callback)
+        req->callback(req, req->user_data, response_text, len, error_message);
+    connpool_request_free(req);
+}
+
+static guint connpool_host_connections(const gchar * key)
+{
+    return host_connections ? GPOINTER_TO_UINT(g_hash_table_lookup(host_connections, key)) : 0;
+}
+
+static void connpool_host_connections_add(const gchar * key, gint delta)
+{
+    guint           count = connpool_host_connections(key) + delta;
+
+    if (!host_connections)
+        host_connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    if (count > 0)
+        g_hash_table_replace(host_connections, g_strdup(key), GUINT_TO_POINTER(count));
+    else
+        g_hash_table_remove(host_connections, key);
+}
+
+static void connpool_request_wait(TwitterConnPoolRequest * req)
+{
+    GQueue         *queue;
+
+    if (!waiting_requests)
+        waiting_requests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_queue_free);
+
+    queue = g_hash_table_lookup(waiting_requests, req->key);
+    if (!queue) {
+        queue = g_queue_new();
+        g_hash_table_insert(waiting_requests, g_strdup(req->key), queue);
+    }
+
+    connpool_stats.waited++;
+    req->waiting = TRUE;
+    g_queue_push_tail(queue, req);
+}
+
+static void connpool_request_unwait(TwitterConnPoolRequest * req)
+{
+    GQueue         *queue;
+
+    if (!req->waiting)
+        return;
+    req->waiting = FALSE;
+
+    if (waiting_requests && (queue = g_hash_table_lookup(waiting_requests, req->key))) {
+        g_queue_remove(queue, req);
+        if (g_queue_is_empty(queue))
+            g_hash_table_remove(waiting_requests, req->key);
+    }
+}
+
+static TwitterConnPoolRequest *connpool_take_waiting(const gchar * key)
+{
+    GQueue         *queue;
+    TwitterConnPoolRequest *req;
+
+    if (!waiting_requests || !(queue = g_hash_table_lookup(waiting_requests, key)))
+        return NULL;
+
+    req = g_queue_peek_head(queue);
+    if (req)
+        connpool_request_unwait(req);
+    return req;
+}
+
+static gboolean connpool_waiting_cb(gpointer data)
+{
+    GList          *keys = NULL;
+    GList          *l;
+    GHashTableIter  iter;
+    gpointer        key;
+    TwitterConnPoolRequest *req;
+
+    waiting_timer = 0;
+    if (!waiting_requests)
+        return FALSE;
+
+    /* Starting a request can call back, which may change the table */
+    g_hash_table_iter_init(&iter, waiting_requests);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+        keys = g_list_prepend(keys, g_strdup(key));
+
+    for (l = keys; l; l = l->next) {
+        while (connpool_host_connections(l->data) < TWITTER_CONNPOOL_MAX_PER_HOST && (req = connpool_take_waiting(l->data)))
+            connpool_request_start(req);
+        g_free(l->data);
+    }
+    g_list_free(keys);
+    return FALSE;
+}
+
+static TwitterConnPoolConn *connpool_conn_new(const gchar * key, const gchar * host, int port, gboolean use_https)
+{
+    TwitterConnPoolConn *conn = g_new0(TwitterConnPoolConn, 1);
+    conn->key = g_strdup(key);
+    conn->host = g_strdup(host);
+    conn->port = port;
+    conn->use_https = use_https;
+    conn->fd = -1;
+    conn->ref = 1;
+    twitter_http_reader_init(&conn->reader);
+    return conn;
+}
+
+static void connpool_conn_ref(TwitterConnPoolConn * conn)
+{
+    conn->ref++;
+}
+
+static void connpool_conn_unref(TwitterConnPoolConn * conn)
+{
+    if (--conn->ref > 0)
+        return;
+    g_free(conn->key);
+    g_free(conn->host);
+    g_strfreev(conn->addresses);
+    twitter_http_reader_clear(&conn->reader);
+    g_free(conn);
+}
+
+static void connpool_idle_remove(TwitterConnPoolConn * conn)
+{
+    GQueue         *queue;
+
+    if (!conn->idle)
+        return;
+    conn->idle = FALSE;
+
+    if (conn->idle_timer) {
+        purple_timeout_remove(conn->idle_timer);
+        conn->idle_timer = 0;
+    }
+
+    if (idle_connections && (queue = g_hash_table_lookup(idle_connections, conn->key))) {
+        g_queue_remove(queue, conn);
+        if (g_queue_is_empty(queue))
+            g_hash_table_remove(idle_connections, conn->key);
+    }
+}
+
+static void connpool_conn_close(TwitterConnPoolConn * conn)
+{
+    if (conn->closed)
+        return;
+    conn->closed = TRUE;
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Closing connection to %s:%d\n", conn->host, conn->port);
+
+    connpool_idle_remove(conn);
+    unclaimed_connections = g_list_remove(unclaimed_connections, conn);
+
+    if (conn->dns_query)
+        prpltwtr_dns_query_cancel(conn->dns_query);
+    if (conn->fail_timer)
+        purple_timeout_remove(conn->fail_timer);
+    if (conn->write_watcher)
+        purple_input_remove(conn->write_watcher);
+    if (conn->read_watcher)
+        purple_input_remove(conn->read_watcher);
+    if (conn->connect_data)
+        purple_proxy_connect_cancel(conn->connect_data);
+
+    if (conn->gsc)
+        purple_ssl_close(conn->gsc);
+    else if (conn->fd >= 0)
+        close(conn->fd);
+
+    conn->dns_query = NULL;
+    conn->fail_timer = 0;
+    conn->write_watcher = 0;
+    conn->read_watcher = 0;
+    conn->connect_data = NULL;
+    conn->gsc = NULL;
+    conn->fd = -1;
+
+    open_connections--;
+    connpool_host_connections_add(conn->key, -1);
+
+    /* A request waiting for this host can open a connection now. Not from
+     * here though, we may be deep in another request's error handling */
+    if (!waiting_timer && waiting_requests && g_hash_table_lookup(waiting_requests, conn->key))
+        waiting_timer = purple_timeout_add(0, connpool_waiting_cb, NULL);
+
+    connpool_conn_unref(conn);
+}
+
+static gboolean connpool_idle_timeout_cb(gpointer data)
+{
+    TwitterConnPoolConn *conn = data;
+    conn->idle_timer = 0;
+    connpool_stats.evicted++;
+    connpool_conn_close(conn);
+    return FALSE;
+}
+
+static void connpool_conn_make_idle(TwitterConnPoolConn * conn)
+{
+    GQueue         *queue;
+    TwitterConnPoolRequest *req = connpool_take_waiting(conn->key);
+
+    if (req) {
+        /* Someone's been waiting for a connection to this host */
+        connpool_stats.reused++;
+        req->reused = TRUE;
+        req->conn = conn;
+        conn->request = req;
+        connpool_conn_send(conn);
+        return;
+    }
+
+    if (!idle_connections)
+        idle_connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_queue_free);
+
+    queue = g_hash_table_lookup(idle_connections, conn->key);
+    if (!queue) {
+        queue = g_queue_new();
+        g_hash_table_insert(idle_connections, g_strdup(conn->key), queue);
+    }
+
+    if (g_queue_get_length(queue) >= TWITTER_CONNPOOL_MAX_IDLE_PER_HOST) {
+        connpool_conn_close(conn);
+        return;
+    }
+
+    twitter_http_reader_reset(&conn->reader);
+    conn->idle = TRUE;
+    g_queue_push_head(queue, conn);
+    conn->idle_timer = purple_timeout_add_seconds(TWITTER_CONNPOOL_IDLE_TIMEOUT, connpool_idle_timeout_cb, conn);
+}
+
+static TwitterConnPoolConn *connpool_take_idle(const gchar * key)
+{
+    GQueue         *queue;
+    TwitterConnPoolConn *conn;
+
+    if (!idle_connections || !(queue = g_hash_table_lookup(idle_connections, key)))
+        return NULL;
+
+    conn = g_queue_peek_head(queue);
+    if (conn)
+        connpool_idle_remove(conn);
+    return conn;
+}
+
+static TwitterConnPoolConn *connpool_take_unclaimed(const gchar * key)
+{
+    GList          *l;
+
+    for (l = unclaimed_connections; l; l = l->next) {
+        TwitterConnPoolConn *conn = l->data;
+        if (!strcmp(conn->key, key)) {
+            unclaimed_connections = g_list_delete_link(unclaimed_connections, l);
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+static void connpool_conn_error(TwitterConnPoolConn * conn, const gchar * error_message)
+{
+    TwitterConnPoolRequest *req = conn->request;
+    gboolean        got_data = twitter_http_reader_started(&conn->reader);
+
+    /* The address may be stale, don't try it again */
+    if (conn->addresses && !conn->connected)
+        prpltwtr_dns_forget(conn->host, conn->addresses[conn->address_index]);
+
+    conn->request = NULL;
+    connpool_conn_close(conn);
+
+    if (!req)
+        return;
+    req->conn = NULL;
+
+    if (req->reused && !req->retried && !got_data && req->idempotent) {
+        /* The server dropped the keep-alive connection before we noticed.
+         * Nothing was received, so it's safe to send it again on a fresh
+         * one. Unless it's a POST: the server may have acted on it anyway */
+        purple_debug_info(GENERIC_PROTOCOL_ID, "Stale connection to %s, retrying request\n", req->host);
+        req->retried = TRUE;
+        req->written = 0;
+        connpool_request_start(req);
+        return;
+    }
+
+    connpool_request_complete(req, NULL, 0, error_message ? error_message : _("Connection failed"));
+}
+
+static void connpool_conn_send(TwitterConnPoolConn * conn)
+{
+    twitter_http_reader_reset(&conn->reader);
+    connpool_conn_write(conn);
+}
+
+static void connpool_send_cb(gpointer data, gint source, PurpleInputCondition cond)
+{
+    connpool_conn_write(data);
+}
+
+static void connpool_conn_write(TwitterConnPoolConn * conn)
+{
+    TwitterConnPoolRequest *req = conn->request;
+    GOutputVector   vectors[TWITTER_CONNPOOL_WRITE_VECTORS];
+    guint           count;
+    gssize          len;
+
+    while (req && (count = twitter_http_segments_get_vectors(req->segments, req->written, vectors, G_N_ELEMENTS(vectors))) > 0) {
+        if (conn->gsc) {
+            /* libpurple's SSL API takes one buffer at a time */
+            len = purple_ssl_write(conn->gsc, vectors[0].buffer, vectors[0].size);
+        } else {
+#ifndef _WIN32
+            struct iovec    iov[TWITTER_CONNPOOL_WRITE_VECTORS];
+            guint           i;
+
+            for (i = 0; i < count; i++) {
+                iov[i].iov_base = (void *) vectors[i].buffer;
+                iov[i].iov_len = vectors[i].size;
+            }
+            len = writev(conn->fd, iov, count);
+#else
+            len = write(conn->fd, vectors[0].buffer, vectors[0].size);
+#endif
+        }
+
+        if (len < 0 && errno == EAGAIN) {
+            if (!conn->write_watcher)
+                conn->write_watcher = purple_input_add(conn->fd, PURPLE_INPUT_WRITE, connpool_send_cb, conn);
+            return;
+        } else if (len <= 0) {
+            connpool_conn_error(conn, g_strerror(errno));
+            return;
+        }
+        req->written += len;
+    }
+
+    if (conn->write_watcher) {
+        purple_input_remove(conn->write_watcher);
+        conn->write_watcher = 0;
+    }
+}
+
+static void connpool_conn_ready(TwitterConnPoolConn * conn)
+{
+    unclaimed_connections = g_list_remove(unclaimed_connections, conn);
+    conn->connected = TRUE;
+    if (conn->request)
+        connpool_conn_send(conn);
+    else
+        connpool_conn_make_idle(conn);           /* the request was cancelled while we were connecting */
+}
+
+static void connpool_recv_cb(gpointer data, gint source, PurpleInputCondition cond)
+{
+    connpool_conn_read(data);
+}
+
+static void connpool_ssl_recv_cb(gpointer data, PurpleSslConnection * gsc, PurpleInputCondition cond)
+{
+    connpool_conn_read(data);
+}
+
+static void connpool_connected_cb(gpointer data, gint source, const gchar * error_message)
+{
+    TwitterConnPoolConn *conn = data;
+
+    conn->connect_data = NULL;
+    if (source < 0) {
+        purple_debug_error(GENERIC_PROTOCOL_ID, "Unable to connect to %s: %s\n", conn->host, error_message ? error_message : "");
+        if (!connpool_conn_connect_next(conn))
+            connpool_conn_error(conn, error_message);
+        return;
+    }
+
+#if PURPLE_VERSION_CHECK(2, 6, 0)
+    if (conn->use_https) {
+        PurpleSslConnection *gsc;
+
+        /* TLS is started on the socket, so the server name and certificate
+         * check use the host name and not the address we connected to */
+        conn->opening = TRUE;
+        gsc = purple_ssl_connect_with_host_fd(conn->account, source, connpool_ssl_connected_cb, connpool_ssl_error_cb, conn->host, conn);
+        conn->opening = FALSE;
+
+        if (!gsc || conn->ssl_failed) {
+            /* On a handshake error libpurple has closed the socket already */
+            if (!gsc)
+                close(source);
+            connpool_conn_error(conn, _("Unable to start SSL"));
+        } else {
+            conn->gsc = gsc;
+        }
+        return;
+    }
+#endif
+
+    conn->fd = source;
+    conn->read_watcher = purple_input_add(source, PURPLE_INPUT_READ, connpool_recv_cb, conn);
+    connpool_conn_ready(conn);
+}
+
+static void connpool_ssl_connected_cb(gpointer data, PurpleSslConnection * gsc, PurpleInputCondition cond)
+{
+    TwitterConnPoolConn *conn = data;
+
+    conn->fd = gsc->fd;
+    purple_ssl_input_add(gsc, connpool_ssl_recv_cb, conn);
+    connpool_conn_ready(conn);
+}
+
+static void connpool_ssl_error_cb(PurpleSslConnection * gsc, PurpleSslErrorType error, gpointer data)
+{
+    TwitterConnPoolConn *conn = data;
+
+    /* libpurple frees the ssl connection after this returns */
+    conn->gsc = NULL;
+    if (conn->opening) {
+        conn->ssl_failed = TRUE;
+        return;
+    }
+
+    purple_debug_error(GENERIC_PROTOCOL_ID, "SSL error connecting to %s: %s\n", conn->host, purple_ssl_strerror(error));
+    connpool_conn_error(conn, purple_ssl_strerror(error));
+}
+
+static gboolean connpool_open_failed_cb(gpointer data)
+{
+    TwitterConnPoolConn *conn = data;
+    conn->fail_timer = 0;
+    if (!connpool_conn_connect_next(conn))
+        connpool_conn_error(conn, _("Unable to connect"));
+    return FALSE;
+}
+
+static void connpool_conn_connect(TwitterConnPoolConn * conn)
+{
+    const gchar    *connect_host = conn->addresses ? conn->addresses[conn->address_index] : conn->host;
+
+    conn->opening = TRUE;
+#if PURPLE_VERSION_CHECK(2, 6, 0)
+    conn->connect_data = purple_proxy_connect(NULL, conn->account, connect_host, conn->port, connpool_connected_cb, conn);
+#else
+    if (conn->use_https)
+        conn->gsc = purple_ssl_connect(conn->account, conn->host, conn->port, connpool_ssl_connected_cb, connpool_ssl_error_cb, conn);
+    else
+        conn->connect_data = purple_proxy_connect(NULL, conn->account, connect_host, conn->port, connpool_connected_cb, conn);
+#endif
+    conn->opening = FALSE;
+
+    /* Never call back from within prpltwtr_connpool_request */
+    if (!conn->gsc && !conn->connect_data)
+        conn->fail_timer = purple_timeout_add(0, connpool_open_failed_cb, conn);
+}
+
+/// Connects to the next of host's addresses after the one that couldn't be
+/// connected to. Returns FALSE if there is none left to try.
+static gboolean connpool_conn_connect_next(TwitterConnPoolConn * conn)
+{
+    if (!conn->addresses || !conn->addresses[conn->address_index + 1])
+        return FALSE;
+
+    prpltwtr_dns_forget(conn->host, conn->addresses[conn->address_index]);
+    conn->address_index++;
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Trying %s's next address, %s\n", conn->host, conn->addresses[conn->address_index]);
+    connpool_conn_connect(conn);
+    return TRUE;
+}
+
+static void connpool_resolved_cb(const gchar * host, gchar ** addresses, gpointer user_data)
+{
+    TwitterConnPoolConn *conn = user_data;
+
+    conn->dns_query = NULL;
+    /* Without an address, libpurple gets to resolve it and report errors */
+    conn->addresses = g_strdupv(addresses);
+    connpool_conn_connect(conn);
+}
+
+static void connpool_conn_open(TwitterConnPoolConn * conn, PurpleAccount * account)
+{
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Opening new %s connection to %s:%d\n", conn->use_https ? "https" : "http", conn->host, conn->port);
+
+    connpool_stats.opened++;
+    open_connections++;
+    connpool_host_connections_add(conn->key, 1);
+    conn->account = account;
+
+#if PURPLE_VERSION_CHECK(2, 6, 0)
+    if (connpool_is_direct(account)) {
+        gchar         **addresses = prpltwtr_dns_lookup_cached(conn->host);
+        if (!addresses) {
+            conn->dns_query = prpltwtr_dns_resolve(conn->host, connpool_resolved_cb, conn);
+            return;
+        }
+        conn->addresses = g_strdupv(addresses);
+    }
+#endif
+
+    connpool_conn_connect(conn);
+}
+
+static void connpool_conn_record_stats(TwitterConnPoolConn * conn)
+{
+    gsize           wire_bytes;
+    gsize           bytes;
+
+    twitter_http_reader_take_counts(&conn->reader, &wire_bytes, &bytes);
+    if (conn->request)
+        prpltwtr_stats_add_transfer(conn->request->endpoint, wire_bytes, bytes);
+}
+
+static void connpool_conn_finish(TwitterConnPoolConn * conn)
+{
+    TwitterConnPoolRequest *req = conn->request;
+    gboolean        decode_failed = conn->reader.decode_failed;
+    GString        *response = twitter_http_reader_steal_response(&conn->reader);
+
+    conn->request = NULL;
+    req->conn = NULL;
+
+    /* Hand the connection back before calling back, so a follow-up request
+     * (the next page, say) can go straight out on it */
+    if (conn->reader.keep_alive && !conn->closed && !twitter_http_reader_has_trailing_data(&conn->reader))
+        connpool_conn_make_idle(conn);
+    else
+        connpool_conn_close(conn);
+
+    if (decode_failed)
+        connpool_request_complete(req, NULL, 0, _("Unable to decompress the response"));
+    else
+        connpool_request_complete(req, response->str, response->len, NULL);
+    g_string_free(response, TRUE);
+}
+
+static void connpool_conn_eof(TwitterConnPoolConn * conn, const gchar * error_message)
+{
+    if (!conn->request) {
+        /* An idle connection was closed by the server */
+        connpool_conn_close(conn);
+    } else if (!error_message && twitter_http_reader_eof(&conn->reader)) {
+        connpool_conn_finish(conn);
+    } else {
+        connpool_conn_error(conn, error_message ? error_message : _("Server closed the connection"));
+    }
+}
+
+static void connpool_conn_read(TwitterConnPoolConn * conn)
+{
+    gchar           buf[4096];
+    gssize          len;
+    gboolean        done;
+
+    connpool_conn_ref(conn);
+    while (!conn->closed) {
+        if (conn->gsc)
+            len = purple_ssl_read(conn->gsc, buf, sizeof (buf));
+        else
+            len = read(conn->fd, buf, sizeof (buf));
+
+        if (len < 0 && errno == EAGAIN)
+            break;
+
+        if (len <= 0) {
+            connpool_conn_eof(conn, len < 0 ? g_strerror(errno) : NULL);
+            break;
+        }
+
+        if (!conn->request) {
+            /* Nobody asked for this */
+            connpool_conn_close(conn);
+            break;
+        }
+
+        done = twitter_http_reader_feed(&conn->reader, buf, len);
+        connpool_conn_record_stats(conn);
+        if (done)
+            connpool_conn_finish(conn);
+    }
+    connpool_conn_unref(conn);
+}
+
+static void connpool_request_start(TwitterConnPoolRequest * req)
+{
+    TwitterConnPoolConn *conn = connpool_take_idle(req->key);
+
+    if (conn) {
+        connpool_stats.reused++;
+        req->reused = TRUE;
+        req->conn = conn;
+        conn->request = req;
+        conn->account = req->account;
+        connpool_conn_send(conn);
+        return;
+    }
+
+    req->reused = FALSE;
+    conn = connpool_take_unclaimed(req->key);
+    if (conn) {
+        /* Still connecting, it sends the request once it's ready */
+        req->conn = conn;
+        conn->request = req;
+        conn->account = req->account;
+        return;
+    }
+
+    if (connpool_host_connections(req->key) >= TWITTER_CONNPOOL_MAX_PER_HOST) {
+        connpool_request_wait(req);
+        return;
+    }
+
+    conn = connpool_conn_new(req->key, req->host, req->port, req->use_https);
+    req->conn = conn;
+    conn->request = req;
+    connpool_conn_open(conn, req->account);
+}
+
+TwitterConnPoolRequest *prpltwtr_connpool_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, TwitterConnPoolCallback callback, gpointer user_data)
+{
+    TwitterHttpSegments *segments = twitter_http_segments_new();
+
+    twitter_http_segments_add_take(segments, g_memdup(request, request_len), request_len);
+    return prpltwtr_connpool_request_segments(account, use_https, host, port, segments, callback, user_data);
+}
+
+TwitterConnPoolRequest *prpltwtr_connpool_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, TwitterConnPoolCallback callback, gpointer user_data)
+{
+    TwitterConnPoolRequest *req = g_new0(TwitterConnPoolRequest, 1);
+
+    req->account = account;
+    req->host = g_strdup(host);
+    req->port = port;
+    req->use_https = use_https;
+    req->key = connpool_key(account, use_https, host, port);
+    req->endpoint = twitter_http_segments_endpoint(segments);
+    req->idempotent = twitter_http_segments_is_idempotent(segments);
+    req->segments = segments;
+    req->callback = callback;
+    req->user_data = user_data;
+
+    connpool_request_start(req);
+
+    return req;
+}
+
+void prpltwtr_connpool_request_cancel(TwitterConnPoolRequest * req)
+{
+    TwitterConnPoolConn *conn = req->conn;
+
+    connpool_request_unwait(req);
+    if (conn) {
+        conn->request = NULL;
+        /* A half-read response can't be skipped reliably, so drop the
+         * connection. If we were still connecting, it goes to the idle pool */
+        if (conn->connected)
+            connpool_conn_close(conn);
+        else
+            unclaimed_connections = g_list_prepend(unclaimed_connections, conn);
+    }
+    connpool_request_free(req);
+}
+
+gchar          *prpltwtr_connpool_build_get(const gchar * url, gboolean * use_https, gchar ** host, int *port)
+{
+    gchar          *url_host = NULL;
+    gchar          *path = NULL;
+    int             url_port = 0;
+    gchar          *request;
+
+    if (!g_ascii_strncasecmp(url, "https://", 8)) {
+        if (!purple_ssl_is_supported())
+            return NULL;
+        *use_https = TRUE;
+    } else if (!g_ascii_strncasecmp(url, "http://", 7)) {
+        *use_https = FALSE;
+    } else {
+        return NULL;
+    }
+
+    if (!purple_url_parse(url, &url_host, &url_port, &path, NULL, NULL))
+        return NULL;
+
+    request = g_strdup_printf("GET /%s HTTP/1.1\r\n" "User-Agent: " TWITTER_USER_AGENT "\r\n" "Host: %s\r\n" "Connection: keep-alive\r\n\r\n", path ? path : "", url_host);
+
+    g_free(*host);
+    *host = url_host;
+    *port = url_port;
+    g_free(path);
+    return request;
+}
+
+TwitterConnPoolRequest *prpltwtr_connpool_fetch_url(PurpleAccount * account, const gchar * url, TwitterConnPoolCallback callback, gpointer user_data)
+{
+    gboolean        use_https = FALSE;
+    gchar          *host = NULL;
+    int             port = 0;
+    gchar          *request = prpltwtr_connpool_build_get(url, &use_https, &host, &port);
+    TwitterConnPoolRequest *req;
+
+    if (!request)
+        return NULL;
+
+    prpltwtr_dns_remember_host(host);
+    req = prpltwtr_connpool_request(account, use_https, host, port, request, strlen(request), callback, user_data);
+    req->redirects = TWITTER_CONNPOOL_MAX_REDIRECTS;
+    /* Image paths are unique per user, so count them by host */
+    g_free(req->endpoint);
+    req->endpoint = g_strdup(host);
+
+    g_free(request);
+    g_free(host);
+    return req;
+}
+
+void prpltwtr_connpool_warmup(PurpleAccount * account, gboolean use_https, const gchar * host, int port)
+{
+    gchar          *key = connpool_key(account, use_https, host, port);
+    TwitterConnPoolConn *conn;
+    GQueue         *queue;
+    GList          *l;
+
+    if (idle_connections && (queue = g_hash_table_lookup(idle_connections, key)) && !g_queue_is_empty(queue)) {
+        g_free(key);
+        return;
+    }
+    for (l = unclaimed_connections; l; l = l->next) {
+        if (!strcmp(((TwitterConnPoolConn *) l->data)->key, key)) {
+            g_free(key);
+            return;
+        }
+    }
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Warming up connection to %s:%d\n", host, port);
+    conn = connpool_conn_new(key, host, port, use_https);
+    unclaimed_connections = g_list_prepend(unclaimed_connections, conn);
+    connpool_conn_open(conn, account);
+    g_free(key);
+}
+
+static void connpool_count_idle_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+    *((guint *) user_data) += g_queue_get_length(value);
+}
+
+void prpltwtr_connpool_get_stats(TwitterConnPoolStats * stats)
+{
+    *stats = connpool_stats;
+    stats->idle = 0;
+    if (idle_connections)
+        g_hash_table_foreach(idle_connections, connpool_count_idle_foreach, &stats->idle);
+    stats->active = open_connections - stats->idle;
+}
+
+static void connpool_collect_idle_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+    GList         **conns = user_data;
+    GList          *l;
+    for (l = ((GQueue *) value)->head; l; l = l->next)
+        *conns = g_list_prepend(*conns, l->data);
+}
+
+void prpltwtr_connpool_close_idle()
+{
+    GList          *conns = NULL;
+    GList          *l;
+
+    if (!idle_connections)
+        return;
+
+    g_hash_table_foreach(idle_connections, connpool_collect_idle_foreach, &conns);
+    for (l = conns; l; l = l->next)
+        connpool_conn_close(l->data);
+    g_list_free(conns);
+}
+
+static void connpool_collect_account_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+    GList         **conns = user_data;
+    GList          *l;
+    for (l = ((GQueue *) value)->head; l; l = l->next)
+        if (((TwitterConnPoolConn *) l->data)->account == (*conns)->data)
+            *conns = g_list_append(*conns, l->data);
+}
+
+void prpltwtr_connpool_drop_account(PurpleAccount * account)
+{
+    GList          *conns = g_list_append(NULL, account);
+    GList          *l;
+
+    if (idle_connections)
+        g_hash_table_foreach(idle_connections, connpool_collect_account_foreach, &conns);
+    for (l = unclaimed_connections; l; l = l->next)
+        if (((TwitterConnPoolConn *) l->data)->account == account)
+            conns = g_list_append(conns, l->data);
+
+    for (l = conns->next; l; l = l->next)
+        connpool_conn_close(l->data);
+    g_list_free(conns);
+}
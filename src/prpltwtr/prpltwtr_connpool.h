@@ -0,0 +1,102 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_CONNPOOL_H_
+#define _TWITTER_CONNPOOL_H_
+
+#include <glib.h>
+#include <account.h>
+
+#include "prpltwtr_http.h"
+
+/* Seconds an idle keep-alive connection is kept before it is closed */
+#define TWITTER_CONNPOOL_IDLE_TIMEOUT 30
+
+/* Maximum number of idle connections kept per host */
+#define TWITTER_CONNPOOL_MAX_IDLE_PER_HOST 4
+
+/* Maximum number of connections open at once per host. Further requests
+ * wait for one of them to become free instead of opening another, so a
+ * burst of small requests (icons, say) doesn't pay for a TLS handshake each */
+#define TWITTER_CONNPOOL_MAX_PER_HOST 6
+
+/* Maximum number of redirects followed by prpltwtr_connpool_fetch_url */
+#define TWITTER_CONNPOOL_MAX_REDIRECTS 5
+
+typedef struct _TwitterConnPoolRequest TwitterConnPoolRequest;
+
+/// Called once per request, with the full response (status line, headers,
+/// blank line and the de-chunked body) or with an error message. The response
+/// text is only valid for the duration of the callback.
+typedef void    (*TwitterConnPoolCallback) (TwitterConnPoolRequest * req, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message);
+
+typedef struct {
+    guint           opened;                      /* connections opened (full TCP/TLS handshake) */
+    guint           reused;                      /* requests sent over an already open connection */
+    guint           waited;                      /* requests that waited for a connection to free up */
+    guint           evicted;                     /* idle connections closed by the idle timeout */
+    guint           idle;                        /* connections currently idle in the pool */
+    guint           active;                      /* connections currently serving a request */
+} TwitterConnPoolStats;
+
+/// Sends a raw HTTP/1.1 request to host:port over a pooled keep-alive
+/// connection, opening a new one if no idle connection to that host exists
+/// (or waiting for one, if TWITTER_CONNPOOL_MAX_PER_HOST are open already).
+/// The connections are shared by every account using the same host (and
+/// proxy setup).
+TwitterConnPoolRequest *prpltwtr_connpool_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, TwitterConnPoolCallback callback, gpointer user_data);
+
+/// Like prpltwtr_connpool_request, for a request in segments. They are
+/// sent with vectored writes where possible. Takes ownership of segments.
+TwitterConnPoolRequest *prpltwtr_connpool_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, TwitterConnPoolCallback callback, gpointer user_data);
+
+/// Fetches an http:// or https:// URL with a GET request, following
+/// redirects. Returns NULL if the URL can't be fetched.
+TwitterConnPoolRequest *prpltwtr_connpool_fetch_url(PurpleAccount * account, const gchar * url, TwitterConnPoolCallback callback, gpointer user_data);
+
+/// Builds a GET request for url. On return use_https, host and port tell
+/// where it should be sent (*host is freed and replaced). Returns NULL for
+/// a URL that can't be fetched.
+gchar          *prpltwtr_connpool_build_get(const gchar * url, gboolean * use_https, gchar ** host, int *port);
+
+/// Opens a connection to host:port ahead of the first request, unless one
+/// is already open or being opened. The first request to that host then
+/// takes it over, even if it's still connecting.
+void            prpltwtr_connpool_warmup(PurpleAccount * account, gboolean use_https, const gchar * host, int port);
+
+/// Cancels a request. The callback will not be called. If the request was
+/// already on the wire the connection is closed, since it cannot be reused.
+void            prpltwtr_connpool_request_cancel(TwitterConnPoolRequest * req);
+
+void            prpltwtr_connpool_get_stats(TwitterConnPoolStats * stats);
+
+/// Closes all idle connections.
+void            prpltwtr_connpool_close_idle(void);
+
+/// Closes the connections kept for the account, idle or being opened
+/// without a request, so none of them outlives it. Call once its own
+/// requests are cancelled; those of other accounts are left alone.
+void            prpltwtr_connpool_drop_account(PurpleAccount * account);
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <prefs.h>
+
+#include "prpltwtr_dns.h"
+
+typedef struct {
+    gchar         **addresses;
+    time_t          expires;
+} TwitterDnsEntry;
+
+struct _TwitterDnsQuery {
+    gchar          *host;
+    TwitterDnsCallback callback;
+    gpointer        user_data;
+};
+
+/* key: host, value: TwitterDnsEntry */
+static GHashTable *dns_cache = NULL;
+/* key: host being resolved, value: GList of TwitterDnsQuery */
+static GHashTable *dns_pending = NULL;
+/* TWITTER_PREFS_PREFETCH_HOSTS, most recently used first. The order is
+ * only saved along with a change to the hosts */
+static GList   *dns_remembered_hosts = NULL;
+static gboolean dns_remembered_loaded = FALSE;
+
+static void dns_entry_free(TwitterDnsEntry * entry)
+{
+    g_strfreev(entry->addresses);
+    g_free(entry);
+}
+
+static void dns_query_free(TwitterDnsQuery * query)
+{
+    g_free(query->host);
+    g_free(query);
+}
+
+gchar         **prpltwtr_dns_lookup_cached(const gchar * host)
+{
+    TwitterDnsEntry *entry;
+
+    if (!dns_cache || !(entry = g_hash_table_lookup(dns_cache, host)))
+        return NULL;
+    if (entry->expires <= time(NULL)) {
+        g_hash_table_remove(dns_cache, host);
+        return NULL;
+    }
+    return entry->addresses;
+}
+
+void prpltwtr_dns_forget(const gchar * host, const gchar * address)
+{
+    TwitterDnsEntry *entry;
+    guint           i, j;
+
+    if (!dns_cache || !(entry = g_hash_table_lookup(dns_cache, host)))
+        return;
+
+    for (i = 0, j = 0; entry->addresses[i]; i++) {
+        if (!strcmp(entry->addresses[i], address))
+            g_free(entry->addresses[i]);
+        else
+            entry->addresses[j++] = entry->addresses[i];
+    }
+    entry->addresses[j] = NULL;
+
+    if (!j)
+        g_hash_table_remove(dns_cache, host);
+}
+
+static void dns_resolved_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    gchar          *host = data;
+    GError         *error = NULL;
+    GList          *addresses = g_resolver_lookup_by_name_finish(G_RESOLVER(source), result, &error);
+    gchar         **strings = NULL;
+    GList          *queries = NULL;
+    GList          *l;
+    guint           i;
+
+    if (addresses) {
+        TwitterDnsEntry *entry = g_new0(TwitterDnsEntry, 1);
+
+        /* The addresses come sorted in the order they should be tried */
+        strings = g_new0(gchar *, g_list_length(addresses) + 1);
+        for (l = addresses, i = 0; l; l = l->next, i++)
+            strings[i] = g_inet_address_to_string(l->data);
+        entry->addresses = g_strdupv(strings);
+        entry->expires = time(NULL) + TWITTER_DNS_TTL;
+
+        if (!dns_cache)
+            dns_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) dns_entry_free);
+        g_hash_table_replace(dns_cache, g_strdup(host), entry);
+
+        purple_debug_info(GENERIC_PROTOCOL_ID, "Resolved %s to %s (%u addresses)\n", host, strings[0], i);
+        g_resolver_free_addresses(addresses);
+    } else {
+        purple_debug_error(GENERIC_PROTOCOL_ID, "Unable to resolve %s: %s\n", host, error->message);
+        g_error_free(error);
+    }
+
+    if (dns_pending) {
+        queries = g_hash_table_lookup(dns_pending, host);
+        g_hash_table_remove(dns_pending, host);
+    }
+    for (l = queries; l; l = l->next) {
+        TwitterDnsQuery *query = l->data;
+        if (query->callback)
+            query->callback(host, strings, query->user_data);
+        dns_query_free(query);
+    }
+    g_list_free(queries);
+
+    g_strfreev(strings);
+    g_free(host);
+}
+
+TwitterDnsQuery *prpltwtr_dns_resolve(const gchar * host, TwitterDnsCallback callback, gpointer user_data)
+{
+    TwitterDnsQuery *query = g_new0(TwitterDnsQuery, 1);
+    GList          *queries;
+
+    query->host = g_strdup(host);
+    query->callback = callback;
+    query->user_data = user_data;
+
+    if (!dns_pending)
+        dns_pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    queries = g_hash_table_lookup(dns_pending, host);
+    if (queries) {
+        queries = g_list_append(queries, query);
+    } else {
+        GResolver      *resolver = g_resolver_get_default();
+
+        queries = g_list_append(NULL, query);
+        g_hash_table_insert(dns_pending, g_strdup(host), queries);
+        g_resolver_lookup_by_name_async(resolver, host, NULL, dns_resolved_cb, g_strdup(host));
+        g_object_unref(resolver);
+    }
+
+    return query;
+}
+
+void prpltwtr_dns_query_cancel(TwitterDnsQuery * query)
+{
+    GList          *queries;
+
+    /* The lookup itself carries on, its result is still worth caching */
+    if (dns_pending && (queries = g_hash_table_lookup(dns_pending, query->host))) {
+        queries = g_list_remove(queries, query);
+        if (queries)
+            g_hash_table_replace(dns_pending, g_strdup(query->host), queries);
+        else
+            g_hash_table_remove(dns_pending, query->host);
+    }
+    dns_query_free(query);
+}
+
+void prpltwtr_dns_prefetch(const gchar * host)
+{
+    if (!host || !*host || prpltwtr_dns_lookup_cached(host))
+        return;
+    if (dns_pending && g_hash_table_lookup(dns_pending, host))
+        return;
+    prpltwtr_dns_resolve(host, NULL, NULL);
+}
+
+static void dns_remembered_load(void)
+{
+    if (dns_remembered_loaded)
+        return;
+    dns_remembered_loaded = TRUE;
+
+    purple_prefs_add_none("/prpltwtr");
+    purple_prefs_add_string_list(TWITTER_PREFS_PREFETCH_HOSTS, NULL);
+    dns_remembered_hosts = purple_prefs_get_string_list(TWITTER_PREFS_PREFETCH_HOSTS);
+}
+
+void prpltwtr_dns_remember_host(const gchar * host)
+{
+    GList          *l;
+
+    dns_remembered_load();
+
+    /* Most recently used first. Moving a known host up is kept in memory
+     * only: it's called for every icon fetch, and the prefs file is
+     * rewritten on every change */
+    for (l = dns_remembered_hosts; l; l = l->next) {
+        if (!strcmp(l->data, host))
+            break;
+    }
+    if (l) {
+        dns_remembered_hosts = g_list_remove_link(dns_remembered_hosts, l);
+        dns_remembered_hosts = g_list_concat(l, dns_remembered_hosts);
+        return;
+    }
+    dns_remembered_hosts = g_list_prepend(dns_remembered_hosts, g_strdup(host));
+
+    while (g_list_length(dns_remembered_hosts) > TWITTER_DNS_MAX_PREFETCH_HOSTS) {
+        l = g_list_last(dns_remembered_hosts);
+        g_free(l->data);
+        dns_remembered_hosts = g_list_delete_link(dns_remembered_hosts, l);
+    }
+
+    purple_prefs_set_string_list(TWITTER_PREFS_PREFETCH_HOSTS, dns_remembered_hosts);
+}
+
+void prpltwtr_dns_prefetch_remembered()
+{
+    GList          *l;
+
+    dns_remembered_load();
+    for (l = dns_remembered_hosts; l; l = l->next)
+        prpltwtr_dns_prefetch(l->data);
+}
@@ -0,0 +1,75 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+
+#ifndef _TWITTER_DNS_H_
+#define _TWITTER_DNS_H_
+
+#include <glib.h>
+
+/* Seconds a resolved address is used for. The system resolver doesn't
+ * tell us the record's TTL, so this is an upper bound on it */
+#define TWITTER_DNS_TTL 300
+
+/* Maximum number of hosts remembered to be resolved at login */
+#define TWITTER_DNS_MAX_PREFETCH_HOSTS 8
+
+/* Global pref holding the hosts resolved at login */
+#define TWITTER_PREFS_PREFETCH_HOSTS "/prpltwtr/prefetch_hosts"
+
+typedef struct _TwitterDnsQuery TwitterDnsQuery;
+
+/// Called with the addresses host resolved to, as a NULL-terminated list
+/// of strings in the order they should be tried, or NULL if it could not
+/// be resolved.
+typedef void    (*TwitterDnsCallback) (const gchar * host, gchar ** addresses, gpointer user_data);
+
+/// Returns the cached addresses of host, NULL-terminated, or NULL if there
+/// are none or they have expired. The cache is shared by all accounts.
+gchar         **prpltwtr_dns_lookup_cached(const gchar * host);
+
+/// Resolves host and caches the result. The callback is never called from
+/// within this function. Lookups of a host already being resolved share
+/// the same query.
+TwitterDnsQuery *prpltwtr_dns_resolve(const gchar * host, TwitterDnsCallback callback, gpointer user_data);
+
+/// Cancels a query. The callback will not be called.
+void            prpltwtr_dns_query_cancel(TwitterDnsQuery * query);
+
+/// Drops address from host's cached addresses, for when connecting to it
+/// failed. Once none are left, host is looked up again.
+void            prpltwtr_dns_forget(const gchar * host, const gchar * address);
+
+/// Resolves host in the background unless a fresh address is cached.
+void            prpltwtr_dns_prefetch(const gchar * host);
+
+/// Adds host to the hosts resolved by prpltwtr_dns_prefetch_remembered,
+/// which are kept across sessions. The pref is only written when a host
+/// is added or dropped.
+void            prpltwtr_dns_remember_host(const gchar * host);
+
+/// Resolves every remembered host in the background.
+void            prpltwtr_dns_prefetch_remembered(void);
+
+#endif
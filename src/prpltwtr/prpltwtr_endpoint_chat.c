@@ -4,6 +4,7 @@
 #include "prpltwtr_endpoint_search.h"
 #include "prpltwtr_endpoint_timeline.h"
 #include "prpltwtr_endpoint_list.h"
+#include "prpltwtr_statuscache.h"
 
 static TwitterEndpointChatSettings *TwitterEndpointChatSettingsLookup[TWITTER_CHAT_UNKNOWN];
 
@@ -39,6 +40,11 @@ void twitter_endpoint_chat_free(TwitterEndpointChat * ctx)
 {
     GList          *l;
 
+    /* Nobody wants the results any more */
+    if (ctx->requests) {
+        twitter_request_scope_free(ctx->requests);
+        ctx->requests = NULL;
+    }
     if (ctx->settings && ctx->settings->endpoint_data_free)
         ctx->settings->endpoint_data_free(ctx->endpoint_data);
     purple_account_get_connection(ctx->account);
@@ -68,6 +74,8 @@ TwitterEndpointChat *twitter_endpoint_chat_new(TwitterEndpointChatSettings * set
     ctx->endpoint_data = settings->create_endpoint_data ? settings->create_endpoint_data(components) : NULL;
     ctx->retrieval_in_progress = FALSE;
     ctx->retrieval_in_progress_timeout = 0;
+    ctx->requests = twitter_request_scope_new(purple_account_get_requestor(account));
+    twitter_request_scope_set_label(ctx->requests, chat_name);
 
     return ctx;
 }
@@ -369,6 +377,7 @@ void twitter_chat_got_user_tweets(TwitterEndpointChat * endpoint_chat, GList * u
             /* This could be more efficient */
             if (!twitter_sent_tweets_contains_id(endpoint_chat, user_tweet->status->id))
                 twitter_chat_got_tweet(endpoint_chat, user_tweet);
+            prpltwtr_statuscache_want_parent(prpltwtr_statuscache_get(account), user_tweet->status);
 
             status = twitter_user_tweet_take_tweet(user_tweet);
             twitter_buddy_set_status_data(account, user_tweet->screen_name, status);
@@ -399,12 +408,37 @@ static void twitter_add_sent_tweet_id(TwitterEndpointChat * endpoint_chat, gchar
     endpoint_chat->sent_tweet_ids = g_list_insert_sorted(endpoint_chat->sent_tweet_ids, p, (GCompareFunc) _tweet_id_compare);
 }
 
+static TwitterUsageClass twitter_endpoint_chat_usage_class(TwitterEndpointChat * endpoint)
+{
+    switch (endpoint->type) {
+    case TWITTER_CHAT_SEARCH:
+        return TWITTER_USAGE_SEARCHES;
+    case TWITTER_CHAT_TIMELINE:
+        return TWITTER_USAGE_TIMELINE;
+    case TWITTER_CHAT_LIST:
+        return TWITTER_USAGE_LISTS;
+    default:
+        return TWITTER_USAGE_OTHER;
+    }
+}
+
 static gboolean twitter_endpoint_chat_interval_timeout(gpointer data)
 {
     TwitterEndpointChat *endpoint = data;
-    if (endpoint->settings->interval_timeout)
-        return endpoint->settings->interval_timeout(endpoint);
-    return FALSE;
+    TwitterRequestor *r = purple_account_get_requestor(endpoint->account);
+    TwitterRequestScope *previous_scope;
+    gboolean        rv;
+
+    if (!endpoint->settings->interval_timeout)
+        return FALSE;
+    /* Near the daily budget, only every few refreshes go ahead */
+    if (prpltwtr_usage_is_cut(twitter_requestor_get_usage(r), twitter_endpoint_chat_usage_class(endpoint)) && ++endpoint->ticks_skipped < TWITTER_USAGE_CUT_FACTOR)
+        return TRUE;
+    endpoint->ticks_skipped = 0;
+    previous_scope = twitter_request_scope_enter(r, endpoint->requests);
+    rv = endpoint->settings->interval_timeout(endpoint);
+    twitter_request_scope_leave(r, previous_scope);
+    return rv;
 }
 
 void twitter_endpoint_chat_start(PurpleConnection * gc, TwitterEndpointChatSettings * settings, GHashTable * components, gboolean open_conv)
@@ -448,8 +482,12 @@ void twitter_endpoint_chat_start(PurpleConnection * gc, TwitterEndpointChatSetti
     if (!twitter_endpoint_chat_find(account, chat_name)) {
         TwitterConnectionData *twitter = gc->proto_data;
         TwitterEndpointChat *endpoint_chat = twitter_endpoint_chat_new(settings, settings->type, account, chat_name, components);
+        TwitterRequestScope *previous_scope;
+
         g_hash_table_insert(twitter->chat_contexts, g_strdup(purple_normalize(account, chat_name)), endpoint_chat);
+        previous_scope = twitter_request_scope_enter(twitter->requestor, endpoint_chat->requests);
         settings->on_start(endpoint_chat);
+        twitter_request_scope_leave(twitter->requestor, previous_scope);
 
         endpoint_chat->timer_handle = purple_timeout_add_seconds(60 * interval, twitter_endpoint_chat_interval_timeout, endpoint_chat);
 
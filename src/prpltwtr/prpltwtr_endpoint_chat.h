@@ -72,6 +72,8 @@ struct _TwitterEndpointChat {
     int             rate_limit_remaining;
     gboolean        retrieval_in_progress;
     int             retrieval_in_progress_timeout;  /* Prevent getting stuck */
+    TwitterRequestScope *requests;               /* fetches for the chat, cancelled when it's left */
+    guint           ticks_skipped;               /* refreshes let pass while saving data */
 };
 
 //Identifier to use for multithreading
@@ -1,7 +1,9 @@
 #include "prpltwtr_endpoint_im.h"
 #include "prpltwtr_util.h"
 #include "prpltwtr_conn.h"
+#include "prpltwtr_endpoint_userstream.h"
 
+static void     twitter_endpoint_im_get_last_since_id_success_cb(PurpleAccount * account, gchar * id, gpointer user_data);
 static void     twitter_endpoint_im_get_last_since_id_error_cb(PurpleAccount * account, const TwitterRequestErrorData * error_data, gpointer user_data);
 static void     twitter_endpoint_im_start_timer(TwitterEndpointIm * ctx);
 
@@ -73,11 +75,14 @@ TwitterEndpointIm *twitter_endpoint_im_new(PurpleAccount * account, TwitterEndpo
     endpoint->settings = settings;
     endpoint->retrieve_history = retrieve_history;
     endpoint->initial_max_retrieve = initial_max_retrieve;
+    endpoint->requests = twitter_request_scope_new(purple_account_get_requestor(account));
     return endpoint;
 }
 
 void twitter_endpoint_im_free(TwitterEndpointIm * ctx)
 {
+    /* First, as the error callbacks start the timer again */
+    twitter_request_scope_free(ctx->requests);
     if (ctx->timer) {
         purple_timeout_remove(ctx->timer);
         ctx->timer = 0;
@@ -108,15 +113,36 @@ static void twitter_endpoint_im_success_cb(TwitterRequestor * r, GList * nodes,
     twitter_endpoint_im_start_timer(ctx);
 }
 
+static void twitter_endpoint_im_fetch(TwitterEndpointIm * ctx)
+{
+    TwitterRequestor *r = purple_account_get_requestor(ctx->account);
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, ctx->requests);
+    // TODO Discard const gchar *
+    ctx->settings->get_im_func(r, (gchar *) twitter_endpoint_im_get_since_id(ctx), twitter_endpoint_im_success_cb, twitter_endpoint_im_error_cb, ctx->ran_once ? -1 : ctx->initial_max_retrieve, ctx);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
 static gboolean twitter_im_timer_timeout(gpointer _ctx)
 {
     TwitterEndpointIm *ctx = (TwitterEndpointIm *) _ctx;
-    // TODO Discard const gchar *
-    ctx->settings->get_im_func(purple_account_get_requestor(ctx->account), (gchar *) twitter_endpoint_im_get_since_id(ctx), twitter_endpoint_im_success_cb, twitter_endpoint_im_error_cb, ctx->ran_once ? -1 : ctx->initial_max_retrieve, ctx);
+
     ctx->timer = 0;
+    /* The user stream delivers these as they're sent */
+    if (twitter_endpoint_userstream_is_live(ctx->account))
+        twitter_endpoint_im_start_timer(ctx);
+    else
+        twitter_endpoint_im_fetch(ctx);
     return FALSE;
 }
 
+static void twitter_endpoint_im_get_last_since_id(TwitterEndpointIm * ctx)
+{
+    TwitterRequestor *r = purple_account_get_requestor(ctx->account);
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, ctx->requests);
+    ctx->settings->get_last_since_id(ctx->account, twitter_endpoint_im_get_last_since_id_success_cb, twitter_endpoint_im_get_last_since_id_error_cb, ctx);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
 static void twitter_endpoint_im_get_last_since_id_success_cb(PurpleAccount * account, gchar * id, gpointer user_data)
 {
     TwitterEndpointIm *im = user_data;
@@ -132,7 +158,7 @@ static void twitter_endpoint_im_get_last_since_id_success_cb(PurpleAccount * acc
 static gboolean twitter_endpoint_im_get_since_id_timeout(gpointer user_data)
 {
     TwitterEndpointIm *ctx = user_data;
-    ctx->settings->get_last_since_id(ctx->account, twitter_endpoint_im_get_last_since_id_success_cb, twitter_endpoint_im_get_last_since_id_error_cb, ctx);
+    twitter_endpoint_im_get_last_since_id(ctx);
     ctx->timer = 0;
     return FALSE;
 }
@@ -145,21 +171,36 @@ static void twitter_endpoint_im_get_last_since_id_error_cb(PurpleAccount * accou
 
 static void twitter_endpoint_im_start_timer(TwitterEndpointIm * ctx)
 {
-    ctx->timer = purple_timeout_add_seconds(60 * ctx->settings->timespan_func(ctx->account), twitter_im_timer_timeout, ctx);
+    TwitterRequestor *r = purple_account_get_requestor(ctx->account);
+    TwitterUsageClass usage_class = ctx->settings->type == TWITTER_IM_TYPE_DM ? TWITTER_USAGE_DMS : TWITTER_USAGE_REPLIES;
+    gint            minutes = ctx->settings->timespan_func(ctx->account);
+
+    /* Near the daily budget, check less often */
+    if (r && prpltwtr_usage_is_cut(twitter_requestor_get_usage(r), usage_class))
+        minutes *= TWITTER_USAGE_CUT_FACTOR;
+    ctx->timer = purple_timeout_add_seconds(60 * minutes, twitter_im_timer_timeout, ctx);
 }
 
 void twitter_endpoint_im_start(TwitterEndpointIm * ctx)
 {
     if (ctx->timer) {
         purple_timeout_remove(ctx->timer);
+        ctx->timer = 0;
     }
     if (!strcmp("0", twitter_endpoint_im_get_since_id(ctx)) && ctx->retrieve_history) {
-        ctx->settings->get_last_since_id(ctx->account, twitter_endpoint_im_get_last_since_id_success_cb, twitter_endpoint_im_get_last_since_id_error_cb, ctx);
+        twitter_endpoint_im_get_last_since_id(ctx);
     } else {
-        twitter_im_timer_timeout(ctx);
+        twitter_endpoint_im_fetch(ctx);
     }
 }
 
+void twitter_endpoint_im_catch_up(TwitterEndpointIm * ctx)
+{
+    /* Without a timer, a fetch is already under way */
+    if (ctx->timer)
+        twitter_endpoint_im_start(ctx);
+}
+
 const gchar    *twitter_endpoint_im_get_since_id(TwitterEndpointIm * ctx)
 {
     return (ctx->since_id ? ctx->since_id : twitter_endpoint_im_settings_load_since_id(ctx->account, ctx->settings));
@@ -36,6 +36,7 @@ typedef struct {
     //these should be 'private'
     guint           timer;
     gboolean        ran_once;
+    TwitterRequestScope *requests;               /* fetches, cancelled when the endpoint is freed */
 } TwitterEndpointIm;
 
 TwitterEndpointIm *twitter_endpoint_im_new(PurpleAccount * account, TwitterEndpointImSettings * settings, gboolean retrieve_history, gint initial_max_retrieve);
@@ -51,6 +52,9 @@ void            twitter_endpoint_im_set_since_id(TwitterEndpointIm * ctx, gchar
 const gchar    *twitter_endpoint_im_get_since_id(TwitterEndpointIm * ctx);
 
 void            twitter_endpoint_im_start(TwitterEndpointIm * ctx);
+/// Fetches what was sent since the last fetch now, instead of when the
+/// timer next fires
+void            twitter_endpoint_im_catch_up(TwitterEndpointIm * ctx);
 char           *twitter_endpoint_im_buddy_name_to_conv_name(TwitterEndpointIm * im, const char *name);
 void            twitter_status_data_update_conv(TwitterEndpointIm * ctx, char *buddy_name, TwitterTweet * s);
 TwitterImType   twitter_conv_name_to_type(PurpleAccount * account, const char *name);
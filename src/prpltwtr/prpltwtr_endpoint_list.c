@@ -1,4 +1,5 @@
 #include "prpltwtr_endpoint_list.h"
+#include "prpltwtr_sharedfetch.h"
 
 static gpointer twitter_list_timeout_context_new(GHashTable * components)
 {
@@ -98,11 +99,10 @@ static gboolean twitter_get_list_all_error_cb(TwitterRequestor * r, const Twitte
     return FALSE;                                /* Do not retry. Too many edge cases */
 }
 
-static void twitter_get_list_all_cb(TwitterRequestor * r, GList * nodes, gpointer user_data)
+static void twitter_get_list_all_cb(TwitterRequestor * r, GList * statuses, gpointer user_data)
 {
     TwitterEndpointChatId *chat_id = (TwitterEndpointChatId *) user_data;
     TwitterEndpointChat *endpoint_chat;
-    GList          *statuses;
 
     purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
 
@@ -110,8 +110,11 @@ static void twitter_get_list_all_cb(TwitterRequestor * r, GList * nodes, gpointe
     endpoint_chat = twitter_endpoint_chat_find_by_id(chat_id);
     twitter_endpoint_chat_id_free(chat_id);
 
-    if (endpoint_chat == NULL)
+    if (endpoint_chat == NULL) {
+        g_list_foreach(statuses, (GFunc) twitter_user_tweet_free, NULL);
+        g_list_free(statuses);
         return;
+    }
 
     endpoint_chat->rate_limit_remaining = r->rate_limit_remaining;
     endpoint_chat->rate_limit_total = r->rate_limit_total;
@@ -119,16 +122,21 @@ static void twitter_get_list_all_cb(TwitterRequestor * r, GList * nodes, gpointe
     endpoint_chat->retrieval_in_progress = FALSE;
     endpoint_chat->retrieval_in_progress_timeout = 0;
 
-    statuses = twitter_statuses_nodes_parse(r, nodes);
     twitter_get_list_parse_statuses(endpoint_chat, statuses);
 }
 
+static void twitter_list_fetch(TwitterRequestor * r, const gchar * list_id, gchar * since_id, TwitterSendRequestMultiPageAllSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gint max_count, gpointer data)
+{
+    twitter_api_get_list_all(r, list_id, NULL, since_id, success_func, error_func, max_count, data);
+}
+
 static gboolean twitter_list_timeout(TwitterEndpointChat * endpoint_chat)
 {
     PurpleAccount  *account = endpoint_chat->account;
     TwitterListTimeoutContext *ctx = endpoint_chat->endpoint_data;
     TwitterEndpointChatId *chat_id = NULL;
     gchar          *key = g_strdup_printf("list_%s", ctx->list_name);
+    gchar          *resource;
 
     ctx->last_tweet_id = g_strdup(purple_account_get_string(endpoint_chat->account, key, NULL));
     g_free(key);
@@ -156,7 +164,13 @@ static gboolean twitter_list_timeout(TwitterEndpointChat * endpoint_chat)
     } else {
         purple_debug_info(purple_account_get_protocol_id(account), "Retrieving %s statuses since %s\n", ctx->list_name, ctx->last_tweet_id);
     }
-    twitter_api_get_list_all(purple_account_get_requestor(account), ctx->list_id, ctx->owner, ctx->last_tweet_id, twitter_get_list_all_cb, twitter_get_list_all_error_cb, twitter_option_list_max_tweets(account), chat_id);
+    /* A private list, or one with protected users in it, shows each
+     * account something else, so only the account's own chats share its
+     * fetch, or its result for half the interval */
+    resource = g_strdup_printf("list %s %s", ctx->list_id, purple_normalize(account, purple_account_get_username(account)));
+    prpltwtr_sharedfetch_get_all(purple_account_get_requestor(account), resource, ctx->list_id, ctx->last_tweet_id, 60 * twitter_option_list_timeout(account) / 2, twitter_list_fetch, twitter_get_list_all_cb,
+                                 twitter_get_list_all_error_cb, twitter_option_list_max_tweets(account), chat_id);
+    g_free(resource);
 
     return TRUE;
 }
@@ -1,5 +1,6 @@
 #include "prpltwtr_endpoint_reply.h"
 #include "prpltwtr_util.h"
+#include "prpltwtr_statuscache.h"
 
 static void twitter_send_reply_success_cb(PurpleAccount * account, gpointer node, gboolean last, gpointer _who)
 {
@@ -106,6 +107,7 @@ static void _process_replies(PurpleAccount * account, GList * statuses, TwitterC
         } else {
             gchar          *reply_id;
             twitter_buddy_set_user_data(account, user_data, FALSE);
+            prpltwtr_statuscache_want_parent(prpltwtr_statuscache_get(account), status);
             twitter_status_data_update_conv(ctx, data->screen_name, status);
 
             /* update user_reply_id_table table */
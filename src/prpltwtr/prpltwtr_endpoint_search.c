@@ -1,9 +1,21 @@
 #include "prpltwtr_endpoint_search.h"
+#include "prpltwtr_sharedfetch.h"
+
+struct _TwitterSearchStream {
+    PurpleAccount  *account;
+    TwitterStream  *stream;                      /* NULL while no open search can be streamed */
+    GHashTable     *terms;                       /* the terms it's tracking */
+    guint           rebuild_timer;
+};
+
+static gchar   *twitter_search_stream_term(const gchar * search);
+static void     twitter_search_stream_changed(PurpleAccount * account);
 
 static gpointer twitter_search_timeout_context_new(GHashTable * components)
 {
     TwitterSearchTimeoutContext *ctx = g_slice_new0(TwitterSearchTimeoutContext);
     ctx->search_name = g_strdup(g_hash_table_lookup(components, "search"));
+    ctx->stream_term = twitter_search_stream_term(ctx->search_name);
     return ctx;
 }
 
@@ -21,6 +33,11 @@ static void twitter_search_timeout_context_free(gpointer _ctx)
     g_free(ctx->last_tweet_id);
     ctx->last_tweet_id = NULL;
 
+    /* Stop tracking it */
+    if (ctx->account)
+        twitter_search_stream_changed(ctx->account);
+    g_free(ctx->stream_term);
+
     g_slice_free(TwitterSearchTimeoutContext, ctx);
 }
 
@@ -98,11 +115,10 @@ static gboolean twitter_get_search_all_error_cb(TwitterRequestor * r, const Twit
     return FALSE;                                /* Do not retry. Too many edge cases */
 }
 
-static void twitter_get_search_all_cb(TwitterRequestor * r, GList * nodes, gpointer user_data)
+static void twitter_get_search_all_cb(TwitterRequestor * r, GList * statuses, gpointer user_data)
 {
     TwitterEndpointChatId *chat_id = (TwitterEndpointChatId *) user_data;
     TwitterEndpointChat *endpoint_chat;
-    GList          *statuses;
 
     purple_debug_info(purple_account_get_protocol_id(r->account), "%s\n", G_STRFUNC);
 
@@ -110,8 +126,11 @@ static void twitter_get_search_all_cb(TwitterRequestor * r, GList * nodes, gpoin
     endpoint_chat = twitter_endpoint_chat_find_by_id(chat_id);
     twitter_endpoint_chat_id_free(chat_id);
 
-    if (endpoint_chat == NULL)
+    if (endpoint_chat == NULL) {
+        g_list_foreach(statuses, (GFunc) twitter_user_tweet_free, NULL);
+        g_list_free(statuses);
         return;
+    }
 
     endpoint_chat->rate_limit_remaining = r->rate_limit_remaining;
     endpoint_chat->rate_limit_total = r->rate_limit_total;
@@ -119,7 +138,6 @@ static void twitter_get_search_all_cb(TwitterRequestor * r, GList * nodes, gpoin
     endpoint_chat->retrieval_in_progress = FALSE;
     endpoint_chat->retrieval_in_progress_timeout = 0;
 
-    statuses = twitter_statuses_nodes_parse(r, nodes);
     twitter_get_search_parse_statuses(endpoint_chat, statuses);
 }
 
@@ -129,6 +147,7 @@ static gboolean twitter_search_timeout(TwitterEndpointChat * endpoint_chat)
     TwitterSearchTimeoutContext *ctx = (TwitterSearchTimeoutContext *) endpoint_chat->endpoint_data;
     TwitterEndpointChatId *chat_id = twitter_endpoint_chat_id_new(endpoint_chat);
     gchar          *key = g_strdup_printf("search_%s", ctx->search_name);
+    gchar          *resource;
 
     ctx->last_tweet_id = g_strdup(purple_account_get_string(endpoint_chat->account, key, NULL));
     g_free(key);
@@ -154,13 +173,321 @@ static gboolean twitter_search_timeout(TwitterEndpointChat * endpoint_chat)
     } else {
         purple_debug_info(purple_account_get_protocol_id(account), "Retrieving %s statuses since %s\n", ctx->search_name, ctx->last_tweet_id);
     }
-    twitter_api_get_search_all(purple_account_get_requestor(account), ctx->search_name, ctx->last_tweet_id, twitter_get_search_all_cb, twitter_get_search_all_error_cb, TWITTER_SEARCH_COUNT_DEFAULT, chat_id);
+    resource = g_strdup_printf("search %s", ctx->search_name);
+    /* Other accounts with the search open share the fetch, or its result
+     * for half the interval */
+    prpltwtr_sharedfetch_get_all(purple_account_get_requestor(account), resource, ctx->search_name, ctx->last_tweet_id, 60 * twitter_option_search_timeout(account) / 2, twitter_api_get_search_all, twitter_get_search_all_cb,
+                                 twitter_get_search_all_error_cb, TWITTER_SEARCH_COUNT_DEFAULT, chat_id);
+    g_free(resource);
 
     return TRUE;
 }
 
+/// Returns the search as a filter stream term: lowercase words, all of
+/// which must be in a tweet. Returns NULL if the search uses operators or
+/// characters the stream can't match the way search does.
+static gchar   *twitter_search_stream_term(const gchar * search)
+{
+    gchar         **words;
+    GString        *term;
+    gchar          *term_lower;
+    int             i;
+
+    if (!search)
+        return NULL;
+
+    words = g_strsplit_set(search, " \t", -1);
+    term = g_string_new(NULL);
+    for (i = 0; words[i]; i++) {
+        const gchar    *p = words[i];
+
+        if (*p == '\0')
+            continue;
+        /* OR, or a word with an operator such as from: or -exclude */
+        if (!strcmp(p, "OR"))
+            break;
+        if (*p == '#' || *p == '@')
+            p++;
+        if (*p == '\0')
+            break;
+        for (; *p; p = g_utf8_next_char(p))
+            if (!g_unichar_isalnum(g_utf8_get_char(p)) && *p != '_')
+                break;
+        if (*p)
+            break;
+
+        if (term->len)
+            g_string_append_c(term, ' ');
+        g_string_append(term, words[i]);
+    }
+
+    if (words[i] || !term->len || term->len > TWITTER_SEARCH_STREAM_MAX_TERM_LENGTH) {
+        g_strfreev(words);
+        g_string_free(term, TRUE);
+        return NULL;
+    }
+    g_strfreev(words);
+    term_lower = g_utf8_strdown(term->str, -1);
+    g_string_free(term, TRUE);
+    return term_lower;
+}
+
+/// Splits text into the set of lowercase words terms are matched against.
+/// A hashtag or mention is in it both with and without its # or @.
+static GHashTable *twitter_search_stream_words(const gchar * text)
+{
+    GHashTable     *words = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gchar          *lower = g_utf8_strdown(text, -1);
+    const gchar    *start = NULL;
+    const gchar    *p;
+
+    for (p = lower;; p = g_utf8_next_char(p)) {
+        gunichar        c = g_utf8_get_char(p);
+
+        if (c && (g_unichar_isalnum(c) || c == '_')) {
+            if (!start)
+                start = p;
+            continue;
+        }
+        if (start && !((*start == '#' || *start == '@') && start + 1 == p)) {
+            g_hash_table_replace(words, g_strndup(start, p - start), GINT_TO_POINTER(TRUE));
+            if (*start == '#' || *start == '@')
+                g_hash_table_replace(words, g_strndup(start + 1, p - start - 1), GINT_TO_POINTER(TRUE));
+        }
+        start = (c == '#' || c == '@') ? p : NULL;
+        if (!c)
+            break;
+    }
+    g_free(lower);
+    return words;
+}
+
+static gboolean twitter_search_stream_matches(const gchar * term, GHashTable * words)
+{
+    gchar         **term_words = g_strsplit(term, " ", -1);
+    gboolean        matches = TRUE;
+    int             i;
+
+    for (i = 0; matches && term_words[i]; i++)
+        matches = g_hash_table_lookup(words, term_words[i]) != NULL;
+    g_strfreev(term_words);
+    return matches;
+}
+
+static TwitterSearchStream *twitter_search_stream_find(PurpleAccount * account)
+{
+    PurpleConnection *gc = purple_account_get_connection(account);
+    TwitterConnectionData *twitter = gc ? gc->proto_data : NULL;
+
+    return twitter ? twitter->search_stream : NULL;
+}
+
+/// Whether the stream is delivering the chat's tweets, so it needn't poll
+static gboolean twitter_search_stream_covers(TwitterSearchStream * search_stream, TwitterSearchTimeoutContext * ctx)
+{
+    return search_stream && ctx->stream_term && g_hash_table_lookup(search_stream->terms, ctx->stream_term) && twitter_stream_is_live(search_stream->stream);
+}
+
+/// Calls func for each of the account's search chats that the stream
+/// tracks. They're gathered first, as func may change the chats.
+static void twitter_search_stream_foreach_chat(TwitterSearchStream * search_stream, void (*func) (TwitterSearchStream * search_stream, TwitterEndpointChat * endpoint_chat, gpointer data), gpointer data)
+{
+    PurpleConnection *gc = purple_account_get_connection(search_stream->account);
+    TwitterConnectionData *twitter = gc->proto_data;
+    GList          *chat_ids = NULL;
+    GList          *l;
+    GHashTableIter  iter;
+    gpointer        value;
+
+    g_hash_table_iter_init(&iter, twitter->chat_contexts);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        TwitterEndpointChat *endpoint_chat = value;
+        TwitterSearchTimeoutContext *ctx = endpoint_chat->endpoint_data;
+
+        if (endpoint_chat->type == TWITTER_CHAT_SEARCH && ctx->stream_term && g_hash_table_lookup(search_stream->terms, ctx->stream_term))
+            chat_ids = g_list_prepend(chat_ids, twitter_endpoint_chat_id_new(endpoint_chat));
+    }
+    for (l = chat_ids; l; l = l->next) {
+        TwitterEndpointChat *endpoint_chat = twitter_endpoint_chat_find_by_id(l->data);
+
+        if (endpoint_chat)
+            func(search_stream, endpoint_chat, data);
+        twitter_endpoint_chat_id_free(l->data);
+    }
+    g_list_free(chat_ids);
+}
+
+static void twitter_search_stream_deliver(TwitterSearchStream * search_stream, TwitterEndpointChat * endpoint_chat, gpointer data)
+{
+    gpointer       *message = data;
+    TwitterSearchTimeoutContext *ctx = endpoint_chat->endpoint_data;
+    TwitterRequestor *r = purple_account_get_requestor(search_stream->account);
+
+    if (twitter_search_stream_matches(ctx->stream_term, message[1]))
+        twitter_get_search_parse_statuses(endpoint_chat, twitter_statuses_node_parse(r, message[0]));
+}
+
+static void twitter_search_stream_message_cb(TwitterStream * stream, gpointer node, gpointer user_data)
+{
+    TwitterSearchStream *search_stream = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(search_stream->account);
+    gchar          *text;
+    gpointer        message[2];
+
+    /* Limit notices and warnings */
+    if (!r->format->get_node(node, "user") || !(text = r->format->get_str(node, "text"))) {
+        purple_debug_info(purple_account_get_protocol_id(search_stream->account), "Ignoring search stream message\n");
+        return;
+    }
+
+    /* The stream doesn't say which term matched, so work it out again */
+    message[0] = node;
+    message[1] = twitter_search_stream_words(text);
+    twitter_search_stream_foreach_chat(search_stream, twitter_search_stream_deliver, message);
+    g_hash_table_destroy(message[1]);
+    g_free(text);
+}
+
+static void twitter_search_stream_catch_up(TwitterSearchStream * search_stream, TwitterEndpointChat * endpoint_chat, gpointer data)
+{
+    TwitterRequestor *r = purple_account_get_requestor(search_stream->account);
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, endpoint_chat->requests);
+
+    twitter_search_timeout(endpoint_chat);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
+static void twitter_search_stream_connected_cb(TwitterStream * stream, gpointer user_data)
+{
+    /* Fetch whatever was posted while the stream was down */
+    twitter_search_stream_foreach_chat(user_data, twitter_search_stream_catch_up, NULL);
+}
+
+static gint twitter_search_stream_term_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(a, b);
+}
+
+/// Reconnects the stream with the terms of the searches open now, unless
+/// they're the ones it's already tracking
+static gboolean twitter_search_stream_rebuild_timeout(gpointer data)
+{
+    TwitterSearchStream *search_stream = data;
+    PurpleAccount  *account = search_stream->account;
+    TwitterRequestor *r = purple_account_get_requestor(account);
+    TwitterConnectionData *twitter = purple_account_get_connection(account)->proto_data;
+    GHashTable     *terms = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gboolean        changed;
+    GHashTableIter  iter;
+    gpointer        value;
+
+    search_stream->rebuild_timer = 0;
+
+    g_hash_table_iter_init(&iter, twitter->chat_contexts);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        TwitterEndpointChat *endpoint_chat = value;
+        TwitterSearchTimeoutContext *ctx = endpoint_chat->endpoint_data;
+
+        if (endpoint_chat->type == TWITTER_CHAT_SEARCH && ctx->stream_term && g_hash_table_size(terms) < TWITTER_SEARCH_STREAM_MAX_TERMS)
+            g_hash_table_replace(terms, g_strdup(ctx->stream_term), GINT_TO_POINTER(TRUE));
+    }
+
+    changed = g_hash_table_size(terms) != g_hash_table_size(search_stream->terms);
+    g_hash_table_iter_init(&iter, terms);
+    while (!changed && g_hash_table_iter_next(&iter, &value, NULL))
+        changed = !g_hash_table_lookup(search_stream->terms, value);
+    if (!changed) {
+        g_hash_table_destroy(terms);
+        return FALSE;
+    }
+
+    g_hash_table_destroy(search_stream->terms);
+    search_stream->terms = terms;
+
+    if (!g_hash_table_size(terms)) {
+        purple_debug_info(purple_account_get_protocol_id(account), "No searches to stream, closing the search stream\n");
+        twitter_stream_free(search_stream->stream);
+        search_stream->stream = NULL;
+    } else {
+        GList          *keys = g_list_sort(g_hash_table_get_keys(terms), twitter_search_stream_term_compare);
+        GString        *track = g_string_new(NULL);
+        TwitterRequestParams *params = twitter_request_params_new();
+        GList          *l;
+
+        for (l = keys; l; l = l->next) {
+            if (track->len)
+                g_string_append_c(track, ',');
+            g_string_append(track, l->data);
+        }
+        g_list_free(keys);
+
+        purple_debug_info(purple_account_get_protocol_id(account), "Streaming %u searches: %s\n", g_hash_table_size(terms), track->str);
+        twitter_request_params_add(params, twitter_request_param_new("track", track->str));
+        twitter_request_params_add(params, twitter_request_param_new("delimited", "length"));
+        twitter_request_params_add(params, twitter_request_param_new("stall_warnings", "true"));
+        if (search_stream->stream) {
+            twitter_stream_set_params(search_stream->stream, params);
+        } else {
+            search_stream->stream = twitter_stream_new(r, TRUE, r->urls->search_stream, params, twitter_search_stream_message_cb, twitter_search_stream_connected_cb, search_stream);
+            twitter_stream_start(search_stream->stream);
+        }
+        twitter_request_params_free(params);
+        g_string_free(track, TRUE);
+    }
+    return FALSE;
+}
+
+/// Called when a search chat starts or goes away
+static void twitter_search_stream_changed(PurpleAccount * account)
+{
+    TwitterSearchStream *search_stream = twitter_search_stream_find(account);
+
+    if (!search_stream)
+        return;
+    if (search_stream->rebuild_timer)
+        purple_timeout_remove(search_stream->rebuild_timer);
+    search_stream->rebuild_timer = purple_timeout_add_seconds(TWITTER_SEARCH_STREAM_REBUILD_DELAY, twitter_search_stream_rebuild_timeout, search_stream);
+}
+
+TwitterSearchStream *twitter_endpoint_search_stream_new(PurpleAccount * account)
+{
+    TwitterRequestor *r = purple_account_get_requestor(account);
+    TwitterSearchStream *search_stream;
+
+    if (!twitter_option_use_search_stream(account) || !r->urls->search_stream || !r->do_send_streaming)
+        return NULL;
+
+    search_stream = g_new0(TwitterSearchStream, 1);
+    search_stream->account = account;
+    search_stream->terms = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    return search_stream;
+}
+
+void twitter_endpoint_search_stream_free(TwitterSearchStream * search_stream)
+{
+    if (!search_stream)
+        return;
+    if (search_stream->rebuild_timer)
+        purple_timeout_remove(search_stream->rebuild_timer);
+    twitter_stream_free(search_stream->stream);
+    g_hash_table_destroy(search_stream->terms);
+    g_free(search_stream);
+}
+
+static gboolean twitter_search_interval_timeout(TwitterEndpointChat * endpoint_chat)
+{
+    /* The search stream delivers its tweets as they're posted */
+    if (twitter_search_stream_covers(twitter_search_stream_find(endpoint_chat->account), endpoint_chat->endpoint_data))
+        return TRUE;
+    return twitter_search_timeout(endpoint_chat);
+}
+
 static gboolean twitter_endpoint_search_interval_start(TwitterEndpointChat * endpoint_chat)
 {
+    TwitterSearchTimeoutContext *ctx = endpoint_chat->endpoint_data;
+
+    ctx->account = endpoint_chat->account;
+    twitter_search_stream_changed(ctx->account);
     return twitter_search_timeout(endpoint_chat);
 }
 
@@ -180,7 +507,7 @@ static TwitterEndpointChatSettings TwitterEndpointSearchSettings = {
     twitter_option_search_timeout,               //get_default_interval
     twitter_search_chat_name_from_components,    //get_name
     twitter_search_verify_components,            //verify_components
-    twitter_search_timeout,                      //interval_timeout
+    twitter_search_interval_timeout,             //interval_timeout
     twitter_endpoint_search_interval_start,
     twitter_search_timeout_context_new,
 };
@@ -31,14 +31,31 @@
 #include "prpltwtr_prefs.h"
 #include "prpltwtr_api.h"
 
+/* Most terms one filter stream tracks. Searches past it are polled */
+#define TWITTER_SEARCH_STREAM_MAX_TERMS 400
+/* Longest term the filter stream accepts (bytes) */
+#define TWITTER_SEARCH_STREAM_MAX_TERM_LENGTH 60
+/* Seconds a change of searches waits for others before the stream is
+ * reconnected, so opening many at once costs a single reconnect */
+#define TWITTER_SEARCH_STREAM_REBUILD_DELAY 5
+
 typedef struct {
     gchar          *search_name;
 //    gchar          *list_id;
 //    gchar          *owner;
 
     gchar          *last_tweet_id;
+    gchar          *stream_term;                 /* how the filter stream tracks it, NULL if it can't */
+    PurpleAccount  *account;                     /* set once the chat has started */
 } TwitterSearchTimeoutContext;
 
 TwitterEndpointChatSettings *twitter_endpoint_search_get_settings(void);
 
+/// Creates the filter stream that the account's search chats share while
+/// their searches are simple enough for it to track. Returns NULL if the
+/// account can't have one (turned off, not Twitter, or a backend without
+/// streaming), in which case every search is polled.
+TwitterSearchStream *twitter_endpoint_search_stream_new(PurpleAccount * account);
+void            twitter_endpoint_search_stream_free(TwitterSearchStream * search_stream);
+
 #endif
@@ -218,6 +218,47 @@ static gboolean twitter_endpoint_timeline_interval_start(TwitterEndpointChat * e
     return twitter_timeline_timeout(endpoint_chat);
 }
 
+static gboolean twitter_timeline_interval_timeout(TwitterEndpointChat * endpoint_chat)
+{
+    /* The user stream delivers the timeline as it's posted */
+    if (twitter_endpoint_userstream_is_live(endpoint_chat->account))
+        return TRUE;
+    return twitter_timeline_timeout(endpoint_chat);
+}
+
+static TwitterEndpointChat *twitter_endpoint_timeline_find(PurpleAccount * account)
+{
+    gchar          *chat_name = twitter_chat_name_from_timeline_id(0);
+    TwitterEndpointChat *endpoint_chat = twitter_endpoint_chat_find(account, chat_name);
+
+    g_free(chat_name);
+    return endpoint_chat;
+}
+
+void twitter_endpoint_timeline_got_user_tweets(PurpleAccount * account, GList * statuses)
+{
+    TwitterEndpointChat *endpoint_chat = twitter_endpoint_timeline_find(account);
+
+    if (endpoint_chat) {
+        twitter_get_home_timeline_parse_statuses(endpoint_chat, statuses);
+    } else {
+        g_list_free_full(statuses, (GDestroyNotify) twitter_user_tweet_free);
+    }
+}
+
+void twitter_endpoint_timeline_catch_up(PurpleAccount * account)
+{
+    TwitterEndpointChat *endpoint_chat = twitter_endpoint_timeline_find(account);
+    TwitterRequestor *r = purple_account_get_requestor(account);
+    TwitterRequestScope *previous_scope;
+
+    if (!endpoint_chat)
+        return;
+    previous_scope = twitter_request_scope_enter(r, endpoint_chat->requests);
+    twitter_timeline_timeout(endpoint_chat);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
 static TwitterEndpointChatSettings TwitterEndpointTimelineSettings = {
     TWITTER_CHAT_TIMELINE,
 #ifdef _HAZE_
@@ -228,7 +269,7 @@ static TwitterEndpointChatSettings TwitterEndpointTimelineSettings = {
     twitter_option_timeline_timeout,             //get_default_interval
     twitter_timeline_chat_name_from_components,  //get_name
     NULL,                                        //verify_components
-    twitter_timeline_timeout, twitter_endpoint_timeline_interval_start, twitter_timeline_timeout_context_new,
+    twitter_timeline_interval_timeout, twitter_endpoint_timeline_interval_start, twitter_timeline_timeout_context_new,
 };
 
 TwitterEndpointChatSettings *twitter_endpoint_timeline_get_settings(void)
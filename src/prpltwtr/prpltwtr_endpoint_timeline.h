@@ -33,6 +33,7 @@
 #include "prpltwtr_xml.h"
 #include "prpltwtr_buddy.h"
 #include "prpltwtr_conn.h"
+#include "prpltwtr_endpoint_userstream.h"
 #include "prpltwtr_util.h"                       //TODO remove
 
 typedef struct {
@@ -41,4 +42,11 @@ typedef struct {
 
 TwitterEndpointChatSettings *twitter_endpoint_timeline_get_settings(void);
 
+/// Shows tweets that arrived some other way (the user stream) in the
+/// timeline chat, if it's open. Takes ownership of statuses.
+void            twitter_endpoint_timeline_got_user_tweets(PurpleAccount * account, GList * statuses);
+
+/// Fetches what was posted since the timeline chat last got a tweet
+void            twitter_endpoint_timeline_catch_up(PurpleAccount * account);
+
 #endif
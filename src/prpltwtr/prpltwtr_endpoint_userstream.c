@@ -0,0 +1,161 @@
+#include "prpltwtr_endpoint_userstream.h"
+#include "prpltwtr_endpoint_timeline.h"
+#include "prpltwtr_endpoint_im.h"
+#include "prpltwtr_conn.h"
+#include "prpltwtr_buddy.h"
+#include "prpltwtr_xml.h"
+
+static gboolean twitter_userstream_is_me(PurpleAccount * account, const gchar * screen_name)
+{
+    char          **userparts = g_strsplit(purple_account_get_username(account), "@", 2);
+    gboolean        is_me = screen_name && !g_ascii_strcasecmp(userparts[0], screen_name);
+
+    g_strfreev(userparts);
+    return is_me;
+}
+
+static gboolean twitter_userstream_user_is_me(TwitterRequestor * r, gpointer user_node)
+{
+    gchar          *screen_name = user_node ? r->format->get_str(user_node, "screen_name") : NULL;
+    gboolean        is_me = twitter_userstream_is_me(r->account, screen_name);
+
+    g_free(screen_name);
+    return is_me;
+}
+
+/// Whether the status mentions the account, going by its entities
+static gboolean twitter_userstream_mentions_me(TwitterRequestor * r, gpointer status_node)
+{
+    gpointer        entities = r->format->get_node(status_node, "entities");
+    gpointer        mentions = entities ? r->format->get_node(entities, "user_mentions") : NULL;
+    gpointer        iter;
+    gboolean        mentioned = FALSE;
+
+    if (!mentions)
+        return FALSE;
+    /* Walked to the end, which is what frees the iterator */
+    for (iter = r->format->iter_start(mentions, NULL); !r->format->iter_done(iter); iter = r->format->iter_next(iter))
+        if (twitter_userstream_user_is_me(r, r->format->get_iter_node(iter)))
+            mentioned = TRUE;
+    return mentioned;
+}
+
+static void twitter_userstream_got_im(TwitterRequestor * r, TwitterImType type, gpointer node)
+{
+    TwitterEndpointIm *im = twitter_endpoint_im_find(r->account, type);
+    GList          *nodes;
+
+    if (!im)
+        return;
+    nodes = g_list_prepend(NULL, node);
+    im->settings->success_cb(r, nodes, NULL);
+    g_list_free(nodes);
+}
+
+static void twitter_userstream_got_status(TwitterRequestor * r, gpointer node)
+{
+    if (!twitter_userstream_user_is_me(r, r->format->get_node(node, "user")) && twitter_userstream_mentions_me(r, node))
+        twitter_userstream_got_im(r, TWITTER_IM_TYPE_AT_MSG, node);
+    twitter_endpoint_timeline_got_user_tweets(r->account, twitter_statuses_node_parse(r, node));
+}
+
+static void twitter_userstream_got_delete(TwitterRequestor * r, gpointer node)
+{
+    gpointer        status = r->format->get_node(node, "status");
+    gchar          *id;
+
+    /* Deleted direct messages aren't shown anywhere we could take them
+     * back from */
+    if (!status || !(id = r->format->get_str(status, "id_str")))
+        return;
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Status %s was deleted\n", id);
+    purple_signal_emit(purple_conversations_get_handle(), "prpltwtr-status-deleted", r->account, id);
+    g_free(id);
+}
+
+static void twitter_userstream_got_event(TwitterRequestor * r, gpointer node)
+{
+    PurpleAccount  *account = r->account;
+    gchar          *event = r->format->get_str(node, "event");
+    gpointer        target = r->format->get_node(node, "target");
+
+    purple_debug_info(purple_account_get_protocol_id(account), "User stream event %s\n", event ? event : "(none)");
+
+    /* Only follows from this account (made elsewhere) change the buddy
+     * list */
+    if (event && target && twitter_userstream_user_is_me(r, r->format->get_node(node, "source"))) {
+        if (!strcmp(event, "follow")) {
+            twitter_buddy_set_user_data(account, twitter_user_node_parse(r, target), twitter_option_get_following(account));
+        } else if (!strcmp(event, "unfollow")) {
+            gchar          *screen_name = r->format->get_str(target, "screen_name");
+            PurpleBuddy    *b = screen_name ? purple_find_buddy(account, screen_name) : NULL;
+
+            if (b)
+                purple_blist_remove_buddy(b);
+            g_free(screen_name);
+        }
+    }
+    g_free(event);
+}
+
+static void twitter_userstream_message_cb(TwitterStream * stream, gpointer node, gpointer user_data)
+{
+    PurpleAccount  *account = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(account);
+    gpointer        child;
+
+    if ((child = r->format->get_node(node, "direct_message"))) {
+        twitter_userstream_got_im(r, TWITTER_IM_TYPE_DM, child);
+    } else if ((child = r->format->get_node(node, "delete"))) {
+        twitter_userstream_got_delete(r, child);
+    } else if (r->format->get_node(node, "event")) {
+        twitter_userstream_got_event(r, node);
+    } else if (r->format->get_node(node, "text") && r->format->get_node(node, "user")) {
+        twitter_userstream_got_status(r, node);
+    } else {
+        /* friends list, warnings, limit notices and disconnect reasons */
+        purple_debug_info(purple_account_get_protocol_id(account), "Ignoring user stream message\n");
+    }
+}
+
+static void twitter_userstream_im_catch_up(TwitterConnectionData * twitter, TwitterEndpointIm * im, gpointer data)
+{
+    twitter_endpoint_im_catch_up(im);
+}
+
+static void twitter_userstream_connected_cb(TwitterStream * stream, gpointer user_data)
+{
+    PurpleAccount  *account = user_data;
+    PurpleConnection *gc = purple_account_get_connection(account);
+
+    /* Fetch whatever was posted while the stream was down */
+    twitter_endpoint_timeline_catch_up(account);
+    twitter_connection_foreach_endpoint_im(gc->proto_data, twitter_userstream_im_catch_up, NULL);
+}
+
+TwitterStream  *twitter_endpoint_userstream_start(PurpleAccount * account)
+{
+    TwitterRequestor *r = purple_account_get_requestor(account);
+    TwitterRequestParams *params;
+    TwitterStream  *stream;
+
+    if (!twitter_option_use_user_stream(account) || !r->urls->user_stream || !r->do_send_streaming)
+        return NULL;
+
+    params = twitter_request_params_new();
+    twitter_request_params_add(params, twitter_request_param_new("delimited", "length"));
+    twitter_request_params_add(params, twitter_request_param_new("stall_warnings", "true"));
+    stream = twitter_stream_new(r, FALSE, r->urls->user_stream, params, twitter_userstream_message_cb, twitter_userstream_connected_cb, account);
+    twitter_request_params_free(params);
+
+    twitter_stream_start(stream);
+    return stream;
+}
+
+gboolean twitter_endpoint_userstream_is_live(PurpleAccount * account)
+{
+    PurpleConnection *gc = purple_account_get_connection(account);
+    TwitterConnectionData *twitter = gc ? gc->proto_data : NULL;
+
+    return twitter && twitter_stream_is_live(twitter->user_stream);
+}
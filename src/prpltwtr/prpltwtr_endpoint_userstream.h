@@ -0,0 +1,18 @@
+#ifndef _TWITTER_ENDPOINT_USERSTREAM_H_
+#define _TWITTER_ENDPOINT_USERSTREAM_H_
+
+#include "defaults.h"
+
+#include "prpltwtr_api.h"
+#include "prpltwtr_stream.h"
+
+/// Opens the account's user stream, which pushes its timeline, replies,
+/// direct messages and follows as they happen. Returns NULL if the account
+/// can't have one (turned off, not Twitter, or a backend without streaming),
+/// in which case polling carries on as before.
+TwitterStream  *twitter_endpoint_userstream_start(PurpleAccount * account);
+
+/// Whether the account's user stream is up, so polling can be skipped
+gboolean        twitter_endpoint_userstream_is_live(PurpleAccount * account);
+
+#endif
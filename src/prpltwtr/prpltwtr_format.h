@@ -87,6 +87,10 @@ typedef struct {
     /// given node.
     TwitterFormatStringFromChildNodeFunc get_str;
 
+    /// A function pointer that retrieves the value of a node holding a
+    /// number or a string, such as an element of an array of ids.
+    TwitterFormatStringFromNodeFunc get_value;
+
     /// A function pointer that takes a node and string and determines if the
     /// node matches.
     TwitterFormatBoolFromNodeStringFunc is_name;
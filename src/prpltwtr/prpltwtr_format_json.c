@@ -47,6 +47,7 @@ static gchar   *json_get_name(gpointer node);
 static gpointer json_get_node(gpointer node, const gchar * child_node_name);
 static gint     json_get_node_child_count(gpointer node);
 static gchar   *json_get_str(gpointer node, const gchar * child_node_name);
+static gchar   *json_get_value(gpointer node);
 static gboolean json_is_name(gpointer node, const gchar * child_name);
 static gpointer json_iter_start(gpointer node, const gchar * child_name);
 static gboolean json_iter_done(gpointer iter);
@@ -200,6 +201,21 @@ static gchar   *json_get_str(gpointer node, const gchar * child_node_name)
     return child_value;
 }
 
+static gchar   *json_get_value(gpointer node)
+{
+    if (!node || JSON_NODE_TYPE(node) != JSON_NODE_VALUE)
+        return NULL;
+
+    switch (json_node_get_value_type(node)) {
+    case G_TYPE_INT64:
+        return g_strdup_printf("%" G_GINT64_FORMAT, json_node_get_int(node));
+    case G_TYPE_STRING:
+        return g_strdup(json_node_get_string(node));
+    default:
+        return NULL;
+    }
+}
+
 static gboolean json_is_name(gpointer node, const gchar * child_name)
 {
     return TRUE;
@@ -274,6 +290,7 @@ void prpltwtr_format_json_setup(TwitterFormat * format)
     format->get_node = json_get_node;
     format->get_node_child_count = json_get_node_child_count;
     format->get_str = json_get_str;
+    format->get_value = json_get_value;
     format->is_name = json_is_name;
     format->iter_start = json_iter_start;
     format->iter_done = json_iter_done;
@@ -78,6 +78,11 @@ gchar          *prpltwtr_format_xml_get_str(gpointer node, const gchar * child_n
     return xmlnode_get_child_data(node, child_name);
 }
 
+gchar          *prpltwtr_format_xml_get_value(gpointer node)
+{
+    return xmlnode_get_data_unescaped(node);
+}
+
 const gchar    *prpltwtr_format_xml_node_parse_error(gpointer node)
 {
     xmlnode        *xml_node = node;
@@ -117,6 +122,7 @@ void prpltwtr_format_xml_setup(TwitterFormat * format)
     format->get_node = prpltwtr_format_xml_get_node;
     format->get_node_child_count = prpltwtr_format_xml_get_node_child_count;
     format->get_str = prpltwtr_format_xml_get_str;
+    format->get_value = prpltwtr_format_xml_get_value;
     format->is_name = prpltwtr_format_xml_is_name;
     format->iter_start = prpltwtr_format_xml_iter_start;
     format->iter_done = prpltwtr_format_xml_iter_done;
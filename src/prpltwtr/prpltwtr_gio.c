@@ -0,0 +1,586 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+#include <proxy.h>
+
+#include "prpltwtr_gio.h"
+#include "prpltwtr_http.h"
+#include "prpltwtr_stats.h"
+
+#define TWITTER_GIO_READ_SIZE 8192
+/* Buffers handed to a single vectored write */
+#define TWITTER_GIO_WRITE_VECTORS 8
+
+typedef struct {
+    gchar          *key;
+    GSocketConnection *connection;
+    guint           timer;
+} TwitterGioIdleConn;
+
+typedef struct {
+    /* a finished connection, only kept for its session state */
+    GTlsClientConnection *connection;
+    time_t          saved;
+} TwitterGioTlsSession;
+
+struct _TwitterGioRequest {
+    gchar          *host;
+    int             port;
+    gboolean        use_https;
+    gchar          *endpoint;
+    gchar          *proxy_uri;                   /* NULL to connect directly */
+    gchar          *key;                         /* for the idle connections */
+    guint           timeout;
+    gboolean        idempotent;                  /* a GET or HEAD, safe to send twice */
+    gboolean        reused;
+    gboolean        retried;
+
+    TwitterHttpSegments *segments;
+    gsize           written;
+
+    GTask          *task;
+    GCancellable   *cancellable;
+    GSocketConnection *connection;
+    gboolean        cancelled;
+    gboolean        session_saved;
+
+    TwitterHttpReader reader;
+    gchar           buf[TWITTER_GIO_READ_SIZE];
+
+    TwitterGioChunkFunc chunk_func;
+    TwitterGioCallback callback;
+    gpointer        user_data;
+};
+
+/* key: "host:port", value: TwitterGioTlsSession */
+static GHashTable *tls_sessions = NULL;
+static TwitterGioTlsStats tls_stats;
+
+/* key: see gio_connection_key, value: GQueue of TwitterGioIdleConn, most
+ * recently used first */
+static GHashTable *idle_connections = NULL;
+
+static void     gio_request_read(TwitterGioRequest * req);
+static void     gio_request_write(TwitterGioRequest * req);
+static void     gio_request_open(TwitterGioRequest * req);
+
+/* The account's proxy as a URI for GSimpleProxyResolver, or NULL to
+ * connect directly. purple_proxy_get_setup has already turned the global
+ * and environment settings into the proxy to use */
+static gchar   *gio_proxy_uri(PurpleAccount * account)
+{
+    PurpleProxyInfo *gpi = purple_proxy_get_setup(account);
+    const gchar    *scheme;
+    const gchar    *username;
+    const gchar    *password;
+    gchar          *user_info = NULL;
+    gchar          *uri;
+
+    if (!gpi || !purple_proxy_info_get_host(gpi))
+        return NULL;
+
+    switch (purple_proxy_info_get_type(gpi)) {
+    case PURPLE_PROXY_NONE:
+    case PURPLE_PROXY_USE_GLOBAL:
+    case PURPLE_PROXY_USE_ENVVAR:
+        return NULL;
+    case PURPLE_PROXY_HTTP:
+        scheme = "http";
+        break;
+    case PURPLE_PROXY_SOCKS4:
+        scheme = "socks4";
+        break;
+    case PURPLE_PROXY_SOCKS5:
+        scheme = "socks5";
+        break;
+    default:
+        /* Tor is a SOCKS5 proxy, GIO leaves the host names to it */
+        scheme = "socks5";
+        break;
+    }
+
+    username = purple_proxy_info_get_username(gpi);
+    password = purple_proxy_info_get_password(gpi);
+    if (username && *username) {
+        gchar          *u = g_uri_escape_string(username, NULL, FALSE);
+        gchar          *p = password && *password ? g_uri_escape_string(password, NULL, FALSE) : NULL;
+        user_info = p ? g_strdup_printf("%s:%s@", u, p) : g_strdup_printf("%s@", u);
+        g_free(u);
+        g_free(p);
+    }
+
+    uri = g_strdup_printf("%s://%s%s:%d", scheme, user_info ? user_info : "", purple_proxy_info_get_host(gpi), purple_proxy_info_get_port(gpi));
+    g_free(user_info);
+    return uri;
+}
+
+static void gio_client_set_proxy_uri(GSocketClient * client, const gchar * proxy_uri)
+{
+    GProxyResolver *resolver;
+
+    /* Without this, GIO would go by the desktop's proxy settings instead
+     * of the account's */
+    if (!proxy_uri) {
+        g_socket_client_set_enable_proxy(client, FALSE);
+        return;
+    }
+
+    resolver = g_simple_proxy_resolver_new(proxy_uri, NULL);
+    g_socket_client_set_proxy_resolver(client, resolver);
+    g_object_unref(resolver);
+}
+
+void prpltwtr_gio_client_set_proxy(GSocketClient * client, PurpleAccount * account)
+{
+    gchar          *proxy_uri = gio_proxy_uri(account);
+    gio_client_set_proxy_uri(client, proxy_uri);
+    g_free(proxy_uri);
+}
+
+/* Connections are shared between accounts, but only if they go through
+ * the same proxy */
+static gchar   *gio_connection_key(gboolean use_https, const gchar * host, int port, const gchar * proxy_uri)
+{
+    return g_strdup_printf("%s://%s:%d|%s", use_https ? "https" : "http", host, port, proxy_uri ? proxy_uri : "");
+}
+
+static void gio_connection_close(GSocketConnection * connection)
+{
+    /* The TLS layer may live on in the session cache, which would keep
+     * the socket open */
+    g_io_stream_close_async(G_IO_STREAM(connection), G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+    g_object_unref(connection);
+}
+
+/* Takes idle out of the pool, and frees it. Returns its connection */
+static GSocketConnection *gio_idle_conn_remove(TwitterGioIdleConn * idle)
+{
+    GQueue         *queue = g_hash_table_lookup(idle_connections, idle->key);
+    GSocketConnection *connection = idle->connection;
+
+    g_queue_remove(queue, idle);
+    if (g_queue_is_empty(queue))
+        g_hash_table_remove(idle_connections, idle->key);
+
+    if (idle->timer)
+        purple_timeout_remove(idle->timer);
+    g_free(idle->key);
+    g_free(idle);
+    return connection;
+}
+
+static gboolean gio_idle_timeout_cb(gpointer data)
+{
+    TwitterGioIdleConn *idle = data;
+    idle->timer = 0;
+    gio_connection_close(gio_idle_conn_remove(idle));
+    return FALSE;
+}
+
+/* Keeps a connection whose response was read to the end, for the next
+ * request to the same server. Takes ownership of connection */
+static void gio_connection_park(const gchar * key, GSocketConnection * connection)
+{
+    GQueue         *queue;
+    TwitterGioIdleConn *idle;
+
+    if (!idle_connections)
+        idle_connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_queue_free);
+
+    queue = g_hash_table_lookup(idle_connections, key);
+    if (!queue) {
+        queue = g_queue_new();
+        g_hash_table_insert(idle_connections, g_strdup(key), queue);
+    }
+
+    if (g_queue_get_length(queue) >= TWITTER_GIO_MAX_IDLE_PER_HOST) {
+        gio_connection_close(connection);
+        return;
+    }
+
+    idle = g_new0(TwitterGioIdleConn, 1);
+    idle->key = g_strdup(key);
+    idle->connection = connection;
+    idle->timer = purple_timeout_add_seconds(TWITTER_GIO_IDLE_TIMEOUT, gio_idle_timeout_cb, idle);
+    g_queue_push_head(queue, idle);
+}
+
+static GSocketConnection *gio_connection_take(const gchar * key)
+{
+    GQueue         *queue;
+
+    if (!idle_connections || !(queue = g_hash_table_lookup(idle_connections, key)))
+        return NULL;
+    return gio_idle_conn_remove(g_queue_peek_head(queue));
+}
+
+static void gio_tls_session_free(gpointer data)
+{
+    TwitterGioTlsSession *session = data;
+    g_object_unref(session->connection);
+    g_free(session);
+}
+
+/* The TLS layer of a connection made by GSocketClient, if it has one */
+static GTlsClientConnection *gio_tls_connection(GIOStream * connection)
+{
+    GIOStream      *base;
+
+    if (G_IS_TLS_CLIENT_CONNECTION(connection))
+        return G_TLS_CLIENT_CONNECTION(connection);
+    if (G_IS_TCP_WRAPPER_CONNECTION(connection)) {
+        base = g_tcp_wrapper_connection_get_base_io_stream(G_TCP_WRAPPER_CONNECTION(connection));
+        if (G_IS_TLS_CLIENT_CONNECTION(base))
+            return G_TLS_CLIENT_CONNECTION(base);
+    }
+    return NULL;
+}
+
+void prpltwtr_gio_tls_session_offer(GIOStream * connection, const gchar * host, int port)
+{
+    GTlsClientConnection *tls = gio_tls_connection(connection);
+    gchar          *key;
+    TwitterGioTlsSession *session;
+
+    if (!tls)
+        return;
+
+    tls_stats.handshakes++;
+    key = g_strdup_printf("%s:%d", host, port);
+    session = tls_sessions ? g_hash_table_lookup(tls_sessions, key) : NULL;
+    if (session && time(NULL) - session->saved > TWITTER_GIO_TLS_SESSION_TTL) {
+        g_hash_table_remove(tls_sessions, key);
+        session = NULL;
+    }
+
+    if (session) {
+        tls_stats.offered++;
+        g_tls_client_connection_copy_session_state(tls, session->connection);
+    } else {
+        tls_stats.misses++;
+    }
+    g_free(key);
+}
+
+void prpltwtr_gio_tls_session_save(GIOStream * connection, const gchar * host, int port)
+{
+    GTlsClientConnection *tls = gio_tls_connection(connection);
+    TwitterGioTlsSession *session;
+
+    if (!tls)
+        return;
+
+    if (!tls_sessions)
+        tls_sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gio_tls_session_free);
+
+    session = g_new0(TwitterGioTlsSession, 1);
+    session->connection = g_object_ref(tls);
+    session->saved = time(NULL);
+    g_hash_table_replace(tls_sessions, g_strdup_printf("%s:%d", host, port), session);
+}
+
+void prpltwtr_gio_get_tls_stats(TwitterGioTlsStats * stats)
+{
+    *stats = tls_stats;
+    stats->sessions = tls_sessions ? g_hash_table_size(tls_sessions) : 0;
+}
+
+static void gio_request_free(TwitterGioRequest * req)
+{
+    if (req->connection)
+        gio_connection_close(req->connection);
+    g_object_unref(req->cancellable);
+    twitter_http_reader_clear(&req->reader);
+    g_free(req->host);
+    g_free(req->endpoint);
+    g_free(req->proxy_uri);
+    g_free(req->key);
+    twitter_http_segments_free(req->segments);
+    g_free(req);
+}
+
+static void gio_response_free(gpointer data)
+{
+    g_string_free(data, TRUE);
+}
+
+static void gio_request_return(TwitterGioRequest * req, GError * error)
+{
+    GTask          *task = req->task;
+
+    req->task = NULL;
+    if (!error && req->reader.decode_failed)
+        error = g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s", _("Unable to decompress the response"));
+    if (error)
+        g_task_return_error(task, error);
+    else
+        g_task_return_pointer(task, twitter_http_reader_steal_response(&req->reader), gio_response_free);
+    g_object_unref(task);
+}
+
+static void gio_request_done_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterGioRequest *req = data;
+    GError         *error = NULL;
+    GString        *response = g_task_propagate_pointer(G_TASK(result), &error);
+
+    if (!req->cancelled && req->callback) {
+        if (error) {
+            purple_debug_error(GENERIC_PROTOCOL_ID, "Request to %s failed: %s\n", req->host, error->message);
+            req->callback(req, req->user_data, NULL, 0, error->message);
+        } else {
+            prpltwtr_stats_add_response(req->endpoint);
+            req->callback(req, req->user_data, response->str, response->len, NULL);
+        }
+    }
+
+    if (response)
+        g_string_free(response, TRUE);
+    if (error)
+        g_error_free(error);
+    gio_request_free(req);
+}
+
+static void gio_reader_body_cb(TwitterHttpReader * reader, const gchar * data, gsize len, gpointer user_data)
+{
+    TwitterGioRequest *req = user_data;
+    if (!req->cancelled)
+        req->chunk_func(req, req->user_data, data, len);
+}
+
+static void gio_reader_headers_cb(TwitterHttpReader * reader, gpointer user_data)
+{
+    /* Error bodies are kept whole, so they can be parsed for a message */
+    if (reader->status_code >= 200 && reader->status_code < 300)
+        reader->body_func = gio_reader_body_cb;
+}
+
+/* Returns TRUE if the request went out again on a new connection, after
+ * the server dropped the keep-alive connection it was sent on before we
+ * noticed. Only when nothing was received, and not for a POST: the server
+ * may have acted on it anyway */
+static gboolean gio_request_retry(TwitterGioRequest * req)
+{
+    if (!req->reused || req->retried || req->cancelled || !req->idempotent || twitter_http_reader_started(&req->reader))
+        return FALSE;
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Stale connection to %s, retrying request\n", req->host);
+    req->retried = TRUE;
+    req->written = 0;
+    gio_connection_close(req->connection);
+    req->connection = NULL;
+    gio_request_open(req);
+    return TRUE;
+}
+
+static void gio_request_read_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterGioRequest *req = data;
+    GError         *error = NULL;
+    gssize          len = g_input_stream_read_finish(G_INPUT_STREAM(source), result, &error);
+    gboolean        done;
+    gsize           wire_bytes;
+    gsize           bytes;
+
+    if (len < 0) {
+        if (gio_request_retry(req))
+            g_error_free(error);
+        else
+            gio_request_return(req, error);
+    } else if (len == 0) {
+        if (twitter_http_reader_eof(&req->reader))
+            gio_request_return(req, NULL);
+        else if (!gio_request_retry(req))
+            gio_request_return(req, g_error_new(G_IO_ERROR, G_IO_ERROR_CLOSED, "%s", _("Server closed the connection")));
+    } else {
+        if (!req->session_saved) {
+            req->session_saved = TRUE;
+            prpltwtr_gio_tls_session_save(G_IO_STREAM(req->connection), req->host, req->port);
+        }
+        done = twitter_http_reader_feed(&req->reader, req->buf, len);
+        twitter_http_reader_take_counts(&req->reader, &wire_bytes, &bytes);
+        prpltwtr_stats_add_transfer(req->endpoint, wire_bytes, bytes);
+        if (done) {
+            /* Hand the connection back before calling back, so a follow-up
+             * request can go straight out on it */
+            if (req->reader.keep_alive && !twitter_http_reader_has_trailing_data(&req->reader)) {
+                gio_connection_park(req->key, req->connection);
+                req->connection = NULL;
+            }
+            gio_request_return(req, NULL);
+        } else {
+            gio_request_read(req);
+        }
+    }
+}
+
+static void gio_request_read(TwitterGioRequest * req)
+{
+    GInputStream   *input = g_io_stream_get_input_stream(G_IO_STREAM(req->connection));
+    g_input_stream_read_async(input, req->buf, sizeof (req->buf), G_PRIORITY_DEFAULT, req->cancellable, gio_request_read_cb, req);
+}
+
+static void gio_request_written_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterGioRequest *req = data;
+    GError         *error = NULL;
+    gsize           written = 0;
+
+#if GLIB_CHECK_VERSION(2, 60, 0)
+    if (!g_output_stream_writev_all_finish(G_OUTPUT_STREAM(source), result, &written, &error)) {
+#else
+    if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(source), result, &written, &error)) {
+#endif
+        if (gio_request_retry(req))
+            g_error_free(error);
+        else
+            gio_request_return(req, error);
+        return;
+    }
+    req->written += written;
+    gio_request_write(req);
+}
+
+static void gio_request_write(TwitterGioRequest * req)
+{
+    GOutputStream  *output = g_io_stream_get_output_stream(G_IO_STREAM(req->connection));
+    GOutputVector   vectors[TWITTER_GIO_WRITE_VECTORS];
+    guint           count = twitter_http_segments_get_vectors(req->segments, req->written, vectors, G_N_ELEMENTS(vectors));
+
+    if (count == 0) {
+        gio_request_read(req);
+        return;
+    }
+#if GLIB_CHECK_VERSION(2, 60, 0)
+    g_output_stream_writev_all_async(output, vectors, count, G_PRIORITY_DEFAULT, req->cancellable, gio_request_written_cb, req);
+#else
+    g_output_stream_write_all_async(output, vectors[0].buffer, vectors[0].size, G_PRIORITY_DEFAULT, req->cancellable, gio_request_written_cb, req);
+#endif
+}
+
+static void gio_client_event_cb(GSocketClient * client, GSocketClientEvent event, GSocketConnectable * connectable, GIOStream * connection, gpointer data)
+{
+    TwitterGioRequest *req = data;
+
+    if (event == G_SOCKET_CLIENT_TLS_HANDSHAKING)
+        prpltwtr_gio_tls_session_offer(connection, req->host, req->port);
+}
+
+static void gio_request_connected_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterGioRequest *req = data;
+    GError         *error = NULL;
+
+    req->connection = g_socket_client_connect_to_host_finish(G_SOCKET_CLIENT(source), result, &error);
+    if (!req->connection) {
+        gio_request_return(req, error);
+        return;
+    }
+
+    gio_request_write(req);
+}
+
+TwitterGioRequest *prpltwtr_gio_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, guint timeout, TwitterGioChunkFunc chunk_func, TwitterGioCallback callback, gpointer user_data)
+{
+    TwitterHttpSegments *segments = twitter_http_segments_new();
+
+    twitter_http_segments_add_take(segments, g_memdup(request, request_len), request_len);
+    return prpltwtr_gio_request_segments(account, use_https, host, port, segments, timeout, chunk_func, callback, user_data);
+}
+
+/* Sends the request on a new connection */
+static void gio_request_open(TwitterGioRequest * req)
+{
+    GSocketClient  *client;
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Opening %s connection to %s:%d%s\n", req->use_https ? "https" : "http", req->host, req->port, req->proxy_uri ? " through a proxy" : "");
+
+    /* The socket timeout applies to every connect, read and write, so a
+     * streaming request only times out when it stalls */
+    client = g_socket_client_new();
+    g_socket_client_set_tls(client, req->use_https);
+    g_socket_client_set_timeout(client, req->timeout);
+    gio_client_set_proxy_uri(client, req->proxy_uri);
+    g_signal_connect(client, "event", G_CALLBACK(gio_client_event_cb), req);
+    g_socket_client_connect_to_host_async(client, req->host, req->port, req->cancellable, gio_request_connected_cb, req);
+    g_object_unref(client);
+}
+
+TwitterGioRequest *prpltwtr_gio_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, guint timeout, TwitterGioChunkFunc chunk_func, TwitterGioCallback callback, gpointer user_data)
+{
+    TwitterGioRequest *req = g_new0(TwitterGioRequest, 1);
+
+    req->host = g_strdup(host);
+    req->port = port;
+    req->use_https = use_https;
+    req->endpoint = twitter_http_segments_endpoint(segments);
+    req->proxy_uri = gio_proxy_uri(account);
+    req->key = gio_connection_key(use_https, host, port, req->proxy_uri);
+    req->timeout = timeout;
+    req->idempotent = twitter_http_segments_is_idempotent(segments);
+    req->segments = segments;
+    req->chunk_func = chunk_func;
+    req->callback = callback;
+    req->user_data = user_data;
+
+    twitter_http_reader_init(&req->reader);
+    if (chunk_func) {
+        req->reader.headers_func = gio_reader_headers_cb;
+        req->reader.user_data = req;
+    }
+
+    req->cancellable = g_cancellable_new();
+    req->task = g_task_new(NULL, req->cancellable, gio_request_done_cb, req);
+
+    req->connection = gio_connection_take(req->key);
+    if (req->connection) {
+        /* Its TLS session was saved when it was opened */
+        req->reused = TRUE;
+        req->session_saved = TRUE;
+        g_socket_set_timeout(g_socket_connection_get_socket(req->connection), timeout);
+        gio_request_write(req);
+    } else {
+        gio_request_open(req);
+    }
+
+    return req;
+}
+
+void prpltwtr_gio_request_cancel(TwitterGioRequest * req)
+{
+    /* The pending operation fails with G_IO_ERROR_CANCELLED, which
+     * finishes the task and frees the request */
+    req->cancelled = TRUE;
+    g_cancellable_cancel(req->cancellable);
+}
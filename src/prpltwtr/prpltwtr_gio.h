@@ -0,0 +1,97 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_GIO_H_
+#define _TWITTER_GIO_H_
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <account.h>
+
+#include "prpltwtr_http.h"
+
+/* Seconds a connection is kept open after its last response */
+#define TWITTER_GIO_IDLE_TIMEOUT 30
+
+/* Most idle connections kept to the same server */
+#define TWITTER_GIO_MAX_IDLE_PER_HOST 4
+
+/* Seconds a TLS session is offered for resumption after it was saved */
+#define TWITTER_GIO_TLS_SESSION_TTL 600
+
+typedef struct _TwitterGioRequest TwitterGioRequest;
+
+/// Called once per request, with the full response (status line, headers,
+/// blank line and the de-chunked body) or with an error message. If a chunk
+/// function received the body, the response text only holds the headers.
+typedef void    (*TwitterGioCallback) (TwitterGioRequest * req, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message);
+
+/// Receives the de-chunked body of a successful (2xx) response as it arrives.
+typedef void    (*TwitterGioChunkFunc) (TwitterGioRequest * req, gpointer user_data, const gchar * data, gsize len);
+
+typedef struct {
+    guint           handshakes;                  /* TLS handshakes started */
+    /* handshakes offered a cached session to resume. GIO doesn't say
+     * whether the server took it up, so some may have been full ones */
+    guint           offered;
+    guint           misses;                      /* handshakes with no cached session for the host */
+    guint           sessions;                    /* hosts with a cached session */
+} TwitterGioTlsStats;
+
+/// Sends a raw HTTP/1.1 request to host:port with GSocketClient, through
+/// the account's proxy. Connections are kept open after a complete
+/// response and reused by later requests to the same server through the
+/// same proxy. The request fails with a timeout error if no progress is
+/// made for 'timeout' seconds (0 for no timeout).
+/// The callback is never called from within this function.
+TwitterGioRequest *prpltwtr_gio_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, guint timeout, TwitterGioChunkFunc chunk_func, TwitterGioCallback callback, gpointer user_data);
+
+/// Like prpltwtr_gio_request, for a request in segments. They are sent
+/// with vectored writes (GLib 2.60 and later). Takes ownership of segments.
+TwitterGioRequest *prpltwtr_gio_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, guint timeout, TwitterGioChunkFunc chunk_func, TwitterGioCallback callback, gpointer user_data);
+
+/// Cancels a request. Neither callback will be called again.
+void            prpltwtr_gio_request_cancel(TwitterGioRequest * req);
+
+/// Makes a GSocketClient connect through the account's proxy, as set up in
+/// libpurple, instead of the desktop's.
+void            prpltwtr_gio_client_set_proxy(GSocketClient * client, PurpleAccount * account);
+
+/// Offers the session last saved for host:port to a TLS connection that is
+/// about to handshake (the G_SOCKET_CLIENT_TLS_HANDSHAKING event), so the
+/// server can resume it instead of doing a full handshake. Sessions are
+/// shared by all accounts, and only used by the GIO and HTTP/2 backends:
+/// libpurple's SSL API, used by the connection pool and icon fetches,
+/// gives no access to them.
+void            prpltwtr_gio_tls_session_offer(GIOStream * connection, const gchar * host, int port);
+
+/// Saves the TLS session of a connection to host:port for later
+/// connections. Call it once data was read, as TLS 1.3 servers send their
+/// session tickets after the handshake. Does nothing for plain connections.
+void            prpltwtr_gio_tls_session_save(GIOStream * connection, const gchar * host, int port);
+
+void            prpltwtr_gio_get_tls_stats(TwitterGioTlsStats * stats);
+
+#endif
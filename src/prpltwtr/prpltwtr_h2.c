@@ -0,0 +1,878 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <nghttp2/nghttp2.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+
+#include "prpltwtr_h2.h"
+#include "prpltwtr_gio.h"
+#include "prpltwtr_http.h"
+#include "prpltwtr_stats.h"
+
+#define TWITTER_H2_READ_SIZE 16384
+#define TWITTER_H2_MAX_CONCURRENT_STREAMS 100
+
+typedef struct _TwitterH2Session TwitterH2Session;
+
+struct _TwitterH2Session {
+    gchar          *key;
+    PurpleAccount  *account;
+    gchar          *host;
+    int             port;
+    gboolean        use_https;
+
+    GCancellable   *cancellable;
+    GIOStream      *stream;
+    nghttp2_session *session;
+    gboolean        negotiated_h2;
+    gboolean        session_saved;
+    gboolean        connected;
+    gboolean        closed;
+    gboolean        in_recv;
+    gboolean        writing;
+    gint            ref;
+
+    GByteArray     *outbuf;
+    guint8          rbuf[TWITTER_H2_READ_SIZE];
+
+    /* requests waiting for the connection */
+    GList          *queued;
+    /* key: stream id, value: TwitterH2Request */
+    GHashTable     *streams;
+    /* requests whose stream closed during the current read */
+    GList          *completed;
+    guint           idle_timer;
+    time_t          last_read;
+};
+
+struct _TwitterH2Request {
+    PurpleAccount  *account;
+    TwitterH2Session *session;
+    gint32          stream_id;
+    gboolean        cancelled;
+    gboolean        failed;
+    gchar          *error_message;
+    guint           fail_timer;
+
+    gboolean        use_https;
+    gchar          *host;
+    int             port;
+    guint           timeout;                     /* seconds without progress, 0 for none */
+    guint           stall_timer;
+    gint            weight;
+    gchar          *endpoint;
+
+    /* the HTTP/1.1 request, translated when submitted */
+    gchar          *data;
+    gsize           data_len;
+    const gchar    *body;
+    gsize           body_len;
+    gsize           body_sent;
+
+    gint            status;
+    GString        *headers;
+    GString        *response_body;
+    TwitterHttpDecoder *decoder;
+
+    TwitterGioRequest *fallback;
+
+    TwitterH2ChunkFunc chunk_func;
+    TwitterH2Callback callback;
+    gpointer        user_data;
+};
+
+/* key: gchar *, value: TwitterH2Session */
+static GHashTable *h2_sessions = NULL;
+/* key: "scheme://host:port" of servers which didn't negotiate h2 */
+static GHashTable *h2_unsupported = NULL;
+static TwitterH2Stats h2_stats;
+
+static void     h2_session_flush(TwitterH2Session * s);
+static void     h2_session_read(TwitterH2Session * s);
+static void     h2_session_submit(TwitterH2Session * s, TwitterH2Request * req);
+static void     h2_session_close(TwitterH2Session * s, const gchar * error_message);
+
+static void h2_request_free(TwitterH2Request * req)
+{
+    if (req->fail_timer)
+        purple_timeout_remove(req->fail_timer);
+    if (req->stall_timer)
+        purple_timeout_remove(req->stall_timer);
+    if (req->headers)
+        g_string_free(req->headers, TRUE);
+    if (req->response_body)
+        g_string_free(req->response_body, TRUE);
+    if (req->decoder)
+        twitter_http_decoder_free(req->decoder);
+    g_free(req->error_message);
+    g_free(req->host);
+    g_free(req->endpoint);
+    g_free(req->data);
+    g_free(req);
+}
+
+static void h2_request_complete(TwitterH2Request * req, const gchar * error_message)
+{
+    if (!req->cancelled && req->callback) {
+        if (error_message) {
+            req->callback(req, req->user_data, NULL, 0, error_message);
+        } else {
+            GString        *response = g_string_sized_new(req->headers->len + req->response_body->len + 32);
+            g_string_printf(response, "HTTP/1.1 %d \r\n", req->status);
+            g_string_append_len(response, req->headers->str, req->headers->len);
+            g_string_append(response, "\r\n");
+            g_string_append_len(response, req->response_body->str, req->response_body->len);
+            prpltwtr_stats_add_response(req->endpoint);
+            req->callback(req, req->user_data, response->str, response->len, NULL);
+            g_string_free(response, TRUE);
+        }
+    }
+    h2_request_free(req);
+}
+
+static gboolean h2_request_fail_cb(gpointer data)
+{
+    TwitterH2Request *req = data;
+    req->fail_timer = 0;
+    h2_request_complete(req, req->error_message);
+    return FALSE;
+}
+
+/* For errors found while the caller may still be in prpltwtr_h2_request */
+static void h2_request_fail_later(TwitterH2Request * req, const gchar * error_message)
+{
+    req->failed = TRUE;
+    req->error_message = g_strdup(error_message);
+    req->fail_timer = purple_timeout_add(0, h2_request_fail_cb, req);
+}
+
+static gboolean h2_request_stall_cb(gpointer data)
+{
+    TwitterH2Request *req = data;
+    TwitterH2Session *s = req->session;
+
+    req->stall_timer = 0;
+    if (time(NULL) - s->last_read >= req->timeout) {
+        /* Nothing came in for any stream, the connection is gone */
+        h2_session_close(s, _("Connection timed out"));
+        return FALSE;
+    }
+
+    /* Only this stream is stuck. Its callback gets the error once the
+     * reset goes through */
+    purple_debug_info(GENERIC_PROTOCOL_ID, "HTTP/2 request to %s timed out\n", req->host);
+    if (!req->error_message)
+        req->error_message = g_strdup(_("Request timed out"));
+    nghttp2_submit_rst_stream(s->session, NGHTTP2_FLAG_NONE, req->stream_id, NGHTTP2_CANCEL);
+    h2_session_flush(s);
+    return FALSE;
+}
+
+/* (Re)starts the timeout of a request on an open stream */
+static void h2_request_progress(TwitterH2Request * req)
+{
+    if (req->stall_timer)
+        purple_timeout_remove(req->stall_timer);
+    req->stall_timer = req->timeout ? purple_timeout_add_seconds(req->timeout, h2_request_stall_cb, req) : 0;
+}
+
+static void h2_fallback_chunk_cb(TwitterGioRequest * gio_request, gpointer user_data, const gchar * data, gsize len)
+{
+    TwitterH2Request *req = user_data;
+    req->chunk_func(req, req->user_data, data, len);
+}
+
+static void h2_fallback_cb(TwitterGioRequest * gio_request, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message)
+{
+    TwitterH2Request *req = user_data;
+    if (req->callback)
+        req->callback(req, req->user_data, response_text, len, error_message);
+    h2_request_free(req);
+}
+
+static void h2_request_fallback(TwitterH2Request * req)
+{
+    h2_stats.fallbacks++;
+    req->session = NULL;
+    req->fallback = prpltwtr_gio_request(req->account, req->use_https, req->host, req->port, req->data, req->data_len, req->timeout, req->chunk_func ? h2_fallback_chunk_cb : NULL, h2_fallback_cb, req);
+}
+
+static gchar   *h2_server_key(gboolean use_https, const gchar * host, int port)
+{
+    return g_strdup_printf("%s://%s:%d", use_https ? "https" : "http", host, port);
+}
+
+static void h2_session_ref(TwitterH2Session * s)
+{
+    s->ref++;
+}
+
+static void h2_session_unref(TwitterH2Session * s)
+{
+    if (--s->ref > 0)
+        return;
+    if (s->session)
+        nghttp2_session_del(s->session);
+    if (s->stream) {
+        g_io_stream_close_async(s->stream, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+        g_object_unref(s->stream);
+    }
+    g_object_unref(s->cancellable);
+    g_byte_array_free(s->outbuf, TRUE);
+    g_hash_table_destroy(s->streams);
+    g_free(s->key);
+    g_free(s->host);
+    g_free(s);
+}
+
+static void h2_session_close(TwitterH2Session * s, const gchar * error_message)
+{
+    GList          *reqs;
+    GList          *l;
+
+    if (s->closed)
+        return;
+    s->closed = TRUE;
+    h2_stats.sessions--;
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Closing HTTP/2 connection to %s:%d%s%s\n", s->host, s->port, error_message ? ": " : "", error_message ? error_message : "");
+
+    if (h2_sessions && g_hash_table_lookup(h2_sessions, s->key) == s)
+        g_hash_table_remove(h2_sessions, s->key);
+    if (s->idle_timer) {
+        purple_timeout_remove(s->idle_timer);
+        s->idle_timer = 0;
+    }
+    g_cancellable_cancel(s->cancellable);
+
+    /* Streams which finished before the connection went away keep their result */
+    reqs = s->completed;
+    s->completed = NULL;
+    for (l = reqs; l; l = l->next) {
+        TwitterH2Request *req = l->data;
+        h2_request_complete(req, req->error_message);
+    }
+    g_list_free(reqs);
+
+    reqs = g_list_concat(g_hash_table_get_values(s->streams), s->queued);
+    g_hash_table_steal_all(s->streams);
+    s->queued = NULL;
+
+    for (l = reqs; l; l = l->next) {
+        TwitterH2Request *req = l->data;
+        req->session = NULL;
+        h2_request_complete(req, error_message ? error_message : _("Connection closed"));
+    }
+    g_list_free(reqs);
+
+    h2_session_unref(s);
+}
+
+static gboolean h2_session_idle_cb(gpointer data)
+{
+    TwitterH2Session *s = data;
+    s->idle_timer = 0;
+    h2_session_close(s, NULL);
+    return FALSE;
+}
+
+static void h2_session_check_idle(TwitterH2Session * s)
+{
+    if (s->closed || s->idle_timer || s->queued || g_hash_table_size(s->streams) > 0)
+        return;
+    s->idle_timer = purple_timeout_add_seconds(TWITTER_H2_IDLE_TIMEOUT, h2_session_idle_cb, s);
+}
+
+static void h2_session_dispatch(TwitterH2Session * s)
+{
+    h2_session_ref(s);
+    while (s->completed) {
+        TwitterH2Request *req = s->completed->data;
+        s->completed = g_list_delete_link(s->completed, s->completed);
+        h2_request_complete(req, req->error_message);
+    }
+    h2_session_check_idle(s);
+    h2_session_unref(s);
+}
+
+static void h2_session_write_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterH2Session *s = data;
+    GError         *error = NULL;
+    gssize          len = g_output_stream_write_finish(G_OUTPUT_STREAM(source), result, &error);
+
+    s->writing = FALSE;
+    if (!s->closed) {
+        if (len < 0) {
+            h2_session_close(s, error->message);
+        } else {
+            g_byte_array_remove_range(s->outbuf, 0, len);
+            h2_session_flush(s);
+        }
+    }
+    if (error)
+        g_error_free(error);
+    h2_session_unref(s);
+}
+
+static void h2_session_flush(TwitterH2Session * s)
+{
+    const guint8   *data;
+    ssize_t         len;
+
+    /* nghttp2 doesn't allow sending from within its callbacks, the read
+     * handler flushes once it's done */
+    if (s->closed || !s->connected || s->writing || s->in_recv)
+        return;
+
+    while ((len = nghttp2_session_mem_send(s->session, &data)) > 0)
+        g_byte_array_append(s->outbuf, data, len);
+    if (len < 0) {
+        h2_session_close(s, nghttp2_strerror((int) len));
+        return;
+    }
+    if (s->outbuf->len == 0)
+        return;
+
+    s->writing = TRUE;
+    h2_session_ref(s);
+    g_output_stream_write_async(g_io_stream_get_output_stream(s->stream), s->outbuf->data, s->outbuf->len, G_PRIORITY_DEFAULT, s->cancellable, h2_session_write_cb, s);
+}
+
+static void h2_session_read_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterH2Session *s = data;
+    GError         *error = NULL;
+    gssize          len = g_input_stream_read_finish(G_INPUT_STREAM(source), result, &error);
+    ssize_t         rv;
+
+    if (s->closed) {
+        /* cancelled */
+    } else if (len <= 0) {
+        h2_session_close(s, error ? error->message : _("Server closed the connection"));
+    } else {
+        if (!s->session_saved) {
+            s->session_saved = TRUE;
+            prpltwtr_gio_tls_session_save(s->stream, s->host, s->port);
+        }
+        s->last_read = time(NULL);
+        s->in_recv = TRUE;
+        rv = nghttp2_session_mem_recv(s->session, s->rbuf, len);
+        s->in_recv = FALSE;
+
+        if (rv < 0) {
+            h2_session_close(s, nghttp2_strerror((int) rv));
+        } else {
+            h2_session_dispatch(s);
+            h2_session_flush(s);
+            if (!s->closed) {
+                if (nghttp2_session_want_read(s->session) || nghttp2_session_want_write(s->session))
+                    h2_session_read(s);
+                else
+                    h2_session_close(s, NULL);
+            }
+        }
+    }
+
+    if (error)
+        g_error_free(error);
+    h2_session_unref(s);
+}
+
+static void h2_session_read(TwitterH2Session * s)
+{
+    h2_session_ref(s);
+    g_input_stream_read_async(g_io_stream_get_input_stream(s->stream), s->rbuf, sizeof (s->rbuf), G_PRIORITY_DEFAULT, s->cancellable, h2_session_read_cb, s);
+}
+
+static int h2_on_header_cb(nghttp2_session * session, const nghttp2_frame * frame, const uint8_t * name, size_t namelen, const uint8_t * value, size_t valuelen, uint8_t flags, void *user_data)
+{
+    TwitterH2Request *req;
+
+    if (frame->hd.type != NGHTTP2_HEADERS)
+        return 0;
+    req = nghttp2_session_get_stream_user_data(session, frame->hd.stream_id);
+    if (!req)
+        return 0;
+    h2_request_progress(req);
+
+    if (namelen == 7 && !memcmp(name, ":status", 7)) {
+        gchar          *status = g_strndup((const gchar *) value, valuelen);
+        req->status = atoi(status);
+        g_free(status);
+    } else if (namelen > 0 && name[0] != ':') {
+        if (namelen == 16 && !memcmp(name, "content-encoding", 16) && !req->decoder) {
+            gchar          *encoding = g_strndup((const gchar *) value, valuelen);
+            req->decoder = twitter_http_decoder_new(encoding);
+            g_free(encoding);
+        }
+        g_string_append_len(req->headers, (const gchar *) name, namelen);
+        g_string_append(req->headers, ": ");
+        g_string_append_len(req->headers, (const gchar *) value, valuelen);
+        g_string_append(req->headers, "\r\n");
+    }
+    return 0;
+}
+
+static void h2_request_body(const gchar * data, gsize len, gpointer user_data)
+{
+    TwitterH2Request *req = user_data;
+
+    prpltwtr_stats_add_transfer(req->endpoint, 0, len);
+    /* Error bodies are kept whole, so they can be parsed for a message */
+    if (req->chunk_func && req->status >= 200 && req->status < 300)
+        req->chunk_func(req, req->user_data, data, len);
+    else
+        g_string_append_len(req->response_body, data, len);
+}
+
+static int h2_on_data_chunk_recv_cb(nghttp2_session * session, uint8_t flags, int32_t stream_id, const uint8_t * data, size_t len, void *user_data)
+{
+    TwitterH2Request *req = nghttp2_session_get_stream_user_data(session, stream_id);
+
+    if (!req || req->cancelled || req->error_message)
+        return 0;
+
+    h2_request_progress(req);
+    prpltwtr_stats_add_transfer(req->endpoint, len, 0);
+    if (!req->decoder)
+        h2_request_body((const gchar *) data, len, req);
+    else if (!twitter_http_decoder_feed(req->decoder, (const gchar *) data, len, h2_request_body, req))
+        req->error_message = g_strdup(_("Unable to decompress the response"));
+    return 0;
+}
+
+static int h2_on_stream_close_cb(nghttp2_session * session, int32_t stream_id, uint32_t error_code, void *user_data)
+{
+    TwitterH2Session *s = user_data;
+    TwitterH2Request *req = g_hash_table_lookup(s->streams, GINT_TO_POINTER(stream_id));
+
+    if (!req)
+        return 0;
+    g_hash_table_steal(s->streams, GINT_TO_POINTER(stream_id));
+    req->session = NULL;
+    if (req->stall_timer) {
+        purple_timeout_remove(req->stall_timer);
+        req->stall_timer = 0;
+    }
+    if (error_code != NGHTTP2_NO_ERROR && !req->error_message)
+        req->error_message = g_strdup_printf(_("HTTP/2 stream error: %s"), nghttp2_http2_strerror(error_code));
+    /* Called back once nghttp2 is done with the data we fed it */
+    s->completed = g_list_append(s->completed, req);
+    return 0;
+}
+
+static int h2_on_frame_recv_cb(nghttp2_session * session, const nghttp2_frame * frame, void *user_data)
+{
+    TwitterH2Session *s = user_data;
+
+    if (frame->hd.type == NGHTTP2_GOAWAY) {
+        /* Streams already open still finish; new requests get a new session */
+        purple_debug_info(GENERIC_PROTOCOL_ID, "HTTP/2 server %s sent GOAWAY\n", s->host);
+        if (h2_sessions && g_hash_table_lookup(h2_sessions, s->key) == s)
+            g_hash_table_remove(h2_sessions, s->key);
+    }
+    return 0;
+}
+
+static ssize_t h2_body_read_cb(nghttp2_session * session, int32_t stream_id, uint8_t * buf, size_t length, uint32_t * data_flags, nghttp2_data_source * source, void *user_data)
+{
+    TwitterH2Request *req = source->ptr;
+    size_t          n = MIN(length, req->body_len - req->body_sent);
+
+    memcpy(buf, req->body + req->body_sent, n);
+    req->body_sent += n;
+    if (req->body_sent == req->body_len)
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    return n;
+}
+
+static void h2_nv_add(GArray * nva, const gchar * name, const gchar * value)
+{
+    nghttp2_nv      nv;
+    nv.name = (uint8_t *) name;
+    nv.namelen = strlen(name);
+    nv.value = (uint8_t *) value;
+    nv.valuelen = strlen(value);
+    nv.flags = NGHTTP2_NV_FLAG_NONE;
+    g_array_append_val(nva, nv);
+}
+
+static void h2_session_submit(TwitterH2Session * s, TwitterH2Request * req)
+{
+    gchar          *head_end = g_strstr_len(req->data, req->data_len, "\r\n\r\n");
+    gchar          *head;
+    gchar         **lines;
+    gchar         **request_line;
+    GArray         *nva;
+    GArray         *headers;
+    GPtrArray      *names;
+    const gchar    *path = "/";
+    const gchar    *authority = s->host;
+    nghttp2_priority_spec spec;
+    nghttp2_data_provider provider;
+    int             i;
+
+    if (!head_end) {
+        h2_request_fail_later(req, _("Invalid request"));
+        return;
+    }
+    head = g_strndup(req->data, head_end - req->data);
+    req->body = head_end + 4;
+    req->body_len = req->data + req->data_len - req->body;
+
+    lines = g_strsplit(head, "\r\n", 0);
+    request_line = g_strsplit(lines[0] ? lines[0] : "", " ", 3);
+    nva = g_array_new(FALSE, FALSE, sizeof (nghttp2_nv));
+    headers = g_array_new(FALSE, FALSE, sizeof (nghttp2_nv));
+    names = g_ptr_array_new_with_free_func(g_free);
+
+    /* The request line has the absolute URL, the path starts after the host */
+    if (request_line[0] && request_line[1]) {
+        const gchar    *target = strstr(request_line[1], "://");
+        target = target ? strchr(target + 3, '/') : request_line[1];
+        if (target)
+            path = target;
+    }
+
+    for (i = 1; lines[i]; i++) {
+        gchar          *colon = strchr(lines[i], ':');
+        gchar          *name;
+        if (!colon)
+            continue;
+        name = g_ascii_strdown(lines[i], colon - lines[i]);
+        if (!strcmp(name, "host")) {
+            authority = g_strchug(colon + 1);
+            g_free(name);
+        } else if (!strcmp(name, "connection") || !strcmp(name, "keep-alive") || !strcmp(name, "transfer-encoding")) {
+            /* connection-specific headers are not allowed in HTTP/2 */
+            g_free(name);
+        } else {
+            g_ptr_array_add(names, name);
+            h2_nv_add(headers, name, g_strchug(colon + 1));
+        }
+    }
+
+    /* pseudo-headers must come first */
+    h2_nv_add(nva, ":method", request_line[0] ? request_line[0] : "GET");
+    h2_nv_add(nva, ":scheme", s->use_https ? "https" : "http");
+    h2_nv_add(nva, ":authority", authority);
+    h2_nv_add(nva, ":path", path);
+    g_array_append_vals(nva, headers->data, headers->len);
+
+    nghttp2_priority_spec_init(&spec, 0, CLAMP(req->weight, NGHTTP2_MIN_WEIGHT, NGHTTP2_MAX_WEIGHT), 0);
+    provider.source.ptr = req;
+    provider.read_callback = h2_body_read_cb;
+
+    req->stream_id = nghttp2_submit_request(s->session, &spec, (nghttp2_nv *) nva->data, nva->len, req->body_len ? &provider : NULL, req);
+
+    g_array_free(nva, TRUE);
+    g_array_free(headers, TRUE);
+    g_ptr_array_free(names, TRUE);
+    g_strfreev(request_line);
+    g_strfreev(lines);
+    g_free(head);
+
+    if (req->stream_id < 0) {
+        h2_request_fail_later(req, nghttp2_strerror(req->stream_id));
+        return;
+    }
+
+    h2_stats.streams++;
+    req->session = s;
+    g_hash_table_insert(s->streams, GINT_TO_POINTER(req->stream_id), req);
+    h2_request_progress(req);
+    if (s->idle_timer) {
+        purple_timeout_remove(s->idle_timer);
+        s->idle_timer = 0;
+    }
+}
+
+static gboolean h2_session_start(TwitterH2Session * s)
+{
+    nghttp2_session_callbacks *callbacks;
+    nghttp2_settings_entry settings[] = {
+        {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, TWITTER_H2_MAX_CONCURRENT_STREAMS},
+        {NGHTTP2_SETTINGS_ENABLE_PUSH, 0}
+    };
+    int             rv;
+
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, h2_on_header_cb);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, h2_on_data_chunk_recv_cb);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, h2_on_stream_close_cb);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, h2_on_frame_recv_cb);
+    rv = nghttp2_session_client_new(&s->session, callbacks, s);
+    nghttp2_session_callbacks_del(callbacks);
+    if (rv != 0)
+        return FALSE;
+
+    return nghttp2_submit_settings(s->session, NGHTTP2_FLAG_NONE, settings, G_N_ELEMENTS(settings)) == 0;
+}
+
+static void h2_client_event_cb(GSocketClient * client, GSocketClientEvent event, GSocketConnectable * connectable, GIOStream * connection, gpointer data)
+{
+    TwitterH2Session *s = data;
+    static const gchar *protocols[] = { "h2", "http/1.1", NULL };
+
+    if (event == G_SOCKET_CLIENT_TLS_HANDSHAKING) {
+        g_tls_connection_set_advertised_protocols(G_TLS_CONNECTION(connection), protocols);
+        prpltwtr_gio_tls_session_offer(connection, s->host, s->port);
+    }
+    else if (event == G_SOCKET_CLIENT_TLS_HANDSHAKED)
+        s->negotiated_h2 = !g_strcmp0(g_tls_connection_get_negotiated_protocol(G_TLS_CONNECTION(connection)), "h2");
+}
+
+static void h2_session_connected_cb(GObject * source, GAsyncResult * result, gpointer data)
+{
+    TwitterH2Session *s = data;
+    GError         *error = NULL;
+    GSocketConnection *connection = g_socket_client_connect_to_host_finish(G_SOCKET_CLIENT(source), result, &error);
+    GList          *queued;
+    GList          *l;
+
+    if (s->closed) {
+        if (connection)
+            g_object_unref(connection);
+    } else if (!connection) {
+        h2_session_close(s, error->message);
+    } else if (s->use_https && !s->negotiated_h2) {
+        /* No h2 here. Send what we have over HTTP/1.1, and don't try again */
+        purple_debug_info(GENERIC_PROTOCOL_ID, "%s doesn't support HTTP/2, using HTTP/1.1\n", s->host);
+        g_object_unref(connection);
+        if (!h2_unsupported)
+            h2_unsupported = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_insert(h2_unsupported, h2_server_key(s->use_https, s->host, s->port), GINT_TO_POINTER(TRUE));
+
+        queued = s->queued;
+        s->queued = NULL;
+        for (l = queued; l; l = l->next)
+            h2_request_fallback(l->data);
+        g_list_free(queued);
+        h2_session_close(s, NULL);
+    } else if (!h2_session_start(s)) {
+        g_object_unref(connection);
+        h2_session_close(s, _("Unable to start HTTP/2 session"));
+    } else {
+        /* The socket timeout was for connecting. The connection outlives
+         * its requests, and idle or waiting on a stream isn't stalling:
+         * each request times out on its own instead */
+        g_socket_set_timeout(g_socket_connection_get_socket(connection), 0);
+        s->stream = G_IO_STREAM(connection);
+        s->connected = TRUE;
+        s->last_read = time(NULL);
+
+        queued = s->queued;
+        s->queued = NULL;
+        for (l = queued; l; l = l->next)
+            h2_session_submit(s, l->data);
+        g_list_free(queued);
+
+        h2_session_flush(s);
+        h2_session_read(s);
+        h2_session_check_idle(s);
+    }
+
+    if (error)
+        g_error_free(error);
+    h2_session_unref(s);
+}
+
+static TwitterH2Session *h2_session_new(const gchar * key, PurpleAccount * account, gboolean use_https, const gchar * host, int port, guint timeout)
+{
+    TwitterH2Session *s = g_new0(TwitterH2Session, 1);
+    GSocketClient  *client;
+
+    s->key = g_strdup(key);
+    s->account = account;
+    s->host = g_strdup(host);
+    s->port = port;
+    s->use_https = use_https;
+    s->ref = 1;
+    s->cancellable = g_cancellable_new();
+    s->outbuf = g_byte_array_new();
+    s->streams = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Opening HTTP/2 connection to %s:%d%s\n", host, port, use_https ? "" : " (h2c)");
+    h2_stats.sessions_opened++;
+    h2_stats.sessions++;
+
+    client = g_socket_client_new();
+    g_socket_client_set_tls(client, use_https);
+    /* For connecting and the TLS handshake */
+    g_socket_client_set_timeout(client, timeout);
+    prpltwtr_gio_client_set_proxy(client, account);
+    g_signal_connect(client, "event", G_CALLBACK(h2_client_event_cb), s);
+    h2_session_ref(s);
+    g_socket_client_connect_to_host_async(client, host, port, s->cancellable, h2_session_connected_cb, s);
+    g_object_unref(client);
+
+    return s;
+}
+
+/* Returns the account's session with host:port, opening it if needed, or
+ * NULL if the server is known not to speak h2 */
+static TwitterH2Session *h2_session_get(PurpleAccount * account, gboolean use_https, const gchar * host, int port, guint timeout)
+{
+    gchar          *server_key = h2_server_key(use_https, host, port);
+    gchar          *key;
+    TwitterH2Session *s;
+
+    if (h2_unsupported && g_hash_table_lookup(h2_unsupported, server_key)) {
+        g_free(server_key);
+        return NULL;
+    }
+
+    key = g_strdup_printf("%p|%s", account, server_key);
+    g_free(server_key);
+
+    if (!h2_sessions)
+        h2_sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    s = g_hash_table_lookup(h2_sessions, key);
+    if (!s) {
+        s = h2_session_new(key, account, use_https, host, port, timeout);
+        g_hash_table_insert(h2_sessions, g_strdup(key), s);
+    }
+    g_free(key);
+
+    return s;
+}
+
+/* Takes ownership of request */
+static TwitterH2Request *h2_request_start(PurpleAccount * account, gboolean use_https, const gchar * host, int port, gchar * request, gsize request_len, gint weight, guint timeout, TwitterH2ChunkFunc chunk_func, TwitterH2Callback callback, gpointer user_data)
+{
+    TwitterH2Request *req = g_new0(TwitterH2Request, 1);
+    TwitterH2Session *s;
+
+    req->account = account;
+    req->use_https = use_https;
+    req->host = g_strdup(host);
+    req->port = port;
+    req->timeout = timeout;
+    req->weight = weight;
+    req->endpoint = twitter_http_request_endpoint(request);
+    req->data = request;
+    req->data_len = request_len;
+    req->headers = g_string_new(NULL);
+    req->response_body = g_string_new(NULL);
+    req->chunk_func = chunk_func;
+    req->callback = callback;
+    req->user_data = user_data;
+
+    s = h2_session_get(account, use_https, host, port, timeout);
+    if (!s) {
+        h2_request_fallback(req);
+        return req;
+    }
+
+    if (s->connected) {
+        h2_session_submit(s, req);
+        h2_session_flush(s);
+    } else {
+        req->session = s;
+        s->queued = g_list_append(s->queued, req);
+    }
+    return req;
+}
+
+TwitterH2Request *prpltwtr_h2_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, gint weight, guint timeout, TwitterH2ChunkFunc chunk_func, TwitterH2Callback callback, gpointer user_data)
+{
+    return h2_request_start(account, use_https, host, port, g_strndup(request, request_len), request_len, weight, timeout, chunk_func, callback, user_data);
+}
+
+TwitterH2Request *prpltwtr_h2_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, gint weight, guint timeout, TwitterH2ChunkFunc chunk_func, TwitterH2Callback callback, gpointer user_data)
+{
+    gsize           len;
+    gchar          *request = twitter_http_segments_flatten(segments, &len);
+
+    twitter_http_segments_free(segments);
+    return h2_request_start(account, use_https, host, port, request, len, weight, timeout, chunk_func, callback, user_data);
+}
+
+void prpltwtr_h2_warmup(PurpleAccount * account, gboolean use_https, const gchar * host, int port, guint timeout)
+{
+    h2_session_get(account, use_https, host, port, timeout);
+}
+
+void prpltwtr_h2_request_cancel(TwitterH2Request * req)
+{
+    TwitterH2Session *s = req->session;
+
+    if (req->fallback) {
+        prpltwtr_gio_request_cancel(req->fallback);
+        h2_request_free(req);
+    } else if (req->failed) {
+        h2_request_free(req);
+    } else if (s && !s->connected) {
+        s->queued = g_list_remove(s->queued, req);
+        h2_request_free(req);
+        h2_session_check_idle(s);
+    } else if (s) {
+        /* Freed when the stream closes */
+        req->cancelled = TRUE;
+        nghttp2_submit_rst_stream(s->session, NGHTTP2_FLAG_NONE, req->stream_id, NGHTTP2_CANCEL);
+        h2_session_flush(s);
+    } else {
+        /* The stream has closed and is waiting to be dispatched */
+        req->cancelled = TRUE;
+    }
+}
+
+static void h2_collect_account_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+    GList         **l = user_data;
+    TwitterH2Session *s = value;
+    if (s->account == (*l)->data)
+        *l = g_list_append(*l, s);
+}
+
+void prpltwtr_h2_close_account(PurpleAccount * account)
+{
+    GList          *sessions;
+    GList          *l;
+
+    if (!h2_sessions)
+        return;
+
+    sessions = g_list_append(NULL, account);
+    g_hash_table_foreach(h2_sessions, h2_collect_account_foreach, &sessions);
+    for (l = sessions->next; l; l = l->next)
+        h2_session_close(l->data, NULL);
+    g_list_free(sessions);
+}
+
+void prpltwtr_h2_get_stats(TwitterH2Stats * stats)
+{
+    *stats = h2_stats;
+}
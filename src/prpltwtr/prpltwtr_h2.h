@@ -0,0 +1,80 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_H2_H_
+#define _TWITTER_H2_H_
+
+#include <glib.h>
+#include <account.h>
+
+#include "prpltwtr_http.h"
+
+/* Seconds a session without streams is kept open */
+#define TWITTER_H2_IDLE_TIMEOUT 30
+
+typedef struct _TwitterH2Request TwitterH2Request;
+
+/// Called once per request, with the response translated to HTTP/1.1 form
+/// (status line, headers, blank line and body) or with an error message.
+/// If a chunk function received the body, the response only holds headers.
+typedef void    (*TwitterH2Callback) (TwitterH2Request * req, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message);
+
+/// Receives the body of a successful (2xx) response as it arrives.
+typedef void    (*TwitterH2ChunkFunc) (TwitterH2Request * req, gpointer user_data, const gchar * data, gsize len);
+
+typedef struct {
+    guint           sessions_opened;             /* connections opened */
+    guint           streams;                     /* requests sent as HTTP/2 streams */
+    guint           fallbacks;                   /* requests sent over HTTP/1.1 because the server has no h2 */
+    guint           sessions;                    /* connections currently open */
+} TwitterH2Stats;
+
+/// Sends a raw HTTP/1.1 request as a stream on the account's HTTP/2
+/// connection to host:port, opening it if needed. Over TLS, h2 is
+/// negotiated with ALPN and servers without it get the request over
+/// HTTP/1.1 instead. Without TLS, h2 is spoken with prior knowledge (h2c).
+/// weight (1-256) is the stream's share of the connection. The timeout
+/// (seconds without progress, 0 for none) applies to opening the
+/// connection and to each request on its own; a request that times out
+/// has its stream reset, and the connection is closed if nothing at all
+/// came in meanwhile.
+TwitterH2Request *prpltwtr_h2_request(PurpleAccount * account, gboolean use_https, const gchar * host, int port, const gchar * request, gsize request_len, gint weight, guint timeout, TwitterH2ChunkFunc chunk_func, TwitterH2Callback callback, gpointer user_data);
+
+/// Like prpltwtr_h2_request, for a request in segments. nghttp2 frames the
+/// request itself, so they're joined first. Takes ownership of segments.
+TwitterH2Request *prpltwtr_h2_request_segments(PurpleAccount * account, gboolean use_https, const gchar * host, int port, TwitterHttpSegments * segments, gint weight, guint timeout, TwitterH2ChunkFunc chunk_func, TwitterH2Callback callback, gpointer user_data);
+
+/// Opens the account's connection to host:port ahead of the first request.
+/// It's closed again if no request comes within TWITTER_H2_IDLE_TIMEOUT.
+void            prpltwtr_h2_warmup(PurpleAccount * account, gboolean use_https, const gchar * host, int port, guint timeout);
+
+/// Cancels a request. Neither callback will be called again.
+void            prpltwtr_h2_request_cancel(TwitterH2Request * req);
+
+/// Closes the account's connections. Requests still on them fail.
+void            prpltwtr_h2_close_account(PurpleAccount * account);
+
+void            prpltwtr_h2_get_stats(TwitterH2Stats * stats);
+
+#endif
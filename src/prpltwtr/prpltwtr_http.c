@@ -0,0 +1,649 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gio/gio.h>
+
+#include "prpltwtr_http.h"
+
+#define TWITTER_HTTP_DECODE_SIZE 16384
+
+struct _TwitterHttpDecoder {
+    GConverter     *converter;
+    gboolean        finished;
+};
+
+struct _TwitterHttpBufferPool {
+    gint            ref;
+    GSList         *free_buffers;
+    guint           free_count;
+    guint           allocated;
+    guint           reused;
+};
+
+typedef struct {
+    TwitterHttpBufferPool *pool;
+    GString        *buffer;
+} TwitterHttpPooledBuffer;
+
+static time_t twitter_http_parse_date(const gchar * value)
+{
+    static const gchar *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    const gchar    *comma = strchr(value, ',');
+    gchar           month[4];
+    gint            day, year, hour, min, sec;
+    gint            i;
+    GDateTime      *dt;
+    time_t          t;
+
+    /* RFC 1123, the only format servers send nowadays:
+     * "Sun, 06 Nov 1994 08:49:37 GMT" */
+    if (!comma || sscanf(comma + 1, " %d %3s %d %d:%d:%d", &day, month, &year, &hour, &min, &sec) != 6)
+        return 0;
+    for (i = 0; i < 12 && g_ascii_strcasecmp(month, months[i]); i++);
+    if (i == 12 || !(dt = g_date_time_new_utc(year, i + 1, day, hour, min, sec)))
+        return 0;
+
+    t = g_date_time_to_unix(dt);
+    g_date_time_unref(dt);
+    return t;
+}
+
+static void twitter_http_headers_set(TwitterHttpHeaders * headers, const gchar * name, gsize name_len, const gchar * value, gsize value_len)
+{
+#define HEADER_IS(n) (name_len == sizeof (n) - 1 && !g_ascii_strncasecmp(name, n, name_len))
+    gchar          *v;
+
+    /* Only copy values we keep */
+    if (!HEADER_IS("Content-Length") && !HEADER_IS("Transfer-Encoding") && !HEADER_IS("Content-Encoding") && !HEADER_IS("Connection") && !HEADER_IS("ETag") && !HEADER_IS("Last-Modified") && !HEADER_IS("Location") && !HEADER_IS("Date") && !HEADER_IS("Retry-After") && (name_len < 12 || g_ascii_strncasecmp(name, "X-Rate", 6)))
+        return;
+    v = g_strndup(value, value_len);
+
+    if (HEADER_IS("Content-Length")) {
+        headers->content_length = g_ascii_strtoll(v, NULL, 10);
+    } else if (HEADER_IS("Transfer-Encoding")) {
+        headers->chunked = strstr(v, "chunked") != NULL;
+    } else if (HEADER_IS("Content-Encoding")) {
+        g_free(headers->content_encoding);
+        headers->content_encoding = v;
+        v = NULL;
+    } else if (HEADER_IS("Connection")) {
+        if (!g_ascii_strncasecmp(v, "close", 5))
+            headers->keep_alive = FALSE;
+        else if (!g_ascii_strncasecmp(v, "keep-alive", 10))
+            headers->keep_alive = TRUE;
+    } else if (HEADER_IS("ETag")) {
+        g_free(headers->etag);
+        headers->etag = v;
+        v = NULL;
+    } else if (HEADER_IS("Last-Modified")) {
+        /* Only ever sent back as is, in If-Modified-Since */
+        g_free(headers->last_modified);
+        headers->last_modified = v;
+        v = NULL;
+    } else if (HEADER_IS("Location")) {
+        g_free(headers->location);
+        headers->location = v;
+        v = NULL;
+    } else if (HEADER_IS("Date")) {
+        headers->date = twitter_http_parse_date(v);
+    } else if (HEADER_IS("Retry-After")) {
+        /* Seconds from now or a date */
+        if (g_ascii_isdigit(*v))
+            headers->retry_after = time(NULL) + g_ascii_strtoll(v, NULL, 10);
+        else
+            headers->retry_after = twitter_http_parse_date(v);
+    } else if (HEADER_IS("X-RateLimit-Remaining") || HEADER_IS("X-Rate-Limit-Remaining")) {
+        /* API 1.0 and 1.1 spell these differently */
+        headers->rate_limit_remaining = atoi(v);
+    } else if (HEADER_IS("X-RateLimit-Limit") || HEADER_IS("X-Rate-Limit-Limit")) {
+        headers->rate_limit_limit = atoi(v);
+    } else if (HEADER_IS("X-RateLimit-Reset") || HEADER_IS("X-Rate-Limit-Reset")) {
+        headers->rate_limit_reset = (time_t) g_ascii_strtoll(v, NULL, 10);
+    }
+
+    g_free(v);
+#undef HEADER_IS
+}
+
+gboolean twitter_http_headers_parse(TwitterHttpHeaders * headers, const gchar * text, gsize len)
+{
+    const gchar    *end = text + len;
+    const gchar    *line;
+    const gchar    *next;
+    const gchar    *line_end;
+    const gchar    *colon;
+    const gchar    *value;
+
+    memset(headers, 0, sizeof (TwitterHttpHeaders));
+    headers->rate_limit_remaining = -1;
+    headers->rate_limit_limit = -1;
+    headers->content_length = -1;
+
+    if (len < 12 || strncmp(text, "HTTP/1.", 7))
+        return FALSE;
+
+    /* HTTP/1.1 is keep-alive unless told otherwise, HTTP/1.0 is the reverse */
+    headers->keep_alive = text[7] == '1';
+    headers->status_code = atoi(text + 9);
+
+    for (line = text; line < end; line = next) {
+        if (!(next = memchr(line, '\n', end - line)))
+            break;
+        line_end = next++;
+        if (line_end > line && line_end[-1] == '\r')
+            line_end--;
+
+        if (line == text)
+            continue;                            /* the status line */
+        if (line_end == line) {
+            headers->length = next - text;
+            return TRUE;
+        }
+
+        if (!(colon = memchr(line, ':', line_end - line)))
+            continue;
+        for (value = colon + 1; value < line_end && (*value == ' ' || *value == '\t'); value++);
+        twitter_http_headers_set(headers, line, colon - line, value, line_end - value);
+    }
+
+    return FALSE;
+}
+
+void twitter_http_headers_clear(TwitterHttpHeaders * headers)
+{
+    g_free(headers->content_encoding);
+    g_free(headers->etag);
+    g_free(headers->last_modified);
+    g_free(headers->location);
+    headers->content_encoding = NULL;
+    headers->etag = NULL;
+    headers->last_modified = NULL;
+    headers->location = NULL;
+}
+
+void twitter_http_reader_init(TwitterHttpReader * reader)
+{
+    memset(reader, 0, sizeof (TwitterHttpReader));
+    reader->rbuf = g_string_new(NULL);
+    reader->state = TWITTER_HTTP_READ_HEADERS;
+}
+
+void twitter_http_reader_clear(TwitterHttpReader * reader)
+{
+    if (reader->rbuf)
+        g_string_free(reader->rbuf, TRUE);
+    if (reader->response)
+        g_string_free(reader->response, TRUE);
+    if (reader->decoder)
+        twitter_http_decoder_free(reader->decoder);
+    twitter_http_headers_clear(&reader->headers);
+    reader->rbuf = NULL;
+    reader->response = NULL;
+    reader->decoder = NULL;
+}
+
+void twitter_http_reader_reset(TwitterHttpReader * reader)
+{
+    reader->state = TWITTER_HTTP_READ_HEADERS;
+    twitter_http_headers_clear(&reader->headers);
+    reader->status_code = 0;
+    reader->keep_alive = FALSE;
+    reader->decode_failed = FALSE;
+    reader->body_remaining = 0;
+    reader->headers_func = NULL;
+    reader->body_func = NULL;
+    reader->user_data = NULL;
+    g_string_truncate(reader->rbuf, 0);
+    if (reader->response) {
+        g_string_free(reader->response, TRUE);
+        reader->response = NULL;
+    }
+    if (reader->decoder) {
+        twitter_http_decoder_free(reader->decoder);
+        reader->decoder = NULL;
+    }
+}
+
+gboolean twitter_http_reader_started(TwitterHttpReader * reader)
+{
+    return reader->state != TWITTER_HTTP_READ_HEADERS || reader->rbuf->len > 0;
+}
+
+gboolean twitter_http_reader_has_trailing_data(TwitterHttpReader * reader)
+{
+    return reader->rbuf->len > 0;
+}
+
+GString        *twitter_http_reader_steal_response(TwitterHttpReader * reader)
+{
+    GString        *response = reader->response;
+    reader->response = NULL;
+    return response;
+}
+
+void twitter_http_reader_take_counts(TwitterHttpReader * reader, gsize * wire_bytes, gsize * body_bytes)
+{
+    *wire_bytes = reader->wire_bytes;
+    *body_bytes = reader->body_bytes;
+    reader->wire_bytes = 0;
+    reader->body_bytes = 0;
+}
+
+static void twitter_http_reader_parse_headers(TwitterHttpReader * reader, const gchar * headers, gsize len)
+{
+    TwitterHttpHeaders *h = &reader->headers;
+
+    twitter_http_headers_clear(h);
+    twitter_http_headers_parse(h, headers, len);
+    reader->status_code = h->status_code;
+    reader->keep_alive = h->keep_alive;
+    if (h->content_encoding)
+        reader->decoder = twitter_http_decoder_new(h->content_encoding);
+
+    if (reader->status_code == 204 || reader->status_code == 304 || (reader->status_code >= 100 && reader->status_code < 200)) {
+        reader->state = TWITTER_HTTP_READ_DONE;
+    } else if (h->chunked) {
+        reader->state = TWITTER_HTTP_READ_CHUNK_SIZE;
+    } else if (h->content_length >= 0) {
+        reader->body_remaining = h->content_length;
+        reader->state = reader->body_remaining ? TWITTER_HTTP_READ_BODY : TWITTER_HTTP_READ_DONE;
+    } else {
+        /* No framing, the body ends when the server closes the connection */
+        reader->state = TWITTER_HTTP_READ_BODY_EOF;
+        reader->keep_alive = FALSE;
+    }
+}
+
+static void twitter_http_reader_decoded(const gchar * data, gsize len, gpointer user_data)
+{
+    TwitterHttpReader *reader = user_data;
+
+    reader->body_bytes += len;
+    if (reader->body_func)
+        reader->body_func(reader, data, len, reader->user_data);
+    else
+        g_string_append_len(reader->response, data, len);
+}
+
+static void twitter_http_reader_body(TwitterHttpReader * reader, const gchar * data, gsize len)
+{
+    reader->wire_bytes += len;
+    if (!reader->decoder)
+        twitter_http_reader_decoded(data, len, reader);
+    else if (!reader->decode_failed && !twitter_http_decoder_feed(reader->decoder, data, len, twitter_http_reader_decoded, reader))
+        reader->decode_failed = TRUE;
+}
+
+gboolean twitter_http_reader_feed(TwitterHttpReader * reader, const gchar * data, gsize len)
+{
+    GString        *rbuf = reader->rbuf;
+    gsize           pos = 0;
+
+    g_string_append_len(rbuf, data, len);
+
+    while (reader->state != TWITTER_HTTP_READ_DONE) {
+        gchar          *avail = rbuf->str + pos;
+        gsize           avail_len = rbuf->len - pos;
+        gchar          *end;
+        gsize           n;
+
+        switch (reader->state) {
+        case TWITTER_HTTP_READ_HEADERS:
+            end = g_strstr_len(avail, avail_len, "\r\n\r\n");
+            if (!end)
+                goto out;
+            n = end - avail + 4;
+            twitter_http_reader_parse_headers(reader, avail, n);
+            reader->response = g_string_sized_new(n + reader->body_remaining + 1);
+            g_string_append_len(reader->response, avail, n);
+            pos += n;
+            if (reader->headers_func)
+                reader->headers_func(reader, reader->user_data);
+            break;
+        case TWITTER_HTTP_READ_BODY:
+        case TWITTER_HTTP_READ_CHUNK_DATA:
+            n = MIN(avail_len, reader->body_remaining);
+            if (n == 0)
+                goto out;
+            twitter_http_reader_body(reader, avail, n);
+            reader->body_remaining -= n;
+            pos += n;
+            if (reader->body_remaining == 0)
+                reader->state = reader->state == TWITTER_HTTP_READ_BODY ? TWITTER_HTTP_READ_DONE : TWITTER_HTTP_READ_CHUNK_CRLF;
+            break;
+        case TWITTER_HTTP_READ_BODY_EOF:
+            if (avail_len > 0)
+                twitter_http_reader_body(reader, avail, avail_len);
+            pos += avail_len;
+            goto out;
+        case TWITTER_HTTP_READ_CHUNK_SIZE:
+            end = g_strstr_len(avail, avail_len, "\r\n");
+            if (!end)
+                goto out;
+            reader->body_remaining = strtoul(avail, NULL, 16);
+            pos += end - avail + 2;
+            reader->state = reader->body_remaining ? TWITTER_HTTP_READ_CHUNK_DATA : TWITTER_HTTP_READ_TRAILER;
+            break;
+        case TWITTER_HTTP_READ_CHUNK_CRLF:
+            if (avail_len < 2)
+                goto out;
+            pos += 2;
+            reader->state = TWITTER_HTTP_READ_CHUNK_SIZE;
+            break;
+        case TWITTER_HTTP_READ_TRAILER:
+            end = g_strstr_len(avail, avail_len, "\r\n");
+            if (!end)
+                goto out;
+            if (end == avail)
+                reader->state = TWITTER_HTTP_READ_DONE;
+            pos += end - avail + 2;
+            break;
+        case TWITTER_HTTP_READ_DONE:
+            break;
+        }
+    }
+
+  out:
+    g_string_erase(rbuf, 0, pos);
+    return reader->state == TWITTER_HTTP_READ_DONE;
+}
+
+gboolean twitter_http_reader_eof(TwitterHttpReader * reader)
+{
+    if (reader->state != TWITTER_HTTP_READ_BODY_EOF)
+        return reader->state == TWITTER_HTTP_READ_DONE;
+    reader->state = TWITTER_HTTP_READ_DONE;
+    reader->keep_alive = FALSE;
+    return TRUE;
+}
+
+TwitterHttpDecoder *twitter_http_decoder_new(const gchar * content_encoding)
+{
+    gchar          *encoding = g_strstrip(g_ascii_strdown(content_encoding, -1));
+    TwitterHttpDecoder *decoder = NULL;
+
+    if (!strcmp(encoding, "gzip") || !strcmp(encoding, "x-gzip")) {
+        decoder = g_new0(TwitterHttpDecoder, 1);
+        decoder->converter = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+    } else if (!strcmp(encoding, "deflate")) {
+        /* The zlib wrapper is checked for on the first bytes */
+        decoder = g_new0(TwitterHttpDecoder, 1);
+    }
+
+    g_free(encoding);
+    return decoder;
+}
+
+void twitter_http_decoder_free(TwitterHttpDecoder * decoder)
+{
+    if (decoder->converter)
+        g_object_unref(decoder->converter);
+    g_free(decoder);
+}
+
+gboolean twitter_http_decoder_feed(TwitterHttpDecoder * decoder, const gchar * data, gsize len, TwitterHttpDecoderFunc func, gpointer user_data)
+{
+    gchar           buf[TWITTER_HTTP_DECODE_SIZE];
+    gsize           bytes_read;
+    gsize           bytes_written;
+
+    if (len == 0 || decoder->finished)
+        return TRUE;
+
+    if (!decoder->converter) {
+        const guchar   *head = (const guchar *) data;
+        GZlibCompressorFormat format = G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+
+        /* "deflate" is meant to be zlib data, but some servers send a raw
+         * deflate stream */
+        if (len < 2 || (head[0] & 0x0f) != 8 || (head[0] * 256 + head[1]) % 31 != 0)
+            format = G_ZLIB_COMPRESSOR_FORMAT_RAW;
+        decoder->converter = G_CONVERTER(g_zlib_decompressor_new(format));
+    }
+
+    do {
+        GError         *error = NULL;
+        GConverterResult result = g_converter_convert(decoder->converter, data, len, buf, sizeof (buf), G_CONVERTER_NO_FLAGS, &bytes_read, &bytes_written, &error);
+
+        if (result == G_CONVERTER_ERROR) {
+            /* Nothing more can come out until more input arrives */
+            gboolean        partial = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT);
+            g_error_free(error);
+            return partial;
+        }
+
+        if (bytes_written > 0)
+            func(buf, bytes_written, user_data);
+        data += bytes_read;
+        len -= bytes_read;
+
+        if (result == G_CONVERTER_FINISHED)
+            decoder->finished = TRUE;
+        /* A full output buffer may mean there's more waiting inside zlib */
+    } while (!decoder->finished && (len > 0 || bytes_written == sizeof (buf)));
+
+    return TRUE;
+}
+
+gchar          *twitter_http_request_endpoint(const gchar * request)
+{
+    const gchar    *start = strchr(request, ' ');
+    gchar          *url;
+    gchar          *endpoint;
+
+    if (!start)
+        return g_strdup("");
+    start++;
+
+    /* The request line carries the absolute URL */
+    url = g_strndup(start, strcspn(start, " \r\n"));
+    endpoint = twitter_http_url_endpoint(url);
+    g_free(url);
+    return endpoint;
+}
+
+gchar          *twitter_http_url_endpoint(const gchar * url)
+{
+    const gchar    *start = url;
+    const gchar    *end = url + strcspn(url, "?#");
+    const gchar    *scheme;
+    GString        *endpoint;
+    gchar          *path;
+    gchar         **segments;
+    int             i;
+
+    scheme = g_strstr_len(start, end - start, "://");
+    if (scheme)
+        start = scheme + 3;
+
+    endpoint = g_string_new(NULL);
+    path = g_strndup(start, end - start);
+    segments = g_strsplit(path, "/", 0);
+    g_free(path);
+    for (i = 0; segments[i]; i++) {
+        const gchar    *segment = segments[i];
+        gsize           digits = strspn(segment, "0123456789");
+
+        if (i > 0)
+            g_string_append_c(endpoint, '/');
+        if (i > 0 && digits > 0 && (segment[digits] == '\0' || segment[digits] == '.')) {
+            g_string_append(endpoint, ":id");
+            g_string_append(endpoint, segment + digits);
+        } else {
+            g_string_append(endpoint, segment);
+        }
+    }
+    g_strfreev(segments);
+
+    return g_string_free(endpoint, FALSE);
+}
+
+TwitterHttpSegments *twitter_http_segments_new()
+{
+    TwitterHttpSegments *segments = g_new0(TwitterHttpSegments, 1);
+    segments->bytes = g_ptr_array_new_with_free_func((GDestroyNotify) g_bytes_unref);
+    return segments;
+}
+
+void twitter_http_segments_free(TwitterHttpSegments * segments)
+{
+    g_ptr_array_free(segments->bytes, TRUE);
+    g_free(segments);
+}
+
+void twitter_http_segments_add_take(TwitterHttpSegments * segments, gchar * data, gsize len)
+{
+    g_ptr_array_add(segments->bytes, g_bytes_new_take(data, len));
+    segments->length += len;
+}
+
+static void twitter_http_buffer_pool_put(gpointer data)
+{
+    TwitterHttpPooledBuffer *pooled = data;
+    TwitterHttpBufferPool *pool = pooled->pool;
+
+    if (pool->free_count < TWITTER_HTTP_BUFFER_POOL_SIZE && pooled->buffer->allocated_len <= TWITTER_HTTP_BUFFER_MAX_KEPT) {
+        g_string_truncate(pooled->buffer, 0);
+        pool->free_buffers = g_slist_prepend(pool->free_buffers, pooled->buffer);
+        pool->free_count++;
+    } else {
+        g_string_free(pooled->buffer, TRUE);
+    }
+    g_free(pooled);
+    twitter_http_buffer_pool_unref(pool);
+}
+
+void twitter_http_segments_add_pooled(TwitterHttpSegments * segments, TwitterHttpBufferPool * pool, GString * buffer)
+{
+    TwitterHttpPooledBuffer *pooled = g_new(TwitterHttpPooledBuffer, 1);
+
+    pooled->pool = pool;
+    pooled->buffer = buffer;
+    pool->ref++;
+    g_ptr_array_add(segments->bytes, g_bytes_new_with_free_func(buffer->str, buffer->len, twitter_http_buffer_pool_put, pooled));
+    segments->length += buffer->len;
+}
+
+guint twitter_http_segments_get_vectors(const TwitterHttpSegments * segments, gsize offset, GOutputVector * vectors, guint max)
+{
+    guint           count = 0;
+    guint           i;
+
+    for (i = 0; i < segments->bytes->len && count < max; i++) {
+        gsize           size;
+        const gchar    *data = g_bytes_get_data(g_ptr_array_index(segments->bytes, i), &size);
+
+        if (offset >= size) {
+            offset -= size;
+            continue;
+        }
+        vectors[count].buffer = data + offset;
+        vectors[count].size = size - offset;
+        offset = 0;
+        count++;
+    }
+    return count;
+}
+
+gchar          *twitter_http_segments_flatten(const TwitterHttpSegments * segments, gsize * len)
+{
+    gchar          *data = g_malloc(segments->length + 1);
+    gsize           pos = 0;
+    guint           i;
+
+    for (i = 0; i < segments->bytes->len; i++) {
+        gsize           size;
+        gconstpointer   segment = g_bytes_get_data(g_ptr_array_index(segments->bytes, i), &size);
+        memcpy(data + pos, segment, size);
+        pos += size;
+    }
+    data[pos] = '\0';
+    *len = pos;
+    return data;
+}
+
+gchar          *twitter_http_segments_endpoint(const TwitterHttpSegments * segments)
+{
+    gsize           size = 0;
+    const gchar    *head = segments->bytes->len ? g_bytes_get_data(g_ptr_array_index(segments->bytes, 0), &size) : NULL;
+    const gchar    *eol = head ? memchr(head, '\n', size) : NULL;
+    gchar          *request_line = head ? g_strndup(head, eol ? eol - head : size) : g_strdup("");
+    gchar          *endpoint = twitter_http_request_endpoint(request_line);
+
+    g_free(request_line);
+    return endpoint;
+}
+
+gboolean twitter_http_segments_is_idempotent(const TwitterHttpSegments * segments)
+{
+    gsize           size = 0;
+    const gchar    *head = segments->bytes->len ? g_bytes_get_data(g_ptr_array_index(segments->bytes, 0), &size) : NULL;
+
+    return head && ((size >= 4 && !strncmp(head, "GET ", 4)) || (size >= 5 && !strncmp(head, "HEAD ", 5)));
+}
+
+TwitterHttpBufferPool *twitter_http_buffer_pool_new()
+{
+    TwitterHttpBufferPool *pool = g_new0(TwitterHttpBufferPool, 1);
+    pool->ref = 1;
+    return pool;
+}
+
+void twitter_http_buffer_pool_unref(TwitterHttpBufferPool * pool)
+{
+    GSList         *l;
+
+    if (--pool->ref > 0)
+        return;
+    for (l = pool->free_buffers; l; l = l->next)
+        g_string_free(l->data, TRUE);
+    g_slist_free(pool->free_buffers);
+    g_free(pool);
+}
+
+GString        *twitter_http_buffer_pool_get(TwitterHttpBufferPool * pool)
+{
+    GString        *buffer;
+
+    if (!pool->free_buffers) {
+        pool->allocated++;
+        return g_string_sized_new(512);
+    }
+
+    pool->reused++;
+    buffer = pool->free_buffers->data;
+    pool->free_buffers = g_slist_delete_link(pool->free_buffers, pool->free_buffers);
+    pool->free_count--;
+    return buffer;
+}
+
+void twitter_http_buffer_pool_get_stats(TwitterHttpBufferPool * pool, guint * allocated, guint * reused)
+{
+    *allocated = pool->allocated;
+    *reused = pool->reused;
+}
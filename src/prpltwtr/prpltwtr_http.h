@@ -0,0 +1,204 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_HTTP_H_
+#define _TWITTER_HTTP_H_
+
+#include <time.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+/// The parts of a response's status line and headers that anyone here
+/// looks at, read in a single pass over the header block. Header names are
+/// matched ignoring case, as HTTP/2 sends them all lowercase.
+typedef struct {
+    gint            status_code;
+    gint            rate_limit_remaining;        /* -1 if not sent */
+    gint            rate_limit_limit;            /* -1 if not sent */
+    time_t          rate_limit_reset;            /* when the window resets, 0 if not sent */
+    gint64          content_length;              /* -1 if not sent */
+    gchar          *content_encoding;
+    gchar          *etag;
+    gchar          *last_modified;
+    gchar          *location;
+    time_t          date;                        /* 0 if not sent or unparseable */
+    time_t          retry_after;                 /* when to try again, 0 if not sent */
+
+    /* framing */
+    gboolean        keep_alive;                  /* per the version and Connection header */
+    gboolean        chunked;
+
+    /* length of the status line and headers, blank line included */
+    gsize           length;
+} TwitterHttpHeaders;
+
+/// Parses the status line and headers at the start of text, stopping at the
+/// blank line; the body isn't looked at. Returns FALSE if text doesn't start
+/// with a complete header block. Free with twitter_http_headers_clear either way.
+gboolean        twitter_http_headers_parse(TwitterHttpHeaders * headers, const gchar * text, gsize len);
+void            twitter_http_headers_clear(TwitterHttpHeaders * headers);
+
+typedef enum {
+    TWITTER_HTTP_READ_HEADERS,
+    TWITTER_HTTP_READ_BODY,
+    TWITTER_HTTP_READ_BODY_EOF,
+    TWITTER_HTTP_READ_CHUNK_SIZE,
+    TWITTER_HTTP_READ_CHUNK_DATA,
+    TWITTER_HTTP_READ_CHUNK_CRLF,
+    TWITTER_HTTP_READ_TRAILER,
+    TWITTER_HTTP_READ_DONE
+} TwitterHttpReadState;
+
+typedef struct _TwitterHttpReader TwitterHttpReader;
+typedef struct _TwitterHttpDecoder TwitterHttpDecoder;
+
+/// Receives decompressed data.
+typedef void    (*TwitterHttpDecoderFunc) (const gchar * data, gsize len, gpointer user_data);
+
+/// Called once the header block has been read, before any body byte is
+/// handled. This is the place to install a body_func.
+typedef void    (*TwitterHttpReaderHeadersFunc) (TwitterHttpReader * reader, gpointer user_data);
+
+/// Receives the decoded (de-chunked and decompressed) body as it arrives.
+typedef void    (*TwitterHttpReaderBodyFunc) (TwitterHttpReader * reader, const gchar * data, gsize len, gpointer user_data);
+
+/// Incremental HTTP/1.x response reader. Feed it raw bytes from the socket;
+/// it handles Content-Length, chunked and read-until-close framing, and
+/// inflates gzip or deflate bodies as they arrive.
+struct _TwitterHttpReader {
+    TwitterHttpReadState state;
+
+    /* status line and headers, followed by the decoded body unless a
+     * body_func is set */
+    GString        *response;
+    TwitterHttpHeaders headers;
+    gint            status_code;
+    gboolean        keep_alive;
+    /* the body was compressed and could not be inflated */
+    gboolean        decode_failed;
+
+    TwitterHttpReaderHeadersFunc headers_func;
+    TwitterHttpReaderBodyFunc body_func;
+    gpointer        user_data;
+
+    /* private */
+    GString        *rbuf;
+    gsize           body_remaining;
+    TwitterHttpDecoder *decoder;
+    gsize           wire_bytes;
+    gsize           body_bytes;
+};
+
+void            twitter_http_reader_init(TwitterHttpReader * reader);
+void            twitter_http_reader_clear(TwitterHttpReader * reader);
+
+/// Gets the reader ready for the next response on the same connection.
+void            twitter_http_reader_reset(TwitterHttpReader * reader);
+
+/// Returns TRUE once a complete response has been read.
+gboolean        twitter_http_reader_feed(TwitterHttpReader * reader, const gchar * data, gsize len);
+
+/// To be called when the connection is closed. Returns TRUE if that
+/// completes the response (a body delimited by the end of the connection).
+gboolean        twitter_http_reader_eof(TwitterHttpReader * reader);
+
+/// Whether any byte of a response has been seen since the last reset.
+gboolean        twitter_http_reader_started(TwitterHttpReader * reader);
+
+/// Whether bytes beyond the end of the response were received.
+gboolean        twitter_http_reader_has_trailing_data(TwitterHttpReader * reader);
+
+/// Takes the response text out of the reader. Free with g_string_free.
+GString        *twitter_http_reader_steal_response(TwitterHttpReader * reader);
+
+/// Returns the body bytes read, as received and once decoded, since the
+/// last call, and zeroes the counts.
+void            twitter_http_reader_take_counts(TwitterHttpReader * reader, gsize * wire_bytes, gsize * body_bytes);
+
+/// Returns a decoder for a Content-Encoding value, or NULL if the encoding
+/// is not one we can inflate (or is "identity").
+TwitterHttpDecoder *twitter_http_decoder_new(const gchar * content_encoding);
+void            twitter_http_decoder_free(TwitterHttpDecoder * decoder);
+
+/// Inflates the next piece of a compressed body, passing the output to func.
+/// Returns FALSE if the data is corrupt.
+gboolean        twitter_http_decoder_feed(TwitterHttpDecoder * decoder, const gchar * data, gsize len, TwitterHttpDecoderFunc func, gpointer user_data);
+
+/* Free buffers kept by a pool, and the largest size a buffer is kept at */
+#define TWITTER_HTTP_BUFFER_POOL_SIZE 8
+#define TWITTER_HTTP_BUFFER_MAX_KEPT 65536
+
+typedef struct _TwitterHttpBufferPool TwitterHttpBufferPool;
+
+/// A request as a list of buffers that are written out in order, without
+/// joining them into one first. The first segment holds the request line.
+typedef struct {
+    GPtrArray      *bytes;                       /* of GBytes */
+    gsize           length;
+} TwitterHttpSegments;
+
+TwitterHttpSegments *twitter_http_segments_new(void);
+void            twitter_http_segments_free(TwitterHttpSegments * segments);
+
+/// Appends len bytes of data, taking ownership of it (no copy is made).
+void            twitter_http_segments_add_take(TwitterHttpSegments * segments, gchar * data, gsize len);
+
+/// Appends a buffer from twitter_http_buffer_pool_get. It goes back to the
+/// pool once the request has been written and freed.
+void            twitter_http_segments_add_pooled(TwitterHttpSegments * segments, TwitterHttpBufferPool * pool, GString * buffer);
+
+/// Fills up to max vectors with the data left after the first offset bytes.
+/// Returns the number of vectors filled, 0 once everything was written.
+guint           twitter_http_segments_get_vectors(const TwitterHttpSegments * segments, gsize offset, GOutputVector * vectors, guint max);
+
+/// Copies the segments into one buffer, for code that needs the request in
+/// one piece. Free with g_free.
+gchar          *twitter_http_segments_flatten(const TwitterHttpSegments * segments, gsize * len);
+
+/// twitter_http_request_endpoint for a segmented request.
+gchar          *twitter_http_segments_endpoint(const TwitterHttpSegments * segments);
+
+/// Whether the request is a GET or a HEAD, which can safely be sent twice.
+gboolean        twitter_http_segments_is_idempotent(const TwitterHttpSegments * segments);
+
+/// Recycles request buffers so building a request doesn't allocate. The
+/// pool lives until its last buffer is back and it has been unreffed.
+TwitterHttpBufferPool *twitter_http_buffer_pool_new(void);
+void            twitter_http_buffer_pool_unref(TwitterHttpBufferPool * pool);
+
+/// Returns an empty buffer, reusing a free one if there is one.
+GString        *twitter_http_buffer_pool_get(TwitterHttpBufferPool * pool);
+
+/// Counts buffers handed out by twitter_http_buffer_pool_get, newly
+/// allocated or reused.
+void            twitter_http_buffer_pool_get_stats(TwitterHttpBufferPool * pool, guint * allocated, guint * reused);
+
+/// Returns the endpoint a raw HTTP/1.1 request is for: host and path without
+/// the query string, with numeric path segments (ids) replaced by ":id".
+gchar          *twitter_http_request_endpoint(const gchar * request);
+
+/// Like twitter_http_request_endpoint, for a URL (with or without a scheme)
+gchar          *twitter_http_url_endpoint(const gchar * url);
+
+#endif
@@ -0,0 +1,293 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <util.h>
+
+#include "prpltwtr_httpcache.h"
+
+#define TWITTER_HTTP_CACHE_MAGIC "prpltwtr-cache 1"
+
+/* One response on disk. Its file holds the magic line, the key, the ETag
+ * and the Last-Modified date on a line each, then the body */
+typedef struct {
+    gchar          *name;                        /* file name, a hash of the key */
+    gsize           size;
+    time_t          last_used;
+    gchar          *validator;                   /* ETag and Last-Modified, once known */
+} TwitterHttpCacheFile;
+
+struct _TwitterHttpCache {
+    gchar          *dir;
+    /* key: file name, value: TwitterHttpCacheFile */
+    GHashTable     *files;
+    gsize           bytes;
+    guint           stored;
+    guint           revalidated;
+};
+
+static void http_cache_file_free(TwitterHttpCacheFile * file)
+{
+    g_free(file->name);
+    g_free(file->validator);
+    g_free(file);
+}
+
+static gchar   *http_cache_file_name(const gchar * key)
+{
+    return g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+}
+
+static gchar   *http_cache_validator(const gchar * etag, const gchar * last_modified)
+{
+    return g_strdup_printf("%s\n%s", etag ? etag : "", last_modified ? last_modified : "");
+}
+
+static void http_cache_remove(TwitterHttpCache * cache, TwitterHttpCacheFile * file)
+{
+    gchar          *path = g_build_filename(cache->dir, file->name, NULL);
+
+    g_unlink(path);
+    g_free(path);
+    cache->bytes -= file->size;
+    g_hash_table_remove(cache->files, file->name);
+}
+
+/// Drops the least recently used files until the cache fits its limit
+static void http_cache_trim(TwitterHttpCache * cache)
+{
+    while (cache->bytes > TWITTER_HTTP_CACHE_MAX_BYTES) {
+        TwitterHttpCacheFile *oldest = NULL;
+        GHashTableIter  iter;
+        gpointer        value;
+
+        g_hash_table_iter_init(&iter, cache->files);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            TwitterHttpCacheFile *file = value;
+            if (!oldest || file->last_used < oldest->last_used)
+                oldest = file;
+        }
+        if (!oldest)
+            break;
+        http_cache_remove(cache, oldest);
+    }
+}
+
+TwitterHttpCache *prpltwtr_http_cache_new(PurpleAccount * account)
+{
+    TwitterHttpCache *cache = g_new0(TwitterHttpCache, 1);
+    gchar          *account_name = g_strdup_printf("%s_%s", purple_account_get_protocol_id(account), purple_normalize(account, purple_account_get_username(account)));
+    GDir           *dir;
+    const gchar    *name;
+
+    cache->dir = g_build_filename(purple_user_dir(), "prpltwtr", "cache", purple_escape_filename(account_name), NULL);
+    cache->files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) http_cache_file_free);
+    g_free(account_name);
+
+    if (g_mkdir_with_parents(cache->dir, 0700) != 0)
+        purple_debug_error(GENERIC_PROTOCOL_ID, "Unable to create cache directory %s\n", cache->dir);
+
+    if ((dir = g_dir_open(cache->dir, 0, NULL))) {
+        while ((name = g_dir_read_name(dir))) {
+            gchar          *path = g_build_filename(cache->dir, name, NULL);
+            GStatBuf        st;
+
+            if (g_stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+                TwitterHttpCacheFile *file = g_new0(TwitterHttpCacheFile, 1);
+                file->name = g_strdup(name);
+                file->size = st.st_size;
+                file->last_used = st.st_mtime;
+                g_hash_table_insert(cache->files, file->name, file);
+                cache->bytes += file->size;
+            }
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Response cache %s: %u entries, %" G_GSIZE_FORMAT " bytes\n", cache->dir, g_hash_table_size(cache->files), cache->bytes);
+
+    /* The limit may have been lowered since */
+    http_cache_trim(cache);
+    return cache;
+}
+
+void prpltwtr_http_cache_free(TwitterHttpCache * cache)
+{
+    g_hash_table_destroy(cache->files);
+    g_free(cache->dir);
+    g_free(cache);
+}
+
+TwitterHttpCacheEntry *prpltwtr_http_cache_lookup(TwitterHttpCache * cache, const gchar * key)
+{
+    gchar          *name = http_cache_file_name(key);
+    TwitterHttpCacheFile *file = g_hash_table_lookup(cache->files, name);
+    TwitterHttpCacheEntry *entry = NULL;
+    gchar          *path;
+    gchar          *contents = NULL;
+    gsize           len;
+    gchar         **lines;
+
+    g_free(name);
+    if (!file)
+        return NULL;
+
+    path = g_build_filename(cache->dir, file->name, NULL);
+    if (!g_file_get_contents(path, &contents, &len, NULL)) {
+        g_free(path);
+        return NULL;
+    }
+    g_free(path);
+
+    /* magic, key, ETag, Last-Modified, body */
+    lines = g_strsplit(contents, "\n", 5);
+    if (g_strv_length(lines) == 5 && !strcmp(lines[0], TWITTER_HTTP_CACHE_MAGIC) && !strcmp(lines[1], key)) {
+        entry = g_new0(TwitterHttpCacheEntry, 1);
+        entry->etag = *lines[2] ? g_strdup(lines[2]) : NULL;
+        entry->last_modified = *lines[3] ? g_strdup(lines[3]) : NULL;
+        entry->len = strlen(lines[4]);
+        entry->body = g_strdup(lines[4]);
+
+        g_free(file->validator);
+        file->validator = http_cache_validator(entry->etag, entry->last_modified);
+    } else {
+        /* Damaged, or a hash collision */
+        http_cache_remove(cache, file);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return entry;
+}
+
+void prpltwtr_http_cache_entry_free(TwitterHttpCacheEntry * entry)
+{
+    if (!entry)
+        return;
+    g_free(entry->etag);
+    g_free(entry->last_modified);
+    g_free(entry->body);
+    g_free(entry);
+}
+
+gchar         **prpltwtr_http_cache_entry_headers(const TwitterHttpCacheEntry * entry)
+{
+    gchar         **headers = g_new0(gchar *, 3);
+    int             i = 0;
+
+    if (entry->etag)
+        headers[i++] = g_strdup_printf("If-None-Match: %s", entry->etag);
+    if (entry->last_modified)
+        headers[i++] = g_strdup_printf("If-Modified-Since: %s", entry->last_modified);
+    return headers;
+}
+
+void prpltwtr_http_cache_store(TwitterHttpCache * cache, const gchar * key, const TwitterHttpHeaders * headers, const gchar * body, gsize len)
+{
+    gchar          *name;
+    gchar          *validator;
+    TwitterHttpCacheFile *file;
+    GString        *contents;
+    gchar          *path;
+    GError         *error = NULL;
+
+    if (!headers->etag && !headers->last_modified)
+        return;
+    if (len > TWITTER_HTTP_CACHE_MAX_ENTRY || memchr(body, '\0', len))
+        return;
+
+    name = http_cache_file_name(key);
+    validator = http_cache_validator(headers->etag, headers->last_modified);
+    file = g_hash_table_lookup(cache->files, name);
+    if (file && !g_strcmp0(file->validator, validator)) {
+        /* Already have this version, several callers shared the response */
+        file->last_used = time(NULL);
+        g_free(validator);
+        g_free(name);
+        return;
+    }
+
+    contents = g_string_sized_new(len + 256);
+    g_string_append_printf(contents, "%s\n%s\n%s\n%s\n", TWITTER_HTTP_CACHE_MAGIC, key, headers->etag ? headers->etag : "", headers->last_modified ? headers->last_modified : "");
+    g_string_append_len(contents, body, len);
+
+    path = g_build_filename(cache->dir, name, NULL);
+    if (!g_file_set_contents(path, contents->str, contents->len, &error)) {
+        purple_debug_error(GENERIC_PROTOCOL_ID, "Unable to write %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_free(validator);
+        g_free(name);
+    } else {
+        if (file) {
+            cache->bytes -= file->size;
+            g_free(name);
+        } else {
+            file = g_new0(TwitterHttpCacheFile, 1);
+            file->name = name;
+            g_hash_table_insert(cache->files, file->name, file);
+        }
+        g_free(file->validator);
+        file->validator = validator;
+        file->size = contents->len;
+        file->last_used = time(NULL);
+        cache->bytes += file->size;
+        cache->stored++;
+        http_cache_trim(cache);
+    }
+    g_free(path);
+    g_string_free(contents, TRUE);
+}
+
+void prpltwtr_http_cache_revalidated(TwitterHttpCache * cache, const gchar * key)
+{
+    gchar          *name = http_cache_file_name(key);
+    TwitterHttpCacheFile *file = g_hash_table_lookup(cache->files, name);
+    gchar          *path;
+
+    g_free(name);
+    cache->revalidated++;
+    if (!file)
+        return;
+
+    /* The file's time is what orders the entries at the next login */
+    file->last_used = time(NULL);
+    path = g_build_filename(cache->dir, file->name, NULL);
+    g_utime(path, NULL);
+    g_free(path);
+}
+
+void prpltwtr_http_cache_get_stats(TwitterHttpCache * cache, TwitterHttpCacheStats * stats)
+{
+    stats->entries = g_hash_table_size(cache->files);
+    stats->bytes = cache->bytes;
+    stats->stored = cache->stored;
+    stats->revalidated = cache->revalidated;
+}
@@ -0,0 +1,79 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_HTTPCACHE_H_
+#define _TWITTER_HTTPCACHE_H_
+
+#include <glib.h>
+#include <account.h>
+
+#include "prpltwtr_http.h"
+
+/* On-disk size of an account's cache. The least recently used entries
+ * are dropped past it */
+#define TWITTER_HTTP_CACHE_MAX_BYTES (1024 * 1024)
+/* Larger responses aren't cached */
+#define TWITTER_HTTP_CACHE_MAX_ENTRY (256 * 1024)
+
+typedef struct _TwitterHttpCache TwitterHttpCache;
+
+/// A cached response body and the validators to revalidate it with
+typedef struct {
+    gchar          *etag;                        /* NULL if the server sent none */
+    gchar          *last_modified;               /* NULL if the server sent none */
+    gchar          *body;                        /* NUL-terminated */
+    gsize           len;
+} TwitterHttpCacheEntry;
+
+typedef struct {
+    guint           entries;
+    gsize           bytes;                       /* on disk */
+    guint           stored;                      /* responses written since login */
+    guint           revalidated;                 /* 304s answered from the cache */
+} TwitterHttpCacheStats;
+
+/// Opens the account's cache, a directory of one file per response under
+/// the purple user dir. Only the file sizes are read up front.
+TwitterHttpCache *prpltwtr_http_cache_new(PurpleAccount * account);
+void            prpltwtr_http_cache_free(TwitterHttpCache * cache);
+
+/// Returns the entry for key (a url and its normalized params) read from
+/// disk, or NULL if there's none.
+TwitterHttpCacheEntry *prpltwtr_http_cache_lookup(TwitterHttpCache * cache, const gchar * key);
+void            prpltwtr_http_cache_entry_free(TwitterHttpCacheEntry * entry);
+
+/// Returns the If-None-Match and If-Modified-Since header lines that
+/// revalidate the entry, as a NULL-terminated array to free with g_strfreev.
+gchar         **prpltwtr_http_cache_entry_headers(const TwitterHttpCacheEntry * entry);
+
+/// Stores a 200 response's body, if headers carry a validator and the body
+/// isn't too large. Nothing is written if the same version is cached.
+void            prpltwtr_http_cache_store(TwitterHttpCache * cache, const gchar * key, const TwitterHttpHeaders * headers, const gchar * body, gsize len);
+
+/// Records that the server answered 304 for key, so its entry was used
+void            prpltwtr_http_cache_revalidated(TwitterHttpCache * cache, const gchar * key);
+
+void            prpltwtr_http_cache_get_stats(TwitterHttpCache * cache, TwitterHttpCacheStats * stats);
+
+#endif
@@ -0,0 +1,585 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+#include <notify.h>
+#include <util.h>
+
+#include "prpltwtr_outbox.h"
+
+#define TWITTER_OUTBOX_MAGIC "prpltwtr-outbox 2"
+/* Journals from before commit records, whose messages are all whole */
+#define TWITTER_OUTBOX_MAGIC_V1 "prpltwtr-outbox 1"
+
+/* The journal is a line per record, appended as things happen:
+ *   M <id> <kind> <target>   a message was queued: kind 's' for a status,
+ *                            'd' for a DM; target is the status replied to
+ *                            or the DM's recipient, "-" if none
+ *   P <id> <text>            its next part, escaped with g_strescape
+ *   C <id>                   all of its parts are in
+ *   S <id> <part> [<status>] the part (from 0) was sent, and for a status
+ *                            posted as <status>, which the next part
+ *                            replies to
+ *   D <id>                   it's done with, sent or given up on
+ * A message's M, P and C records are written at once. A line cut short by
+ * a crash has no newline, and is ignored, as is a message without its C
+ * record, so a message is never sent in part. The journal
+ * is rewritten with only what's left when it's opened, and emptied when
+ * the outbox is. */
+
+typedef enum {
+    TWITTER_OUTBOX_PART_PENDING,
+    TWITTER_OUTBOX_PART_SENDING,
+    TWITTER_OUTBOX_PART_SENT
+} TwitterOutboxPartState;
+
+typedef struct _TwitterOutboxMessage TwitterOutboxMessage;
+
+typedef struct {
+    TwitterOutboxMessage *message;
+    guint           index;
+    gchar          *text;
+    TwitterOutboxPartState state;
+} TwitterOutboxPart;
+
+struct _TwitterOutboxMessage {
+    TwitterOutbox  *outbox;
+    guint           id;
+    gchar           kind;                        /* 's' for a status, 'd' for a DM */
+    gchar          *target;                      /* the status the next part replies to, or the DM's recipient; NULL if none */
+    GPtrArray      *parts;                       /* TwitterOutboxPart */
+    guint           in_flight;                   /* parts being sent */
+    guint           failures;                    /* consecutive failed sends */
+    guint           retry_timer;                 /* holding back its parts after a failure */
+    gboolean        abandoned;                   /* given up on, waiting for the parts in flight */
+    /* NULL for a message from an earlier session */
+    TwitterApiMultiStatusSuccessFunc success_func;
+    TwitterApiMultiStatusErrorFunc error_func;
+    gpointer        user_data;
+};
+
+struct _TwitterOutbox {
+    PurpleAccount  *account;
+    gchar          *path;
+    FILE           *journal;                     /* opened for appending on first use */
+    GQueue         *messages;                    /* TwitterOutboxMessage, oldest first */
+    guint           last_id;
+    guint           in_flight;
+    TwitterRequestScope *requests;
+};
+
+static void     outbox_drain(TwitterOutbox * outbox);
+
+static void outbox_part_free(TwitterOutboxPart * part)
+{
+    g_free(part->text);
+    g_free(part);
+}
+
+static TwitterOutboxMessage *outbox_message_new(TwitterOutbox * outbox, guint id, gchar kind, const gchar * target)
+{
+    TwitterOutboxMessage *message = g_new0(TwitterOutboxMessage, 1);
+
+    message->outbox = outbox;
+    message->id = id;
+    message->kind = kind;
+    message->target = g_strdup(target);
+    message->parts = g_ptr_array_new_with_free_func((GDestroyNotify) outbox_part_free);
+    return message;
+}
+
+/// Adds a part, taking ownership of text
+static void outbox_message_add_part(TwitterOutboxMessage * message, gchar * text)
+{
+    TwitterOutboxPart *part = g_new0(TwitterOutboxPart, 1);
+
+    part->message = message;
+    part->index = message->parts->len;
+    part->text = text;
+    g_ptr_array_add(message->parts, part);
+}
+
+static void outbox_message_free(TwitterOutboxMessage * message)
+{
+    if (message->retry_timer)
+        purple_timeout_remove(message->retry_timer);
+    g_free(message->target);
+    g_ptr_array_free(message->parts, TRUE);
+    g_free(message);
+}
+
+/// Returns the first part that's still to be sent, NULL if there's none
+static TwitterOutboxPart *outbox_message_next_part(TwitterOutboxMessage * message)
+{
+    guint           i;
+
+    for (i = 0; i < message->parts->len; i++) {
+        TwitterOutboxPart *part = g_ptr_array_index(message->parts, i);
+        if (part->state == TWITTER_OUTBOX_PART_PENDING)
+            return part;
+    }
+    return NULL;
+}
+
+static gboolean outbox_message_is_sent(TwitterOutboxMessage * message)
+{
+    return !message->in_flight && !outbox_message_next_part(message);
+}
+
+static void outbox_journal_append(TwitterOutbox * outbox, const gchar * format, ...) G_GNUC_PRINTF(2, 3);
+
+/// Appends a record and flushes it to disk, so it's there should we crash
+static void outbox_journal_append(TwitterOutbox * outbox, const gchar * format, ...)
+{
+    va_list         args;
+    gchar          *record;
+
+    if (!outbox->journal && !(outbox->journal = g_fopen(outbox->path, "ab"))) {
+        purple_debug_error(purple_account_get_protocol_id(outbox->account), "Unable to open %s\n", outbox->path);
+        return;
+    }
+
+    va_start(args, format);
+    record = g_strdup_vprintf(format, args);
+    va_end(args);
+
+    if (fputs(record, outbox->journal) < 0 || fputc('\n', outbox->journal) == EOF || fflush(outbox->journal) != 0)
+        purple_debug_error(purple_account_get_protocol_id(outbox->account), "Unable to write to %s\n", outbox->path);
+#ifndef _WIN32
+    else
+        fsync(fileno(outbox->journal));
+#endif
+    g_free(record);
+}
+
+/// Replaces the journal with one holding only the parts still to be sent
+static void outbox_journal_rewrite(TwitterOutbox * outbox)
+{
+    GString        *contents = g_string_new(TWITTER_OUTBOX_MAGIC "\n");
+    GError         *error = NULL;
+    GList          *l;
+    guint           i;
+
+    for (l = outbox->messages->head; l; l = l->next) {
+        TwitterOutboxMessage *message = l->data;
+        gchar          *target = message->target ? g_strescape(message->target, NULL) : g_strdup("-");
+
+        g_string_append_printf(contents, "M %u %c %s\n", message->id, message->kind, target);
+        for (i = 0; i < message->parts->len; i++) {
+            TwitterOutboxPart *part = g_ptr_array_index(message->parts, i);
+            gchar          *text;
+
+            if (part->state == TWITTER_OUTBOX_PART_SENT)
+                continue;
+            text = g_strescape(part->text, NULL);
+            g_string_append_printf(contents, "P %u %s\n", message->id, text);
+            g_free(text);
+        }
+        g_string_append_printf(contents, "C %u\n", message->id);
+        g_free(target);
+    }
+
+    if (outbox->journal) {
+        fclose(outbox->journal);
+        outbox->journal = NULL;
+    }
+    if (!g_file_set_contents(outbox->path, contents->str, contents->len, &error)) {
+        purple_debug_error(purple_account_get_protocol_id(outbox->account), "Unable to write %s: %s\n", outbox->path, error->message);
+        g_error_free(error);
+    }
+    g_string_free(contents, TRUE);
+}
+
+static TwitterOutboxMessage *outbox_journal_find(GList * messages, guint id)
+{
+    for (; messages; messages = messages->next)
+        if (((TwitterOutboxMessage *) messages->data)->id == id)
+            return messages->data;
+    return NULL;
+}
+
+/// Reads back the messages an earlier session left unsent, keeping only
+/// their unsent parts
+static void outbox_journal_load(TwitterOutbox * outbox)
+{
+    gchar          *contents;
+    gchar         **lines;
+    GList          *messages = NULL;
+    GList          *l;
+    GHashTable     *committed;
+    gboolean        v1;
+    guint           i;
+
+    if (!g_file_get_contents(outbox->path, &contents, NULL, NULL))
+        return;
+    lines = g_strsplit(contents, "\n", 0);
+    g_free(contents);
+
+    if (!lines[0] || (strcmp(lines[0], TWITTER_OUTBOX_MAGIC) && strcmp(lines[0], TWITTER_OUTBOX_MAGIC_V1))) {
+        purple_debug_warning(purple_account_get_protocol_id(outbox->account), "Ignoring %s, not an outbox journal\n", outbox->path);
+        g_strfreev(lines);
+        return;
+    }
+    v1 = !strcmp(lines[0], TWITTER_OUTBOX_MAGIC_V1);
+    /* ids of the messages whose C record was read */
+    committed = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    /* The last piece has no newline: it's empty or was cut short */
+    for (i = 1; lines[i] && lines[i + 1]; i++) {
+        gchar         **fields = g_strsplit(lines[i], " ", 4);
+        guint           id = fields[0] && fields[1] ? strtoul(fields[1], NULL, 10) : 0;
+        TwitterOutboxMessage *message = id ? outbox_journal_find(messages, id) : NULL;
+
+        if (!id) {
+            /* nothing to do with it */
+        } else if (!strcmp(fields[0], "M") && !message && fields[2] && fields[3] && (fields[2][0] == 's' || fields[2][0] == 'd')) {
+            gchar          *target = strcmp(fields[3], "-") ? g_strcompress(fields[3]) : NULL;
+
+            messages = g_list_append(messages, outbox_message_new(outbox, id, fields[2][0], target));
+            outbox->last_id = MAX(outbox->last_id, id);
+            g_free(target);
+        } else if (!strcmp(fields[0], "C") && message) {
+            g_hash_table_insert(committed, GUINT_TO_POINTER(id), GUINT_TO_POINTER(TRUE));
+        } else if (!strcmp(fields[0], "P") && message && fields[2] && !g_hash_table_lookup(committed, GUINT_TO_POINTER(id))) {
+            /* Splitting on the first spaces only leaves the text whole */
+            outbox_message_add_part(message, g_strcompress(lines[i] + strlen(fields[0]) + strlen(fields[1]) + 2));
+        } else if (!strcmp(fields[0], "S") && message && fields[2]) {
+            guint           index = strtoul(fields[2], NULL, 10);
+
+            if (index < message->parts->len)
+                ((TwitterOutboxPart *) g_ptr_array_index(message->parts, index))->state = TWITTER_OUTBOX_PART_SENT;
+            if (message->kind == 's' && fields[3]) {
+                g_free(message->target);
+                message->target = g_strdup(fields[3]);
+            }
+        } else if (!strcmp(fields[0], "D") && message) {
+            messages = g_list_remove(messages, message);
+            outbox_message_free(message);
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+
+    for (l = messages; l; l = l->next) {
+        TwitterOutboxMessage *message = l->data;
+        TwitterOutboxMessage *unsent;
+
+        if (!v1 && !g_hash_table_lookup(committed, GUINT_TO_POINTER(message->id))) {
+            purple_debug_warning(purple_account_get_protocol_id(outbox->account), "Dropping message %u, it wasn't journaled whole\n", message->id);
+            outbox_message_free(message);
+            continue;
+        }
+        if (outbox_message_is_sent(message)) {
+            outbox_message_free(message);
+            continue;
+        }
+        /* Renumbered, as the rewritten journal only has these parts */
+        unsent = outbox_message_new(outbox, message->id, message->kind, message->target);
+        for (i = 0; i < message->parts->len; i++) {
+            TwitterOutboxPart *part = g_ptr_array_index(message->parts, i);
+
+            if (part->state != TWITTER_OUTBOX_PART_SENT) {
+                outbox_message_add_part(unsent, part->text);
+                part->text = NULL;
+            }
+        }
+        outbox_message_free(message);
+        g_queue_push_tail(outbox->messages, unsent);
+    }
+    g_list_free(messages);
+    g_hash_table_destroy(committed);
+
+    if (!g_queue_is_empty(outbox->messages))
+        purple_debug_info(purple_account_get_protocol_id(outbox->account), "Sending %u messages left in the outbox\n", g_queue_get_length(outbox->messages));
+}
+
+TwitterOutbox  *prpltwtr_outbox_new(PurpleAccount * account)
+{
+    TwitterOutbox  *outbox = g_new0(TwitterOutbox, 1);
+    gchar          *account_name = g_strdup_printf("%s_%s", purple_account_get_protocol_id(account), purple_normalize(account, purple_account_get_username(account)));
+    gchar          *dir = g_build_filename(purple_user_dir(), "prpltwtr", "outbox", NULL);
+
+    outbox->account = account;
+    outbox->messages = g_queue_new();
+    outbox->requests = twitter_request_scope_new(purple_account_get_requestor(account));
+    outbox->path = g_build_filename(dir, purple_escape_filename(account_name), NULL);
+    if (g_mkdir_with_parents(dir, 0700) != 0)
+        purple_debug_error(purple_account_get_protocol_id(account), "Unable to create outbox directory %s\n", dir);
+    g_free(account_name);
+    g_free(dir);
+
+    outbox_journal_load(outbox);
+    outbox_journal_rewrite(outbox);
+    outbox_drain(outbox);
+    return outbox;
+}
+
+void prpltwtr_outbox_free(TwitterOutbox * outbox)
+{
+    TwitterOutboxMessage *message;
+    TwitterRequestErrorData error_data;
+
+    /* The parts in flight come back cancelled, and stay queued */
+    twitter_request_scope_free(outbox->requests);
+    outbox->requests = NULL;
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+    error_data.message = _("Not sent yet, it will be when the account reconnects");
+    while ((message = g_queue_pop_head(outbox->messages))) {
+        if (message->error_func && !message->abandoned)
+            message->error_func(outbox->account, &error_data, message->user_data);
+        outbox_message_free(message);
+    }
+    g_queue_free(outbox->messages);
+
+    if (outbox->journal)
+        fclose(outbox->journal);
+    g_free(outbox->path);
+    g_free(outbox);
+}
+
+guint prpltwtr_outbox_get_length(TwitterOutbox * outbox)
+{
+    return g_queue_get_length(outbox->messages);
+}
+
+/// Takes a message out of the queue for good
+static void outbox_message_done(TwitterOutboxMessage * message)
+{
+    TwitterOutbox  *outbox = message->outbox;
+    guint           id = message->id;
+
+    g_queue_remove(outbox->messages, message);
+    outbox_message_free(message);
+    if (g_queue_is_empty(outbox->messages))
+        outbox_journal_rewrite(outbox);
+    else
+        outbox_journal_append(outbox, "D %u", id);
+}
+
+static void     outbox_send_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data);
+static void     outbox_send_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data);
+
+static void outbox_send(TwitterOutboxPart * part)
+{
+    TwitterOutboxMessage *message = part->message;
+    TwitterOutbox  *outbox = message->outbox;
+    TwitterRequestor *r = purple_account_get_requestor(outbox->account);
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, outbox->requests);
+
+    part->state = TWITTER_OUTBOX_PART_SENDING;
+    message->in_flight++;
+    outbox->in_flight++;
+    if (message->kind == 'd')
+        twitter_api_send_dm(r, message->target, part->text, outbox_send_success_cb, outbox_send_error_cb, part);
+    else
+        twitter_api_set_status(r, part->text, message->target, outbox_send_success_cb, outbox_send_error_cb, part);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
+/// Sends what can be sent now, up to TWITTER_OUTBOX_MAX_IN_FLIGHT parts:
+/// the next part of the oldest message of each destination, unless the one
+/// before it is still being sent.
+static void outbox_drain(TwitterOutbox * outbox)
+{
+    GHashTable     *busy;
+    GList          *l;
+
+    if (!outbox->requests || !purple_account_get_requestor(outbox->account))
+        return;
+
+    busy = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (l = outbox->messages->head; l && outbox->in_flight < TWITTER_OUTBOX_MAX_IN_FLIGHT; l = l->next) {
+        TwitterOutboxMessage *message = l->data;
+        gchar          *destination = message->kind == 'd' ? g_strdup_printf("d %s", message->target) : g_strdup("s");
+        TwitterOutboxPart *part;
+
+        if (g_hash_table_lookup(busy, destination)) {
+            g_free(destination);
+            continue;
+        }
+        g_hash_table_insert(busy, destination, GINT_TO_POINTER(TRUE));
+        if (message->retry_timer || message->abandoned || message->in_flight)
+            continue;
+        /* Each status part replies to the one before, so it waits for its id */
+        if ((part = outbox_message_next_part(message)))
+            outbox_send(part);
+    }
+    g_hash_table_destroy(busy);
+}
+
+static gboolean outbox_retry_timeout(gpointer user_data)
+{
+    TwitterOutboxMessage *message = user_data;
+
+    message->retry_timer = 0;
+    outbox_drain(message->outbox);
+    return FALSE;
+}
+
+/// Holds the message back for a while, and its destination with it
+static void outbox_retry_later(TwitterOutboxMessage * message, const TwitterRequestErrorData * error_data)
+{
+    guint           delay = MIN(TWITTER_OUTBOX_RETRY_DELAY << MIN(message->failures, 10), TWITTER_OUTBOX_MAX_RETRY_DELAY);
+    time_t          now = time(NULL);
+
+    message->failures++;
+    if (error_data->headers && error_data->headers->retry_after > now)
+        delay = MAX(delay, error_data->headers->retry_after - now);
+    else if (error_data->headers && error_data->headers->rate_limit_remaining == 0 && error_data->headers->rate_limit_reset > now)
+        delay = MAX(delay, error_data->headers->rate_limit_reset - now);
+
+    purple_debug_info(purple_account_get_protocol_id(message->outbox->account), "Sending message %u again in %u seconds\n", message->id, delay);
+    message->retry_timer = purple_timeout_add_seconds(delay, outbox_retry_timeout, message);
+}
+
+static void outbox_send_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
+{
+    TwitterOutboxPart *part = user_data;
+    TwitterOutboxMessage *message = part->message;
+    TwitterOutbox  *outbox = message->outbox;
+    gchar          *status_id = message->kind == 's' && node ? r->format->get_str(node, "id_str") : NULL;
+    gboolean        last;
+
+    part->state = TWITTER_OUTBOX_PART_SENT;
+    message->in_flight--;
+    message->failures = 0;
+    outbox->in_flight--;
+    if (status_id) {
+        /* The next part replies to this one */
+        g_free(message->target);
+        message->target = status_id;
+        outbox_journal_append(outbox, "S %u %u %s", message->id, part->index, status_id);
+    } else {
+        outbox_journal_append(outbox, "S %u %u", message->id, part->index);
+    }
+    last = outbox_message_is_sent(message);
+
+    if (message->abandoned) {
+        if (!message->in_flight)
+            outbox_message_done(message);
+    } else {
+        if (message->success_func)
+            message->success_func(r->account, node, last, message->user_data);
+        if (last)
+            outbox_message_done(message);
+    }
+    outbox_drain(outbox);
+}
+
+static void outbox_send_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterOutboxPart *part = user_data;
+    TwitterOutboxMessage *message = part->message;
+    TwitterOutbox  *outbox = message->outbox;
+    gint            status_code = error_data->headers ? error_data->headers->status_code : 0;
+
+    part->state = TWITTER_OUTBOX_PART_PENDING;
+    message->in_flight--;
+    outbox->in_flight--;
+    /* Disconnecting, it's left for the next session */
+    if (error_data->type == TWITTER_REQUEST_ERROR_CANCELED)
+        return;
+
+    if (message->abandoned) {
+        /* The caller has been told already */
+    } else if (error_data->type == TWITTER_REQUEST_ERROR_RATE_LIMITED || prpltwtr_retry_is_transient(status_code)) {
+        outbox_retry_later(message, error_data);
+    } else if (message->error_func) {
+        if (message->error_func(r->account, error_data, message->user_data))
+            outbox_retry_later(message, error_data);
+        else
+            message->abandoned = TRUE;
+    } else {
+        /* Nobody's waiting for it since it was queued in an earlier session */
+        gchar          *text = g_strdup_printf("%s\n\n%s", error_data->message ? error_data->message : _("unknown error"), part->text);
+
+        purple_notify_error(purple_account_get_connection(r->account), _("Message Not Sent"), _("A message queued before the account went offline couldn't be sent"), text);
+        g_free(text);
+        message->abandoned = TRUE;
+    }
+    if (message->abandoned && !message->in_flight)
+        outbox_message_done(message);
+    outbox_drain(outbox);
+}
+
+/// Queues a message, journaling it before any of it is sent
+static void outbox_add(TwitterOutbox * outbox, gchar kind, const gchar * target, GArray * statuses, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data)
+{
+    TwitterOutboxMessage *message = outbox_message_new(outbox, ++outbox->last_id, kind, target);
+    gchar          *escaped = target ? g_strescape(target, NULL) : g_strdup("-");
+    GString        *records = g_string_new(NULL);
+    guint           i;
+
+    message->success_func = success_func;
+    message->error_func = error_func;
+    message->user_data = data;
+
+    /* In one write, ending with the C record */
+    g_string_append_printf(records, "M %u %c %s\n", message->id, kind, escaped);
+    for (i = 0; i < statuses->len; i++) {
+        gchar          *text = g_array_index(statuses, gchar *, i);
+        gchar          *escaped_text = g_strescape(text, NULL);
+
+        g_string_append_printf(records, "P %u %s\n", message->id, escaped_text);
+        outbox_message_add_part(message, text);
+        g_free(escaped_text);
+    }
+    g_string_append_printf(records, "C %u", message->id);
+    outbox_journal_append(outbox, "%s", records->str);
+    g_string_free(records, TRUE);
+    g_array_free(statuses, TRUE);
+    g_free(escaped);
+
+    g_queue_push_tail(outbox->messages, message);
+    outbox_drain(outbox);
+}
+
+void prpltwtr_outbox_send_statuses(TwitterOutbox * outbox, GArray * statuses, const gchar * in_reply_to_status_id, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data)
+{
+    g_return_if_fail(statuses && statuses->len);
+    outbox_add(outbox, 's', in_reply_to_status_id && in_reply_to_status_id[0] ? in_reply_to_status_id : NULL, statuses, success_func, error_func, data);
+}
+
+void prpltwtr_outbox_send_dms(TwitterOutbox * outbox, const gchar * who, GArray * statuses, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data)
+{
+    g_return_if_fail(statuses && statuses->len && who && who[0]);
+    outbox_add(outbox, 'd', who, statuses, success_func, error_func, data);
+}
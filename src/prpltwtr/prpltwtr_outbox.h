@@ -0,0 +1,66 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_OUTBOX_H_
+#define _TWITTER_OUTBOX_H_
+
+#include "prpltwtr_api.h"
+#include "prpltwtr_conn.h"
+
+/* Parts being sent at once, across the outbox. A destination (the account's
+ * timeline, or a DM's recipient) has one message being sent at a time, and
+ * a message one part: a part is only sent once the server has accepted the
+ * one before it, so they're posted in the order they were queued */
+#define TWITTER_OUTBOX_MAX_IN_FLIGHT 4
+/* Wait before sending a part again after a failure that may go away,
+ * doubled each time it fails again (seconds) */
+#define TWITTER_OUTBOX_RETRY_DELAY 5
+#define TWITTER_OUTBOX_MAX_RETRY_DELAY 900
+
+/// Opens the account's outbox. Messages left in its journal by an earlier
+/// session, unsent as it disconnected or crashed, are sent again.
+TwitterOutbox  *prpltwtr_outbox_new(PurpleAccount * account);
+
+/// Cancels what's being sent, and frees the outbox. Unsent messages stay in
+/// the journal for the next session; their senders get a
+/// TWITTER_REQUEST_ERROR_CANCELED error.
+void            prpltwtr_outbox_free(TwitterOutbox * outbox);
+
+/// Queues the parts of a status update, replying to in_reply_to_status_id
+/// if set, and takes ownership of statuses. They're written to the journal
+/// before anything is sent. success_func is called after each part is sent,
+/// with last_page set once they all are. The first part replies to
+/// in_reply_to_status_id, and each of the others to the part before it, so
+/// they read as a thread. Failures that may go away (no response,
+/// rate limits, server errors) are retried with backoff; others go to
+/// error_func, and the rest of the message is dropped unless it returns TRUE.
+void            prpltwtr_outbox_send_statuses(TwitterOutbox * outbox, GArray * statuses, const gchar * in_reply_to_status_id, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data);
+
+/// Like prpltwtr_outbox_send_statuses, for the parts of a direct message
+void            prpltwtr_outbox_send_dms(TwitterOutbox * outbox, const gchar * who, GArray * statuses, TwitterApiMultiStatusSuccessFunc success_func, TwitterApiMultiStatusErrorFunc error_func, gpointer data);
+
+/// Messages waiting to be sent, or being sent
+guint           prpltwtr_outbox_get_length(TwitterOutbox * outbox);
+
+#endif
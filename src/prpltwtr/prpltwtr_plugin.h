@@ -19,6 +19,10 @@ typedef struct {
     const gchar    *add_favorite;
     const gchar    *delete_favorite;
     const gchar    *get_user_info;
+    const gchar    *lookup_users;                /* NULL if the server has none */
+    const gchar    *lookup_statuses;             /* NULL if the server has none */
+    const gchar    *user_stream;                 /* NULL if the server has none */
+    const gchar    *search_stream;               /* NULL if the server has none */
 } TwitterUrls;
 
 void            twitter_destroy(PurplePlugin * plugin);
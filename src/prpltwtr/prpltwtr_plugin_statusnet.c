@@ -196,7 +196,20 @@ void prpltwtr_statusnet_login(PurpleAccount * account)
     twitter->requestor->urls = g_new0(TwitterUrls, 1);
     twitter->requestor->account = account;
     twitter->requestor->post_failed = prpltwtr_requestor_post_failed;
-    twitter->requestor->do_send = twitter_requestor_send;
+#ifdef HAVE_NGHTTP2
+    if (!strcmp(twitter_option_http_backend(account), TWITTER_PREF_HTTP_BACKEND_H2)) {
+        twitter->requestor->do_send = twitter_requestor_send_h2;
+        twitter->requestor->do_send_streaming = twitter_requestor_send_h2_streaming;
+        twitter->requestor->do_preconnect = twitter_requestor_preconnect_h2;
+    } else
+#endif
+    if (!strcmp(twitter_option_http_backend(account), TWITTER_PREF_HTTP_BACKEND_GIO)) {
+        twitter->requestor->do_send = twitter_requestor_send_gio;
+        twitter->requestor->do_send_streaming = twitter_requestor_send_gio_streaming;
+    } else {
+        twitter->requestor->do_send = twitter_requestor_send;
+        twitter->requestor->do_preconnect = twitter_requestor_preconnect;
+    }
 
     if (!twitter_option_use_oauth(account)) {
         twitter->requestor->pre_send = prpltwtr_auth_pre_send_auth_basic;
@@ -206,9 +219,15 @@ void prpltwtr_statusnet_login(PurpleAccount * account)
         twitter->requestor->post_send = prpltwtr_auth_post_send_oauth;
     }
 
+    /* Record or replay the account's traffic */
+    twitter_requestor_setup_trace(twitter->requestor);
+
     // Set up the URLs and formats for this requestor.
     prpltwtr_plugin_setup(twitter->requestor);
 
+    /* Look up hosts and connect while the rest of the login is set up */
+    twitter_requestor_warmup(twitter->requestor);
+
     /* key: gchar *, value: TwitterEndpointChat */
     twitter->chat_contexts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) twitter_endpoint_chat_free);
 
@@ -101,6 +101,101 @@ static GList   *get_protocol_options(const char *protocol_id)
         options = g_list_append(options, option);
     }
 
+    /* Which HTTP implementation to send requests with */
+    {
+        static const gchar *backend_keys[] = {
+            N_("libpurple"),
+            N_("GIO"),
+#ifdef HAVE_NGHTTP2
+            N_("HTTP/2, one connection per account"),
+#endif
+            NULL
+        };
+        static const gchar *backend_values[] = {
+            TWITTER_PREF_HTTP_BACKEND_PURPLE,
+            TWITTER_PREF_HTTP_BACKEND_GIO,
+#ifdef HAVE_NGHTTP2
+            TWITTER_PREF_HTTP_BACKEND_H2,
+#endif
+            NULL
+        };
+        GList          *backend_options = NULL;
+        int             i;
+
+        for (i = 0; backend_keys[i]; i++) {
+            PurpleKeyValuePair *kvp = g_new0(PurpleKeyValuePair, 1);
+            kvp->key = g_strdup(_(backend_keys[i]));
+            kvp->value = g_strdup(backend_values[i]);
+            backend_options = g_list_append(backend_options, kvp);
+        }
+
+        option = purple_account_option_list_new(_("HTTP backend"), TWITTER_PREF_HTTP_BACKEND, backend_options);
+        options = g_list_append(options, option);
+    }
+
+    /* Give up on a request that makes no progress for this long */
+    option = purple_account_option_int_new(_("Request timeout (sec, GIO and HTTP/2 backends only)"),   /* text shown to user */
+                                           TWITTER_PREF_REQUEST_TIMEOUT,    /* pref name */
+                                           TWITTER_PREF_REQUEST_TIMEOUT_DEFAULT);   /* default value */
+    options = g_list_append(options, option);
+
+    /* How many requests may be in flight at once */
+    option = purple_account_option_int_new(_("Max concurrent requests"),    /* text shown to user */
+                                           TWITTER_PREF_MAX_REQUESTS,   /* pref name */
+                                           TWITTER_PREF_MAX_REQUESTS_DEFAULT);  /* default value */
+    options = g_list_append(options, option);
+
+    option = purple_account_option_int_new(_("Max concurrent requests per host (all accounts)"),    /* text shown to user */
+                                           TWITTER_PREF_MAX_HOST_REQUESTS,  /* pref name */
+                                           TWITTER_PREF_MAX_HOST_REQUESTS_DEFAULT); /* default value */
+    options = g_list_append(options, option);
+
+    /* Save data as the day's budget runs out */
+    option = purple_account_option_int_new(_("Daily data budget (MB, 0: unlimited)"),   /* text shown to user */
+                                           TWITTER_PREF_DAILY_BUDGET,   /* pref name */
+                                           TWITTER_PREF_DAILY_BUDGET_DEFAULT);  /* default value */
+    options = g_list_append(options, option);
+
+    option = purple_account_option_string_new(_("Near the budget, cut first (icons, lists, searches, timeline, replies, dms, users)"),  /* text shown to user */
+                                              TWITTER_PREF_BUDGET_CUT_ORDER,    /* pref name */
+                                              TWITTER_PREF_BUDGET_CUT_ORDER_DEFAULT);   /* default value */
+    options = g_list_append(options, option);
+
+    /* Record the account's traffic, or replay it instead of going online */
+    {
+        static const gchar *trace_keys[] = {
+            N_("Off"),
+            N_("Record"),
+            N_("Replay at recorded speed"),
+            N_("Replay as fast as possible"),
+            NULL
+        };
+        static const gchar *trace_values[] = {
+            TWITTER_PREF_TRACE_MODE_OFF,
+            TWITTER_PREF_TRACE_MODE_RECORD,
+            TWITTER_PREF_TRACE_MODE_REPLAY,
+            TWITTER_PREF_TRACE_MODE_REPLAY_FAST,
+            NULL
+        };
+        GList          *trace_options = NULL;
+        int             i;
+
+        for (i = 0; trace_keys[i]; i++) {
+            PurpleKeyValuePair *kvp = g_new0(PurpleKeyValuePair, 1);
+            kvp->key = g_strdup(_(trace_keys[i]));
+            kvp->value = g_strdup(trace_values[i]);
+            trace_options = g_list_append(trace_options, kvp);
+        }
+
+        option = purple_account_option_list_new(_("Request trace"), TWITTER_PREF_TRACE_MODE, trace_options);
+        options = g_list_append(options, option);
+    }
+
+    option = purple_account_option_string_new(_("Request trace file (empty: one per account)"), /* text shown to user */
+                                              TWITTER_PREF_TRACE_FILE,  /* pref name */
+                                              TWITTER_PREF_TRACE_FILE_DEFAULT); /* default value */
+    options = g_list_append(options, option);
+
     /* Add URL link to each tweet */
     option = purple_account_option_bool_new(_("Add URL link to each tweet"), TWITTER_PREF_ADD_URL_TO_TWEET, TWITTER_PREF_ADD_URL_TO_TWEET_DEFAULT);
     options = g_list_append(options, option);
@@ -136,6 +231,17 @@ static GList   *get_protocol_options(const char *protocol_id)
     options = g_list_append(options, option);
 
     if (!strcmp(protocol_id, TWITTER_PROTOCOL_ID)) {
+        /* Timeline, replies and dms pushed over a user stream */
+        option = purple_account_option_bool_new(_("Receive tweets, replies and direct messages as they're posted (GIO and HTTP/2 backends only)"),  /* text shown to user */
+                                                TWITTER_PREF_USE_USER_STREAM,   /* pref name */
+                                                TWITTER_PREF_USE_USER_STREAM_DEFAULT);  /* default value */
+        options = g_list_append(options, option);
+
+        option = purple_account_option_string_new(_("User stream URL"), /* text shown to user */
+                                                  TWITTER_PREF_USER_STREAM_URL, /* pref name */
+                                                  TWITTER_PREF_USER_STREAM_URL_DEFAULT);    /* default value */
+        options = g_list_append(options, option);
+
         /* Lists tweets refresh interval */
         option = purple_account_option_int_new(_("Refresh lists every (min)"),  /* text shown to user */
                                                TWITTER_PREF_LIST_TIMEOUT,   /* pref name */
@@ -155,6 +261,19 @@ static GList   *get_protocol_options(const char *protocol_id)
                                            TWITTER_PREF_SEARCH_TIMEOUT_DEFAULT);    /* default value */
     options = g_list_append(options, option);
 
+    if (!strcmp(protocol_id, TWITTER_PROTOCOL_ID)) {
+        /* Searches' tweets pushed over one filter stream */
+        option = purple_account_option_bool_new(_("Receive search results as they're posted (GIO and HTTP/2 backends only)"),    /* text shown to user */
+                                                TWITTER_PREF_USE_SEARCH_STREAM, /* pref name */
+                                                TWITTER_PREF_USE_SEARCH_STREAM_DEFAULT);    /* default value */
+        options = g_list_append(options, option);
+
+        option = purple_account_option_string_new(_("Search stream URL"),   /* text shown to user */
+                                                  TWITTER_PREF_SEARCH_STREAM_URL,   /* pref name */
+                                                  TWITTER_PREF_SEARCH_STREAM_URL_DEFAULT);  /* default value */
+        options = g_list_append(options, option);
+    }
+
     if (!strcmp(protocol_id, STATUSNET_PROTOCOL_ID)) {
         option = purple_account_option_string_new(_("API Base URL"),    /* text shown to user */
                                                   TWITTER_PREF_API_BASE,    /* pref name */
@@ -218,6 +337,34 @@ gint twitter_option_dms_timeout(PurpleAccount * account)
     return purple_account_get_int(account, TWITTER_PREF_DMS_TIMEOUT, TWITTER_PREF_DMS_TIMEOUT_DEFAULT);
 }
 
+gboolean twitter_option_use_user_stream(PurpleAccount * account)
+{
+    if (!strcmp(purple_account_get_protocol_id(account), TWITTER_PROTOCOL_ID)) {
+        return purple_account_get_bool(account, TWITTER_PREF_USE_USER_STREAM, TWITTER_PREF_USE_USER_STREAM_DEFAULT);
+    } else {
+        return FALSE;
+    }
+}
+
+const gchar    *twitter_option_user_stream_url(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_USER_STREAM_URL, TWITTER_PREF_USER_STREAM_URL_DEFAULT);
+}
+
+gboolean twitter_option_use_search_stream(PurpleAccount * account)
+{
+    if (!strcmp(purple_account_get_protocol_id(account), TWITTER_PROTOCOL_ID)) {
+        return purple_account_get_bool(account, TWITTER_PREF_USE_SEARCH_STREAM, TWITTER_PREF_USE_SEARCH_STREAM_DEFAULT);
+    } else {
+        return FALSE;
+    }
+}
+
+const gchar    *twitter_option_search_stream_url(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_SEARCH_STREAM_URL, TWITTER_PREF_SEARCH_STREAM_URL_DEFAULT);
+}
+
 gint twitter_option_user_status_timeout(PurpleAccount * account)
 {
     return purple_account_get_int(account, TWITTER_PREF_USER_STATUS_TIMEOUT, TWITTER_PREF_USER_STATUS_TIMEOUT_DEFAULT);
@@ -252,6 +399,49 @@ gboolean twitter_option_use_oauth(PurpleAccount * account)
     }
 }
 
+const gchar    *twitter_option_http_backend(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_HTTP_BACKEND, TWITTER_PREF_HTTP_BACKEND_DEFAULT);
+}
+
+gint twitter_option_request_timeout(PurpleAccount * account)
+{
+    return purple_account_get_int(account, TWITTER_PREF_REQUEST_TIMEOUT, TWITTER_PREF_REQUEST_TIMEOUT_DEFAULT);
+}
+
+gint twitter_option_max_requests(PurpleAccount * account)
+{
+    gint            max = purple_account_get_int(account, TWITTER_PREF_MAX_REQUESTS, TWITTER_PREF_MAX_REQUESTS_DEFAULT);
+    return max > 0 ? max : 1;
+}
+
+gint twitter_option_max_host_requests(PurpleAccount * account)
+{
+    gint            max = purple_account_get_int(account, TWITTER_PREF_MAX_HOST_REQUESTS, TWITTER_PREF_MAX_HOST_REQUESTS_DEFAULT);
+    return max > 0 ? max : 1;
+}
+
+gint twitter_option_daily_budget(PurpleAccount * account)
+{
+    gint            budget = purple_account_get_int(account, TWITTER_PREF_DAILY_BUDGET, TWITTER_PREF_DAILY_BUDGET_DEFAULT);
+    return budget > 0 ? budget : 0;
+}
+
+const gchar    *twitter_option_budget_cut_order(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_BUDGET_CUT_ORDER, TWITTER_PREF_BUDGET_CUT_ORDER_DEFAULT);
+}
+
+const gchar    *twitter_option_trace_mode(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_TRACE_MODE, TWITTER_PREF_TRACE_MODE_DEFAULT);
+}
+
+const gchar    *twitter_option_trace_file(PurpleAccount * account)
+{
+    return purple_account_get_string(account, TWITTER_PREF_TRACE_FILE, TWITTER_PREF_TRACE_FILE_DEFAULT);
+}
+
 gint twitter_option_home_timeline_max_tweets(PurpleAccount * account)
 {
     return purple_account_get_int(account, TWITTER_PREF_HOME_TIMELINE_MAX_TWEETS, TWITTER_PREF_HOME_TIMELINE_MAX_TWEETS_DEFAULT);
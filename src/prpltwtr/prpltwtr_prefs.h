@@ -36,6 +36,35 @@
 #define TWITTER_PREF_USE_HTTPS "use_https"
 #define TWITTER_PREF_USE_HTTPS_DEFAULT TRUE
 
+#define TWITTER_PREF_HTTP_BACKEND "http_backend"
+#define TWITTER_PREF_HTTP_BACKEND_PURPLE "purple"
+#define TWITTER_PREF_HTTP_BACKEND_GIO "gio"
+#define TWITTER_PREF_HTTP_BACKEND_H2 "h2"
+#define TWITTER_PREF_HTTP_BACKEND_DEFAULT TWITTER_PREF_HTTP_BACKEND_PURPLE
+
+#define TWITTER_PREF_REQUEST_TIMEOUT "request_timeout_seconds"
+#define TWITTER_PREF_REQUEST_TIMEOUT_DEFAULT 60
+
+#define TWITTER_PREF_MAX_REQUESTS "max_concurrent_requests"
+#define TWITTER_PREF_MAX_REQUESTS_DEFAULT 4
+#define TWITTER_PREF_MAX_HOST_REQUESTS "max_requests_per_host"
+#define TWITTER_PREF_MAX_HOST_REQUESTS_DEFAULT 6
+
+#define TWITTER_PREF_DAILY_BUDGET "daily_budget_mb"
+#define TWITTER_PREF_DAILY_BUDGET_DEFAULT 0
+#define TWITTER_PREF_BUDGET_CUT_ORDER "budget_cut_order"
+#define TWITTER_PREF_BUDGET_CUT_ORDER_DEFAULT "icons,lists,searches,timeline,replies,dms"
+
+#define TWITTER_PREF_TRACE_MODE "trace_mode"
+#define TWITTER_PREF_TRACE_MODE_OFF "off"
+#define TWITTER_PREF_TRACE_MODE_RECORD "record"
+#define TWITTER_PREF_TRACE_MODE_REPLAY "replay"
+#define TWITTER_PREF_TRACE_MODE_REPLAY_FAST "replay_fast"
+#define TWITTER_PREF_TRACE_MODE_DEFAULT TWITTER_PREF_TRACE_MODE_OFF
+/* empty: <user dir>/prpltwtr/traces/<protocol>_<username> */
+#define TWITTER_PREF_TRACE_FILE "trace_file"
+#define TWITTER_PREF_TRACE_FILE_DEFAULT ""
+
 #define TWITTER_PREF_USE_OAUTH "use_oauth"
 #define TWITTER_PREF_USE_OAUTH_DEFAULT FALSE
 
@@ -68,12 +97,24 @@
 #define TWITTER_PREF_DMS_TIMEOUT "refresh_dms_minutes"
 #define	TWITTER_PREF_DMS_TIMEOUT_DEFAULT 30
 
+#define TWITTER_PREF_USE_USER_STREAM "use_user_stream"
+#define TWITTER_PREF_USE_USER_STREAM_DEFAULT TRUE
+/* Host and path of the user stream. No stand-in server ships with the
+ * plugin: this only lets one be used, with the same framing as Twitter's */
+#define TWITTER_PREF_USER_STREAM_URL "user_stream_url"
+#define TWITTER_PREF_USER_STREAM_URL_DEFAULT "userstream.twitter.com/1.1/user.json"
+
 #define TWITTER_PREF_USER_STATUS_TIMEOUT "refresh_friendlist_minutes"
 #define	TWITTER_PREF_USER_STATUS_TIMEOUT_DEFAULT 60
 
 #define TWITTER_PREF_SEARCH_TIMEOUT "refresh_search_minutes"
 #define TWITTER_PREF_SEARCH_TIMEOUT_DEFAULT 5
 
+#define TWITTER_PREF_USE_SEARCH_STREAM "use_search_stream"
+#define TWITTER_PREF_USE_SEARCH_STREAM_DEFAULT TRUE
+#define TWITTER_PREF_SEARCH_STREAM_URL "search_stream_url"
+#define TWITTER_PREF_SEARCH_STREAM_URL_DEFAULT "stream.twitter.com/1.1/statuses/filter.json"
+
 #define TWITTER_PREF_GET_FRIENDS "get_friends"
 #define TWITTER_PREF_GET_FRIENDS_DEFAULT TRUE
 
@@ -120,6 +161,8 @@
 #define TWITTER_PREF_URL_GET_STATUS "/statuses/show"
 #define TWITTER_PREF_URL_REPORT_SPAMMER "/report_spam"
 #define TWITTER_PREF_URL_GET_USER_INFO "/users/show"
+#define TWITTER_PREF_URL_LOOKUP_USERS "/users/lookup"
+#define TWITTER_PREF_URL_LOOKUP_STATUSES "/statuses/lookup"
 
 /***** END URLS *****/
 
@@ -135,6 +178,10 @@ const gchar    *twitter_option_list_group(PurpleAccount * account);
 const gchar    *twitter_option_search_group(PurpleAccount * account);
 const gchar    *twitter_option_buddy_group(PurpleAccount * account);
 gint            twitter_option_dms_timeout(PurpleAccount * account);
+gboolean        twitter_option_use_user_stream(PurpleAccount * account);
+const gchar    *twitter_option_user_stream_url(PurpleAccount * account);
+gboolean        twitter_option_use_search_stream(PurpleAccount * account);
+const gchar    *twitter_option_search_stream_url(PurpleAccount * account);
 gint            twitter_option_replies_timeout(PurpleAccount * account);
 gboolean        twitter_option_get_following(PurpleAccount * account);
 gint            twitter_option_user_status_timeout(PurpleAccount * account);
@@ -142,6 +189,14 @@ gboolean        twitter_option_get_history(PurpleAccount * account);
 gboolean        twitter_option_sync_status(PurpleAccount * account);
 gboolean        twitter_option_use_https(PurpleAccount * account);
 gboolean        twitter_option_use_oauth(PurpleAccount * account);
+const gchar    *twitter_option_http_backend(PurpleAccount * account);
+gint            twitter_option_request_timeout(PurpleAccount * account);
+gint            twitter_option_max_requests(PurpleAccount * account);
+gint            twitter_option_max_host_requests(PurpleAccount * account);
+gint            twitter_option_daily_budget(PurpleAccount * account);
+const gchar    *twitter_option_budget_cut_order(PurpleAccount * account);
+const gchar    *twitter_option_trace_mode(PurpleAccount * account);
+const gchar    *twitter_option_trace_file(PurpleAccount * account);
 gint            twitter_option_home_timeline_max_tweets(PurpleAccount * account);
 gint            twitter_option_list_max_tweets(PurpleAccount * account);
 gboolean        twitter_option_default_dm(PurpleAccount * account);
@@ -43,10 +43,16 @@
 #include "prpltwtr_util.h"
 #include "prpltwtr_conn.h"
 #include "prpltwtr_auth.h"
+#include "prpltwtr_connpool.h"
+#include "prpltwtr_dns.h"
+#include "prpltwtr_gio.h"
+#include "prpltwtr_stats.h"
+#include "prpltwtr_trace.h"
+#ifdef HAVE_NGHTTP2
+#include "prpltwtr_h2.h"
+#endif
 #include "xmlnode_ext.h"
 
-#define USER_AGENT "Mozilla/4.0 (compatible; MSIE 5.5)"
-
 //TODO: clean this up to be a bit more robust. 
 const gchar    *twitter_account_get_last_home_timeline_id(PurpleAccount * account);
 
@@ -54,11 +60,67 @@ typedef struct {
     TwitterRequestor *requestor;
     TwitterSendRequestSuccessFunc success_func;
     TwitterSendRequestErrorFunc error_func;
+    TwitterSendRequestChunkFunc chunk_func;
 
     gpointer        request_id;
+    void            (*cancel) (gpointer request_id);
     gpointer        user_data;
+    TwitterRequestHandle handle;
+    gsize           request_len;                 /* bytes sent, head and body */
+    gchar          *trace_key;                   /* set if it's being recorded */
+    gint64          sent_at;                     /* monotonic, us, if it's being recorded */
 } TwitterSendRequestData;
 
+static void twitter_send_request_data_free(TwitterSendRequestData * request_data)
+{
+    g_free(request_data->trace_key);
+    g_free(request_data);
+}
+
+/* A request from twitter_send_request until it completes, first queued in
+ * the scheduler and then sent */
+typedef struct {
+    TwitterRequestor *requestor;
+    TwitterRequestHandle handle;
+    TwitterSchedulerJob *job;                    /* queued or running, NULL before it is queued and once its slot is freed */
+    TwitterSendRequestData *sent;                /* what do_send returned, NULL while queued */
+    gboolean        submitting;                  /* still inside twitter_send_request */
+    guint           retry_timer;                 /* waiting to be queued, after a failure */
+    guint           attempts;                    /* times it was sent again */
+    gboolean        probe;                       /* testing its endpoint's half-open circuit */
+    gchar          *coalesce_key;                /* "url?params" for a GET others may join */
+    GList          *followers;                   /* TwitterRequestFollower, callers joined to it */
+    TwitterUsageClass usage_class;               /* what its bytes are counted as */
+    gchar          *usage_label;                 /* its scope's label, if it has one */
+
+    /* what to send, kept until it is */
+    gboolean        post;
+    gchar          *url;
+    TwitterRequestParams *params;
+    gchar         **extra_headers;               /* added to those from pre_send */
+    gboolean        streaming;
+    TwitterSendRequestChunkFunc chunk_callback;
+    TwitterSendRequestSuccessFunc success_callback;
+    TwitterSendRequestErrorFunc error_callback;
+    gpointer        data;
+} TwitterPendingRequest;
+
+/* A caller joined to an identical GET that was already pending. It gets
+ * the same response as the request's own caller */
+typedef struct {
+    TwitterRequestHandle handle;
+    TwitterSendRequestSuccessFunc success_callback;
+    TwitterSendRequestErrorFunc error_callback;
+    gpointer        data;
+} TwitterRequestFollower;
+
+typedef struct {
+    TwitterSendRequestChunkFunc chunk_func;
+    TwitterSendRequestSuccessFunc success_func;
+    TwitterSendRequestErrorFunc error_func;
+    gpointer        user_data;
+} TwitterSendStreamingRequestData;
+
 typedef struct {
     TwitterSendXmlRequestSuccessFunc success_func;
     TwitterSendRequestErrorFunc error_func;
@@ -69,41 +131,67 @@ typedef struct {
     TwitterSendFormatRequestSuccessFunc success_func;
     TwitterSendRequestErrorFunc error_func;
     gpointer        user_data;
+    gchar          *cache_key;                   /* set if the response is cached */
+    TwitterHttpCacheEntry *cached;               /* what a 304 refers to */
 } TwitterSendFormatRequestData;
 
 typedef struct {
-    GList          *nodes;
-    TwitterSendRequestMultiPageAllSuccessFunc success_callback;
+    gchar          *url;
+    TwitterRequestParams *params;                /* without since_id, each window has its own */
+    TwitterSendFormatRequestMultipageAllInnerNodeFunc inner_node_cb;
+    TwitterSendFormatRequestMultiPageAllSuccessFunc success_callback;
     TwitterSendRequestMultiPageAllErrorFunc error_callback;
+    gpointer        user_data;
+    gint            expected_count;
     gint            max_count;
     gint            current_count;
-    gpointer        user_data;
-} TwitterMultiPageAllRequestData;
+    TwitterRequestScope *scope;                  /* the windows' scope, that of the first */
+    GList          *windows;                     /* TwitterBackfillWindow, downloading */
+    GArray         *statuses;                    /* TwitterBackfillStatus, as they arrived */
+    guint64         floor;                       /* statuses up to this id may have a gap above them */
+    gchar          *gaps_key;                    /* the request, for r->backfill_gaps */
+    GArray         *carried;                     /* TwitterBackfillGap, left by the previous fetch */
+    GArray         *gaps;                        /* TwitterBackfillGap, left for the next fetch */
+    gboolean        delivered;
+    gboolean        stopping;                    /* cancelling what's left */
+} TwitterBackfill;
 
 typedef struct {
-    GList          *nodes;
-    TwitterSendFormatRequestMultiPageAllSuccessFunc success_callback;
-    TwitterSendRequestMultiPageAllErrorFunc error_callback;
-    gint            max_count;
-    gint            current_count;
-    gpointer        user_data;
-} TwitterFormatMultiPageAllRequestData;
+    TwitterBackfill *backfill;
+    guint64         since_id;                    /* exclusive, 0 for none */
+    guint64         max_id;                      /* inclusive, 0 for none */
+    TwitterRequestHandle handle;                 /* 0 once complete */
+    guint           resends;                     /* times asked for again after an error */
+} TwitterBackfillWindow;
+
+typedef struct {
+    guint64         id;
+    gpointer        node;
+} TwitterBackfillStatus;
+
+typedef struct {
+    guint64         since_id;                    /* exclusive */
+    guint64         max_id;                      /* inclusive */
+} TwitterBackfillGap;
 
 typedef struct {
-    GList          *nodes;
-    gchar          *next_cursor;
     gchar          *url;
     TwitterRequestParams *params;
-
-    TwitterSendRequestMultiPageAllSuccessFunc success_callback;
+    TwitterSendRequestCursorPageFunc page_callback;
+    TwitterSendRequestCursorDoneFunc done_callback;
     TwitterSendRequestMultiPageAllErrorFunc error_callback;
     gpointer        user_data;
-} TwitterRequestWithCursorData;
+    TwitterRequestScope *scope;                  /* the pages' scope, that of the first */
+    gchar          *cursor;                      /* the page being asked for */
+    TwitterRequestHandle handle;                 /* 0 once it's in */
+    guint           resends;                     /* times it was asked for again after an error */
+    gboolean        stopping;                    /* cancelling what's left */
+} TwitterCursorListing;
 
-void            twitter_send_format_request_multipage_do(TwitterRequestor * r, TwitterFormatMultiPageRequestData * request_data);
+static GList   *twitter_requestor_unregister(TwitterRequestor * r, TwitterRequestHandle handle);
+static gboolean twitter_requestor_retry_response(TwitterRequestor * r, TwitterRequestHandle handle, gint status_code);
 
-static void     twitter_send_format_request_with_cursor_cb(TwitterRequestor * r, gpointer node, gpointer user_data);
-void            twitter_send_format_request_multipage_cb(TwitterRequestor * r, gpointer node, gpointer user_data);
+static gint     twitter_request_params_sort_do(TwitterRequestParam ** a, TwitterRequestParam ** b);
 
 TwitterRequestParam *twitter_request_param_new(const gchar * name, const gchar * value)
 {
@@ -177,6 +265,27 @@ static void twitter_request_params_set_size(TwitterRequestParams * params, guint
     g_array_set_size(params, length);
 }
 
+/// Asks for smaller pages while the request's class is saving data
+static void twitter_request_params_cut_count(TwitterRequestor * r, TwitterPendingRequest * pending)
+{
+    int             i;
+
+    for (i = 0; pending->params && i < pending->params->len; i++) {
+        TwitterRequestParam *p = g_array_index(pending->params, TwitterRequestParam *, i);
+        gint            count;
+        gint            cut;
+
+        if (strcmp(p->name, "count") || !p->value)
+            continue;
+        count = atoi(p->value);
+        cut = prpltwtr_usage_cut_count(twitter_requestor_get_usage(r), pending->usage_class, count);
+        if (cut != count) {
+            g_free(p->value);
+            p->value = g_strdup_printf("%d", cut);
+        }
+    }
+}
+
 void twitter_request_param_free(TwitterRequestParam * p)
 {
     g_free(p->name);
@@ -207,16 +316,52 @@ static gchar   *twitter_request_params_to_string(const TwitterRequestParams * pa
 
 }
 
-static void twitter_requestor_on_error(TwitterRequestor * r, const TwitterRequestErrorData * error_data, TwitterSendRequestErrorFunc called_error_cb, gpointer user_data)
+/// Identifies a request in a trace: "<method> <url>?<params>", leaving out
+/// the OAuth params, which change every time
+static gchar   *twitter_request_trace_key(gboolean post, const char *url, const TwitterRequestParams * params)
+{
+    GString        *key = g_string_new(post ? "POST " : "GET ");
+    gchar           sep = '?';
+    int             i;
+
+    g_string_append(key, url);
+    for (i = 0; params && i < params->len; i++) {
+        TwitterRequestParam *p = g_array_index(params, TwitterRequestParam *, i);
+        if (g_str_has_prefix(p->name, "oauth_"))
+            continue;
+        g_string_append_c(key, sep);
+        g_string_append(key, purple_url_encode(p->name));
+        g_string_append_c(key, '=');
+        g_string_append(key, purple_url_encode(p->value));
+        sep = '&';
+    }
+    return g_string_free(key, FALSE);
+}
+
+/// Calls the error callback, and those of the request's followers, between
+/// the requestor's pre_failed and post_failed, which are called once
+static void twitter_requestor_on_error_all(TwitterRequestor * r, const TwitterRequestErrorData * error_data, TwitterSendRequestErrorFunc called_error_cb, gpointer user_data, GList * followers)
 {
+    GList          *l;
+
     if (r->pre_failed)
         r->pre_failed(r, &error_data);
     if (called_error_cb)
         called_error_cb(r, error_data, user_data);
+    for (l = followers; l; l = l->next) {
+        TwitterRequestFollower *follower = l->data;
+        if (follower->error_callback)
+            follower->error_callback(r, error_data, follower->data);
+    }
     if (r->post_failed)
         r->post_failed(r, &error_data);
 }
 
+static void twitter_requestor_on_error(TwitterRequestor * r, const TwitterRequestErrorData * error_data, TwitterSendRequestErrorFunc called_error_cb, gpointer user_data)
+{
+    twitter_requestor_on_error_all(r, error_data, called_error_cb, user_data, NULL);
+}
+
 gint twitter_response_text_status_code(const gchar * response_text)
 {
     const gchar    *ptr;
@@ -229,30 +374,6 @@ gint twitter_response_text_status_code(const gchar * response_text)
     return atoi(ptr);
 }
 
-static gboolean twitter_response_text_rate_limit(const gchar * response_text, int *remaining, int *total)
-{
-    const gchar    *ptr;
-    const gchar    *remaining_str = "X-RateLimit-Remaining: ";
-    const gchar    *total_str = "X-RateLimit-Limit: ";
-
-    if (!response_text)
-        return FALSE;
-
-    ptr = g_strrstr(response_text, remaining_str);
-    if (!ptr)
-        return FALSE;
-
-    *remaining = atoi(ptr + strlen(remaining_str));
-
-    ptr = g_strrstr(response_text, total_str);
-    if (!ptr)
-        return FALSE;
-
-    *total = atoi(ptr + strlen(total_str));
-
-    return TRUE;
-}
-
 const gchar    *twitter_response_text_data(const gchar * response_text, gsize len)
 {
     const gchar    *data;
@@ -275,23 +396,68 @@ static gchar   *twitter_xml_node_parse_error(const xmlnode * node)
     return xmlnode_get_child_data(node, "error");
 }
 
-static void twitter_send_request_cb(PurpleUtilFetchUrlData * url_data, gpointer user_data, const gchar * response_text, gsize len, const gchar * server_error_message)
+/// Counts a request's bytes in the account's usage. A request is counted
+/// once per time it's sent, stream chunks only add what they received
+static void twitter_pending_request_count_usage(TwitterRequestor * r, TwitterPendingRequest * pending, gboolean request, gsize sent, gsize received)
+{
+    TwitterUsageClass usage_class = pending ? pending->usage_class : TWITTER_USAGE_OTHER;
+    const gchar    *label = pending ? pending->usage_label : NULL;
+
+    if (request)
+        prpltwtr_usage_add_request(twitter_requestor_get_usage(r), usage_class, label, sent, received);
+    else
+        prpltwtr_usage_add_received(twitter_requestor_get_usage(r), usage_class, label, received);
+}
+
+static void twitter_requestor_count_usage(TwitterRequestor * r, TwitterRequestHandle handle, gboolean request, gsize sent, gsize received)
+{
+    TwitterPendingRequest *pending = handle && r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+
+    twitter_pending_request_count_usage(r, pending, request, sent, received);
+}
+
+static void twitter_send_request_response(TwitterSendRequestData * request_data, const gchar * response_text, gsize len, const gchar * server_error_message)
 {
     const gchar    *url_text;
-    TwitterSendRequestData *request_data = user_data;
     gchar          *error_message = NULL;
     TwitterRequestErrorType error_type = TWITTER_REQUEST_ERROR_NONE;
+    TwitterRequestor *r = request_data->requestor;
+    TwitterHttpHeaders *headers = &r->response_headers;
+    gboolean        have_headers;
     gint            status_code;
-
-    request_data->requestor->pending_requests = g_list_remove(request_data->requestor->pending_requests, request_data);
+    GList          *followers = NULL;
+    GList          *l;
 
 #ifdef _DEBUG_
     purple_debug_info(purple_account_get_protocol_id(request_data->requestor->account), "Received response: %s\n", response_text ? response_text : "NULL");
 #endif
 
-    status_code = twitter_response_text_status_code(response_text);
+    if (request_data->trace_key && r->trace)
+        prpltwtr_trace_record(r->trace, request_data->trace_key, (g_get_monotonic_time() - request_data->sent_at) / 1000, response_text, len, server_error_message);
+
+    /* Only the header block is looked at, however big the body */
+    twitter_http_headers_clear(headers);
+    have_headers = response_text && twitter_http_headers_parse(headers, response_text, len);
+    status_code = have_headers ? headers->status_code : 0;
+    url_text = have_headers ? response_text + headers->length : NULL;
 
-    url_text = twitter_response_text_data(response_text, len);
+    /* Failed attempts cost as much as any other */
+    twitter_requestor_count_usage(r, request_data->handle, TRUE, request_data->request_len, response_text ? len : 0);
+
+    if (request_data->handle && twitter_requestor_retry_response(r, request_data->handle, server_error_message ? 0 : status_code)) {
+        twitter_send_request_data_free(request_data);
+        return;
+    }
+
+    /* Lets the scheduler start the next request */
+    if (request_data->handle)
+        followers = twitter_requestor_unregister(r, request_data->handle);
+
+    if (have_headers && headers->rate_limit_remaining >= 0 && headers->rate_limit_limit >= 0) {
+        r->rate_limit_remaining = headers->rate_limit_remaining;
+        r->rate_limit_total = headers->rate_limit_limit;
+        r->rate_limit_reset = headers->rate_limit_reset;
+    }
 
     if (server_error_message) {
         purple_debug_error(purple_account_get_protocol_id(request_data->requestor->account), "Response error: %s\n", server_error_message);
@@ -351,58 +517,305 @@ static void twitter_send_request_cb(PurpleUtilFetchUrlData * url_data, gpointer
         TwitterRequestErrorData *error_data = g_new0(TwitterRequestErrorData, 1);
         error_data->type = error_type;
         error_data->message = error_message;
-        twitter_requestor_on_error(request_data->requestor, error_data, request_data->error_func, request_data->user_data);
+        error_data->headers = have_headers ? headers : NULL;
+        twitter_requestor_on_error_all(request_data->requestor, error_data, request_data->error_func, request_data->user_data, followers);
         g_free(error_data);
     } else {
-        twitter_response_text_rate_limit(response_text, &(request_data->requestor->rate_limit_remaining), &(request_data->requestor->rate_limit_total));
-
         purple_debug_info(purple_account_get_protocol_id(request_data->requestor->account), "Valid response, calling success func\n");
+        /* Followers get the same response, parsed only once by
+         * twitter_send_format_request */
+        if (followers)
+            r->shared_response = url_text;
         if (request_data->success_func)
             request_data->success_func(request_data->requestor, url_text, request_data->user_data);
+        for (l = followers; l; l = l->next) {
+            TwitterRequestFollower *follower = l->data;
+            if (follower->success_callback)
+                follower->success_callback(r, url_text, follower->data);
+        }
+        if (r->shared_node)
+            r->format->free_node(r->shared_node);
+        r->shared_response = NULL;
+        r->shared_node = NULL;
     }
 
     if (error_message)
         g_free(error_message);
-    g_free(request_data);
+    g_list_free_full(followers, g_free);
+    twitter_send_request_data_free(request_data);
 }
 
-static gpointer twitter_send_request_querystring(TwitterRequestor * r, gboolean post, const char *url, const char *query_string, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+static void twitter_send_request_cb(TwitterConnPoolRequest * conn_request, gpointer user_data, const gchar * response_text, gsize len, const gchar * server_error_message)
 {
-    PurpleAccount  *account = r->account;
-    gchar          *request;
-    gboolean        use_https = twitter_option_use_https(account) && purple_ssl_is_supported();
-    char           *slash = strchr(url, '/');
-    TwitterSendRequestData *request_data = g_new0(TwitterSendRequestData, 1);
-    char           *host = slash ? g_strndup(url, slash - url) : g_strdup(url);
-    char           *full_url = g_strdup_printf("%s://%s",
-                                               use_https ? "https" : "http",
-                                               url);
-    char           *header_fields_text = (header_fields ? g_strjoinv("\r\n", header_fields) : NULL);
+    twitter_send_request_response(user_data, response_text, len, server_error_message);
+}
 
-    purple_debug_info(purple_account_get_protocol_id(account), "Sending %s request to: %s?%s\n", post ? "POST" : "GET", full_url, query_string ? query_string : "");
+static void twitter_send_request_gio_cb(TwitterGioRequest * gio_request, gpointer user_data, const gchar * response_text, gsize len, const gchar * server_error_message)
+{
+    twitter_send_request_response(user_data, response_text, len, server_error_message);
+}
+
+static void twitter_send_request_gio_chunk_cb(TwitterGioRequest * gio_request, gpointer user_data, const gchar * data, gsize len)
+{
+    TwitterSendRequestData *request_data = user_data;
+    twitter_requestor_count_usage(request_data->requestor, request_data->handle, FALSE, 0, len);
+    request_data->chunk_func(request_data->requestor, data, len, request_data->user_data);
+}
 
+static TwitterSendRequestData *twitter_send_request_data_new(TwitterRequestor * r, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    TwitterSendRequestData *request_data = g_new0(TwitterSendRequestData, 1);
     request_data->requestor = r;
     request_data->user_data = data;
     request_data->success_func = success_callback;
     request_data->error_func = error_callback;
+    return request_data;
+}
+
+/// Builds the HTTP/1.1 request for url (host[:port]/path), as a head
+/// from the requestor's buffer pool followed by the POST body. Takes
+/// ownership of query_string, which becomes the body without being copied.
+/// On return host and port hold where it should be sent, and len its size
+static TwitterHttpSegments *twitter_request_build(TwitterRequestor * r, gboolean post, const char *url, gchar * query_string, char **header_fields, gboolean use_https, gchar ** host_ret, int *port_ret, gsize * len_ret)
+{
+    PurpleAccount  *account = r->account;
+    TwitterHttpSegments *segments = twitter_http_segments_new();
+    GString        *head;
+    char           *slash = strchr(url, '/');
+    char           *host = slash ? g_strndup(url, slash - url) : g_strdup(url);
+    char           *colon = strchr(host, ':');
+    int             port = use_https ? 443 : 80;
+    gsize           body_len = query_string && post ? strlen(query_string) : 0;
+    int             i;
+
+    purple_debug_info(purple_account_get_protocol_id(account), "Sending %s request to: %s://%s?%s\n", post ? "POST" : "GET", use_https ? "https" : "http", url, query_string ? query_string : "");
 
-    request = g_strdup_printf("%s %s%s%s HTTP/1.0\r\n" "User-Agent: " USER_AGENT "\r\n" "Host: %s\r\n" "%s" //Content-Type if post
-                              "%s%s"             //extra header fields, if any
-                              "Content-Length: %lu\r\n\r\n" "%s", post ? "POST" : "GET", full_url, (!post && query_string ? "?" : ""), (!post && query_string ? query_string : ""), host, header_fields_text ? header_fields_text : "", header_fields_text ? "\r\n" : "", post ? "Content-Type: application/x-www-form-urlencoded\r\n" : "", query_string && post ? (unsigned long) strlen(query_string) : 0, query_string && post ? query_string : "");
+    if (!r->buffers)
+        r->buffers = twitter_http_buffer_pool_new();
+    head = twitter_http_buffer_pool_get(r->buffers);
+
+    g_string_append(head, post ? "POST " : "GET ");
+    g_string_append(head, use_https ? "https://" : "http://");
+    g_string_append(head, url);
+    if (!post && query_string) {
+        g_string_append_c(head, '?');
+        g_string_append(head, query_string);
+    }
+    g_string_append(head, " HTTP/1.1\r\n" "User-Agent: " TWITTER_USER_AGENT "\r\n" "Host: ");
+    g_string_append(head, host);
+    g_string_append(head, "\r\n" "Connection: keep-alive\r\n" "Accept-Encoding: gzip, deflate\r\n");
+    if (post)
+        g_string_append(head, "Content-Type: application/x-www-form-urlencoded\r\n");
+    for (i = 0; header_fields && header_fields[i]; i++) {
+        g_string_append(head, header_fields[i]);
+        g_string_append(head, "\r\n");
+    }
+    g_string_append_printf(head, "Content-Length: %lu\r\n\r\n", (unsigned long) body_len);
+    *len_ret = head->len + body_len;
 
 #ifdef _DEBUG_
-    purple_debug_info(purple_account_get_protocol_id(account), "Sending request: %s\n", request);
+    purple_debug_info(purple_account_get_protocol_id(account), "Sending request: %s%s\n", head->str, body_len ? query_string : "");
 #endif
 
-    request_data->request_id = purple_util_fetch_url_request_len_with_account(account, full_url, TRUE, USER_AGENT, TRUE, request, TRUE, -1, twitter_send_request_cb, request_data);
-    g_free(full_url);
-    g_free(request);
+    twitter_http_segments_add_pooled(segments, r->buffers, head);
+    if (body_len)
+        twitter_http_segments_add_take(segments, query_string, body_len);
+    else
+        g_free(query_string);
+
+    if (colon) {
+        port = atoi(colon + 1);
+        *colon = '\0';
+    }
+
+    *host_ret = host;
+    *port_ret = port;
+
+    return segments;
+}
+
+/* The twitter_send_request_querystring functions take ownership of query_string */
+static gpointer twitter_send_request_querystring(TwitterRequestor * r, gboolean post, const char *url, gchar * query_string, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    gboolean        use_https = twitter_option_use_https(r->account) && purple_ssl_is_supported();
+    TwitterSendRequestData *request_data = twitter_send_request_data_new(r, success_callback, error_callback, data);
+    gchar          *host;
+    int             port;
+    TwitterHttpSegments *segments = twitter_request_build(r, post, url, query_string, header_fields, use_https, &host, &port, &request_data->request_len);
+
+    request_data->cancel = (void (*)(gpointer)) prpltwtr_connpool_request_cancel;
+    request_data->request_id = prpltwtr_connpool_request_segments(r->account, use_https, host, port, segments, twitter_send_request_cb, request_data);
     g_free(host);
-    g_free(header_fields_text);
 
     return request_data;
 }
 
+static gpointer twitter_send_request_querystring_gio(TwitterRequestor * r, gboolean post, const char *url, gchar * query_string, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    /* GIO does its own TLS, libpurple's SSL plugins don't matter here */
+    gboolean        use_https = twitter_option_use_https(r->account);
+    TwitterSendRequestData *request_data = twitter_send_request_data_new(r, success_callback, error_callback, data);
+    gchar          *host;
+    int             port;
+    TwitterHttpSegments *segments = twitter_request_build(r, post, url, query_string, header_fields, use_https, &host, &port, &request_data->request_len);
+
+    request_data->chunk_func = chunk_callback;
+    request_data->cancel = (void (*)(gpointer)) prpltwtr_gio_request_cancel;
+    request_data->request_id = prpltwtr_gio_request_segments(r->account, use_https, host, port, segments, twitter_option_request_timeout(r->account), chunk_callback ? twitter_send_request_gio_chunk_cb : NULL, twitter_send_request_gio_cb, request_data);
+    g_free(host);
+
+    return request_data;
+}
+
+#ifdef HAVE_NGHTTP2
+static void twitter_send_request_h2_cb(TwitterH2Request * h2_request, gpointer user_data, const gchar * response_text, gsize len, const gchar * server_error_message)
+{
+    twitter_send_request_response(user_data, response_text, len, server_error_message);
+}
+
+static void twitter_send_request_h2_chunk_cb(TwitterH2Request * h2_request, gpointer user_data, const gchar * data, gsize len)
+{
+    TwitterSendRequestData *request_data = user_data;
+    twitter_requestor_count_usage(request_data->requestor, request_data->handle, FALSE, 0, len);
+    request_data->chunk_func(request_data->requestor, data, len, request_data->user_data);
+}
+
+static gint twitter_request_priority_weight(TwitterRequestPriority priority)
+{
+    switch (priority) {
+    case TWITTER_REQUEST_PRIORITY_USER:
+        return 256;
+    case TWITTER_REQUEST_PRIORITY_MENTIONS:
+        return 128;
+    case TWITTER_REQUEST_PRIORITY_TIMELINE:
+        return 64;
+    case TWITTER_REQUEST_PRIORITY_CHAT:
+        return 32;
+    case TWITTER_REQUEST_PRIORITY_BACKGROUND:
+    default:
+        return 16;
+    }
+}
+
+static gpointer twitter_send_request_querystring_h2(TwitterRequestor * r, gboolean post, const char *url, gchar * query_string, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    gboolean        use_https = twitter_option_use_https(r->account);
+    TwitterSendRequestData *request_data = twitter_send_request_data_new(r, success_callback, error_callback, data);
+    gint            weight = twitter_request_priority_weight(twitter_requestor_get_priority(r, post, url));
+    gchar          *host;
+    int             port;
+    TwitterHttpSegments *segments = twitter_request_build(r, post, url, query_string, header_fields, use_https, &host, &port, &request_data->request_len);
+
+    request_data->chunk_func = chunk_callback;
+    request_data->cancel = (void (*)(gpointer)) prpltwtr_h2_request_cancel;
+    request_data->request_id = prpltwtr_h2_request_segments(r->account, use_https, host, port, segments, weight, twitter_option_request_timeout(r->account), chunk_callback ? twitter_send_request_h2_chunk_cb : NULL, twitter_send_request_h2_cb, request_data);
+    g_free(host);
+
+    return request_data;
+}
+#endif
+
+static void twitter_send_request_replay_cb(TwitterTraceReplay * replay, gpointer user_data, const gchar * response_text, gsize len, const gchar * server_error_message)
+{
+    twitter_send_request_response(user_data, response_text, len, server_error_message);
+}
+
+/// Returns the API host name, and sets port
+static gchar   *twitter_requestor_api_host(TwitterRequestor * r, gboolean use_https, int *port)
+{
+    const gchar    *api_host = twitter_option_api_host(r->account);
+    gchar          *host = api_host ? g_strdup(api_host) : NULL;
+    char           *colon = host ? strchr(host, ':') : NULL;
+
+    *port = use_https ? 443 : 80;
+    if (colon) {
+        *port = atoi(colon + 1);
+        *colon = '\0';
+    }
+    return host;
+}
+
+void twitter_requestor_warmup(TwitterRequestor * r)
+{
+    /* Nothing is replayed from the network */
+    if (r->trace && prpltwtr_trace_is_replay(r->trace))
+        return;
+    /* Image hosts seen in earlier sessions */
+    prpltwtr_dns_prefetch_remembered();
+    if (r->do_preconnect)
+        r->do_preconnect(r);
+}
+
+void twitter_requestor_preconnect(TwitterRequestor * r)
+{
+    gboolean        use_https = twitter_option_use_https(r->account) && purple_ssl_is_supported();
+    int             port;
+    gchar          *host = twitter_requestor_api_host(r, use_https, &port);
+
+    if (host)
+        prpltwtr_connpool_warmup(r->account, use_https, host, port);
+    g_free(host);
+}
+
+#ifdef HAVE_NGHTTP2
+void twitter_requestor_preconnect_h2(TwitterRequestor * r)
+{
+    gboolean        use_https = twitter_option_use_https(r->account);
+    int             port;
+    gchar          *host = twitter_requestor_api_host(r, use_https, &port);
+
+    if (host)
+        prpltwtr_h2_warmup(r->account, use_https, host, port, twitter_option_request_timeout(r->account));
+    g_free(host);
+}
+#endif
+
+TwitterRequestPriority twitter_requestor_get_priority(TwitterRequestor * r, gboolean post, const char *url)
+{
+    TwitterUrls    *urls = r->urls;
+
+    if (post || !urls || !g_strcmp0(url, urls->verify_credentials) || !g_strcmp0(url, urls->get_user_info) || !g_strcmp0(url, urls->get_rate_limit_status))
+        return TWITTER_REQUEST_PRIORITY_USER;
+    if (!g_strcmp0(url, urls->get_mentions) || !g_strcmp0(url, urls->get_dms))
+        return TWITTER_REQUEST_PRIORITY_MENTIONS;
+    if (!g_strcmp0(url, urls->get_home_timeline) || !g_strcmp0(url, urls->user_stream))
+        return TWITTER_REQUEST_PRIORITY_TIMELINE;
+    if (!g_strcmp0(url, urls->get_saved_searches) || !g_strcmp0(url, urls->get_subscribed_lists) || !g_strcmp0(url, urls->get_personal_lists)
+        || !g_strcmp0(url, urls->get_list_statuses) || !g_strcmp0(url, urls->get_search_results))
+        return TWITTER_REQUEST_PRIORITY_CHAT;
+    if (!g_strcmp0(url, urls->get_friends) || !g_strcmp0(url, urls->lookup_statuses))
+        return TWITTER_REQUEST_PRIORITY_BACKGROUND;
+    return TWITTER_REQUEST_PRIORITY_TIMELINE;
+}
+
+TwitterUsageClass twitter_requestor_get_usage_class(TwitterRequestor * r, gboolean post, const char *url)
+{
+    TwitterUrls    *urls = r->urls;
+
+    if (!urls)
+        return TWITTER_USAGE_OTHER;
+    if (!g_strcmp0(url, urls->get_home_timeline) || !g_strcmp0(url, urls->user_stream) || !g_strcmp0(url, urls->lookup_statuses))
+        return TWITTER_USAGE_TIMELINE;
+    if (!g_strcmp0(url, urls->get_mentions))
+        return TWITTER_USAGE_REPLIES;
+    if (!g_strcmp0(url, urls->get_dms) || !g_strcmp0(url, urls->new_dm))
+        return TWITTER_USAGE_DMS;
+    if (!g_strcmp0(url, urls->get_search_results) || !g_strcmp0(url, urls->search_stream) || !g_strcmp0(url, urls->get_saved_searches))
+        return TWITTER_USAGE_SEARCHES;
+    if (!g_strcmp0(url, urls->get_list_statuses) || !g_strcmp0(url, urls->get_subscribed_lists) || !g_strcmp0(url, urls->get_personal_lists))
+        return TWITTER_USAGE_LISTS;
+    if (!g_strcmp0(url, urls->get_user_info) || !g_strcmp0(url, urls->lookup_users) || !g_strcmp0(url, urls->get_friends))
+        return TWITTER_USAGE_USERS;
+    return TWITTER_USAGE_OTHER;
+}
+
+TwitterUsage   *twitter_requestor_get_usage(TwitterRequestor * r)
+{
+    if (!r->usage)
+        r->usage = prpltwtr_usage_new(r->account);
+    return r->usage;
+}
+
 void prpltwtr_requestor_post_failed(TwitterRequestor * r, const TwitterRequestErrorData ** error_data)
 {
     purple_debug_error(purple_account_get_protocol_id(r->account), "post_failed called for account %s, error %d, message %s\n", r->account->username, (*error_data)->type, (*error_data)->message ? (*error_data)->message : "");
@@ -412,8 +825,8 @@ void prpltwtr_requestor_post_failed(TwitterRequestor * r, const TwitterRequestEr
         prpltwtr_disconnect(r->account, _("Unauthorized"));
         break;
     case TWITTER_REQUEST_ERROR_RATE_LIMITED:
-        /* TODO: restart automatically */
-        prpltwtr_disconnect(r->account, _("Rate limited"));
+        /* The retry policy holds the endpoint's requests back until its
+         * window resets, the rest of the account carries on */
     default:
         break;
     }
@@ -424,27 +837,710 @@ gpointer twitter_requestor_send(TwitterRequestor * r, gboolean post, const char
     gpointer        request;
     gchar          *querystring = twitter_request_params_to_string(params);
     request = twitter_send_request_querystring(r, post, url, querystring, header_fields, success_callback, error_callback, data);
-    g_free(querystring);
     return request;
 }
 
-void twitter_send_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+gpointer twitter_requestor_send_gio(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    return twitter_requestor_send_gio_streaming(r, post, url, params, header_fields, NULL, success_callback, error_callback, data);
+}
+
+gpointer twitter_requestor_send_gio_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    gpointer        request;
+    gchar          *querystring = twitter_request_params_to_string(params);
+    request = twitter_send_request_querystring_gio(r, post, url, querystring, header_fields, chunk_callback, success_callback, error_callback, data);
+    return request;
+}
+
+#ifdef HAVE_NGHTTP2
+gpointer twitter_requestor_send_h2(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    return twitter_requestor_send_h2_streaming(r, post, url, params, header_fields, NULL, success_callback, error_callback, data);
+}
+
+gpointer twitter_requestor_send_h2_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    gpointer        request;
+    gchar          *querystring = twitter_request_params_to_string(params);
+    request = twitter_send_request_querystring_h2(r, post, url, querystring, header_fields, chunk_callback, success_callback, error_callback, data);
+    return request;
+}
+#endif
+
+gpointer twitter_requestor_send_replay(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    TwitterSendRequestData *request_data = twitter_send_request_data_new(r, success_callback, error_callback, data);
+    gchar          *key = twitter_request_trace_key(post, url, params);
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Replaying %s\n", key);
+    request_data->cancel = (void (*)(gpointer)) prpltwtr_trace_replay_cancel;
+    request_data->request_id = prpltwtr_trace_replay(r->trace, key, twitter_send_request_replay_cb, request_data);
+    g_free(key);
+
+    return request_data;
+}
+
+void twitter_requestor_setup_trace(TwitterRequestor * r)
+{
+    const gchar    *mode = twitter_option_trace_mode(r->account);
+    const gchar    *file = twitter_option_trace_file(r->account);
+    gchar          *path;
+
+    if (strcmp(mode, TWITTER_PREF_TRACE_MODE_RECORD) && strcmp(mode, TWITTER_PREF_TRACE_MODE_REPLAY) && strcmp(mode, TWITTER_PREF_TRACE_MODE_REPLAY_FAST))
+        return;
+
+    path = file && *file ? g_strdup(file) : prpltwtr_trace_default_path(r->account);
+    if (!strcmp(mode, TWITTER_PREF_TRACE_MODE_RECORD))
+        r->trace = prpltwtr_trace_record_new(r->account, path);
+    else
+        r->trace = prpltwtr_trace_replay_new(r->account, path, !strcmp(mode, TWITTER_PREF_TRACE_MODE_REPLAY));
+    g_free(path);
+    if (!r->trace)
+        return;
+
+    /* Streams are polled for instead, so whatever the account receives
+     * is in responses that can be replayed */
+    r->do_send_streaming = NULL;
+    if (prpltwtr_trace_is_replay(r->trace)) {
+        r->do_send = twitter_requestor_send_replay;
+        r->do_preconnect = NULL;
+    }
+}
+
+static void twitter_pending_request_free(TwitterPendingRequest * pending)
+{
+    TwitterRequestor *r = pending->requestor;
+
+    /* Cancelled or never sent, the circuit is still untested */
+    if (pending->probe)
+        prpltwtr_retry_probe_cancelled(r->retry, pending->url);
+
+    /* No one can join it any more */
+    if (pending->coalesce_key && r->coalescable_requests && g_hash_table_lookup(r->coalescable_requests, pending->coalesce_key) == pending)
+        g_hash_table_remove(r->coalescable_requests, pending->coalesce_key);
+    g_free(pending->coalesce_key);
+    g_free(pending->url);
+    g_free(pending->usage_label);
+    twitter_request_params_free(pending->params);
+    g_strfreev(pending->extra_headers);
+    g_free(pending);
+}
+
+/// Takes the request's followers out of the requestor's tables and returns
+/// them. Free the list with g_list_free_full(followers, g_free)
+static GList   *twitter_pending_request_take_followers(TwitterPendingRequest * pending)
+{
+    TwitterRequestor *r = pending->requestor;
+    GList          *followers = pending->followers;
+    GList          *l;
+
+    pending->followers = NULL;
+    for (l = followers; l; l = l->next)
+        g_hash_table_remove(r->follower_handles, GUINT_TO_POINTER(((TwitterRequestFollower *) l->data)->handle));
+    return followers;
+}
+
+/// Returns a new handle, never 0
+static TwitterRequestHandle twitter_requestor_next_handle(TwitterRequestor * r)
 {
+    if (++r->last_request_handle == 0)
+        ++r->last_request_handle;
+    return r->last_request_handle;
+}
+
+/// Adds a request to the pending requests and returns its handle
+static TwitterRequestHandle twitter_requestor_register(TwitterRequestor * r, TwitterPendingRequest * pending)
+{
+    if (!r->pending_requests)
+        r->pending_requests = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    pending->handle = twitter_requestor_next_handle(r);
+    g_hash_table_insert(r->pending_requests, GUINT_TO_POINTER(pending->handle), pending);
+    return pending->handle;
+}
+
+/// Forgets a sent request that has completed, freeing its scheduler slot.
+/// Returns its followers, which are owed the same response
+static GList   *twitter_requestor_unregister(TwitterRequestor * r, TwitterRequestHandle handle)
+{
+    TwitterPendingRequest *pending = r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+    GList          *followers;
+
+    if (!pending)
+        return NULL;
+    g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(handle));
+    followers = twitter_pending_request_take_followers(pending);
+    if (pending->job)
+        prpltwtr_scheduler_job_done(pending->job);
+    twitter_pending_request_free(pending);
+    return followers;
+}
+
+/// Cancels the request, queued or sent, and completes it and its followers
+/// with a TWITTER_REQUEST_ERROR_CANCELED error. The backend won't call back
+/// after its cancel function
+static void twitter_requestor_cancel_request(TwitterRequestor * r, TwitterPendingRequest * pending)
+{
+    TwitterSendRequestData *request_data = pending->sent;
+    TwitterRequestErrorData error_data;
+    GList          *followers = twitter_pending_request_take_followers(pending);
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+
+    if (pending->retry_timer) {
+        purple_timeout_remove(pending->retry_timer);
+    } else if (request_data) {
+        if (request_data->request_id)
+            request_data->cancel(request_data->request_id);
+        twitter_pending_request_count_usage(r, pending, TRUE, request_data->request_len, 0);
+        twitter_send_request_data_free(request_data);
+        if (pending->job)
+            prpltwtr_scheduler_job_done(pending->job);
+    } else if (pending->job) {
+        /* Still queued */
+        prpltwtr_scheduler_job_cancel(pending->job);
+    }
+    twitter_requestor_on_error_all(r, &error_data, pending->error_callback, pending->data, followers);
+    g_list_free_full(followers, g_free);
+    twitter_pending_request_free(pending);
+}
+
+/// Cancels a caller's interest in a request that others still want: the
+/// first follower takes its place, and it's completed on its own
+static void twitter_requestor_cancel_leader(TwitterRequestor * r, TwitterPendingRequest * pending)
+{
+    TwitterRequestFollower *follower = pending->followers->data;
+    TwitterSendRequestErrorFunc error_callback = pending->error_callback;
+    gpointer        data = pending->data;
+    TwitterRequestErrorData error_data;
+
+    pending->followers = g_list_delete_link(pending->followers, pending->followers);
+    g_hash_table_remove(r->follower_handles, GUINT_TO_POINTER(follower->handle));
+    g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(pending->handle));
+
+    pending->handle = follower->handle;
+    pending->success_callback = follower->success_callback;
+    pending->error_callback = follower->error_callback;
+    pending->data = follower->data;
+    if (pending->sent) {
+        pending->sent->handle = follower->handle;
+        pending->sent->success_func = follower->success_callback;
+        pending->sent->error_func = follower->error_callback;
+        pending->sent->user_data = follower->data;
+    }
+    g_hash_table_insert(r->pending_requests, GUINT_TO_POINTER(pending->handle), pending);
+    g_free(follower);
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+    twitter_requestor_on_error(r, &error_data, error_callback, data);
+}
+
+/// Cancels a follower. The request goes on for the others
+static void twitter_requestor_cancel_follower(TwitterRequestor * r, TwitterPendingRequest * pending, TwitterRequestHandle handle)
+{
+    TwitterRequestFollower *follower = NULL;
+    TwitterRequestErrorData error_data;
+    GList          *l;
+
+    for (l = pending->followers; l && !follower; l = l->next)
+        if (((TwitterRequestFollower *) l->data)->handle == handle)
+            follower = l->data;
+    g_return_if_fail(follower != NULL);
+
+    pending->followers = g_list_remove(pending->followers, follower);
+    g_hash_table_remove(r->follower_handles, GUINT_TO_POINTER(handle));
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+    twitter_requestor_on_error(r, &error_data, follower->error_callback, follower->data);
+    g_free(follower);
+}
+
+/// Scheduler start function: sends the request
+static void twitter_pending_request_start(TwitterSchedulerJob * job, gpointer user_data)
+{
+    TwitterPendingRequest *pending = user_data;
+    TwitterRequestor *r = pending->requestor;
+    gboolean        post = pending->post;
+    const char     *url = pending->url;
+    TwitterRequestParams *params = pending->params;
     gpointer        requestor_data = NULL;
-    gpointer        request = NULL;
     gchar         **header_fields = NULL;
+    TwitterSendRequestData *request_data = NULL;
+    gchar         **send_header_fields;
+
+    pending->job = job;
 
     if (r->pre_send)
         r->pre_send(r, &post, &url, &params, &header_fields, &requestor_data);
 
-    if (r->do_send)
-        request = r->do_send(r, post, url, params, header_fields, success_callback, error_callback, data);
+    /* The strings still belong to pre_send and the pending request */
+    send_header_fields = header_fields;
+    if (pending->extra_headers) {
+        guint           n = header_fields ? g_strv_length(header_fields) : 0;
+        send_header_fields = g_new0(gchar *, n + g_strv_length(pending->extra_headers) + 1);
+        if (n)
+            memcpy(send_header_fields, header_fields, n * sizeof (gchar *));
+        memcpy(send_header_fields + n, pending->extra_headers, g_strv_length(pending->extra_headers) * sizeof (gchar *));
+    }
 
-    if (request)
-        r->pending_requests = g_list_append(r->pending_requests, request);
+    if (pending->streaming)
+        request_data = r->do_send_streaming(r, post, url, params, send_header_fields, pending->chunk_callback, pending->success_callback, pending->error_callback, pending->data);
+    else if (r->do_send)
+        request_data = r->do_send(r, post, url, params, send_header_fields, pending->success_callback, pending->error_callback, pending->data);
+
+    /* Keyed before post_send puts the unsigned params back */
+    if (request_data && r->trace && !prpltwtr_trace_is_replay(r->trace)) {
+        request_data->trace_key = twitter_request_trace_key(post, url, params);
+        request_data->sent_at = g_get_monotonic_time();
+    }
+
+    if (send_header_fields != header_fields)
+        g_free(send_header_fields);
 
     if (r->post_send)
         r->post_send(r, &post, &url, &params, &header_fields, &requestor_data);
+
+    if (request_data) {
+        request_data->handle = pending->handle;
+        pending->sent = request_data;
+        return;
+    }
+
+    /* Nothing was sent, so nothing will call back */
+    g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(pending->handle));
+    prpltwtr_scheduler_job_done(job);
+    if (!pending->submitting) {
+        /* The callers have handles by now, so they're owed a callback */
+        TwitterRequestErrorData error_data;
+        GList          *followers = twitter_pending_request_take_followers(pending);
+
+        memset(&error_data, 0, sizeof (error_data));
+        error_data.type = TWITTER_REQUEST_ERROR_SERVER;
+        error_data.message = _("Unable to send request");
+        twitter_requestor_on_error_all(r, &error_data, pending->error_callback, pending->data, followers);
+        g_list_free_full(followers, g_free);
+    }
+    twitter_pending_request_free(pending);
+}
+
+/// Scheduler drop function, for requests dropped while queued
+static void twitter_pending_request_drop(gpointer user_data)
+{
+    TwitterPendingRequest *pending = user_data;
+    TwitterRequestor *r = pending->requestor;
+    TwitterRequestErrorData error_data;
+    GList          *followers = twitter_pending_request_take_followers(pending);
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+
+    g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(pending->handle));
+    twitter_requestor_on_error_all(r, &error_data, pending->error_callback, pending->data, followers);
+    g_list_free_full(followers, g_free);
+    twitter_pending_request_free(pending);
+}
+
+/// Fails a request without sending it, as its endpoint is refusing requests
+static void twitter_pending_request_reject(TwitterPendingRequest * pending, TwitterRetryAdmission admission)
+{
+    TwitterRequestor *r = pending->requestor;
+    TwitterRequestErrorData error_data;
+    GList          *followers = twitter_pending_request_take_followers(pending);
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Not sending %s, the endpoint is %s\n", pending->url, admission == TWITTER_RETRY_RATE_LIMITED ? "rate limited" : "failing");
+
+    memset(&error_data, 0, sizeof (error_data));
+    if (admission == TWITTER_RETRY_RATE_LIMITED) {
+        error_data.type = TWITTER_REQUEST_ERROR_RATE_LIMITED;
+        error_data.message = _("Rate limited");
+    } else {
+        error_data.type = TWITTER_REQUEST_ERROR_SERVER;
+        error_data.message = _("Service temporarily unavailable");
+    }
+
+    g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(pending->handle));
+    prpltwtr_retry_count(r->retry, TRUE);
+    twitter_requestor_on_error_all(r, &error_data, pending->error_callback, pending->data, followers);
+    g_list_free_full(followers, g_free);
+    twitter_pending_request_free(pending);
+}
+
+static void     twitter_pending_request_defer(TwitterPendingRequest * pending, guint delay_ms);
+
+/// Hands the request to the scheduler, classed by its endpoint and limited
+/// by the host in its url. If the endpoint is refusing requests, it fails
+/// instead, though never before twitter_send_request returns.
+static void twitter_pending_request_queue(TwitterPendingRequest * pending)
+{
+    TwitterRequestor *r = pending->requestor;
+    TwitterRetryAdmission admission;
+    TwitterRequestHandle handle = pending->handle;
+    TwitterSchedulerJob *job;
+    gchar          *host;
+
+    if (!r->retry)
+        r->retry = prpltwtr_retry_policy_new();
+
+    admission = prpltwtr_retry_admit(r->retry, pending->url);
+    if (admission == TWITTER_RETRY_CIRCUIT_OPEN || admission == TWITTER_RETRY_RATE_LIMITED) {
+        if (pending->submitting)
+            twitter_pending_request_defer(pending, 0);
+        else
+            twitter_pending_request_reject(pending, admission);
+        return;
+    }
+    pending->probe = admission == TWITTER_RETRY_PROBE;
+
+    host = g_strndup(pending->url, strcspn(pending->url, "/"));
+    job = prpltwtr_scheduler_submit(r->account, host, twitter_requestor_get_priority(r, pending->post, pending->url), twitter_pending_request_start, twitter_pending_request_drop, pending);
+    g_free(host);
+
+    /* If a slot was free it was started already. Then the start function
+     * has the job, which may be done by now, and pending may be gone */
+    pending = g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle));
+    if (pending && !pending->sent && !pending->job)
+        pending->job = job;
+}
+
+static gboolean twitter_pending_request_retry_timeout(gpointer user_data)
+{
+    TwitterPendingRequest *pending = user_data;
+
+    pending->retry_timer = 0;
+    twitter_pending_request_queue(pending);
+    return FALSE;
+}
+
+/// Queues the request after a while
+static void twitter_pending_request_defer(TwitterPendingRequest * pending, guint delay_ms)
+{
+    pending->retry_timer = purple_timeout_add(delay_ms, twitter_pending_request_retry_timeout, pending);
+}
+
+/// Called with each response before anything else. Records how the
+/// request's endpoint did and, if the request is a GET that failed in a
+/// way that may pass, sets it up to be sent again after a backoff. Returns
+/// TRUE if so: the response then goes no further.
+static gboolean twitter_requestor_retry_response(TwitterRequestor * r, TwitterRequestHandle handle, gint status_code)
+{
+    TwitterPendingRequest *pending = r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+    const TwitterHttpHeaders *headers = &r->response_headers;
+    time_t          retry_at = 0;
+    time_t          rate_limited_until = 0;
+    guint           delay;
+
+    if (!pending)
+        return FALSE;
+
+    if (status_code == 429)
+        retry_at = headers->retry_after ? headers->retry_after : headers->rate_limit_reset;
+    else if (status_code >= 500)
+        retry_at = headers->retry_after;
+    /* Requests in a used up window would only get 429s */
+    if (status_code == 429)
+        rate_limited_until = retry_at;
+    else if (status_code && headers->rate_limit_remaining == 0)
+        rate_limited_until = headers->rate_limit_reset;
+
+    if (!r->retry)
+        r->retry = prpltwtr_retry_policy_new();
+    prpltwtr_retry_record(r->retry, pending->url, status_code, retry_at, rate_limited_until);
+    if (status_code && headers->rate_limit_remaining >= 0 && headers->rate_limit_reset)
+        prpltwtr_retry_record_rate_limit(r->retry, pending->url, headers->rate_limit_remaining, headers->rate_limit_reset);
+    pending->probe = FALSE;
+
+    if (pending->post || pending->streaming || !prpltwtr_retry_is_transient(status_code) || pending->attempts >= TWITTER_RETRY_MAX_ATTEMPTS)
+        return FALSE;
+    /* The server wants a longer break than we'd make the caller wait */
+    if (!(delay = prpltwtr_retry_delay(pending->attempts, retry_at)))
+        return FALSE;
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Request for %s failed with status %d, sending it again in %u ms\n", pending->url, status_code, delay);
+    pending->attempts++;
+    prpltwtr_retry_count(r->retry, FALSE);
+
+    /* The caller frees what do_send returned */
+    pending->sent = NULL;
+    prpltwtr_scheduler_job_done(pending->job);
+    pending->job = NULL;
+    twitter_pending_request_defer(pending, delay);
+    return TRUE;
+}
+
+struct _TwitterRequestScope {
+    TwitterRequestor *requestor;                 /* NULL once the requestor is freed */
+    /* TwitterRequestHandle -> TRUE, for requests sent in the scope. Some
+     * may have completed since */
+    GHashTable     *handles;
+    gchar          *label;                       /* what its requests' bytes are counted under */
+};
+
+TwitterRequestScope *twitter_request_scope_new(TwitterRequestor * r)
+{
+    TwitterRequestScope *scope;
+
+    g_return_val_if_fail(r != NULL, NULL);
+
+    scope = g_new0(TwitterRequestScope, 1);
+
+    scope->requestor = r;
+    scope->handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+    r->scopes = g_list_prepend(r->scopes, scope);
+    return scope;
+}
+
+static gboolean twitter_request_scope_completed(gpointer key, gpointer value, gpointer user_data)
+{
+    return !twitter_requestor_is_pending(user_data, GPOINTER_TO_UINT(key));
+}
+
+static void twitter_request_scope_add(TwitterRequestScope * scope, TwitterRequestHandle handle)
+{
+    if (!scope)
+        return;
+    /* Owners poll for as long as they live, so forget what's done */
+    if (g_hash_table_size(scope->handles) >= 16)
+        g_hash_table_foreach_remove(scope->handles, twitter_request_scope_completed, scope->requestor);
+    g_hash_table_insert(scope->handles, GUINT_TO_POINTER(handle), GINT_TO_POINTER(TRUE));
+}
+
+TwitterRequestScope *twitter_request_scope_enter(TwitterRequestor * r, TwitterRequestScope * scope)
+{
+    TwitterRequestScope *previous = r->current_scope;
+    r->current_scope = scope;
+    return previous;
+}
+
+void twitter_request_scope_leave(TwitterRequestor * r, TwitterRequestScope * previous)
+{
+    r->current_scope = previous;
+}
+
+void twitter_request_scope_set_label(TwitterRequestScope * scope, const gchar * label)
+{
+    g_free(scope->label);
+    scope->label = g_strdup(label);
+}
+
+void twitter_request_scope_free(TwitterRequestScope * scope)
+{
+    TwitterRequestor *r;
+    GList          *handles;
+    GList          *l;
+
+    if (!scope)
+        return;
+    r = scope->requestor;
+    if (!r) {
+        g_hash_table_destroy(scope->handles);
+        g_free(scope->label);
+        g_free(scope);
+        return;
+    }
+
+    r->scopes = g_list_remove(r->scopes, scope);
+    if (r->current_scope == scope)
+        r->current_scope = NULL;
+
+    /* Error callbacks may send requests, which then belong to no scope */
+    handles = g_hash_table_get_keys(scope->handles);
+    g_hash_table_destroy(scope->handles);
+    g_free(scope->label);
+    g_free(scope);
+
+    for (l = handles; l; l = l->next) {
+        TwitterRequestHandle handle = GPOINTER_TO_UINT(l->data);
+        TwitterPendingRequest *pending = r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+
+        /* With followers, the request goes on for them */
+        if (pending && !pending->followers) {
+            gchar          *endpoint = twitter_http_url_endpoint(pending->url);
+            prpltwtr_stats_add_cancelled(endpoint);
+            g_free(endpoint);
+        }
+        twitter_requestor_cancel(r, handle);
+    }
+    g_list_free(handles);
+}
+
+/// Joins the caller to a pending GET for the same url and params, if there
+/// is one. Returns its handle, or 0 if the request has to be sent.
+static TwitterRequestHandle twitter_requestor_join(TwitterRequestor * r, const gchar * coalesce_key, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    TwitterPendingRequest *pending = r->coalescable_requests ? g_hash_table_lookup(r->coalescable_requests, coalesce_key) : NULL;
+    TwitterRequestFollower *follower;
+
+    if (!pending)
+        return 0;
+
+    if (!r->follower_handles)
+        r->follower_handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    follower = g_new0(TwitterRequestFollower, 1);
+    follower->handle = twitter_requestor_next_handle(r);
+    follower->success_callback = success_callback;
+    follower->error_callback = error_callback;
+    follower->data = data;
+    pending->followers = g_list_append(pending->followers, follower);
+    g_hash_table_insert(r->follower_handles, GUINT_TO_POINTER(follower->handle), pending);
+    r->requests_coalesced++;
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Joined a pending request for %s\n", coalesce_key);
+    return follower->handle;
+}
+
+/// Queues a request in the scheduler, after delay_ms if not 0. A GET
+/// identical to one still pending isn't sent again, the caller gets the
+/// pending one's response. Takes ownership of extra_headers, header lines
+/// to send along with any from pre_send.
+static TwitterRequestHandle twitter_requestor_submit(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, gchar ** extra_headers, guint delay_ms, gboolean streaming, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    TwitterPendingRequest *pending;
+    TwitterRequestHandle handle;
+    gchar          *coalesce_key = NULL;
+
+    /* Error callbacks run while the requestor is freed mustn't send more */
+    if (r->freeing) {
+        g_strfreev(extra_headers);
+        return 0;
+    }
+
+    if (!post && !streaming) {
+        gchar          *query_string = twitter_request_params_to_string(params);
+        gchar          *headers = extra_headers ? g_strjoinv("\n", extra_headers) : NULL;
+        /* A conditional GET is only the same as another with the same conditions */
+        coalesce_key = g_strconcat(url, "?", query_string ? query_string : "", headers ? "\n" : NULL, headers, NULL);
+        g_free(query_string);
+        g_free(headers);
+        if ((handle = twitter_requestor_join(r, coalesce_key, success_callback, error_callback, data))) {
+            g_free(coalesce_key);
+            g_strfreev(extra_headers);
+            twitter_request_scope_add(r->current_scope, handle);
+            return handle;
+        }
+    }
+
+    pending = g_new0(TwitterPendingRequest, 1);
+
+    pending->requestor = r;
+    pending->post = post;
+    pending->url = g_strdup(url);
+    pending->params = twitter_request_params_clone(params);
+    pending->extra_headers = extra_headers;
+    pending->streaming = streaming;
+    pending->chunk_callback = chunk_callback;
+    pending->success_callback = success_callback;
+    pending->error_callback = error_callback;
+    pending->data = data;
+    pending->submitting = TRUE;
+    pending->usage_class = twitter_requestor_get_usage_class(r, post, url);
+    if (r->current_scope)
+        pending->usage_label = g_strdup(r->current_scope->label);
+    if (!post)
+        twitter_request_params_cut_count(r, pending);
+
+    handle = twitter_requestor_register(r, pending);
+    if (coalesce_key) {
+        if (!r->coalescable_requests)
+            r->coalescable_requests = g_hash_table_new(g_str_hash, g_str_equal);
+        pending->coalesce_key = coalesce_key;
+        g_hash_table_insert(r->coalescable_requests, coalesce_key, pending);
+    }
+    if (delay_ms)
+        twitter_pending_request_defer(pending, delay_ms);
+    else
+        twitter_pending_request_queue(pending);
+
+    /* Gone already if it was started and nothing was sent */
+    if (!twitter_requestor_is_pending(r, handle))
+        return 0;
+    pending->submitting = FALSE;
+    twitter_request_scope_add(r->current_scope, handle);
+    return handle;
+}
+
+gboolean twitter_requestor_cancel(TwitterRequestor * r, TwitterRequestHandle handle)
+{
+    TwitterPendingRequest *pending = r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+
+    if (pending) {
+        if (pending->followers) {
+            twitter_requestor_cancel_leader(r, pending);
+        } else {
+            g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(handle));
+            twitter_requestor_cancel_request(r, pending);
+        }
+        return TRUE;
+    }
+    if (r->follower_handles && (pending = g_hash_table_lookup(r->follower_handles, GUINT_TO_POINTER(handle)))) {
+        twitter_requestor_cancel_follower(r, pending, handle);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean twitter_requestor_is_pending(TwitterRequestor * r, TwitterRequestHandle handle)
+{
+    return (r->pending_requests && g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) != NULL)
+        || (r->follower_handles && g_hash_table_lookup(r->follower_handles, GUINT_TO_POINTER(handle)) != NULL);
+}
+
+guint twitter_requestor_pending_count(TwitterRequestor * r)
+{
+    return (r->pending_requests ? g_hash_table_size(r->pending_requests) : 0) + (r->follower_handles ? g_hash_table_size(r->follower_handles) : 0);
+}
+
+void twitter_requestor_release_slot(TwitterRequestor * r, TwitterRequestHandle handle)
+{
+    TwitterPendingRequest *pending = r->pending_requests ? g_hash_table_lookup(r->pending_requests, GUINT_TO_POINTER(handle)) : NULL;
+
+    if (pending && pending->sent && pending->job) {
+        prpltwtr_scheduler_job_done(pending->job);
+        pending->job = NULL;
+    }
+}
+
+TwitterRequestHandle twitter_send_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    return twitter_requestor_submit(r, post, url, params, NULL, 0, FALSE, NULL, success_callback, error_callback, data);
+}
+
+static void twitter_send_streaming_fallback_success_cb(TwitterRequestor * r, const gchar * response, gpointer user_data)
+{
+    TwitterSendStreamingRequestData *request_data = user_data;
+
+    /* The backend buffered the whole body, so it comes as a single chunk */
+    if (request_data->chunk_func && response && *response)
+        request_data->chunk_func(r, response, strlen(response), request_data->user_data);
+    if (request_data->success_func)
+        request_data->success_func(r, "", request_data->user_data);
+    g_free(request_data);
+}
+
+static void twitter_send_streaming_fallback_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterSendStreamingRequestData *request_data = user_data;
+    if (request_data->error_func)
+        request_data->error_func(r, error_data, request_data->user_data);
+    g_free(request_data);
+}
+
+TwitterRequestHandle twitter_send_request_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    if (!r->do_send_streaming) {
+        TwitterSendStreamingRequestData *request_data = g_new0(TwitterSendStreamingRequestData, 1);
+        request_data->chunk_func = chunk_callback;
+        request_data->success_func = success_callback;
+        request_data->error_func = error_callback;
+        request_data->user_data = data;
+        return twitter_send_request(r, post, url, params, twitter_send_streaming_fallback_success_cb, twitter_send_streaming_fallback_error_cb, request_data);
+    }
+
+    return twitter_requestor_submit(r, post, url, params, NULL, 0, TRUE, chunk_callback, success_callback, error_callback, data);
 }
 
 static void twitter_xml_request_success_cb(TwitterRequestor * r, const gchar * response, gpointer user_data)
@@ -498,7 +1594,7 @@ static void twitter_xml_request_error_cb(TwitterRequestor * r, const TwitterRequ
     g_free(request_data);
 }
 
-void twitter_send_xml_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendXmlRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+TwitterRequestHandle twitter_send_xml_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendXmlRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
 {
 
     TwitterSendXmlRequestData *request_data = g_new0(TwitterSendXmlRequestData, 1);
@@ -506,13 +1602,36 @@ void twitter_send_xml_request(TwitterRequestor * r, gboolean post, const char *u
     request_data->success_func = success_callback;
     request_data->error_func = error_callback;
 
-    twitter_send_request(r, post, url, params, twitter_xml_request_success_cb, twitter_xml_request_error_cb, request_data);
+    return twitter_send_request(r, post, url, params, twitter_xml_request_success_cb, twitter_xml_request_error_cb, request_data);
 }
 
 /// Called when a formatted request is successful. This handles converting the
 /// textual response into a format-specific version (opaque to this function
 /// via the gpointer) and retrieves the information from the request before
 /// calling the appropriate callback.
+static void twitter_format_request_data_free(TwitterSendFormatRequestData * request_data)
+{
+    g_free(request_data->cache_key);
+    prpltwtr_http_cache_entry_free(request_data->cached);
+    g_free(request_data);
+}
+
+/// Returns the body to use for a cached request: the cached one for a 304.
+/// A 200 response is stored for the next time.
+static const gchar *twitter_format_request_cache_response(TwitterRequestor * r, TwitterSendFormatRequestData * request_data, const gchar * response)
+{
+    const TwitterHttpHeaders *headers = &r->response_headers;
+
+    if (headers->status_code == 304 && request_data->cached) {
+        purple_debug_info(purple_account_get_protocol_id(r->account), "Not modified, using cached response for %s\n", request_data->cache_key);
+        prpltwtr_http_cache_revalidated(r->http_cache, request_data->cache_key);
+        return request_data->cached->body;
+    }
+    if (headers->status_code == 200 && response)
+        prpltwtr_http_cache_store(r->http_cache, request_data->cache_key, headers, response, strlen(response));
+    return response;
+}
+
 static void twitter_format_request_success_cb(TwitterRequestor * r, const gchar * response, gpointer user_data)
 {
     TwitterSendFormatRequestData *request_data = user_data;
@@ -524,7 +1643,17 @@ static void twitter_format_request_success_cb(TwitterRequestor * r, const gchar
 
     purple_debug_info(purple_account_get_protocol_id(r->account), "BEGIN: %s\n", G_STRFUNC);
 
-    response_node = format->from_str(response, strlen(response));
+    if (request_data->cache_key)
+        response = twitter_format_request_cache_response(r, request_data, response);
+
+    /* Several callers of a coalesced request share one parse */
+    if (response == r->shared_response) {
+        if (!r->shared_node)
+            r->shared_node = format->from_str(response, strlen(response));
+        response_node = r->shared_node;
+    } else {
+        response_node = format->from_str(response, strlen(response));
+    }
 
     if (!response_node) {
         purple_debug_error(purple_account_get_protocol_id(r->account), "Response error: invalid format\n");
@@ -552,11 +1681,11 @@ static void twitter_format_request_success_cb(TwitterRequestor * r, const gchar
             request_data->success_func(r, response_node, request_data->user_data);
     }
 
-    if (response_node != NULL)
+    if (response_node != NULL && response_node != r->shared_node)
         format->free_node(response_node);
     if (error_node_text != NULL)
         g_free(error_node_text);
-    g_free(request_data);
+    twitter_format_request_data_free(request_data);
 }
 
 static void twitter_format_request_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
@@ -565,17 +1694,58 @@ static void twitter_format_request_error_cb(TwitterRequestor * r, const TwitterR
     TwitterSendFormatRequestData *request_data = user_data;
     if (request_data->error_func)
         request_data->error_func(r, error_data, request_data->user_data);
-    g_free(request_data);
+    twitter_format_request_data_free(request_data);
 }
 
-void twitter_send_format_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+/// Whether responses from url change rarely enough to be worth caching
+static gboolean twitter_requestor_is_cacheable(TwitterRequestor * r, const char *url)
+{
+    TwitterUrls    *urls = r->urls;
+
+    return urls && (!g_strcmp0(url, urls->get_saved_searches) || !g_strcmp0(url, urls->get_personal_lists) || !g_strcmp0(url, urls->get_subscribed_lists)
+                    || !g_strcmp0(url, urls->verify_credentials) || !g_strcmp0(url, urls->get_user_info) || !g_strcmp0(url, urls->get_friends));
+}
+
+/// Returns the cache key for a request: its url and params, sorted
+static gchar   *twitter_request_cache_key(const char *url, const TwitterRequestParams * params)
+{
+    TwitterRequestParams *sorted = twitter_request_params_clone(params);
+    gchar          *query_string;
+    gchar          *key;
+
+    if (sorted)
+        g_array_sort(sorted, (GCompareFunc) twitter_request_params_sort_do);
+    query_string = twitter_request_params_to_string(sorted);
+    key = g_strconcat(url, "?", query_string ? query_string : "", NULL);
+    g_free(query_string);
+    twitter_request_params_free(sorted);
+    return key;
+}
+
+/// Like twitter_send_format_request, with the request queued after delay_ms
+static TwitterRequestHandle twitter_send_format_request_after(TwitterRequestor * r, guint delay_ms, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
 {
     TwitterSendFormatRequestData *request_data = g_new0(TwitterSendFormatRequestData, 1);
+    gchar         **conditional_headers = NULL;
+
     request_data->user_data = data;
     request_data->success_func = success_callback;
     request_data->error_func = error_callback;
 
-    twitter_send_request(r, post, url, params, twitter_format_request_success_cb, twitter_format_request_error_cb, request_data);
+    if (!post && twitter_requestor_is_cacheable(r, url)) {
+        if (!r->http_cache)
+            r->http_cache = prpltwtr_http_cache_new(r->account);
+        request_data->cache_key = twitter_request_cache_key(url, params);
+        if ((request_data->cached = prpltwtr_http_cache_lookup(r->http_cache, request_data->cache_key)))
+            conditional_headers = prpltwtr_http_cache_entry_headers(request_data->cached);
+    }
+
+    return twitter_requestor_submit(r, post, url, params, conditional_headers, delay_ms, FALSE, NULL, twitter_format_request_success_cb, twitter_format_request_error_cb, request_data);
+}
+
+TwitterRequestHandle twitter_send_format_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data)
+{
+    return twitter_send_format_request_after(r, 0, post, url, params, success_callback, error_callback, data);
 }
 
 static long long twitter_oauth_generate_nonce()
@@ -686,256 +1856,495 @@ int xmlnode_child_count(xmlnode * parent)
     return count;
 }
 
-void twitter_send_format_request_multipage_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
-{
-    TwitterFormatMultiPageRequestData *request_data = user_data;
-    int             count = 0;
-    gboolean        get_next_page;
-    gboolean        last_page = FALSE;
+/******************************************************
+ *  Fetch everything since an id
+ ******************************************************/
 
-    purple_debug_info(purple_account_get_protocol_id(r->account), "BEGIN: %s\n", G_STRFUNC);
+/* The first page is asked for with since_id alone. If it comes back full,
+ * there may be more between since_id and the oldest status in it. That gap
+ * is split into max_id windows asked for side by side, and a window that
+ * comes back full leaves a smaller gap of its own. */
 
-    if (request_data->inner_node_cb) {
-        node = request_data->inner_node_cb(r, node);
-    }
+static void     twitter_backfill_send(TwitterRequestor * r, TwitterBackfill * backfill, TwitterBackfillWindow * window, guint delay_ms);
 
-    count = r->format->get_node_child_count(node);
+static guint64 twitter_backfill_parse_id(const gchar * id)
+{
+    return id ? g_ascii_strtoull(id, NULL, 10) : 0;
+}
 
-    if (count <= 20) {
-        last_page = TRUE;
-    }
+static gint twitter_backfill_status_compare(gconstpointer a, gconstpointer b)
+{
+    guint64         id_a = ((const TwitterBackfillStatus *) a)->id;
+    guint64         id_b = ((const TwitterBackfillStatus *) b)->id;
 
-    /* Force last_page to TRUE until we handle max_id properly */
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: forcing last_page to TRUE\n", G_STRFUNC);
-    last_page = TRUE;
+    return id_a < id_b ? -1 : id_a > id_b ? 1 : 0;
+}
 
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: last_page: %s, count: %d, expected_count: %d\n", G_STRFUNC, last_page ? "yes" : "no", count, request_data->expected_count);
+static gint twitter_backfill_gap_compare_newest(gconstpointer a, gconstpointer b)
+{
+    guint64         id_a = ((const TwitterBackfillGap *) a)->max_id;
+    guint64         id_b = ((const TwitterBackfillGap *) b)->max_id;
 
-    if (!request_data->success_callback) {
-        get_next_page = TRUE;
+    return id_a > id_b ? -1 : id_a < id_b ? 1 : 0;
+}
 
-        purple_debug_info(purple_account_get_protocol_id(r->account), "%s no request_data->success_callback, get_next_page: yes\n", G_STRFUNC);
-    } else {
-        get_next_page = request_data->success_callback(r, node, last_page, request_data, request_data->user_data);
+static void twitter_backfill_gaps_free(gpointer gaps)
+{
+    g_array_free(gaps, TRUE);
+}
 
-        purple_debug_info(purple_account_get_protocol_id(r->account), "%s get_next_page: %s\n", G_STRFUNC, get_next_page ? "yes" : "no");
-    }
+/// Keeps the newest of gaps for the next fetch of the request, replacing
+/// what was kept before
+static void twitter_backfill_keep_gaps(TwitterRequestor * r, const gchar * key, GArray * gaps)
+{
+    GArray         *kept;
 
-    if (last_page || !get_next_page) {
-        g_free(request_data->url);
-        twitter_request_params_free(request_data->params);
-        g_free(request_data);
-    } else {
-        request_data->page++;
-        twitter_send_format_request_multipage_do(r, request_data);
+    if (!gaps || !gaps->len) {
+        if (r->backfill_gaps)
+            g_hash_table_remove(r->backfill_gaps, key);
+        return;
     }
+
+    kept = g_array_sized_new(FALSE, FALSE, sizeof (TwitterBackfillGap), gaps->len);
+    g_array_append_vals(kept, gaps->data, gaps->len);
+    g_array_sort(kept, twitter_backfill_gap_compare_newest);
+    if (kept->len > TWITTER_BACKFILL_MAX_GAPS)
+        g_array_set_size(kept, TWITTER_BACKFILL_MAX_GAPS);
+
+    if (!r->backfill_gaps)
+        r->backfill_gaps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, twitter_backfill_gaps_free);
+    g_hash_table_replace(r->backfill_gaps, g_strdup(key), kept);
 }
 
-static void twitter_send_format_request_multipage_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+/// Leaves (since_id, max_id] for the next fetch
+static void twitter_backfill_carry(TwitterRequestor * r, TwitterBackfill * backfill, guint64 since_id, guint64 max_id)
 {
-    TwitterFormatMultiPageRequestData *request_data = user_data;
-    gboolean        try_again;
-
-    if (!request_data->error_callback)
-        try_again = FALSE;
-    else
-        try_again = request_data->error_callback(r, error_data, request_data->user_data);
+    TwitterBackfillGap gap;
 
-    if (try_again)
-        twitter_send_format_request_multipage_do(r, request_data);
+    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: leaving (%" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT "] for the next fetch\n", G_STRFUNC, since_id, max_id);
+    gap.since_id = since_id;
+    gap.max_id = max_id;
+    g_array_append_val(backfill->gaps, gap);
 }
 
-void twitter_send_format_request_multipage_do(TwitterRequestor * r, TwitterFormatMultiPageRequestData * request_data)
+/// Cancels the windows still downloading and frees the backfill
+static void twitter_backfill_stop(TwitterRequestor * r, TwitterBackfill * backfill)
 {
-    int             len = request_data->params->len;
-    /*twitter_request_params_add(request_data->params, twitter_request_param_new_int("page", request_data->page)); */
-    twitter_request_params_add(request_data->params, twitter_request_param_new_int("count", request_data->expected_count));
-
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: page: %d\n", G_STRFUNC, request_data->page);
+    TwitterBackfillWindow *window;
+    GList          *l;
+    guint           i;
 
-    twitter_send_format_request(r, FALSE, request_data->url, request_data->params, twitter_send_format_request_multipage_cb, twitter_send_format_request_multipage_error_cb, request_data);
-    twitter_request_params_set_size(request_data->params, len);
+    backfill->stopping = TRUE;
+    for (l = backfill->windows; l; l = l->next) {
+        window = l->data;
+        if (window->handle)
+            twitter_requestor_cancel(r, window->handle);
+    }
+    g_list_free_full(backfill->windows, g_free);
+
+    /* Given up on, the gaps carried in are still there */
+    twitter_backfill_keep_gaps(r, backfill->gaps_key, backfill->delivered ? backfill->gaps : backfill->carried);
+    g_free(backfill->gaps_key);
+    if (backfill->carried)
+        g_array_free(backfill->carried, TRUE);
+    g_array_free(backfill->gaps, TRUE);
+    for (i = 0; i < backfill->statuses->len; i++)
+        r->format->free_node(g_array_index(backfill->statuses, TwitterBackfillStatus, i).node);
+    g_array_free(backfill->statuses, TRUE);
+    g_free(backfill->url);
+    twitter_request_params_free(backfill->params);
+    g_free(backfill);
 }
 
-static void twitter_send_format_request_multipage(TwitterRequestor * r, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestMultipageAllInnerNodeFunc inner_node_cb, TwitterSendFormatRequestMultiPageSuccessFunc success_callback, TwitterSendRequestMultiPageErrorFunc error_callback, int expected_count, gpointer data)
+/// Hands over the statuses, oldest first, once no window is left
+static void twitter_backfill_deliver(TwitterRequestor * r, TwitterBackfill * backfill)
 {
-    TwitterFormatMultiPageRequestData *request_data = g_new0(TwitterFormatMultiPageRequestData, 1);
-    request_data->user_data = data;
-    request_data->url = g_strdup(url);
-    request_data->params = twitter_request_params_clone(params);
-    request_data->success_callback = success_callback;
-    request_data->error_callback = error_callback;
-    request_data->page = 1;
-    request_data->expected_count = expected_count;
-    request_data->inner_node_cb = inner_node_cb;
+    GList          *nodes = NULL;
+    guint64         last_id = 0;
+    gint            count = 0;
+    guint           i;
+
+    g_array_sort(backfill->statuses, twitter_backfill_status_compare);
+
+    /* From the newest, so max_count keeps those */
+    for (i = backfill->statuses->len; i-- > 0;) {
+        TwitterBackfillStatus *status = &g_array_index(backfill->statuses, TwitterBackfillStatus, i);
+
+        if (backfill->floor && status->id <= backfill->floor)
+            break;
+        if (backfill->max_count > 0 && count >= backfill->max_count)
+            break;
+        /* In case a server ignored max_id */
+        if (status->id && status->id == last_id)
+            continue;
+        last_id = status->id;
+        nodes = g_list_prepend(nodes, status->node);
+        count++;
+    }
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: handing over %d of %u statuses\n", G_STRFUNC, count, backfill->statuses->len);
 
-    twitter_send_format_request_multipage_do(r, request_data);
+    backfill->delivered = TRUE;
+    if (backfill->success_callback)
+        backfill->success_callback(r, nodes, backfill->user_data);
+    g_list_free(nodes);
+    twitter_backfill_stop(r, backfill);
 }
 
-static void twitter_multipage_all_request_data_free(TwitterRequestor * r, TwitterMultiPageAllRequestData * request_data_all)
+/// Asks for the statuses in (since_id, max_id], in as many windows as are
+/// free and the endpoint's rate limit and max_count allow. A gap max_count
+/// leaves stays; one the rate limit leaves is carried to the next fetch.
+static void twitter_backfill_split(TwitterRequestor * r, TwitterBackfill * backfill, guint64 since_id, guint64 max_id)
 {
-    GList          *l = request_data_all->nodes;
-    for (l = request_data_all->nodes; l; l = l->next) {
-        r->format->free_node(l->data);
+    guint64         span = max_id - since_id;
+    guint           windows = g_list_length(backfill->windows);
+    guint           width = TWITTER_BACKFILL_MAX_WINDOWS - MIN(windows, TWITTER_BACKFILL_MAX_WINDOWS);
+    gint            remaining = r->retry ? prpltwtr_retry_rate_limit_remaining(r->retry, backfill->url) : -1;
+    guint           i;
+
+    if (backfill->max_count > 0 && backfill->current_count >= backfill->max_count) {
+        purple_debug_info(purple_account_get_protocol_id(r->account), "%s: leaving a gap up to %" G_GUINT64_FORMAT "\n", G_STRFUNC, max_id);
+        backfill->floor = MAX(backfill->floor, max_id);
+        return;
+    }
+
+    /* Each endpoint has a window of its own. The windows still
+     * downloading will have used some of what it said was left */
+    if (remaining >= 0)
+        width = MIN(width, (guint) MAX(remaining - TWITTER_BACKFILL_RATE_RESERVE - (gint) windows, 0));
+    if (backfill->max_count > 0)
+        width = MIN(width, (guint) ((backfill->max_count - backfill->current_count + backfill->expected_count - 1) / backfill->expected_count));
+    if (width > span)
+        width = span;
+
+    if (!width) {
+        twitter_backfill_carry(r, backfill, since_id, max_id);
+        return;
+    }
+
+    /* Ids grow with time, so equal ranges of them are about equally long */
+    for (i = 0; i < width; i++) {
+        TwitterBackfillWindow *window = g_new0(TwitterBackfillWindow, 1);
+
+        window->backfill = backfill;
+        window->since_id = since_id + span / width * i;
+        window->max_id = i + 1 == width ? max_id : since_id + span / width * (i + 1);
+        backfill->windows = g_list_prepend(backfill->windows, window);
+        twitter_backfill_send(r, backfill, window, 0);
+        if (!window->handle) {
+            backfill->windows = g_list_remove(backfill->windows, window);
+            twitter_backfill_carry(r, backfill, window->since_id, window->max_id);
+            g_free(window);
+        }
     }
-    g_list_free(request_data_all->nodes);
-    g_free(request_data_all);
 }
 
-static gboolean twitter_send_format_request_multipage_all_success_cb(TwitterRequestor * r, gpointer node, gboolean last_page, TwitterFormatMultiPageRequestData * request_multi, gpointer user_data)
+static void twitter_backfill_window_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
 {
-    TwitterMultiPageAllRequestData *request_data_all = user_data;
+    TwitterBackfillWindow *window = user_data;
+    TwitterBackfill *backfill = window->backfill;
+    GList          *copies = NULL;
+    GList          *l;
+    gint            count = 0;
+    guint64         oldest_id = 0;
+
+    window->handle = 0;
+    backfill->windows = g_list_remove(backfill->windows, window);
+
+    if (backfill->inner_node_cb)
+        node = backfill->inner_node_cb(r, node);
+    if (node)
+        copies = r->format->copy_into(node, NULL, &count);
+
+    for (l = copies; l; l = l->next) {
+        TwitterBackfillStatus status;
+        gchar          *id = r->format->get_str(l->data, "id_str");
+
+        status.id = twitter_backfill_parse_id(id);
+        status.node = l->data;
+        g_free(id);
+        g_array_append_val(backfill->statuses, status);
+        if (status.id && (!oldest_id || status.id < oldest_id))
+            oldest_id = status.id;
+    }
+    g_list_free(copies);
+    backfill->current_count += count;
 
-    gint            node_count;
+    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: %d statuses in (%" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT "], %d of %d so far\n", G_STRFUNC, count, window->since_id, window->max_id, backfill->current_count, backfill->max_count);
 
-    purple_debug_info(purple_account_get_protocol_id(r->account), "BEGIN: %s: object %d array %d count %d\n", G_STRFUNC, JSON_NODE_TYPE(node) == JSON_NODE_OBJECT, JSON_NODE_TYPE(node) == JSON_NODE_ARRAY, g_list_length(request_data_all->nodes));
+    /* Twitter drops deleted statuses after counting, so a full page can
+     * come back a little short. An oldest id above max_id means the server
+     * ignored it, and asking again would get the same page. */
+    if (window->since_id && oldest_id > window->since_id + 1 && (!window->max_id || oldest_id <= window->max_id)
+        && count >= backfill->expected_count - backfill->expected_count / 10)
+        twitter_backfill_split(r, backfill, window->since_id, oldest_id - 1);
+    g_free(window);
 
-    // TODO If we clean this out, it will blow away.
-    // TODO request_data_all->nodes = NULL;
-    // TODO request_data_all->current_count = 0;
+    if (!backfill->windows)
+        twitter_backfill_deliver(r, backfill);
+}
 
-    request_data_all->nodes = r->format->copy_into(node, request_data_all->nodes, &node_count);
-    request_data_all->current_count += node_count;
+static void twitter_backfill_window_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterBackfillWindow *window = user_data;
+    TwitterBackfill *backfill = window->backfill;
 
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s last_page: %d current_count: %d max_count: %d count: %d\n", G_STRFUNC, last_page ? 1 : 0, request_data_all->current_count, request_data_all->max_count, request_multi->expected_count);
-    if (last_page || (request_data_all->max_count > 0 && request_data_all->current_count >= request_data_all->max_count)) {
-        request_data_all->success_callback(r, request_data_all->nodes, request_data_all->user_data);
-        twitter_multipage_all_request_data_free(r, request_data_all);
-        return FALSE;
-    } else if (request_data_all->max_count > 0 && (request_data_all->current_count + request_multi->expected_count > request_data_all->max_count)) {
-        request_multi->expected_count = request_data_all->max_count - request_data_all->current_count;
+    window->handle = 0;
+    if (backfill->stopping)
+        return;
+
+    if (backfill->error_callback && backfill->error_callback(r, error_data, backfill->user_data) && error_data->type != TWITTER_REQUEST_ERROR_CANCELED) {
+        /* Backs off, so a failing window isn't asked for in a tight loop */
+        twitter_backfill_send(r, backfill, window, prpltwtr_retry_delay(window->resends++, 0));
+        if (window->handle)
+            return;
     }
-    return TRUE;
+    twitter_backfill_stop(r, backfill);
 }
 
-static gboolean twitter_send_format_request_multipage_all_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+static void twitter_backfill_send(TwitterRequestor * r, TwitterBackfill * backfill, TwitterBackfillWindow * window, guint delay_ms)
 {
-    TwitterMultiPageAllRequestData *request_data_all = user_data;
-    if (request_data_all->error_callback && request_data_all->error_callback(r, error_data, request_data_all->user_data))
-        return TRUE;
-    twitter_multipage_all_request_data_free(r, request_data_all);
-    return FALSE;
+    int             len = backfill->params->len;
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, backfill->scope);
+
+    twitter_request_params_add(backfill->params, twitter_request_param_new_int("count", backfill->expected_count));
+    if (window->since_id)
+        twitter_request_params_add(backfill->params, twitter_request_param_new_ll("since_id", window->since_id));
+    if (window->max_id)
+        twitter_request_params_add(backfill->params, twitter_request_param_new_ll("max_id", window->max_id));
+
+    window->handle = twitter_send_format_request_after(r, delay_ms, FALSE, backfill->url, backfill->params, twitter_backfill_window_success_cb, twitter_backfill_window_error_cb, window);
+    twitter_request_params_set_size(backfill->params, len);
+    twitter_request_scope_leave(r, previous_scope);
 }
 
 void twitter_send_format_request_multipage_all(TwitterRequestor * r, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestMultipageAllInnerNodeFunc inner_node_cb, TwitterSendFormatRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, int expected_count, gint max_count, gpointer data)
 {
-    TwitterFormatMultiPageAllRequestData *request_data_all = g_new0(TwitterFormatMultiPageAllRequestData, 1);
+    TwitterBackfill *backfill = g_new0(TwitterBackfill, 1);
+    TwitterBackfillWindow *window = g_new0(TwitterBackfillWindow, 1);
+    GArray         *carried;
+    int             i;
 
     purple_debug_info(purple_account_get_protocol_id(r->account), "BEGIN: %s\n", G_STRFUNC);
 
-    request_data_all->success_callback = success_callback;
-    request_data_all->error_callback = error_callback;
-    request_data_all->nodes = NULL;
-    request_data_all->user_data = data;
-    request_data_all->max_count = max_count;
-
     if (max_count > 0 && expected_count > max_count)
         expected_count = max_count;
 
-    twitter_send_format_request_multipage(r, url, params, inner_node_cb, twitter_send_format_request_multipage_all_success_cb, twitter_send_format_request_multipage_all_error_cb, expected_count, request_data_all);
+    backfill->url = g_strdup(url);
+    backfill->params = twitter_request_params_new();
+    for (i = 0; params && i < params->len; i++) {
+        TwitterRequestParam *p = g_array_index(params, TwitterRequestParam *, i);
+        if (!strcmp(p->name, "since_id"))
+            window->since_id = twitter_backfill_parse_id(p->value);
+        else
+            twitter_request_params_add(backfill->params, twitter_request_param_clone(p));
+    }
+    backfill->inner_node_cb = inner_node_cb;
+    backfill->success_callback = success_callback;
+    backfill->error_callback = error_callback;
+    backfill->user_data = data;
+    backfill->expected_count = MAX(expected_count, 1);
+    backfill->max_count = max_count;
+    backfill->scope = r->current_scope;
+    backfill->statuses = g_array_new(FALSE, FALSE, sizeof (TwitterBackfillStatus));
+    backfill->gaps_key = twitter_request_trace_key(FALSE, url, backfill->params);
+    backfill->gaps = g_array_new(FALSE, FALSE, sizeof (TwitterBackfillGap));
+
+    window->backfill = backfill;
+    backfill->windows = g_list_prepend(NULL, window);
+    twitter_backfill_send(r, backfill, window, 0);
+    if (!window->handle) {
+        twitter_backfill_stop(r, backfill);
+        return;
+    }
+
+    /* What the previous fetch left, asked for alongside what's new */
+    if (r->backfill_gaps && (carried = g_hash_table_lookup(r->backfill_gaps, backfill->gaps_key))) {
+        backfill->carried = g_array_sized_new(FALSE, FALSE, sizeof (TwitterBackfillGap), carried->len);
+        g_array_append_vals(backfill->carried, carried->data, carried->len);
+        g_hash_table_remove(r->backfill_gaps, backfill->gaps_key);
+        for (i = 0; i < (int) backfill->carried->len && !backfill->stopping; i++) {
+            TwitterBackfillGap *gap = &g_array_index(backfill->carried, TwitterBackfillGap, i);
+            twitter_backfill_split(r, backfill, gap->since_id, gap->max_id);
+        }
+    }
 }
 
 /******************************************************
  *  Request with cursor
  ******************************************************/
 
-static void twitter_request_with_cursor_data_free(TwitterRequestor * r, TwitterRequestWithCursorData * request_data)
-{
-    GList          *l;
+/* One page is asked for at a time, but the next one as soon as a page is
+ * in, so its round trip overlaps the caller's work on the page before. */
 
-    for (l = request_data->nodes; l; l = l->next)
-        r->format->free_node(l->data);
+static void     twitter_cursor_listing_send(TwitterRequestor * r, TwitterCursorListing * listing, guint delay_ms);
 
-    g_list_free(request_data->nodes);
-    g_free(request_data->url);
-    twitter_request_params_free(request_data->params);
-    g_slice_free(TwitterRequestWithCursorData, request_data);
+/// Cancels the page being asked for, if any, and frees the listing
+static void twitter_cursor_listing_stop(TwitterRequestor * r, TwitterCursorListing * listing)
+{
+    listing->stopping = TRUE;
+    if (listing->handle)
+        twitter_requestor_cancel(r, listing->handle);
+    g_free(listing->cursor);
+    g_free(listing->url);
+    twitter_request_params_free(listing->params);
+    g_free(listing);
 }
 
-static void     twitter_send_format_request_with_cursor_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data);
-
-static void twitter_send_format_request_with_cursor_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
+static void twitter_cursor_listing_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
 {
-    TwitterRequestWithCursorData *request_data = user_data;
-    gchar          *next_cursor_str;
-
-    next_cursor_str = r->format->get_str(node, "next_cursor");
-    if (next_cursor_str) {
-        request_data->next_cursor = next_cursor_str;
-        g_free(next_cursor_str);
-    } else {
-        request_data->next_cursor = 0;
+    TwitterCursorListing *listing = user_data;
+    gchar          *next_cursor = r->format->get_str(node, "next_cursor");
+    gboolean        more = next_cursor && *next_cursor && strcmp(next_cursor, "0");
+    gboolean        broken = FALSE;
+    gboolean        go_on;
+
+    purple_debug_info(purple_account_get_protocol_id(r->account), "%s: page for cursor %s, next_cursor: %s\n", G_STRFUNC, listing->cursor, next_cursor ? next_cursor : "none");
+
+    listing->handle = 0;
+    listing->resends = 0;
+    if (more) {
+        g_free(listing->cursor);
+        listing->cursor = next_cursor;
+        next_cursor = NULL;
+        twitter_cursor_listing_send(r, listing, 0);
+        broken = !listing->handle;
     }
+    g_free(next_cursor);
 
-    purple_debug_info(purple_account_get_protocol_id(r->account), "%s next_cursor: %s\n", G_STRFUNC, request_data->next_cursor);
-
-    request_data->nodes = g_list_prepend(request_data->nodes, r->format->copy_node(node));
-
-    if (request_data->next_cursor) {
-        int             len = request_data->params->len;
-        twitter_request_params_add(request_data->params, twitter_request_param_new("cursor", request_data->next_cursor));
+    go_on = listing->page_callback ? listing->page_callback(r, node, listing->user_data) : TRUE;
+    if (go_on && more && !broken)
+        return;
 
-        twitter_send_format_request(r, FALSE, request_data->url, request_data->params, twitter_send_format_request_with_cursor_cb, twitter_send_format_request_with_cursor_error_cb, request_data);
+    if (go_on && !more) {
+        if (listing->done_callback)
+            listing->done_callback(r, listing->user_data);
+    } else if (go_on && listing->error_callback) {
+        TwitterRequestErrorData error_data;
 
-        twitter_request_params_set_size(request_data->params, len);
-    } else {
-        request_data->success_callback(r, request_data->nodes, request_data->user_data);
-        twitter_request_with_cursor_data_free(r, request_data);
+        memset(&error_data, 0, sizeof (error_data));
+        error_data.type = TWITTER_REQUEST_ERROR_SERVER;
+        error_data.message = _("Unable to send request");
+        listing->error_callback(r, &error_data, listing->user_data);
     }
+    twitter_cursor_listing_stop(r, listing);
 }
 
-static void twitter_send_format_request_with_cursor_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+static void twitter_cursor_listing_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
 {
-    TwitterRequestWithCursorData *request_data = user_data;
-    if (request_data->error_callback && request_data->error_callback(r, error_data, request_data->user_data)) {
-        twitter_send_format_request(r, FALSE, request_data->url, request_data->params, twitter_send_format_request_with_cursor_cb, twitter_send_format_request_with_cursor_error_cb, request_data);
+    TwitterCursorListing *listing = user_data;
+
+    listing->handle = 0;
+    if (listing->stopping)
         return;
+
+    if (listing->error_callback && listing->error_callback(r, error_data, listing->user_data) && error_data->type != TWITTER_REQUEST_ERROR_CANCELED) {
+        /* Backs off, so a failing page isn't asked for in a tight loop */
+        twitter_cursor_listing_send(r, listing, prpltwtr_retry_delay(listing->resends++, 0));
+        if (listing->handle)
+            return;
     }
-    twitter_request_with_cursor_data_free(r, request_data);
+    twitter_cursor_listing_stop(r, listing);
 }
 
-void twitter_send_format_request_with_cursor(TwitterRequestor * r, const char *url, TwitterRequestParams * params, long long cursor, TwitterSendRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, gpointer data)
+static void twitter_cursor_listing_send(TwitterRequestor * r, TwitterCursorListing * listing, guint delay_ms)
 {
-    int             len;
-
-    TwitterRequestWithCursorData *request_data = g_slice_new0(TwitterRequestWithCursorData);
-    request_data->url = g_strdup(url);
-    request_data->params = twitter_request_params_clone(params);
-    if (!request_data->params)
-        request_data->params = twitter_request_params_new();
-    request_data->success_callback = success_callback;
-    request_data->error_callback = error_callback;
-    request_data->user_data = data;
+    int             len = listing->params->len;
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, listing->scope);
 
-    len = request_data->params->len;
-    twitter_request_params_add(request_data->params, twitter_request_param_new_ll("cursor", cursor));
+    twitter_request_params_add(listing->params, twitter_request_param_new("cursor", listing->cursor));
+    listing->handle = twitter_send_format_request_after(r, delay_ms, FALSE, listing->url, listing->params, twitter_cursor_listing_success_cb, twitter_cursor_listing_error_cb, listing);
+    twitter_request_params_set_size(listing->params, len);
+    twitter_request_scope_leave(r, previous_scope);
+}
 
-    twitter_send_format_request(r, FALSE, url, request_data->params, twitter_send_format_request_with_cursor_cb, twitter_send_format_request_with_cursor_error_cb, request_data);
+void twitter_send_format_request_with_cursor(TwitterRequestor * r, const char *url, TwitterRequestParams * params, long long cursor, TwitterSendRequestCursorPageFunc page_callback, TwitterSendRequestCursorDoneFunc done_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, gpointer data)
+{
+    TwitterCursorListing *listing = g_new0(TwitterCursorListing, 1);
+
+    listing->url = g_strdup(url);
+    listing->params = params ? twitter_request_params_clone(params) : twitter_request_params_new();
+    listing->page_callback = page_callback;
+    listing->done_callback = done_callback;
+    listing->error_callback = error_callback;
+    listing->user_data = data;
+    listing->scope = r->current_scope;
+    listing->cursor = g_strdup_printf("%lld", cursor);
+
+    twitter_cursor_listing_send(r, listing, 0);
+    if (!listing->handle)
+        twitter_cursor_listing_stop(r, listing);
+}
 
-    twitter_request_params_set_size(request_data->params, len);
+/// A pending request to cancel, queued ones first: cancelling a sent one
+/// lets the scheduler start the next
+static TwitterPendingRequest *twitter_requestor_next_to_cancel(TwitterRequestor * r)
+{
+    TwitterPendingRequest *sent = NULL;
+    GHashTableIter  iter;
+    gpointer        value;
+
+    g_hash_table_iter_init(&iter, r->pending_requests);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (!((TwitterPendingRequest *) value)->sent)
+            return value;
+        sent = value;
+    }
+    return sent;
 }
 
 void twitter_requestor_free(TwitterRequestor * r)
 {
+    TwitterPendingRequest *pending;
     GList          *l;
     purple_debug_info(purple_account_get_protocol_id(r->account), "Freeing requestor\n");
+    r->freeing = TRUE;
     if (r->pending_requests) {
-        TwitterRequestErrorData *error_data;
-        error_data = g_new0(TwitterRequestErrorData, 1);
-        error_data->type = TWITTER_REQUEST_ERROR_CANCELED;
-        error_data->message = NULL;
-        for (l = r->pending_requests; l; l = l->next) {
-            TwitterSendRequestData *request_data = l->data;
-            //TODO: move this to a ->cancel function
-            if (request_data->request_id) {
-                purple_util_fetch_url_cancel(request_data->request_id);
-                //TODO: created a ->free callback
-                twitter_requestor_on_error(request_data->requestor, error_data, request_data->error_func, request_data->user_data);
-            }
-            g_free(request_data);
+        /* One at a time, from the table itself: an error callback may
+         * cancel other requests, such as the rest of a backfill or of a
+         * cursored listing */
+        while ((pending = twitter_requestor_next_to_cancel(r))) {
+            g_hash_table_remove(r->pending_requests, GUINT_TO_POINTER(pending->handle));
+            twitter_requestor_cancel_request(r, pending);
         }
-        g_list_free(r->pending_requests);
-        g_free(error_data);
+        g_hash_table_destroy(r->pending_requests);
+        r->pending_requests = NULL;
+    }
+    /* Their owners free them later */
+    for (l = r->scopes; l; l = l->next)
+        ((TwitterRequestScope *) l->data)->requestor = NULL;
+    g_list_free(r->scopes);
+    r->scopes = NULL;
+    r->current_scope = NULL;
+    if (r->follower_handles)
+        g_hash_table_destroy(r->follower_handles);
+    if (r->coalescable_requests)
+        g_hash_table_destroy(r->coalescable_requests);
+    purple_debug_info(purple_account_get_protocol_id(r->account), "Requests joined to an identical pending one: %u\n", r->requests_coalesced);
+    /* Anything else the account queued, such as icons */
+    prpltwtr_scheduler_drop_account(r->account);
+    prpltwtr_connpool_drop_account(r->account);
+#ifdef HAVE_NGHTTP2
+    prpltwtr_h2_close_account(r->account);
+#endif
+    twitter_http_headers_clear(&r->response_headers);
+    if (r->http_cache)
+        prpltwtr_http_cache_free(r->http_cache);
+    if (r->retry)
+        prpltwtr_retry_policy_free(r->retry);
+    if (r->backfill_gaps)
+        g_hash_table_destroy(r->backfill_gaps);
+    if (r->usage)
+        prpltwtr_usage_free(r->usage);
+    if (r->trace)
+        prpltwtr_trace_free(r->trace);
+    if (r->buffers) {
+        guint           allocated;
+        guint           reused;
+
+        twitter_http_buffer_pool_get_stats(r->buffers, &allocated, &reused);
+        purple_debug_info(purple_account_get_protocol_id(r->account), "Request buffers: %u allocated, %u reused\n", allocated, reused);
+        twitter_http_buffer_pool_unref(r->buffers);
     }
     g_free(r->urls);
     g_free(r->format);
@@ -28,6 +28,12 @@
 #include <glib.h>
 #include "prpltwtr_plugin.h"
 #include "prpltwtr_format.h"
+#include "prpltwtr_http.h"
+#include "prpltwtr_httpcache.h"
+#include "prpltwtr_retry.h"
+#include "prpltwtr_scheduler.h"
+#include "prpltwtr_trace.h"
+#include "prpltwtr_usage.h"
 
 typedef struct {
     gchar          *name;
@@ -36,6 +42,12 @@ typedef struct {
 
 typedef struct _TwitterRequestor TwitterRequestor;
 
+/// Identifies a pending request, see twitter_requestor_cancel. Never 0.
+typedef guint   TwitterRequestHandle;
+
+/// The requests of an owner, such as a chat, see twitter_request_scope_new
+typedef struct _TwitterRequestScope TwitterRequestScope;
+
 TwitterRequestParam *twitter_request_param_new(const gchar * name, const gchar * value);
 TwitterRequestParam *twitter_request_param_new_int(const gchar * name, int value);
 TwitterRequestParam *twitter_request_param_new_ll(const gchar * name, long long value);
@@ -64,6 +76,8 @@ typedef struct {
     TwitterRequestErrorType type;
     /*const xmlnode *response_node; */
     const gchar    *message;
+    /* the response's headers, NULL if no response was received */
+    const TwitterHttpHeaders *headers;
 } TwitterRequestErrorData;
 
 typedef void    (*TwitterSendRequestSuccessFunc) (TwitterRequestor * r, const gchar * response, gpointer user_data);
@@ -76,17 +90,61 @@ typedef void    (*TwitterSendFormatRequestSuccessFunc) (TwitterRequestor * r, gp
 
 typedef void    (*TwitterSendRequestErrorFunc) (TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data);
 
+/// Receives the body of a streaming request as it arrives. Chunk boundaries
+/// are arbitrary, they need not line up with anything in the data.
+typedef void    (*TwitterSendRequestChunkFunc) (TwitterRequestor * r, const gchar * chunk, gsize len, gpointer user_data);
+
 struct _TwitterRequestor {
     PurpleAccount  *account;
-    GList          *pending_requests;
+    /* TwitterRequestHandle -> the request, queued in the scheduler or sent */
+    GHashTable     *pending_requests;
+    TwitterRequestHandle last_request_handle;
+    /* "url?params" -> the pending GET identical requests are joined to */
+    GHashTable     *coalescable_requests;
+    /* TwitterRequestHandle of a joined caller -> the request it joined */
+    GHashTable     *follower_handles;
+    guint           requests_coalesced;
+    /* scopes of the account's request owners */
+    GList          *scopes;
+    /* the scope requests sent now belong to, if any */
+    TwitterRequestScope *current_scope;
+    /* set by twitter_requestor_free, nothing more is sent */
+    gboolean        freeing;
+    /* the response being handed to several callers and its parsed form,
+     * so it's only parsed once */
+    const gchar    *shared_response;
+    gpointer        shared_node;
 
     void            (*pre_send) (TwitterRequestor * r, gboolean * post, const char **url, TwitterRequestParams ** params, gchar *** header_fields, gpointer * requestor_data);
                     gpointer(*do_send) (TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+    /* optional, requests are buffered through do_send if not set */
+                    gpointer(*do_send_streaming) (TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+    /* optional, opens a connection ahead of the first request */
+    void            (*do_preconnect) (TwitterRequestor * r);
     void            (*post_send) (TwitterRequestor * r, gboolean * post, const char **url, TwitterRequestParams ** params, gchar *** header_fields, gpointer * requestor_data);
                     gboolean(*pre_failed) (TwitterRequestor * r, const TwitterRequestErrorData ** error_data);
     void            (*post_failed) (TwitterRequestor * r, const TwitterRequestErrorData ** error_data);
     int             rate_limit_total;
     int             rate_limit_remaining;
+    time_t          rate_limit_reset;
+    /* headers of the last response received, for success callbacks and
+     * anyone else interested */
+    TwitterHttpHeaders response_headers;
+    /* recycled buffers for building requests */
+    TwitterHttpBufferPool *buffers;
+    /* responses kept for conditional requests, opened on first use */
+    TwitterHttpCache *http_cache;
+    /* endpoint health, for retries and circuit breaking */
+    TwitterRetryPolicy *retry;
+    /* "url?params" -> GArray of the gaps an _all fetch of it left, for
+     * the next one to fill in */
+    GHashTable     *backfill_gaps;
+    /* bytes sent and received, and the daily budget; see
+     * twitter_requestor_get_usage */
+    TwitterUsage   *usage;
+    /* the trace requests are recorded to or replayed from, if any; see
+     * twitter_requestor_setup_trace */
+    TwitterTrace   *trace;
 
     TwitterUrls    *urls;
     TwitterFormat  *format;
@@ -94,13 +152,16 @@ struct _TwitterRequestor {
 
 void            twitter_requestor_free(TwitterRequestor * requestor);
 
+/// To be called at login, once the backend is set up: resolves the hosts
+/// we'll need and opens a connection to the API host, so the first
+/// requests don't wait on DNS and connecting.
+void            twitter_requestor_warmup(TwitterRequestor * r);
+
 int             xmlnode_child_count(xmlnode * parent);
 
 typedef struct _TwitterMultiPageRequestData TwitterMultiPageRequestData;
-typedef struct _TwitterFormatMultiPageRequestData TwitterFormatMultiPageRequestData;
 
 typedef         gboolean(*TwitterSendRequestMultiPageSuccessFunc) (TwitterRequestor * r, xmlnode * node, gboolean last_page, TwitterMultiPageRequestData * request, gpointer user_data);
-typedef         gboolean(*TwitterSendFormatRequestMultiPageSuccessFunc) (TwitterRequestor * r, gpointer node, gboolean last_page, TwitterFormatMultiPageRequestData * request, gpointer user_data);
 typedef         gboolean(*TwitterSendRequestMultiPageErrorFunc) (TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data);
 typedef         gpointer(*TwitterSendFormatRequestMultipageAllInnerNodeFunc) (TwitterRequestor * r, gpointer node);
 
@@ -115,41 +176,121 @@ struct _TwitterMultiPageRequestData {
     int             expected_count;
 };
 
-struct _TwitterFormatMultiPageRequestData {
-    gpointer        user_data;
-    char           *url;
-    //char *query_string;
-    TwitterRequestParams *params;
-    TwitterSendFormatRequestMultiPageSuccessFunc success_callback;
-    TwitterSendRequestMultiPageErrorFunc error_callback;
-    TwitterSendFormatRequestMultipageAllInnerNodeFunc inner_node_cb;
-    int             page;
-    int             expected_count;
-};
-
 typedef void    (*TwitterSendRequestMultiPageAllSuccessFunc) (TwitterRequestor * r, GList * nodes, gpointer user_data);
 typedef void    (*TwitterSendFormatRequestMultiPageAllSuccessFunc) (TwitterRequestor * r, GList * nodes, gpointer user_data);
 typedef         gboolean(*TwitterSendRequestMultiPageAllErrorFunc) (TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data);
+/// Receives a page of a cursored listing. Return FALSE to stop there.
+typedef         gboolean(*TwitterSendRequestCursorPageFunc) (TwitterRequestor * r, gpointer node, gpointer user_data);
+typedef void    (*TwitterSendRequestCursorDoneFunc) (TwitterRequestor * r, gpointer user_data);
 
 void            prpltwtr_requestor_post_failed(TwitterRequestor * r, const TwitterRequestErrorData ** error_data);
+/// The scheduling class of a request, derived from its endpoint
+TwitterRequestPriority twitter_requestor_get_priority(TwitterRequestor * r, gboolean post, const char *url);
+/// What a request's bytes are counted as, derived from its endpoint
+TwitterUsageClass twitter_requestor_get_usage_class(TwitterRequestor * r, gboolean post, const char *url);
+/// The account's data usage, created on first use
+TwitterUsage   *twitter_requestor_get_usage(TwitterRequestor * r);
 gpointer        twitter_requestor_send(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+/// do_preconnect for twitter_requestor_send
+void            twitter_requestor_preconnect(TwitterRequestor * r);
+
+/// do_send/do_send_streaming backends built on GIO instead of libpurple's
+/// SSL code. They still go through the account's proxy
+gpointer        twitter_requestor_send_gio(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+gpointer        twitter_requestor_send_gio_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+
+#ifdef HAVE_NGHTTP2
+/// do_send/do_send_streaming backends multiplexing all of an account's
+/// requests on one HTTP/2 connection per host, weighted by priority
+void            twitter_requestor_preconnect_h2(TwitterRequestor * r);
+gpointer        twitter_requestor_send_h2(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+gpointer        twitter_requestor_send_h2_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+#endif
 
-void            twitter_send_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
-
-void            twitter_send_xml_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendXmlRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
-
-void            twitter_send_format_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+/// do_send backend serving the responses of the requestor's trace
+gpointer        twitter_requestor_send_replay(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, char **header_fields, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+
+/// To be called at login, once the backend is set up: records the
+/// account's requests and responses to a trace, or replays them from one
+/// in place of the backend, as the trace mode option says. Either way,
+/// streams are polled for instead.
+void            twitter_requestor_setup_trace(TwitterRequestor * r);
+
+/// Cancels a pending request. Its error callback is called once, with
+/// TWITTER_REQUEST_ERROR_CANCELED, before this returns, and its success
+/// callback never is. Returns FALSE if the request already completed.
+gboolean        twitter_requestor_cancel(TwitterRequestor * r, TwitterRequestHandle handle);
+gboolean        twitter_requestor_is_pending(TwitterRequestor * r, TwitterRequestHandle handle);
+guint           twitter_requestor_pending_count(TwitterRequestor * r);
+/// Frees the scheduler slot of a sent request that will stay open (a
+/// stream), so it doesn't hold up the requests queued behind it
+void            twitter_requestor_release_slot(TwitterRequestor * r, TwitterRequestHandle handle);
+
+/// Creates a scope for the requests of an owner that may go away before
+/// they complete, such as a chat. Free it along with the owner.
+TwitterRequestScope *twitter_request_scope_new(TwitterRequestor * r);
+
+/// Makes requests sent from now on, until twitter_request_scope_leave,
+/// belong to scope (none if NULL). Returns the scope to restore.
+TwitterRequestScope *twitter_request_scope_enter(TwitterRequestor * r, TwitterRequestScope * scope);
+void            twitter_request_scope_leave(TwitterRequestor * r, TwitterRequestScope * previous);
+
+/// Counts the bytes of the scope's requests under label, rather than under
+/// their class's name (see TwitterUsage)
+void            twitter_request_scope_set_label(TwitterRequestScope * scope, const gchar * label);
+
+/// Cancels the scope's pending requests, as twitter_requestor_cancel does,
+/// and frees it. A request other callers joined goes on for them.
+void            twitter_request_scope_free(TwitterRequestScope * scope);
+
+/// Queues the request in the scheduler, which sends it once the account and
+/// host have a free slot. A GET with the same url and params as one still
+/// pending isn't sent again: the caller gets that one's response. Returns a handle for cancelling it, or 0 if
+/// nothing was sent. Exactly one of the callbacks is called, and never
+/// before this returns. params are copied.
+TwitterRequestHandle twitter_send_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+
+/// Like twitter_send_request, but the body of a successful response is
+/// handed to chunk_callback as it arrives. success_callback is then called
+/// with an empty response. Error responses go to error_callback as usual.
+TwitterRequestHandle twitter_send_request_streaming(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendRequestChunkFunc chunk_callback, TwitterSendRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+
+TwitterRequestHandle twitter_send_xml_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendXmlRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
+
+TwitterRequestHandle twitter_send_format_request(TwitterRequestor * r, gboolean post, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestSuccessFunc success_callback, TwitterSendRequestErrorFunc error_callback, gpointer data);
 
 //don't include count in the query_string
 void            twitter_send_xml_request_multipage_all(TwitterRequestor * r, const char *url, TwitterRequestParams * params, TwitterSendRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, int expected_count, gint max_count, gpointer data);
 
+/* Windows an _all fetch's gap is walked in at a time */
+#define TWITTER_BACKFILL_MAX_WINDOWS 3
+/* Requests of an endpoint's rate limit backfilling leaves for everything
+ * else */
+#define TWITTER_BACKFILL_RATE_RESERVE 10
+/* Gaps kept for the next _all fetch of a request, the oldest are given up */
+#define TWITTER_BACKFILL_MAX_GAPS 4
+
+/// Fetches everything newer than the since_id in params, expected_count at
+/// a time. A page that comes back full leaves a gap back to since_id,
+/// which is walked backwards in max_id windows, several at once if the
+/// endpoint's rate limit allows. The statuses are handed over together,
+/// oldest first. A gap the rate limit leaves no room for is left for the
+/// next fetch of the same request, which asks for it along with what's
+/// new. With max_count, no more are fetched once that many have been, and
+/// only the newest max_count of those without a gap among them are handed
+/// over.
 void            twitter_send_format_request_multipage_all(TwitterRequestor * r, const char *url, TwitterRequestParams * params, TwitterSendFormatRequestMultipageAllInnerNodeFunc inner_node_cb, TwitterSendFormatRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, int expected_count, gint max_count, gpointer data);
 
 /* statuses/friends API deprecated page based retrieval,
  * and use cursor based method instead */
 void            twitter_send_xml_request_with_cursor(TwitterRequestor * r, const char *url, TwitterRequestParams * params, gchar * cursor, TwitterSendRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, gpointer data);
 
-void            twitter_send_format_request_with_cursor(TwitterRequestor * r, const char *url, TwitterRequestParams * params, long long cursor, TwitterSendRequestMultiPageAllSuccessFunc success_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, gpointer data);
+/// Fetches every page of a cursored listing, starting at cursor. Each page
+/// is handed to page_callback (the node is only valid during the call) as
+/// it comes in, after the next one has been asked for, and done_callback
+/// is called after the last. error_callback returning TRUE asks for the
+/// failed page again.
+void            twitter_send_format_request_with_cursor(TwitterRequestor * r, const char *url, TwitterRequestParams * params, long long cursor, TwitterSendRequestCursorPageFunc page_callback, TwitterSendRequestCursorDoneFunc done_callback, TwitterSendRequestMultiPageAllErrorFunc error_callback, gpointer data);
 
 TwitterRequestParams *twitter_request_params_add_oauth_params(PurpleAccount * account, gboolean post, const gchar * url, const TwitterRequestParams * params, const gchar * token, const gchar * signing_key);
 
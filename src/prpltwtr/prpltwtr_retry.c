@@ -0,0 +1,200 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <time.h>
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+
+#include "prpltwtr_retry.h"
+
+typedef struct {
+    guint           failures;                    /* consecutive server errors */
+    time_t          open_until;                  /* rejecting requests until then, once failures reach the threshold */
+    guint           cooldown;                    /* seconds it stays open next time */
+    gboolean        probing;                     /* half open, one request is testing it */
+    time_t          rate_limited_until;
+    gint            rate_limit_remaining;        /* as of the last response */
+    time_t          rate_limit_reset;            /* 0 if no response said */
+} TwitterEndpointHealth;
+
+struct _TwitterRetryPolicy {
+    /* key: endpoint, value: TwitterEndpointHealth */
+    GHashTable     *endpoints;
+    guint           retries;
+    guint           rejected;
+    guint           circuits_opened;
+};
+
+TwitterRetryPolicy *prpltwtr_retry_policy_new(void)
+{
+    TwitterRetryPolicy *policy = g_new0(TwitterRetryPolicy, 1);
+    policy->endpoints = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    return policy;
+}
+
+void prpltwtr_retry_policy_free(TwitterRetryPolicy * policy)
+{
+    g_hash_table_destroy(policy->endpoints);
+    g_free(policy);
+}
+
+static TwitterEndpointHealth *retry_endpoint_get(TwitterRetryPolicy * policy, const gchar * endpoint)
+{
+    TwitterEndpointHealth *health = g_hash_table_lookup(policy->endpoints, endpoint);
+
+    if (!health) {
+        health = g_new0(TwitterEndpointHealth, 1);
+        health->cooldown = TWITTER_CIRCUIT_COOLDOWN;
+        g_hash_table_insert(policy->endpoints, g_strdup(endpoint), health);
+    }
+    return health;
+}
+
+TwitterRetryAdmission prpltwtr_retry_admit(TwitterRetryPolicy * policy, const gchar * endpoint)
+{
+    TwitterEndpointHealth *health = g_hash_table_lookup(policy->endpoints, endpoint);
+    time_t          now = time(NULL);
+
+    if (!health)
+        return TWITTER_RETRY_ALLOW;
+    if (health->rate_limited_until > now)
+        return TWITTER_RETRY_RATE_LIMITED;
+    if (health->failures < TWITTER_CIRCUIT_FAILURES)
+        return TWITTER_RETRY_ALLOW;
+    if (health->open_until > now || health->probing)
+        return TWITTER_RETRY_CIRCUIT_OPEN;
+
+    /* Cooled down: let one request through to see if it's back */
+    health->probing = TRUE;
+    return TWITTER_RETRY_PROBE;
+}
+
+void prpltwtr_retry_record(TwitterRetryPolicy * policy, const gchar * endpoint, gint status_code, time_t retry_at, time_t rate_limited_until)
+{
+    TwitterEndpointHealth *health = retry_endpoint_get(policy, endpoint);
+    time_t          now = time(NULL);
+
+    health->probing = FALSE;
+    if (rate_limited_until > now)
+        health->rate_limited_until = rate_limited_until;
+
+    /* Anything but a server error means the endpoint is up */
+    if (status_code != 0 && status_code < 500) {
+        if (health->failures >= TWITTER_CIRCUIT_FAILURES)
+            purple_debug_info(GENERIC_PROTOCOL_ID, "Circuit for %s closed\n", endpoint);
+        health->failures = 0;
+        health->cooldown = TWITTER_CIRCUIT_COOLDOWN;
+        return;
+    }
+
+    if (++health->failures < TWITTER_CIRCUIT_FAILURES)
+        return;
+
+    if (health->failures > TWITTER_CIRCUIT_FAILURES) {
+        /* The probe failed, stay away longer */
+        health->cooldown = MIN(health->cooldown * 2, TWITTER_CIRCUIT_MAX_COOLDOWN);
+    } else {
+        policy->circuits_opened++;
+    }
+    health->open_until = MAX(now + health->cooldown, retry_at);
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Circuit for %s open for %ld seconds after %u failures\n", endpoint, (long) (health->open_until - now), health->failures);
+}
+
+void prpltwtr_retry_record_rate_limit(TwitterRetryPolicy * policy, const gchar * endpoint, gint remaining, time_t reset)
+{
+    TwitterEndpointHealth *health = retry_endpoint_get(policy, endpoint);
+
+    health->rate_limit_remaining = remaining;
+    health->rate_limit_reset = reset;
+}
+
+gint prpltwtr_retry_rate_limit_remaining(TwitterRetryPolicy * policy, const gchar * endpoint)
+{
+    TwitterEndpointHealth *health = g_hash_table_lookup(policy->endpoints, endpoint);
+
+    if (!health || health->rate_limit_reset <= time(NULL))
+        return -1;
+    return health->rate_limit_remaining;
+}
+
+void prpltwtr_retry_probe_cancelled(TwitterRetryPolicy * policy, const gchar * endpoint)
+{
+    TwitterEndpointHealth *health = g_hash_table_lookup(policy->endpoints, endpoint);
+
+    if (health)
+        health->probing = FALSE;
+}
+
+void prpltwtr_retry_count(TwitterRetryPolicy * policy, gboolean rejected)
+{
+    if (rejected)
+        policy->rejected++;
+    else
+        policy->retries++;
+}
+
+gboolean prpltwtr_retry_is_transient(gint status_code)
+{
+    return status_code == 0 || status_code == 429 || status_code >= 500;
+}
+
+guint prpltwtr_retry_delay(guint attempt, time_t retry_at)
+{
+    guint           delay = TWITTER_RETRY_BASE_DELAY * 1000 << MIN(attempt, 10);
+    time_t          now = time(NULL);
+
+    delay = MIN(delay, TWITTER_RETRY_MAX_DELAY * 1000);
+    /* Half fixed, half random, so clients that failed together spread out */
+    delay = delay / 2 + g_random_int_range(0, delay / 2 + 1);
+
+    if (retry_at > now) {
+        if (retry_at - now > TWITTER_RETRY_MAX_DELAY)
+            return 0;
+        delay = MAX(delay, (guint) (retry_at - now) * 1000);
+    }
+    return delay;
+}
+
+void prpltwtr_retry_get_stats(TwitterRetryPolicy * policy, TwitterRetryStats * stats)
+{
+    GHashTableIter  iter;
+    gpointer        value;
+    time_t          now = time(NULL);
+
+    stats->retries = policy->retries;
+    stats->rejected = policy->rejected;
+    stats->circuits_opened = policy->circuits_opened;
+    stats->circuits_open = 0;
+
+    g_hash_table_iter_init(&iter, policy->endpoints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        TwitterEndpointHealth *health = value;
+        if (health->failures >= TWITTER_CIRCUIT_FAILURES && (health->open_until > now || health->probing))
+            stats->circuits_open++;
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_RETRY_H_
+#define _TWITTER_RETRY_H_
+
+#include <time.h>
+#include <glib.h>
+
+/* A failed GET is sent again up to this many times */
+#define TWITTER_RETRY_MAX_ATTEMPTS 3
+/* Backoff before the first retry, doubled for each one after (seconds) */
+#define TWITTER_RETRY_BASE_DELAY 2
+/* Longest backoff. A server asking us to wait longer gets an error instead */
+#define TWITTER_RETRY_MAX_DELAY 60
+
+/* Consecutive server errors that open an endpoint's circuit */
+#define TWITTER_CIRCUIT_FAILURES 5
+/* How long an open circuit rejects requests, doubled each time it
+ * reopens (seconds) */
+#define TWITTER_CIRCUIT_COOLDOWN 30
+#define TWITTER_CIRCUIT_MAX_COOLDOWN 900
+
+typedef struct _TwitterRetryPolicy TwitterRetryPolicy;
+
+typedef enum {
+    TWITTER_RETRY_ALLOW,                         /* send it */
+    TWITTER_RETRY_PROBE,                         /* send it, it tests a half-open circuit */
+    TWITTER_RETRY_CIRCUIT_OPEN,                  /* fail it, the endpoint keeps erroring */
+    TWITTER_RETRY_RATE_LIMITED                   /* fail it, the endpoint's window is used up */
+} TwitterRetryAdmission;
+
+typedef struct {
+    guint           retries;                     /* requests sent again after a failure */
+    guint           rejected;                    /* requests failed without being sent */
+    guint           circuits_opened;
+    guint           circuits_open;               /* endpoints rejecting requests now */
+} TwitterRetryStats;
+
+/// Tracks the health of an account's endpoints (urls without params)
+TwitterRetryPolicy *prpltwtr_retry_policy_new(void);
+void            prpltwtr_retry_policy_free(TwitterRetryPolicy * policy);
+
+/// Decides whether a request to endpoint may be sent now. A request
+/// admitted as TWITTER_RETRY_PROBE must be reported to
+/// prpltwtr_retry_record or prpltwtr_retry_probe_cancelled.
+TwitterRetryAdmission prpltwtr_retry_admit(TwitterRetryPolicy * policy, const gchar * endpoint);
+
+/// Records how a request to endpoint went: the HTTP status, or 0 if no
+/// response came. retry_at is when the server said to try again (0 if it
+/// didn't), and rate_limited_until when the endpoint's rate limit window
+/// resets if it's used up.
+void            prpltwtr_retry_record(TwitterRetryPolicy * policy, const gchar * endpoint, gint status_code, time_t retry_at, time_t rate_limited_until);
+
+/// Records the endpoint's rate limit from a response's headers: the
+/// requests left in its window, and when the window resets.
+void            prpltwtr_retry_record_rate_limit(TwitterRetryPolicy * policy, const gchar * endpoint, gint remaining, time_t reset);
+
+/// The requests left in the endpoint's rate limit window, or -1 if that
+/// isn't known or the window has reset since
+gint            prpltwtr_retry_rate_limit_remaining(TwitterRetryPolicy * policy, const gchar * endpoint);
+
+void            prpltwtr_retry_probe_cancelled(TwitterRetryPolicy * policy, const gchar * endpoint);
+
+/// Counts a request sent again, or failed without being sent
+void            prpltwtr_retry_count(TwitterRetryPolicy * policy, gboolean rejected);
+
+/// Whether a failure with this status (0: no response) may go away by itself
+gboolean        prpltwtr_retry_is_transient(gint status_code);
+
+/// Returns the wait before retry number attempt (from 0), in milliseconds:
+/// exponential backoff with jitter, and no earlier than retry_at if set.
+/// Returns 0 if retry_at is further than TWITTER_RETRY_MAX_DELAY away.
+guint           prpltwtr_retry_delay(guint attempt, time_t retry_at);
+
+void            prpltwtr_retry_get_stats(TwitterRetryPolicy * policy, TwitterRetryStats * stats);
+
+#endif
@@ -0,0 +1,302 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+
+#include "prpltwtr_prefs.h"
+#include "prpltwtr_scheduler.h"
+
+typedef struct {
+    PurpleAccount  *account;
+    guint           running;
+    GQueue          queued[TWITTER_REQUEST_PRIORITY_COUNT];
+} TwitterSchedulerAccount;
+
+struct _TwitterSchedulerJob {
+    TwitterSchedulerAccount *owner;
+    gchar          *host;
+    TwitterRequestPriority priority;
+    gboolean        running;
+    gint64          queued_at;                   /* monotonic time, microseconds */
+
+    TwitterSchedulerStartFunc start_func;
+    TwitterSchedulerDropFunc drop_func;
+    gpointer        user_data;
+};
+
+/* Accounts with queued or running jobs, in the order they get their turn */
+static GList   *scheduler_accounts = NULL;
+/* key: host, value: jobs running against it, all accounts together */
+static GHashTable *host_running = NULL;
+static TwitterSchedulerClassStats class_stats[TWITTER_REQUEST_PRIORITY_COUNT];
+static gboolean dispatching = FALSE;
+static gboolean dispatch_again = FALSE;
+
+static const gchar *priority_names[TWITTER_REQUEST_PRIORITY_COUNT] = {
+    N_("Sends and lookups"),
+    N_("Mentions and DMs"),
+    N_("Timeline"),
+    N_("Lists and searches"),
+    N_("Icons and background"),
+};
+
+static TwitterSchedulerAccount *scheduler_account_find(PurpleAccount * account)
+{
+    GList          *l;
+
+    for (l = scheduler_accounts; l; l = l->next) {
+        TwitterSchedulerAccount *sa = l->data;
+        if (sa->account == account)
+            return sa;
+    }
+    return NULL;
+}
+
+static TwitterSchedulerAccount *scheduler_account_get(PurpleAccount * account)
+{
+    TwitterSchedulerAccount *sa = scheduler_account_find(account);
+    int             i;
+
+    if (sa)
+        return sa;
+    sa = g_new0(TwitterSchedulerAccount, 1);
+    sa->account = account;
+    for (i = 0; i < TWITTER_REQUEST_PRIORITY_COUNT; i++)
+        g_queue_init(&sa->queued[i]);
+    scheduler_accounts = g_list_append(scheduler_accounts, sa);
+    return sa;
+}
+
+/// Forgets the account once it has nothing queued or running
+static void scheduler_account_release(TwitterSchedulerAccount * sa)
+{
+    int             i;
+
+    if (sa->running)
+        return;
+    for (i = 0; i < TWITTER_REQUEST_PRIORITY_COUNT; i++)
+        if (!g_queue_is_empty(&sa->queued[i]))
+            return;
+    scheduler_accounts = g_list_remove(scheduler_accounts, sa);
+    g_free(sa);
+}
+
+static guint scheduler_host_running(const gchar * host)
+{
+    return host && host_running ? GPOINTER_TO_UINT(g_hash_table_lookup(host_running, host)) : 0;
+}
+
+static void scheduler_host_add(const gchar * host, gint delta)
+{
+    guint           count;
+
+    if (!host)
+        return;
+    if (!host_running)
+        host_running = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    count = scheduler_host_running(host) + delta;
+    if (count)
+        g_hash_table_insert(host_running, g_strdup(host), GUINT_TO_POINTER(count));
+    else
+        g_hash_table_remove(host_running, host);
+}
+
+static void scheduler_job_free(TwitterSchedulerJob * job)
+{
+    g_free(job->host);
+    g_free(job);
+}
+
+/// Returns the first of the account's jobs of that priority whose host has
+/// a free slot
+static GList   *scheduler_account_next(TwitterSchedulerAccount * sa, TwitterRequestPriority priority)
+{
+    GList          *l;
+
+    for (l = sa->queued[priority].head; l; l = l->next) {
+        TwitterSchedulerJob *job = l->data;
+        if (!job->host || scheduler_host_running(job->host) < twitter_option_max_host_requests(sa->account))
+            return l;
+    }
+    return NULL;
+}
+
+static void scheduler_job_start(TwitterSchedulerAccount * sa, GList * link)
+{
+    TwitterSchedulerJob *job = link->data;
+    TwitterSchedulerClassStats *stats = &class_stats[job->priority];
+    guint           wait_ms = (g_get_monotonic_time() - job->queued_at) / 1000;
+
+    g_queue_delete_link(&sa->queued[job->priority], link);
+    job->running = TRUE;
+    sa->running++;
+    scheduler_host_add(job->host, 1);
+
+    stats->queued--;
+    stats->running++;
+    stats->started++;
+    stats->wait_total_ms += wait_ms;
+    if (wait_ms > stats->wait_max_ms)
+        stats->wait_max_ms = wait_ms;
+
+    /* Its turn is used up, the other accounts go first next time */
+    scheduler_accounts = g_list_remove(scheduler_accounts, sa);
+    scheduler_accounts = g_list_append(scheduler_accounts, sa);
+
+    /* May call prpltwtr_scheduler_job_done before returning */
+    job->start_func(job, job->user_data);
+}
+
+/// Starts queued jobs while there are free slots
+static void scheduler_dispatch(void)
+{
+    int             priority;
+    GList          *l;
+
+    /* Starting a job can submit or finish others */
+    if (dispatching) {
+        dispatch_again = TRUE;
+        return;
+    }
+    dispatching = TRUE;
+    do {
+        dispatch_again = FALSE;
+        for (priority = 0; priority < TWITTER_REQUEST_PRIORITY_COUNT && !dispatch_again; priority++) {
+            for (l = scheduler_accounts; l; l = l->next) {
+                TwitterSchedulerAccount *sa = l->data;
+                GList          *next;
+
+                if (sa->running >= twitter_option_max_requests(sa->account))
+                    continue;
+                if ((next = scheduler_account_next(sa, priority))) {
+                    scheduler_job_start(sa, next);
+                    /* The account list changed, look again from the top */
+                    dispatch_again = TRUE;
+                    break;
+                }
+            }
+        }
+    } while (dispatch_again);
+    dispatching = FALSE;
+}
+
+TwitterSchedulerJob *prpltwtr_scheduler_submit(PurpleAccount * account, const gchar * host, TwitterRequestPriority priority, TwitterSchedulerStartFunc start_func, TwitterSchedulerDropFunc drop_func, gpointer user_data)
+{
+    TwitterSchedulerAccount *sa;
+    TwitterSchedulerJob *job;
+
+    g_return_val_if_fail(priority < TWITTER_REQUEST_PRIORITY_COUNT, NULL);
+
+    sa = scheduler_account_get(account);
+    job = g_new0(TwitterSchedulerJob, 1);
+    job->owner = sa;
+    job->host = g_strdup(host);
+    job->priority = priority;
+    job->queued_at = g_get_monotonic_time();
+    job->start_func = start_func;
+    job->drop_func = drop_func;
+    job->user_data = user_data;
+
+    g_queue_push_tail(&sa->queued[priority], job);
+    class_stats[priority].queued++;
+    scheduler_dispatch();
+    return job;
+}
+
+void prpltwtr_scheduler_job_done(TwitterSchedulerJob * job)
+{
+    TwitterSchedulerAccount *sa = job->owner;
+
+    g_return_if_fail(job->running);
+
+    sa->running--;
+    scheduler_host_add(job->host, -1);
+    class_stats[job->priority].running--;
+    scheduler_job_free(job);
+    scheduler_account_release(sa);
+    scheduler_dispatch();
+}
+
+gboolean prpltwtr_scheduler_job_cancel(TwitterSchedulerJob * job)
+{
+    TwitterSchedulerAccount *sa;
+
+    g_return_val_if_fail(job != NULL, FALSE);
+
+    sa = job->owner;
+    if (job->running)
+        return FALSE;
+    g_queue_remove(&sa->queued[job->priority], job);
+    class_stats[job->priority].queued--;
+    scheduler_job_free(job);
+    scheduler_account_release(sa);
+    return TRUE;
+}
+
+void prpltwtr_scheduler_drop_account(PurpleAccount * account)
+{
+    TwitterSchedulerAccount *sa = scheduler_account_find(account);
+    GList          *dropped = NULL;
+    GList          *l;
+    int             i;
+
+    if (!sa)
+        return;
+
+    /* Take them all out first, a drop function may submit new jobs */
+    for (i = 0; i < TWITTER_REQUEST_PRIORITY_COUNT; i++) {
+        TwitterSchedulerJob *job;
+        while ((job = g_queue_pop_head(&sa->queued[i]))) {
+            class_stats[i].queued--;
+            dropped = g_list_prepend(dropped, job);
+        }
+    }
+    purple_debug_info(GENERIC_PROTOCOL_ID, "Dropping %u queued requests of %s\n", g_list_length(dropped), purple_account_get_username(account));
+    scheduler_account_release(sa);
+
+    dropped = g_list_reverse(dropped);
+    for (l = dropped; l; l = l->next) {
+        TwitterSchedulerJob *job = l->data;
+        if (job->drop_func)
+            job->drop_func(job->user_data);
+        scheduler_job_free(job);
+    }
+    g_list_free(dropped);
+}
+
+const gchar    *prpltwtr_scheduler_priority_name(TwitterRequestPriority priority)
+{
+    g_return_val_if_fail(priority < TWITTER_REQUEST_PRIORITY_COUNT, NULL);
+    return _(priority_names[priority]);
+}
+
+void prpltwtr_scheduler_get_stats(TwitterRequestPriority priority, TwitterSchedulerClassStats * stats)
+{
+    g_return_if_fail(priority < TWITTER_REQUEST_PRIORITY_COUNT);
+    *stats = class_stats[priority];
+}
@@ -0,0 +1,81 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_SCHEDULER_H_
+#define _TWITTER_SCHEDULER_H_
+
+#include <glib.h>
+#include <account.h>
+
+/// How much a request matters to the user, most important first. The
+/// scheduler starts queued requests in this order.
+typedef enum {
+    TWITTER_REQUEST_PRIORITY_USER,               /* things the user did or waits on: posting, login, lookups */
+    TWITTER_REQUEST_PRIORITY_MENTIONS,           /* mentions and DMs */
+    TWITTER_REQUEST_PRIORITY_TIMELINE,           /* the home timeline */
+    TWITTER_REQUEST_PRIORITY_CHAT,               /* lists and searches */
+    TWITTER_REQUEST_PRIORITY_BACKGROUND,         /* icons, friends, filling in details */
+    TWITTER_REQUEST_PRIORITY_COUNT
+} TwitterRequestPriority;
+
+typedef struct _TwitterSchedulerJob TwitterSchedulerJob;
+
+/// Starts the job's request. Once it has finished (or failed to start),
+/// call prpltwtr_scheduler_job_done.
+typedef void    (*TwitterSchedulerStartFunc) (TwitterSchedulerJob * job, gpointer user_data);
+
+/// Called for a job dropped before it started, to free user_data
+typedef void    (*TwitterSchedulerDropFunc) (gpointer user_data);
+
+typedef struct {
+    guint           queued;                      /* jobs waiting for a slot */
+    guint           running;                     /* jobs started and not done yet */
+    guint           started;                     /* jobs started so far */
+    guint64         wait_total_ms;               /* time the started jobs spent queued */
+    guint           wait_max_ms;                 /* longest time a job spent queued */
+} TwitterSchedulerClassStats;
+
+/// Queues a job for the account. It's started, possibly before this
+/// returns, once the account has fewer than twitter_option_max_requests
+/// jobs running and host (if not NULL) fewer than
+/// twitter_option_max_host_requests, counting every account. Higher
+/// priorities go first; accounts take turns within a priority.
+TwitterSchedulerJob *prpltwtr_scheduler_submit(PurpleAccount * account, const gchar * host, TwitterRequestPriority priority, TwitterSchedulerStartFunc start_func, TwitterSchedulerDropFunc drop_func, gpointer user_data);
+
+/// Frees the job's slot for the next one. The job is freed.
+void            prpltwtr_scheduler_job_done(TwitterSchedulerJob * job);
+
+/// Removes a job that hasn't started yet and frees it, without calling its
+/// drop function. Returns FALSE, doing nothing, if it's already running.
+gboolean        prpltwtr_scheduler_job_cancel(TwitterSchedulerJob * job);
+
+/// Drops the account's queued jobs, calling their drop functions. Running
+/// jobs are left to finish.
+void            prpltwtr_scheduler_drop_account(PurpleAccount * account);
+
+const gchar    *prpltwtr_scheduler_priority_name(TwitterRequestPriority priority);
+
+void            prpltwtr_scheduler_get_stats(TwitterRequestPriority priority, TwitterSchedulerClassStats * stats);
+
+#endif
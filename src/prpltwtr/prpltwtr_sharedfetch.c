@@ -0,0 +1,331 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+
+#include "prpltwtr_conn.h"
+#include "prpltwtr_prefs.h"
+#include "prpltwtr_sharedfetch.h"
+#include "prpltwtr_xml.h"
+
+typedef struct {
+    PurpleAccount  *account;
+    gchar          *since_id;                    /* NULL for the latest */
+    TwitterSharedFetchSuccessFunc success_func;
+    TwitterSendRequestMultiPageAllErrorFunc error_func;
+    gpointer        data;
+} TwitterSharedFetchSubscriber;
+
+typedef struct _TwitterSharedFetch TwitterSharedFetch;
+
+/* What a fetch's request calls back with. It outlives the fetch if the
+ * request is abandoned */
+typedef struct {
+    TwitterSharedFetch *fetch;                   /* NULL once abandoned */
+} TwitterSharedFetchAttempt;
+
+struct _TwitterSharedFetch {
+    gchar          *key;                         /* NULL for a fetch that isn't shared */
+    gchar          *since_id;                    /* what it was last fetched since, NULL for the latest */
+    GList          *nodes;                       /* the pages it returned, copied */
+    TwitterFormatFromNodeFunc free_node;
+    time_t          fetched_at;
+    time_t          last_used;
+    gboolean        fetching;
+    GList          *subscribers;                 /* TwitterSharedFetchSubscriber, waiting for it */
+    guint           deliver_timer;
+
+    /* how it's fetched, to send it again through another account */
+    TwitterSharedFetchFunc fetch_func;
+    gchar          *query;
+    gint            max_count;
+    PurpleAccount  *account;                     /* whose requestor it's being fetched through */
+    TwitterSharedFetchAttempt *attempt;          /* while fetching */
+};
+
+/* key: TwitterSharedFetch, across all accounts */
+static GHashTable *shared_fetches = NULL;
+
+/// Compares status ids, which are numbers too long for a gint64 to be sure
+static gint sharedfetch_id_compare(const gchar * a, const gchar * b)
+{
+    gsize           a_len = strlen(a);
+    gsize           b_len = strlen(b);
+
+    if (a_len != b_len)
+        return a_len < b_len ? -1 : 1;
+    return strcmp(a, b);
+}
+
+/// Whether what was fetched since fetch_since_id has all that's newer
+/// than since_id
+static gboolean sharedfetch_covers(const gchar * fetch_since_id, const gchar * since_id)
+{
+    if (!fetch_since_id)
+        return !since_id;
+    return since_id && sharedfetch_id_compare(since_id, fetch_since_id) >= 0;
+}
+
+static void sharedfetch_free_nodes(TwitterSharedFetch * fetch)
+{
+    GList          *l;
+
+    for (l = fetch->nodes; l; l = l->next)
+        fetch->free_node(l->data);
+    g_list_free(fetch->nodes);
+    fetch->nodes = NULL;
+}
+
+static void sharedfetch_free(TwitterSharedFetch * fetch)
+{
+    if (fetch->deliver_timer)
+        purple_timeout_remove(fetch->deliver_timer);
+    if (fetch->attempt)
+        fetch->attempt->fetch = NULL;
+    sharedfetch_free_nodes(fetch);
+    g_free(fetch->key);
+    g_free(fetch->since_id);
+    g_free(fetch->query);
+    g_free(fetch);
+}
+
+static void sharedfetch_subscriber_free(TwitterSharedFetchSubscriber * subscriber)
+{
+    g_free(subscriber->since_id);
+    g_free(subscriber);
+}
+
+static gboolean sharedfetch_is_unused(gpointer key, gpointer value, gpointer user_data)
+{
+    TwitterSharedFetch *fetch = value;
+
+    return !fetch->fetching && !fetch->subscribers && *(time_t *) user_data - fetch->last_used > TWITTER_SHAREDFETCH_KEEP;
+}
+
+/// Hands the subscriber the statuses newer than its since_id
+static void sharedfetch_deliver(TwitterSharedFetch * fetch, TwitterSharedFetchSubscriber * subscriber)
+{
+    TwitterRequestor *r = purple_account_get_requestor(subscriber->account);
+    GList          *statuses = twitter_statuses_nodes_parse(r, fetch->nodes);
+    GList          *l = statuses;
+
+    while (l) {
+        TwitterUserTweet *user_tweet = l->data;
+        GList          *next = l->next;
+
+        if (subscriber->since_id && (!user_tweet->status || !user_tweet->status->id || sharedfetch_id_compare(user_tweet->status->id, subscriber->since_id) <= 0)) {
+            twitter_user_tweet_free(user_tweet);
+            statuses = g_list_delete_link(statuses, l);
+        }
+        l = next;
+    }
+    subscriber->success_func(r, statuses, subscriber->data);
+}
+
+/// Delivers to the subscribers waiting for the fetch, and frees it if it
+/// wasn't shared
+static void sharedfetch_done(TwitterSharedFetch * fetch, const TwitterRequestErrorData * error_data)
+{
+    GList          *subscribers = fetch->subscribers;
+    GList          *l;
+
+    /* Those asking from here on start a list of their own */
+    fetch->subscribers = NULL;
+    for (l = subscribers; l; l = l->next) {
+        TwitterSharedFetchSubscriber *subscriber = l->data;
+
+        if (error_data)
+            subscriber->error_func(purple_account_get_requestor(subscriber->account), error_data, subscriber->data);
+        else
+            sharedfetch_deliver(fetch, subscriber);
+        sharedfetch_subscriber_free(subscriber);
+    }
+    g_list_free(subscribers);
+
+    if (!fetch->key)
+        sharedfetch_free(fetch);
+}
+
+static void sharedfetch_success_cb(TwitterRequestor * r, GList * nodes, gpointer user_data)
+{
+    TwitterSharedFetchAttempt *attempt = user_data;
+    TwitterSharedFetch *fetch = attempt->fetch;
+    GList          *l;
+
+    g_free(attempt);
+    if (!fetch)
+        return;
+    fetch->attempt = NULL;
+
+    sharedfetch_free_nodes(fetch);
+    for (l = nodes; l; l = l->next)
+        fetch->nodes = g_list_append(fetch->nodes, r->format->copy_node(l->data));
+    fetch->free_node = r->format->free_node;
+    fetch->fetched_at = time(NULL);
+    fetch->fetching = FALSE;
+    if (g_list_length(fetch->subscribers) > 1)
+        purple_debug_info(purple_account_get_protocol_id(r->account), "Shared %s between %u chats\n", fetch->key, g_list_length(fetch->subscribers));
+    sharedfetch_done(fetch, NULL);
+}
+
+static gboolean sharedfetch_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterSharedFetchAttempt *attempt = user_data;
+    TwitterSharedFetch *fetch = attempt->fetch;
+
+    g_free(attempt);
+    if (!fetch)
+        return FALSE;
+    fetch->attempt = NULL;
+
+    fetch->fetching = FALSE;
+    sharedfetch_done(fetch, error_data);
+    return FALSE;                                /* The chats poll again */
+}
+
+/// Sends the fetch through r's account. Not on behalf of the chat that
+/// happened to ask first: closing it mustn't cancel the others' fetch
+static void sharedfetch_start(TwitterSharedFetch * fetch, TwitterRequestor * r)
+{
+    TwitterRequestScope *previous_scope = twitter_request_scope_enter(r, NULL);
+
+    fetch->fetching = TRUE;
+    fetch->account = r->account;
+    fetch->attempt = g_new0(TwitterSharedFetchAttempt, 1);
+    fetch->attempt->fetch = fetch;
+    fetch->fetch_func(r, fetch->query, fetch->since_id, sharedfetch_success_cb, sharedfetch_error_cb, fetch->max_count, fetch->attempt);
+    twitter_request_scope_leave(r, previous_scope);
+}
+
+static gboolean sharedfetch_deliver_timeout(gpointer user_data)
+{
+    TwitterSharedFetch *fetch = user_data;
+
+    fetch->deliver_timer = 0;
+    sharedfetch_done(fetch, NULL);
+    return FALSE;
+}
+
+void prpltwtr_sharedfetch_get_all(TwitterRequestor * r, const gchar * resource, const gchar * query, const gchar * since_id, guint max_age, TwitterSharedFetchFunc fetch_func, TwitterSharedFetchSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gint max_count, gpointer data)
+{
+    TwitterSharedFetchSubscriber *subscriber = g_new0(TwitterSharedFetchSubscriber, 1);
+    TwitterSharedFetch *fetch;
+    time_t          now = time(NULL);
+    gchar          *key;
+
+    subscriber->account = r->account;
+    subscriber->since_id = since_id && since_id[0] && strcmp(since_id, "0") ? g_strdup(since_id) : NULL;
+    subscriber->success_func = success_func;
+    subscriber->error_func = error_func;
+    subscriber->data = data;
+
+    if (!shared_fetches)
+        shared_fetches = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) sharedfetch_free);
+    g_hash_table_foreach_remove(shared_fetches, sharedfetch_is_unused, &now);
+
+    key = g_strdup_printf("%s %s %s", purple_account_get_protocol_id(r->account), twitter_option_api_host(r->account), resource);
+    if ((fetch = g_hash_table_lookup(shared_fetches, key))) {
+        g_free(key);
+    } else {
+        fetch = g_new0(TwitterSharedFetch, 1);
+        fetch->key = key;
+        g_hash_table_insert(shared_fetches, fetch->key, fetch);
+    }
+    fetch->last_used = now;
+
+    if (fetch->fetching && sharedfetch_covers(fetch->since_id, subscriber->since_id)) {
+        fetch->subscribers = g_list_append(fetch->subscribers, subscriber);
+        return;
+    }
+    if (!fetch->fetching && fetch->nodes && now - fetch->fetched_at < max_age && sharedfetch_covers(fetch->since_id, subscriber->since_id)) {
+        fetch->subscribers = g_list_append(fetch->subscribers, subscriber);
+        if (!fetch->deliver_timer)
+            fetch->deliver_timer = purple_timeout_add(0, sharedfetch_deliver_timeout, fetch);
+        return;
+    }
+    /* From further back than the fetch others wait for */
+    if (fetch->fetching || fetch->subscribers)
+        fetch = g_new0(TwitterSharedFetch, 1);
+
+    g_free(fetch->since_id);
+    fetch->since_id = g_strdup(subscriber->since_id);
+    fetch->subscribers = g_list_append(fetch->subscribers, subscriber);
+    fetch->fetch_func = fetch_func;
+    g_free(fetch->query);
+    fetch->query = g_strdup(query);
+    fetch->max_count = max_count;
+    sharedfetch_start(fetch, r);
+}
+
+/// Takes the account's subscribers out of a fetch's list
+static void sharedfetch_forget_account(gpointer key, gpointer value, gpointer user_data)
+{
+    TwitterSharedFetch *fetch = value;
+    PurpleAccount  *account = user_data;
+    TwitterRequestErrorData error_data;
+    GList          *l = fetch->subscribers;
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+    while (l) {
+        TwitterSharedFetchSubscriber *subscriber = l->data;
+        GList          *next = l->next;
+
+        if (subscriber->account == account) {
+            fetch->subscribers = g_list_delete_link(fetch->subscribers, l);
+            subscriber->error_func(purple_account_get_requestor(account), &error_data, subscriber->data);
+            sharedfetch_subscriber_free(subscriber);
+        }
+        l = next;
+    }
+
+    /* Its request goes with the account's requestor */
+    if (fetch->fetching && fetch->account == account) {
+        fetch->attempt->fetch = NULL;
+        fetch->attempt = NULL;
+        fetch->fetching = FALSE;
+        /* They were from before the since_id it was fetching */
+        sharedfetch_free_nodes(fetch);
+        if (fetch->subscribers) {
+            TwitterSharedFetchSubscriber *survivor = fetch->subscribers->data;
+
+            purple_debug_info(purple_account_get_protocol_id(account), "Fetching %s through %s instead\n", fetch->key, purple_account_get_username(survivor->account));
+            sharedfetch_start(fetch, purple_account_get_requestor(survivor->account));
+        }
+    }
+}
+
+void prpltwtr_sharedfetch_forget_account(PurpleAccount * account)
+{
+    if (shared_fetches)
+        g_hash_table_foreach(shared_fetches, sharedfetch_forget_account, account);
+}
@@ -0,0 +1,57 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_SHAREDFETCH_H_
+#define _TWITTER_SHAREDFETCH_H_
+
+#include "prpltwtr_request.h"
+
+/* A fetch's result is dropped once nobody has asked for it this long
+ * (seconds) */
+#define TWITTER_SHAREDFETCH_KEEP 600
+
+/// Fetches every page of query since since_id, as twitter_api_get_search_all
+typedef void    (*TwitterSharedFetchFunc) (TwitterRequestor * r, const gchar * query, gchar * since_id, TwitterSendRequestMultiPageAllSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gint max_count, gpointer data);
+
+/// Gets the statuses newer than the since_id the fetch was asked for, as
+/// TwitterUserTweet, parsed for r's account. Takes ownership of statuses.
+typedef void    (*TwitterSharedFetchSuccessFunc) (TwitterRequestor * r, GList * statuses, gpointer user_data);
+
+/// Fetches a public resource, such as a search, once for all the accounts
+/// on the same server asking for it. resource names it, query is what
+/// fetch_func fetches. What some accounts can't see, such as a list, must
+/// have the account in resource. The statuses go to success_func once the fetch
+/// in flight returns, or once the main loop is idle if one that returned
+/// less than max_age seconds ago covers since_id. Each account only gets
+/// what's newer than its own since_id. An account asking from further back
+/// than the fetch in flight fetches on its own.
+void            prpltwtr_sharedfetch_get_all(TwitterRequestor * r, const gchar * resource, const gchar * query, const gchar * since_id, guint max_age, TwitterSharedFetchFunc fetch_func, TwitterSharedFetchSuccessFunc success_func, TwitterSendRequestMultiPageAllErrorFunc error_func, gint max_count, gpointer data);
+
+/// Drops the account's waiting fetches, whose error_func gets a
+/// TWITTER_REQUEST_ERROR_CANCELED error. Fetches sent through the account
+/// that other accounts still wait for are sent again through one of them.
+/// Called before its requestor goes.
+void            prpltwtr_sharedfetch_forget_account(PurpleAccount * account);
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "prpltwtr_stats.h"
+
+/* key: endpoint, value: TwitterEndpointStats */
+static GHashTable *endpoint_stats = NULL;
+
+static guint    cancelled_requests = 0;
+static guint64  cancelled_saved_bytes = 0;
+
+static void endpoint_stats_free(TwitterEndpointStats * stats)
+{
+    g_free(stats->endpoint);
+    g_free(stats);
+}
+
+static TwitterEndpointStats *endpoint_stats_get(const gchar * endpoint)
+{
+    TwitterEndpointStats *stats;
+
+    if (!endpoint_stats)
+        endpoint_stats = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) endpoint_stats_free);
+
+    stats = g_hash_table_lookup(endpoint_stats, endpoint);
+    if (!stats) {
+        stats = g_new0(TwitterEndpointStats, 1);
+        stats->endpoint = g_strdup(endpoint);
+        g_hash_table_insert(endpoint_stats, stats->endpoint, stats);
+    }
+    return stats;
+}
+
+void prpltwtr_stats_add_transfer(const gchar * endpoint, gsize wire_bytes, gsize bytes)
+{
+    TwitterEndpointStats *stats;
+
+    if (!wire_bytes && !bytes)
+        return;
+
+    stats = endpoint_stats_get(endpoint);
+    stats->wire_bytes += wire_bytes;
+    stats->bytes += bytes;
+}
+
+void prpltwtr_stats_add_response(const gchar * endpoint)
+{
+    endpoint_stats_get(endpoint)->responses++;
+}
+
+void prpltwtr_stats_add_cancelled(const gchar * endpoint)
+{
+    TwitterEndpointStats *stats = endpoint_stats ? g_hash_table_lookup(endpoint_stats, endpoint) : NULL;
+
+    cancelled_requests++;
+    if (stats && stats->responses)
+        cancelled_saved_bytes += stats->wire_bytes / stats->responses;
+}
+
+void prpltwtr_stats_get_cancelled(guint * cancelled, guint64 * saved_bytes)
+{
+    *cancelled = cancelled_requests;
+    *saved_bytes = cancelled_saved_bytes;
+}
+
+static gint endpoint_stats_compare(gconstpointer a, gconstpointer b)
+{
+    const TwitterEndpointStats *sa = a;
+    const TwitterEndpointStats *sb = b;
+
+    if (sa->wire_bytes != sb->wire_bytes)
+        return sa->wire_bytes > sb->wire_bytes ? -1 : 1;
+    return strcmp(sa->endpoint, sb->endpoint);
+}
+
+GList          *prpltwtr_stats_get_endpoints()
+{
+    GList          *endpoints;
+
+    if (!endpoint_stats)
+        return NULL;
+    endpoints = g_hash_table_get_values(endpoint_stats);
+    return g_list_sort(endpoints, endpoint_stats_compare);
+}
+
+void prpltwtr_stats_reset()
+{
+    if (endpoint_stats)
+        g_hash_table_remove_all(endpoint_stats);
+    cancelled_requests = 0;
+    cancelled_saved_bytes = 0;
+}
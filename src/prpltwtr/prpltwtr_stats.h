@@ -0,0 +1,59 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+
+#ifndef _TWITTER_STATS_H_
+#define _TWITTER_STATS_H_
+
+#include <glib.h>
+
+typedef struct {
+    gchar          *endpoint;                    /* host and path, see twitter_http_request_endpoint */
+    guint64         wire_bytes;                  /* body bytes as received (compressed) */
+    guint64         bytes;                       /* body bytes once decompressed */
+    guint           responses;                   /* complete responses received */
+} TwitterEndpointStats;
+
+/// Adds to the response body byte counts of an endpoint. Transports call
+/// this as data arrives, so long-lived streams are counted too.
+void            prpltwtr_stats_add_transfer(const gchar * endpoint, gsize wire_bytes, gsize bytes);
+
+/// Counts a complete response from endpoint, so the average response
+/// size is known.
+void            prpltwtr_stats_add_response(const gchar * endpoint);
+
+/// Counts a request cancelled by its owner before its response was in.
+/// What it saved is estimated as the endpoint's average response.
+void            prpltwtr_stats_add_cancelled(const gchar * endpoint);
+
+/// Returns the number of cancelled requests and the bytes they saved
+void            prpltwtr_stats_get_cancelled(guint * cancelled, guint64 * saved_bytes);
+
+/// Returns the per-endpoint counts, most received bytes first. Free the
+/// list with g_list_free, the entries belong to the stats module.
+GList          *prpltwtr_stats_get_endpoints(void);
+
+void            prpltwtr_stats_reset(void);
+
+#endif
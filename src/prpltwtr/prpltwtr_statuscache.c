@@ -0,0 +1,312 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+
+#include "prpltwtr_statuscache.h"
+
+typedef struct {
+    TwitterStatusCache *cache;
+    GPtrArray      *ids;                         /* gchar *, asked for in one request */
+} TwitterStatusCacheBatch;
+
+typedef struct {
+    TwitterStatusCache *cache;
+    gpointer        node;                        /* a copy, as the cache may drop it meanwhile */
+    guint           timer;
+    TwitterSendFormatRequestSuccessFunc success_func;
+    TwitterSendRequestErrorFunc error_func;
+    gpointer        data;
+} TwitterStatusCacheDelivery;
+
+struct _TwitterStatusCache {
+    PurpleAccount  *account;
+    GHashTable     *statuses;                    /* id: status node */
+    GQueue         *order;                       /* the ids in statuses, oldest first */
+    GHashTable     *wanted;                      /* id: depth, waiting for the main loop to be idle */
+    GHashTable     *sending;                     /* id: depth */
+    GHashTable     *missing;                     /* id: the server didn't return it */
+    guint           flush_timer;
+    GList          *deliveries;                  /* TwitterStatusCacheDelivery */
+    TwitterRequestScope *requests;
+};
+
+static TwitterFormat *statuscache_format(TwitterStatusCache * cache)
+{
+    return purple_account_get_requestor(cache->account)->format;
+}
+
+TwitterStatusCache *prpltwtr_statuscache_new(PurpleAccount * account)
+{
+    TwitterStatusCache *cache = g_new0(TwitterStatusCache, 1);
+
+    cache->account = account;
+    cache->statuses = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) purple_account_get_requestor(account)->format->free_node);
+    cache->order = g_queue_new();
+    cache->wanted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    cache->sending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    cache->missing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    cache->requests = twitter_request_scope_new(purple_account_get_requestor(account));
+    twitter_request_scope_set_label(cache->requests, "reply parents");
+    return cache;
+}
+
+TwitterStatusCache *prpltwtr_statuscache_get(PurpleAccount * account)
+{
+    TwitterConnectionData *twitter = purple_account_get_connection(account)->proto_data;
+
+    if (!twitter->status_cache)
+        twitter->status_cache = prpltwtr_statuscache_new(account);
+    return twitter->status_cache;
+}
+
+static void statuscache_delivery_free(TwitterStatusCacheDelivery * delivery)
+{
+    if (delivery->timer)
+        purple_timeout_remove(delivery->timer);
+    statuscache_format(delivery->cache)->free_node(delivery->node);
+    g_free(delivery);
+}
+
+void prpltwtr_statuscache_free(TwitterStatusCache * cache)
+{
+    TwitterRequestErrorData error_data;
+    GList          *l;
+
+    if (cache->flush_timer)
+        purple_timeout_remove(cache->flush_timer);
+    /* The batches come back cancelled, and free themselves */
+    twitter_request_scope_free(cache->requests);
+
+    memset(&error_data, 0, sizeof (error_data));
+    error_data.type = TWITTER_REQUEST_ERROR_CANCELED;
+    for (l = cache->deliveries; l; l = l->next) {
+        TwitterStatusCacheDelivery *delivery = l->data;
+
+        if (delivery->error_func)
+            delivery->error_func(purple_account_get_requestor(cache->account), &error_data, delivery->data);
+        statuscache_delivery_free(delivery);
+    }
+    g_list_free(cache->deliveries);
+
+    g_hash_table_destroy(cache->statuses);
+    g_queue_free(cache->order);
+    g_hash_table_destroy(cache->wanted);
+    g_hash_table_destroy(cache->sending);
+    g_hash_table_destroy(cache->missing);
+    g_free(cache);
+}
+
+static gboolean statuscache_flush(gpointer user_data);
+
+/// Wants the status with that id fetched, depth replies down from a status
+/// that was delivered
+static void statuscache_want(TwitterStatusCache * cache, const gchar * id, guint depth)
+{
+    TwitterRequestor *r = purple_account_get_requestor(cache->account);
+
+    if (!id || !id[0] || depth > TWITTER_STATUSCACHE_DEPTH || !r->urls->lookup_statuses)
+        return;
+    if (g_hash_table_lookup(cache->statuses, id) || g_hash_table_lookup(cache->wanted, id) || g_hash_table_lookup(cache->sending, id) || g_hash_table_lookup(cache->missing, id))
+        return;
+
+    g_hash_table_insert(cache->wanted, g_strdup(id), GUINT_TO_POINTER(depth));
+    if (!cache->flush_timer)
+        cache->flush_timer = purple_timeout_add(0, statuscache_flush, cache);
+}
+
+void prpltwtr_statuscache_want_parent(TwitterStatusCache * cache, const TwitterTweet * status)
+{
+    if (status)
+        statuscache_want(cache, status->in_reply_to_status_id, 1);
+}
+
+/// Keeps a copy of the status, dropping the oldest over TWITTER_STATUSCACHE_SIZE
+static void statuscache_add(TwitterStatusCache * cache, const gchar * id, gpointer node)
+{
+    gchar          *key;
+
+    if (g_hash_table_lookup(cache->statuses, id))
+        return;
+    key = g_strdup(id);
+    g_hash_table_insert(cache->statuses, key, statuscache_format(cache)->copy_node(node));
+    g_queue_push_tail(cache->order, key);
+    while (g_queue_get_length(cache->order) > TWITTER_STATUSCACHE_SIZE)
+        g_hash_table_remove(cache->statuses, g_queue_pop_head(cache->order));
+}
+
+static void statuscache_batch_free(TwitterStatusCacheBatch * batch)
+{
+    g_ptr_array_free(batch->ids, TRUE);
+    g_free(batch);
+}
+
+static void statuscache_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
+{
+    TwitterStatusCacheBatch *batch = user_data;
+    TwitterStatusCache *cache = batch->cache;
+    gpointer        iter;
+    guint           i;
+
+    for (iter = r->format->iter_start(node, NULL); !r->format->iter_done(iter); iter = r->format->iter_next(iter)) {
+        gpointer        status_node = r->format->get_iter_node(iter);
+        gchar          *id = status_node ? r->format->get_str(status_node, "id_str") : NULL;
+        gpointer        depth;
+
+        if (id && g_hash_table_lookup_extended(cache->sending, id, NULL, &depth)) {
+            gchar          *parent_id = r->format->get_str(status_node, "in_reply_to_status_id_str");
+
+            g_hash_table_remove(cache->sending, id);
+            statuscache_add(cache, id, status_node);
+            statuscache_want(cache, parent_id, GPOINTER_TO_UINT(depth) + 1);
+            g_free(parent_id);
+        }
+        g_free(id);
+    }
+
+    /* statuses/lookup leaves out the deleted and the protected */
+    for (i = 0; i < batch->ids->len; i++) {
+        gchar          *id = g_ptr_array_index(batch->ids, i);
+
+        if (g_hash_table_remove(cache->sending, id)) {
+            if (g_hash_table_size(cache->missing) >= TWITTER_STATUSCACHE_SIZE)
+                g_hash_table_remove_all(cache->missing);
+            g_hash_table_insert(cache->missing, g_strdup(id), GINT_TO_POINTER(TRUE));
+        }
+    }
+    statuscache_batch_free(batch);
+}
+
+static void statuscache_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterStatusCacheBatch *batch = user_data;
+    guint           i;
+
+    if (error_data->type != TWITTER_REQUEST_ERROR_CANCELED)
+        purple_debug_warning(purple_account_get_protocol_id(r->account), "Couldn't fetch %u reply parents: %s\n", batch->ids->len, error_data->message ? error_data->message : "unknown error");
+    /* They're wanted again should another reply to them come */
+    for (i = 0; i < batch->ids->len; i++)
+        g_hash_table_remove(batch->cache->sending, g_ptr_array_index(batch->ids, i));
+    statuscache_batch_free(batch);
+}
+
+static void statuscache_batch_send(TwitterStatusCacheBatch * batch)
+{
+    TwitterStatusCache *cache = batch->cache;
+    TwitterRequestor *r = purple_account_get_requestor(cache->account);
+    TwitterRequestParams *params = twitter_request_params_new();
+    TwitterRequestScope *previous_scope;
+    gchar          *ids;
+
+    g_ptr_array_add(batch->ids, NULL);
+    ids = g_strjoinv(",", (gchar **) batch->ids->pdata);
+    g_ptr_array_remove_index(batch->ids, batch->ids->len - 1);
+    twitter_request_params_add(params, twitter_request_param_new("id", ids));
+    g_free(ids);
+
+    purple_debug_info(purple_account_get_protocol_id(cache->account), "Fetching %u reply parents\n", batch->ids->len);
+    previous_scope = twitter_request_scope_enter(r, cache->requests);
+    twitter_send_format_request(r, FALSE, r->urls->lookup_statuses, params, statuscache_success_cb, statuscache_error_cb, batch);
+    twitter_request_scope_leave(r, previous_scope);
+    twitter_request_params_free(params);
+}
+
+/// Fetches the statuses wanted during the last batch, in as few requests
+/// as statuses/lookup allows. Not while the timeline is over its share of
+/// the data budget: nothing needs them yet.
+static gboolean statuscache_flush(gpointer user_data)
+{
+    TwitterStatusCache *cache = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(cache->account);
+    TwitterStatusCacheBatch *batch = NULL;
+    GHashTableIter  iter;
+    gpointer        key;
+    gpointer        value;
+
+    cache->flush_timer = 0;
+    if (prpltwtr_usage_is_cut(twitter_requestor_get_usage(r), TWITTER_USAGE_TIMELINE)) {
+        g_hash_table_remove_all(cache->wanted);
+        return FALSE;
+    }
+
+    g_hash_table_iter_init(&iter, cache->wanted);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        g_hash_table_iter_steal(&iter);
+        g_hash_table_insert(cache->sending, key, value);
+
+        if (!batch) {
+            batch = g_new0(TwitterStatusCacheBatch, 1);
+            batch->cache = cache;
+            batch->ids = g_ptr_array_new_with_free_func(g_free);
+        }
+        g_ptr_array_add(batch->ids, g_strdup(key));
+        if (batch->ids->len == TWITTER_STATUSCACHE_MAX_STATUSES) {
+            statuscache_batch_send(batch);
+            batch = NULL;
+        }
+    }
+    if (batch)
+        statuscache_batch_send(batch);
+    return FALSE;
+}
+
+static gboolean statuscache_deliver(gpointer user_data)
+{
+    TwitterStatusCacheDelivery *delivery = user_data;
+    TwitterStatusCache *cache = delivery->cache;
+
+    delivery->timer = 0;
+    cache->deliveries = g_list_remove(cache->deliveries, delivery);
+    if (delivery->success_func)
+        delivery->success_func(purple_account_get_requestor(cache->account), delivery->node, delivery->data);
+    statuscache_delivery_free(delivery);
+    return FALSE;
+}
+
+gboolean prpltwtr_statuscache_get_status(TwitterStatusCache * cache, const gchar * id, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data)
+{
+    gpointer        node = id ? g_hash_table_lookup(cache->statuses, id) : NULL;
+    TwitterStatusCacheDelivery *delivery;
+
+    if (!node)
+        return FALSE;
+
+    purple_debug_info(purple_account_get_protocol_id(cache->account), "Status %s was fetched ahead\n", id);
+    delivery = g_new0(TwitterStatusCacheDelivery, 1);
+    delivery->cache = cache;
+    delivery->node = statuscache_format(cache)->copy_node(node);
+    delivery->success_func = success_func;
+    delivery->error_func = error_func;
+    delivery->data = data;
+    delivery->timer = purple_timeout_add(0, statuscache_deliver, delivery);
+    cache->deliveries = g_list_prepend(cache->deliveries, delivery);
+    return TRUE;
+}
@@ -0,0 +1,58 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_STATUSCACHE_H_
+#define _TWITTER_STATUSCACHE_H_
+
+#include "prpltwtr_conn.h"
+#include "prpltwtr_xml.h"
+
+/* Statuses fetched in one request, statuses/lookup's limit */
+#define TWITTER_STATUSCACHE_MAX_STATUSES 100
+/* Statuses kept, the oldest fetched go first */
+#define TWITTER_STATUSCACHE_SIZE 500
+/* How far up a thread is fetched ahead: 1 for the parents of the statuses
+ * delivered, 2 for their parents too, and so on */
+#define TWITTER_STATUSCACHE_DEPTH 2
+
+TwitterStatusCache *prpltwtr_statuscache_new(PurpleAccount * account);
+
+/// The connected account's status cache, created on first use
+TwitterStatusCache *prpltwtr_statuscache_get(PurpleAccount * account);
+
+/// Cancels the fetches being sent, and frees the cache. Statuses waiting
+/// to be handed over from it get a TWITTER_REQUEST_ERROR_CANCELED error.
+void            prpltwtr_statuscache_free(TwitterStatusCache * cache);
+
+/// Notes that status was delivered, so the one it replies to is fetched in
+/// the background, along with the others of the same batch. Batches are
+/// told apart by the main loop: they're fetched once it's idle.
+void            prpltwtr_statuscache_want_parent(TwitterStatusCache * cache, const TwitterTweet * status);
+
+/// Hands over the status with that id, if it's cached: success_func gets
+/// it once the main loop is idle, as it would from a request. Returns
+/// FALSE, calling neither, if it isn't.
+gboolean        prpltwtr_statuscache_get_status(TwitterStatusCache * cache, const gchar * id, TwitterSendFormatRequestSuccessFunc success_func, TwitterSendRequestErrorFunc error_func, gpointer data);
+
+#endif
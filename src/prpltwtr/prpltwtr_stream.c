@@ -0,0 +1,278 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+
+#include "prpltwtr_stream.h"
+
+struct _TwitterStream {
+    TwitterRequestor *requestor;
+    gboolean        post;
+    gchar          *url;
+    TwitterRequestParams *params;
+    TwitterStreamMessageFunc message_func;
+    TwitterStreamConnectedFunc connected_func;
+    gpointer        user_data;
+
+    TwitterRequestHandle handle;                 /* 0 while disconnected */
+    gboolean        live;                        /* data has arrived on this connection */
+    GString        *buffer;                      /* start of a message still arriving */
+    guint           reconnect_timer;
+    guint           failures;                    /* connections in a row that dropped before any data */
+};
+
+static void     twitter_stream_connect(TwitterStream * stream);
+
+static gboolean twitter_stream_reconnect_timeout(gpointer user_data)
+{
+    TwitterStream  *stream = user_data;
+    TwitterRequestHandle handle = stream->handle;
+
+    stream->reconnect_timer = 0;
+    if (handle) {
+        /* We gave up on this connection while it was still open */
+        stream->handle = 0;
+        twitter_requestor_cancel(stream->requestor, handle);
+    }
+    twitter_stream_connect(stream);
+    return FALSE;
+}
+
+/// Connects again in delay seconds (or as soon as possible if 0)
+static void twitter_stream_schedule_reconnect(TwitterStream * stream, guint delay)
+{
+    stream->live = FALSE;
+    g_string_truncate(stream->buffer, 0);
+    if (stream->reconnect_timer)
+        purple_timeout_remove(stream->reconnect_timer);
+    purple_debug_info(purple_account_get_protocol_id(stream->requestor->account), "Reconnecting stream %s in %u seconds\n", stream->url, delay);
+    if (delay)
+        stream->reconnect_timer = purple_timeout_add_seconds(delay, twitter_stream_reconnect_timeout, stream);
+    else
+        stream->reconnect_timer = purple_timeout_add(0, twitter_stream_reconnect_timeout, stream);
+}
+
+static guint twitter_stream_backoff(TwitterStream * stream)
+{
+    guint           delay = TWITTER_STREAM_MIN_BACKOFF;
+    guint           i;
+
+    for (i = 1; i < stream->failures && delay < TWITTER_STREAM_MAX_BACKOFF; i++)
+        delay *= 2;
+    return MIN(delay, TWITTER_STREAM_MAX_BACKOFF);
+}
+
+static void twitter_stream_dispatch(TwitterStream * stream, const gchar * message, gsize len)
+{
+    TwitterFormat  *format = stream->requestor->format;
+    gpointer        node = format->from_str(message, len);
+
+    if (!node) {
+        purple_debug_warning(purple_account_get_protocol_id(stream->requestor->account), "Skipping unparseable message on stream %s\n", stream->url);
+        return;
+    }
+    stream->message_func(stream, node, stream->user_data);
+    format->free_node(node);
+}
+
+/// Hands out every complete message in the buffer. A message is either a
+/// line, or a line holding only its length followed by that many bytes.
+static void twitter_stream_process(TwitterStream * stream)
+{
+    GString        *buffer = stream->buffer;
+
+    while (TRUE) {
+        gsize           start = 0;
+        gsize           digits = 0;
+        const gchar    *eol;
+
+        /* Blank lines are keep-alives */
+        while (start < buffer->len && g_ascii_isspace(buffer->str[start]))
+            start++;
+        g_string_erase(buffer, 0, start);
+        if (!buffer->len)
+            return;
+
+        if (!(eol = memchr(buffer->str, '\n', buffer->len)))
+            return;
+
+        while (g_ascii_isdigit(buffer->str[digits]))
+            digits++;
+        if (digits && (buffer->str + digits == eol || (buffer->str[digits] == '\r' && buffer->str + digits + 1 == eol))) {
+            gsize           length = g_ascii_strtoull(buffer->str, NULL, 10);
+            gsize           body = eol - buffer->str + 1;
+
+            if (buffer->len - body < length)
+                return;
+            twitter_stream_dispatch(stream, buffer->str + body, length);
+            g_string_erase(buffer, 0, body + length);
+        } else {
+            gsize           length = eol - buffer->str + 1;
+
+            twitter_stream_dispatch(stream, buffer->str, length);
+            g_string_erase(buffer, 0, length);
+        }
+    }
+}
+
+static void twitter_stream_chunk_cb(TwitterRequestor * r, const gchar * chunk, gsize len, gpointer user_data)
+{
+    TwitterStream  *stream = user_data;
+
+    /* Given up on, the reconnect will cancel it */
+    if (stream->reconnect_timer)
+        return;
+
+    if (!stream->live) {
+        stream->live = TRUE;
+        stream->failures = 0;
+        /* It stays open for good, so it mustn't count against the host's
+         * concurrent requests */
+        twitter_requestor_release_slot(r, stream->handle);
+        purple_debug_info(purple_account_get_protocol_id(r->account), "Stream %s connected\n", stream->url);
+        if (stream->connected_func)
+            stream->connected_func(stream, stream->user_data);
+    }
+
+    g_string_append_len(stream->buffer, chunk, len);
+    twitter_stream_process(stream);
+
+    if (stream->buffer->len > TWITTER_STREAM_MAX_BUFFER) {
+        purple_debug_error(purple_account_get_protocol_id(r->account), "Stream %s sent a message over %d bytes, reconnecting\n", stream->url, TWITTER_STREAM_MAX_BUFFER);
+        twitter_stream_schedule_reconnect(stream, 0);
+    }
+}
+
+static void twitter_stream_success_cb(TwitterRequestor * r, const gchar * response, gpointer user_data)
+{
+    TwitterStream  *stream = user_data;
+
+    /* The server closed it. That's normal now and then, so reconnect
+     * quickly unless it keeps happening */
+    stream->handle = 0;
+    if (!stream->live)
+        stream->failures++;
+    twitter_stream_schedule_reconnect(stream, stream->failures ? twitter_stream_backoff(stream) : TWITTER_STREAM_MIN_BACKOFF);
+}
+
+static void twitter_stream_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterStream  *stream = user_data;
+    guint           delay;
+
+    /* We did that ourselves */
+    if (error_data->type == TWITTER_REQUEST_ERROR_CANCELED)
+        return;
+
+    stream->handle = 0;
+    stream->failures++;
+    delay = twitter_stream_backoff(stream);
+    if (error_data->type == TWITTER_REQUEST_ERROR_RATE_LIMITED || (error_data->headers && (error_data->headers->status_code == 420 || error_data->headers->status_code == 429)))
+        delay = MAX(delay, TWITTER_STREAM_RATE_LIMITED_BACKOFF);
+
+    purple_debug_error(purple_account_get_protocol_id(r->account), "Stream %s failed: %s\n", stream->url, error_data->message ? error_data->message : "unknown error");
+    twitter_stream_schedule_reconnect(stream, delay);
+}
+
+static void twitter_stream_connect(TwitterStream * stream)
+{
+    stream->live = FALSE;
+    g_string_truncate(stream->buffer, 0);
+    stream->handle = twitter_send_request_streaming(stream->requestor, stream->post, stream->url, stream->params, twitter_stream_chunk_cb, twitter_stream_success_cb, twitter_stream_error_cb, stream);
+    if (!stream->handle) {
+        /* Nothing was sent, so no callback will tell us to try again */
+        stream->failures++;
+        twitter_stream_schedule_reconnect(stream, twitter_stream_backoff(stream));
+    }
+}
+
+TwitterStream  *twitter_stream_new(TwitterRequestor * r, gboolean post, const gchar * url, const TwitterRequestParams * params, TwitterStreamMessageFunc message_func, TwitterStreamConnectedFunc connected_func, gpointer user_data)
+{
+    TwitterStream  *stream;
+
+    g_return_val_if_fail(r->do_send_streaming != NULL, NULL);
+
+    stream = g_new0(TwitterStream, 1);
+    stream->requestor = r;
+    stream->post = post;
+    stream->url = g_strdup(url);
+    stream->params = params ? twitter_request_params_clone(params) : NULL;
+    stream->message_func = message_func;
+    stream->connected_func = connected_func;
+    stream->user_data = user_data;
+    stream->buffer = g_string_new(NULL);
+    return stream;
+}
+
+void twitter_stream_set_params(TwitterStream * stream, const TwitterRequestParams * params)
+{
+    TwitterRequestHandle handle = stream->handle;
+
+    if (stream->params)
+        twitter_request_params_free(stream->params);
+    stream->params = params ? twitter_request_params_clone(params) : NULL;
+
+    /* A stream waiting to reconnect picks them up when it does */
+    if (handle && !stream->reconnect_timer) {
+        stream->handle = 0;
+        twitter_requestor_cancel(stream->requestor, handle);
+        twitter_stream_connect(stream);
+    }
+}
+
+void twitter_stream_start(TwitterStream * stream)
+{
+    if (stream->handle || stream->reconnect_timer)
+        return;
+    twitter_stream_connect(stream);
+}
+
+void twitter_stream_free(TwitterStream * stream)
+{
+    TwitterRequestHandle handle;
+
+    if (!stream)
+        return;
+    if (stream->reconnect_timer)
+        purple_timeout_remove(stream->reconnect_timer);
+    if ((handle = stream->handle)) {
+        stream->handle = 0;
+        twitter_requestor_cancel(stream->requestor, handle);
+    }
+    if (stream->params)
+        twitter_request_params_free(stream->params);
+    g_string_free(stream->buffer, TRUE);
+    g_free(stream->url);
+    g_free(stream);
+}
+
+gboolean twitter_stream_is_live(TwitterStream * stream)
+{
+    return stream && stream->live;
+}
@@ -0,0 +1,69 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_STREAM_H_
+#define _TWITTER_STREAM_H_
+
+#include <glib.h>
+
+#include "prpltwtr_request.h"
+
+/* Reconnect delay after a stream drops, doubled for each failure in a row
+ * (seconds) */
+#define TWITTER_STREAM_MIN_BACKOFF 5
+#define TWITTER_STREAM_MAX_BACKOFF 320
+/* Reconnect delay after the server rejects us for connecting too often */
+#define TWITTER_STREAM_RATE_LIMITED_BACKOFF 60
+/* A message longer than this means we've lost track of the framing */
+#define TWITTER_STREAM_MAX_BUFFER (1024 * 1024)
+
+typedef struct _TwitterStream TwitterStream;
+
+/// Called for each message the server sends. node is freed afterwards.
+typedef void    (*TwitterStreamMessageFunc) (TwitterStream * stream, gpointer node, gpointer user_data);
+
+/// Called each time the stream (re)connects, once the first data arrives.
+/// Anything posted while it was down has to be fetched some other way.
+typedef void    (*TwitterStreamConnectedFunc) (TwitterStream * stream, gpointer user_data);
+
+/// Creates a stream of the messages the server sends on url, one per line
+/// or length-prefixed (delimited=length). It reconnects, with backoff,
+/// whenever it drops. Needs a requestor with do_send_streaming.
+/// params are copied.
+TwitterStream  *twitter_stream_new(TwitterRequestor * r, gboolean post, const gchar * url, const TwitterRequestParams * params, TwitterStreamMessageFunc message_func, TwitterStreamConnectedFunc connected_func, gpointer user_data);
+
+/// Replaces the params the stream connects with. A connected stream
+/// reconnects at once for them to take effect. params are copied.
+void            twitter_stream_set_params(TwitterStream * stream, const TwitterRequestParams * params);
+
+/// Connects, unless already connected or connecting
+void            twitter_stream_start(TwitterStream * stream);
+
+/// Disconnects and frees the stream. No callback is called again.
+void            twitter_stream_free(TwitterStream * stream);
+
+/// Whether the stream is connected and receiving (FALSE if stream is NULL)
+gboolean        twitter_stream_is_live(TwitterStream * stream);
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+#include <util.h>
+
+#include "prpltwtr_trace.h"
+
+#define TWITTER_TRACE_MAGIC "prpltwtr-trace 1"
+
+/* A trace is a line per exchange, written as each completes:
+ *   <offset> <latency> <key> <kind> <data>
+ * separated by tabs. offset is when the request was sent, in ms since the
+ * trace was started, and latency how long its response took (ms). key is
+ * "<method> <url>?<params>", without the OAuth signature. kind is 'R' for
+ * a response, data then being the raw response, or 'E' for a failure,
+ * data being the error message; both base64 encoded. Request headers,
+ * credentials among them, aren't recorded. */
+
+typedef struct {
+    gchar          *key;
+    guint           latency_ms;
+    gchar          *response;                    /* NULL if it failed */
+    gsize           len;
+    gchar          *error_message;
+    gboolean        served;
+} TwitterTraceEntry;
+
+struct _TwitterTrace {
+    PurpleAccount  *account;
+    gchar          *path;
+    gboolean        replay;
+
+    FILE           *file;                        /* recording */
+    gint64          started_at;                  /* monotonic, us */
+
+    /* replaying */
+    GList          *entries;                     /* TwitterTraceEntry, in recorded order */
+    GHashTable     *by_key;                      /* key -> GQueue of its entries */
+    GHashTable     *by_url;                      /* "<method> <url>" -> GQueue of its entries */
+    gboolean        recorded_speed;
+    gint64          delivered_at;                /* when the last response was handed over */
+    guint           served;
+    guint           unmatched;                   /* requests served a recorded response with other params */
+    guint           missing;                     /* requests nothing was recorded for */
+};
+
+struct _TwitterTraceReplay {
+    TwitterTrace   *trace;
+    TwitterTraceEntry *entry;                    /* NULL if nothing was recorded */
+    guint           timer;
+    TwitterTraceReplayFunc callback;
+    gpointer        user_data;
+};
+
+static void trace_entry_free(TwitterTraceEntry * entry)
+{
+    g_free(entry->key);
+    g_free(entry->response);
+    g_free(entry->error_message);
+    g_free(entry);
+}
+
+static void trace_queue_free(gpointer queue)
+{
+    g_queue_free(queue);
+}
+
+/// key without its params
+static gchar   *trace_key_url(const gchar * key)
+{
+    return g_strndup(key, strcspn(key, "?"));
+}
+
+static void trace_index(GHashTable * index, gchar * key, TwitterTraceEntry * entry)
+{
+    GQueue         *queue = g_hash_table_lookup(index, key);
+
+    if (!queue) {
+        queue = g_queue_new();
+        g_hash_table_insert(index, key, queue);
+    } else {
+        g_free(key);
+    }
+    g_queue_push_tail(queue, entry);
+}
+
+/// The first entry of the queue for key not yet served, or NULL
+static TwitterTraceEntry *trace_take(GHashTable * index, const gchar * key)
+{
+    GQueue         *queue = g_hash_table_lookup(index, key);
+    TwitterTraceEntry *entry;
+
+    while (queue && (entry = g_queue_pop_head(queue)))
+        if (!entry->served)
+            return entry;
+    return NULL;
+}
+
+/// Decodes a base64 field in place, NUL terminated
+static gchar   *trace_decode(gchar * field, gsize * len)
+{
+    gchar          *text = g_strdup(field);
+
+    g_base64_decode_inplace(text, len);
+    text[*len] = '\0';
+    return text;
+}
+
+static gboolean trace_load(TwitterTrace * trace)
+{
+    gchar          *contents;
+    gchar         **lines;
+    guint           i;
+
+    if (!g_file_get_contents(trace->path, &contents, NULL, NULL))
+        return FALSE;
+    lines = g_strsplit(contents, "\n", 0);
+    g_free(contents);
+
+    if (!lines[0] || strcmp(lines[0], TWITTER_TRACE_MAGIC)) {
+        purple_debug_warning(purple_account_get_protocol_id(trace->account), "Ignoring %s, not a request trace\n", trace->path);
+        g_strfreev(lines);
+        return FALSE;
+    }
+
+    /* The last piece has no newline: it's empty or was cut short */
+    for (i = 1; lines[i] && lines[i + 1]; i++) {
+        gchar         **fields = g_strsplit(lines[i], "\t", 5);
+
+        if (g_strv_length(fields) == 5 && (!strcmp(fields[3], "R") || !strcmp(fields[3], "E"))) {
+            TwitterTraceEntry *entry = g_new0(TwitterTraceEntry, 1);
+            gsize           len;
+
+            entry->key = g_strdup(fields[2]);
+            entry->latency_ms = strtoul(fields[1], NULL, 10);
+            if (fields[3][0] == 'R')
+                entry->response = trace_decode(fields[4], &entry->len);
+            else
+                entry->error_message = trace_decode(fields[4], &len);
+
+            trace->entries = g_list_prepend(trace->entries, entry);
+            trace_index(trace->by_key, g_strdup(entry->key), entry);
+            trace_index(trace->by_url, trace_key_url(entry->key), entry);
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+
+    trace->entries = g_list_reverse(trace->entries);
+    purple_debug_info(purple_account_get_protocol_id(trace->account), "Replaying %u recorded responses from %s\n", g_list_length(trace->entries), trace->path);
+    return TRUE;
+}
+
+gchar          *prpltwtr_trace_default_path(PurpleAccount * account)
+{
+    gchar          *account_name = g_strdup_printf("%s_%s", purple_account_get_protocol_id(account), purple_normalize(account, purple_account_get_username(account)));
+    gchar          *dir = g_build_filename(purple_user_dir(), "prpltwtr", "traces", NULL);
+    gchar          *path = g_build_filename(dir, purple_escape_filename(account_name), NULL);
+
+    g_free(account_name);
+    g_free(dir);
+    return path;
+}
+
+TwitterTrace   *prpltwtr_trace_record_new(PurpleAccount * account, const gchar * path)
+{
+    TwitterTrace   *trace;
+    gchar          *dir = g_path_get_dirname(path);
+    FILE           *file;
+
+    if (g_mkdir_with_parents(dir, 0700) != 0)
+        purple_debug_error(purple_account_get_protocol_id(account), "Unable to create trace directory %s\n", dir);
+    g_free(dir);
+
+    if (!(file = g_fopen(path, "wb")) || fputs(TWITTER_TRACE_MAGIC "\n", file) < 0) {
+        purple_debug_error(purple_account_get_protocol_id(account), "Unable to write a request trace to %s\n", path);
+        if (file)
+            fclose(file);
+        return NULL;
+    }
+    /* It holds the account's traffic, DMs included */
+    g_chmod(path, 0600);
+
+    trace = g_new0(TwitterTrace, 1);
+    trace->account = account;
+    trace->path = g_strdup(path);
+    trace->file = file;
+    trace->started_at = g_get_monotonic_time();
+    purple_debug_info(purple_account_get_protocol_id(account), "Recording requests to %s\n", path);
+    return trace;
+}
+
+TwitterTrace   *prpltwtr_trace_replay_new(PurpleAccount * account, const gchar * path, gboolean recorded_speed)
+{
+    TwitterTrace   *trace = g_new0(TwitterTrace, 1);
+
+    trace->account = account;
+    trace->path = g_strdup(path);
+    trace->replay = TRUE;
+    trace->recorded_speed = recorded_speed;
+    trace->started_at = g_get_monotonic_time();
+    trace->by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, trace_queue_free);
+    trace->by_url = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, trace_queue_free);
+
+    /* Still replayed, so nothing goes to the network */
+    if (!trace_load(trace))
+        purple_debug_error(purple_account_get_protocol_id(account), "Unable to read a request trace from %s\n", path);
+    return trace;
+}
+
+void prpltwtr_trace_free(TwitterTrace * trace)
+{
+    /* Runs over the same trace can be compared by how long they took to
+     * get through it */
+    if (trace->replay)
+        purple_debug_info(purple_account_get_protocol_id(trace->account), "Replayed %u responses (%u with other params) in %u ms, %u requests had none\n", trace->served, trace->unmatched, trace->delivered_at ? (guint) ((trace->delivered_at - trace->started_at) / 1000) : 0, trace->missing);
+    if (trace->file)
+        fclose(trace->file);
+    if (trace->by_key)
+        g_hash_table_destroy(trace->by_key);
+    if (trace->by_url)
+        g_hash_table_destroy(trace->by_url);
+    g_list_free_full(trace->entries, (GDestroyNotify) trace_entry_free);
+    g_free(trace->path);
+    g_free(trace);
+}
+
+gboolean prpltwtr_trace_is_replay(TwitterTrace * trace)
+{
+    return trace->replay;
+}
+
+void prpltwtr_trace_record(TwitterTrace * trace, const gchar * key, guint latency_ms, const gchar * response_text, gsize len, const gchar * error_message)
+{
+    guint           elapsed_ms;
+    gchar          *data;
+
+    g_return_if_fail(trace->file != NULL);
+
+    /* It would break the line up, and never be matched on replay */
+    if (strpbrk(key, "\t\n")) {
+        purple_debug_warning(purple_account_get_protocol_id(trace->account), "Not recording %s, it can't be written to a trace\n", key);
+        return;
+    }
+
+    if (!error_message && !response_text)
+        error_message = TWITTER_TRACE_NO_RESPONSE;
+    elapsed_ms = (g_get_monotonic_time() - trace->started_at) / 1000;
+    data = error_message ? g_base64_encode((const guchar *) error_message, strlen(error_message)) : g_base64_encode((const guchar *) response_text, len);
+
+    /* Not synced: a trace cut short by a crash is still a trace */
+    /* The offset is when it was sent, not when it completed */
+    if (fprintf(trace->file, "%u\t%u\t%s\t%c\t%s\n", elapsed_ms > latency_ms ? elapsed_ms - latency_ms : 0, latency_ms, key, error_message ? 'E' : 'R', data) < 0 || fflush(trace->file) != 0)
+        purple_debug_error(purple_account_get_protocol_id(trace->account), "Unable to write to %s\n", trace->path);
+    g_free(data);
+}
+
+static gboolean trace_replay_timeout(gpointer user_data)
+{
+    TwitterTraceReplay *replay = user_data;
+    TwitterTraceEntry *entry = replay->entry;
+
+    replay->timer = 0;
+    replay->trace->delivered_at = g_get_monotonic_time();
+    if (!entry)
+        replay->callback(replay, replay->user_data, NULL, 0, TWITTER_TRACE_NO_RESPONSE);
+    else
+        replay->callback(replay, replay->user_data, entry->response, entry->len, entry->error_message);
+    g_free(replay);
+    return FALSE;
+}
+
+TwitterTraceReplay *prpltwtr_trace_replay(TwitterTrace * trace, const gchar * key, TwitterTraceReplayFunc callback, gpointer user_data)
+{
+    TwitterTraceReplay *replay;
+    TwitterTraceEntry *entry;
+
+    g_return_val_if_fail(trace->replay, NULL);
+
+    replay = g_new0(TwitterTraceReplay, 1);
+    replay->trace = trace;
+    replay->callback = callback;
+    replay->user_data = user_data;
+
+    if ((entry = trace_take(trace->by_key, key))) {
+        trace->served++;
+    } else {
+        gchar          *url = trace_key_url(key);
+
+        if ((entry = trace_take(trace->by_url, url))) {
+            trace->served++;
+            trace->unmatched++;
+        } else {
+            purple_debug_warning(purple_account_get_protocol_id(trace->account), "Nothing recorded for %s\n", key);
+            trace->missing++;
+        }
+        g_free(url);
+    }
+
+    if (entry)
+        entry->served = TRUE;
+    replay->entry = entry;
+    replay->timer = purple_timeout_add(entry && trace->recorded_speed ? entry->latency_ms : 0, trace_replay_timeout, replay);
+    return replay;
+}
+
+void prpltwtr_trace_replay_cancel(TwitterTraceReplay * replay)
+{
+    if (replay->timer)
+        purple_timeout_remove(replay->timer);
+    g_free(replay);
+}
@@ -0,0 +1,82 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_TRACE_H_
+#define _TWITTER_TRACE_H_
+
+#include <glib.h>
+#include <account.h>
+
+/* A recorded exchange with no response, or a replayed request nothing was
+ * recorded for, fails with this */
+#define TWITTER_TRACE_NO_RESPONSE "No recorded response"
+
+/// A trace of an account's requests and the raw responses to them, with
+/// their timing. Recorded from live traffic and replayed in place of the
+/// network, so the rest of the plugin runs on real responses offline.
+typedef struct _TwitterTrace TwitterTrace;
+
+/// A replayed response waiting to be delivered, see prpltwtr_trace_replay
+typedef struct _TwitterTraceReplay TwitterTraceReplay;
+
+/// Called once per replayed request, like a backend's callback: with the
+/// raw HTTP/1.1 response (status line, headers, blank line and body) or
+/// with an error message.
+typedef void    (*TwitterTraceReplayFunc) (TwitterTraceReplay * replay, gpointer user_data, const gchar * response_text, gsize len, const gchar * error_message);
+
+/// Where an account's trace goes when no file was set:
+/// <user dir>/prpltwtr/traces/<protocol>_<username>
+gchar          *prpltwtr_trace_default_path(PurpleAccount * account);
+
+/// Starts a new trace at path, replacing any there. Returns NULL if it
+/// can't be written.
+TwitterTrace   *prpltwtr_trace_record_new(PurpleAccount * account, const gchar * path);
+
+/// Loads the trace at path to be replayed. With recorded_speed, each
+/// response comes as long after its request as it did when recorded,
+/// else as soon as the event loop gets to it. If there is no trace there,
+/// every request fails.
+TwitterTrace   *prpltwtr_trace_replay_new(PurpleAccount * account, const gchar * path, gboolean recorded_speed);
+
+/// Replays still pending must have been cancelled
+void            prpltwtr_trace_free(TwitterTrace * trace);
+
+gboolean        prpltwtr_trace_is_replay(TwitterTrace * trace);
+
+/// Appends an exchange to a trace being recorded. key identifies the
+/// request (see prpltwtr_trace_replay), latency_ms is the time it took.
+/// Either response_text or error_message is set.
+void            prpltwtr_trace_record(TwitterTrace * trace, const gchar * key, guint latency_ms, const gchar * response_text, gsize len, const gchar * error_message);
+
+/// Serves the next response recorded for key, "<method> <url>?<params>".
+/// Requests are matched in the order they were recorded; if the params
+/// differ from every one left (a since_id that moved on, say), the next
+/// recorded with the same method and url is used. The callback is never
+/// called before this returns.
+TwitterTraceReplay *prpltwtr_trace_replay(TwitterTrace * trace, const gchar * key, TwitterTraceReplayFunc callback, gpointer user_data);
+
+/// The callback won't be called
+void            prpltwtr_trace_replay_cancel(TwitterTraceReplay * replay);
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+
+#include "prpltwtr_prefs.h"
+#include "prpltwtr_usage.h"
+
+/* Account settings carrying today's total across sessions */
+#define TWITTER_USAGE_DAY_SETTING "usage_day"
+#define TWITTER_USAGE_TODAY_SETTING "usage_today_bytes"
+
+struct _TwitterUsage {
+    PurpleAccount  *account;
+    /* key: "class/label", value: TwitterUsageEntry */
+    GHashTable     *entries;
+    guint           day;                         /* julian day today is */
+    guint64         today;
+    guint64         unsaved;                     /* counted since today was last saved */
+    gboolean        cut[TWITTER_USAGE_CLASS_COUNT]; /* as last reported to the debug log */
+};
+
+/* The names used in the cut order option */
+static const gchar *usage_class_keys[TWITTER_USAGE_CLASS_COUNT] = {
+    "timeline", "replies", "dms", "searches", "lists", "icons", "users", "other"
+};
+
+static const gchar *usage_class_names[TWITTER_USAGE_CLASS_COUNT] = {
+    N_("Timeline"), N_("Replies"), N_("Direct messages"), N_("Searches"), N_("Lists"), N_("Icons"), N_("User lookups"), N_("Other")
+};
+
+static void usage_entry_free(TwitterUsageEntry * entry)
+{
+    g_free(entry->label);
+    g_free(entry);
+}
+
+static guint usage_julian_today(void)
+{
+    GDate           date;
+
+    g_date_clear(&date, 1);
+    g_date_set_time_t(&date, time(NULL));
+    return g_date_get_julian(&date);
+}
+
+static void usage_save(TwitterUsage * usage)
+{
+    gchar          *today = g_strdup_printf("%" G_GUINT64_FORMAT, usage->today);
+
+    purple_account_set_int(usage->account, TWITTER_USAGE_DAY_SETTING, usage->day);
+    purple_account_set_string(usage->account, TWITTER_USAGE_TODAY_SETTING, today);
+    usage->unsaved = 0;
+    g_free(today);
+}
+
+/// Starts today's total over once midnight has passed
+static void usage_roll_over(TwitterUsage * usage)
+{
+    guint           day = usage_julian_today();
+
+    if (day == usage->day)
+        return;
+    usage->day = day;
+    usage->today = 0;
+    memset(usage->cut, 0, sizeof (usage->cut));
+    usage_save(usage);
+}
+
+TwitterUsage   *prpltwtr_usage_new(PurpleAccount * account)
+{
+    TwitterUsage   *usage = g_new0(TwitterUsage, 1);
+    const gchar    *today = purple_account_get_string(account, TWITTER_USAGE_TODAY_SETTING, NULL);
+
+    usage->account = account;
+    usage->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) usage_entry_free);
+    usage->day = purple_account_get_int(account, TWITTER_USAGE_DAY_SETTING, 0);
+    usage->today = today ? g_ascii_strtoull(today, NULL, 10) : 0;
+    usage_roll_over(usage);
+    return usage;
+}
+
+void prpltwtr_usage_free(TwitterUsage * usage)
+{
+    if (usage->unsaved)
+        usage_save(usage);
+    g_hash_table_destroy(usage->entries);
+    g_free(usage);
+}
+
+static TwitterUsageEntry *usage_entry_get(TwitterUsage * usage, TwitterUsageClass usage_class, const gchar * label)
+{
+    gchar          *key;
+    TwitterUsageEntry *entry;
+
+    if (!label)
+        label = prpltwtr_usage_class_name(usage_class);
+    key = g_strdup_printf("%d/%s", usage_class, label);
+    entry = g_hash_table_lookup(usage->entries, key);
+    if (!entry) {
+        entry = g_new0(TwitterUsageEntry, 1);
+        entry->label = g_strdup(label);
+        entry->usage_class = usage_class;
+        g_hash_table_insert(usage->entries, key, entry);
+    } else {
+        g_free(key);
+    }
+    return entry;
+}
+
+static void usage_count(TwitterUsage * usage, gsize bytes)
+{
+    usage_roll_over(usage);
+    usage->today += bytes;
+    usage->unsaved += bytes;
+    if (usage->unsaved >= TWITTER_USAGE_SAVE_BYTES)
+        usage_save(usage);
+}
+
+void prpltwtr_usage_add_request(TwitterUsage * usage, TwitterUsageClass usage_class, const gchar * label, gsize sent, gsize received)
+{
+    TwitterUsageEntry *entry = usage_entry_get(usage, usage_class, label);
+
+    entry->requests++;
+    entry->sent += sent;
+    entry->received += received;
+    usage_count(usage, sent + received);
+}
+
+void prpltwtr_usage_add_received(TwitterUsage * usage, TwitterUsageClass usage_class, const gchar * label, gsize received)
+{
+    if (!received)
+        return;
+    usage_entry_get(usage, usage_class, label)->received += received;
+    usage_count(usage, received);
+}
+
+guint64 prpltwtr_usage_get_today(TwitterUsage * usage)
+{
+    usage_roll_over(usage);
+    return usage->today;
+}
+
+guint64 prpltwtr_usage_get_budget(TwitterUsage * usage)
+{
+    return (guint64) twitter_option_daily_budget(usage->account) * 1024 * 1024;
+}
+
+/// Returns where usage_class is in the account's cut order, and sets
+/// count to the number of classes in it. -1 if it's not there
+static gint usage_cut_position(TwitterUsage * usage, TwitterUsageClass usage_class, gint * count)
+{
+    gchar         **keys = g_strsplit(twitter_option_budget_cut_order(usage->account), ",", 0);
+    gint            position = -1;
+    gint            i;
+
+    *count = 0;
+    for (i = 0; keys[i]; i++) {
+        g_strstrip(keys[i]);
+        if (!keys[i][0])
+            continue;
+        if (position < 0 && !g_ascii_strcasecmp(keys[i], usage_class_keys[usage_class]))
+            position = *count;
+        (*count)++;
+    }
+    g_strfreev(keys);
+    return position;
+}
+
+gboolean prpltwtr_usage_is_cut(TwitterUsage * usage, TwitterUsageClass usage_class)
+{
+    guint64         budget = prpltwtr_usage_get_budget(usage);
+    guint64         today = prpltwtr_usage_get_today(usage);
+    gint            position;
+    gint            count;
+    gboolean        cut;
+
+    if (!budget || today < budget / 100 * TWITTER_USAGE_SAVING_PERCENT)
+        return FALSE;
+    if ((position = usage_cut_position(usage, usage_class, &count)) < 0)
+        return FALSE;
+    cut = today >= budget / 100 * (TWITTER_USAGE_SAVING_PERCENT + (100 - TWITTER_USAGE_SAVING_PERCENT) * position / count);
+
+    if (cut && !usage->cut[usage_class])
+        purple_debug_info(purple_account_get_protocol_id(usage->account), "%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes used today, saving data on %s\n", today, budget, usage_class_keys[usage_class]);
+    usage->cut[usage_class] = cut;
+    return cut;
+}
+
+gint prpltwtr_usage_cut_count(TwitterUsage * usage, TwitterUsageClass usage_class, gint count)
+{
+    if (count <= TWITTER_USAGE_MIN_COUNT || !prpltwtr_usage_is_cut(usage, usage_class))
+        return count;
+    return MAX(count / TWITTER_USAGE_CUT_FACTOR, TWITTER_USAGE_MIN_COUNT);
+}
+
+static gint usage_entry_compare(gconstpointer a, gconstpointer b)
+{
+    const TwitterUsageEntry *entry_a = a;
+    const TwitterUsageEntry *entry_b = b;
+    guint64         bytes_a = entry_a->sent + entry_a->received;
+    guint64         bytes_b = entry_b->sent + entry_b->received;
+
+    if (bytes_a != bytes_b)
+        return bytes_a > bytes_b ? -1 : 1;
+    return g_strcmp0(entry_a->label, entry_b->label);
+}
+
+GList          *prpltwtr_usage_get_entries(TwitterUsage * usage)
+{
+    return g_list_sort(g_hash_table_get_values(usage->entries), usage_entry_compare);
+}
+
+const gchar    *prpltwtr_usage_class_name(TwitterUsageClass usage_class)
+{
+    g_return_val_if_fail(usage_class < TWITTER_USAGE_CLASS_COUNT, NULL);
+    return _(usage_class_names[usage_class]);
+}
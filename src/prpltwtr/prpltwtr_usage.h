@@ -0,0 +1,97 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_USAGE_H_
+#define _TWITTER_USAGE_H_
+
+#include <glib.h>
+#include <account.h>
+
+/* Share of the daily budget (percent) at which the first class in the cut
+ * order starts saving data. The others follow, evenly spread up to 100 */
+#define TWITTER_USAGE_SAVING_PERCENT 80
+/* A class saving data polls this many times less often and asks for pages
+ * this many times smaller */
+#define TWITTER_USAGE_CUT_FACTOR 4
+/* Pages aren't made smaller than this */
+#define TWITTER_USAGE_MIN_COUNT 20
+/* Today's total is written to the account settings every this many bytes */
+#define TWITTER_USAGE_SAVE_BYTES (64 * 1024)
+
+typedef enum {
+    TWITTER_USAGE_TIMELINE,
+    TWITTER_USAGE_REPLIES,
+    TWITTER_USAGE_DMS,
+    TWITTER_USAGE_SEARCHES,
+    TWITTER_USAGE_LISTS,
+    TWITTER_USAGE_ICONS,
+    TWITTER_USAGE_USERS,
+    TWITTER_USAGE_OTHER,
+    TWITTER_USAGE_CLASS_COUNT
+} TwitterUsageClass;
+
+typedef struct {
+    gchar          *label;                       /* the chat's name, or the class's */
+    TwitterUsageClass usage_class;
+    guint           requests;
+    guint64         sent;                        /* request bytes */
+    guint64         received;                    /* response bytes, decompressed */
+} TwitterUsageEntry;
+
+typedef struct _TwitterUsage TwitterUsage;
+
+/// Counts the bytes an account's requests send and receive, by class and
+/// chat, and keeps it within the account's daily budget if it has one
+TwitterUsage   *prpltwtr_usage_new(PurpleAccount * account);
+void            prpltwtr_usage_free(TwitterUsage * usage);
+
+/// Counts a request of usage_class that sent and received this much, under
+/// label (the class's name if NULL)
+void            prpltwtr_usage_add_request(TwitterUsage * usage, TwitterUsageClass usage_class, const gchar * label, gsize sent, gsize received);
+
+/// Counts more bytes received for a request already counted, such as a
+/// stream's
+void            prpltwtr_usage_add_received(TwitterUsage * usage, TwitterUsageClass usage_class, const gchar * label, gsize received);
+
+/// Bytes sent and received since local midnight, also in earlier sessions
+guint64         prpltwtr_usage_get_today(TwitterUsage * usage);
+
+/// The daily budget in bytes, 0 if there's none
+guint64         prpltwtr_usage_get_budget(TwitterUsage * usage);
+
+/// Whether usage_class is saving data, as the day's budget is nearly used
+/// up: it polls less often, asks for smaller pages and, for icons, doesn't
+/// fetch them at all. Classes missing from the cut order never save.
+gboolean        prpltwtr_usage_is_cut(TwitterUsage * usage, TwitterUsageClass usage_class);
+
+/// Returns the page size to ask usage_class for instead of count
+gint            prpltwtr_usage_cut_count(TwitterUsage * usage, TwitterUsageClass usage_class, gint count);
+
+/// Returns the TwitterUsageEntry counters, most bytes first. Free the list,
+/// not the entries.
+GList          *prpltwtr_usage_get_entries(TwitterUsage * usage);
+
+const gchar    *prpltwtr_usage_class_name(TwitterUsageClass usage_class);
+
+#endif
@@ -0,0 +1,400 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "defaults.h"
+
+#include <debug.h>
+#include <eventloop.h>
+
+#include "prpltwtr_buddy.h"
+#include "prpltwtr_prefs.h"
+#include "prpltwtr_userlookup.h"
+
+/* Users are keyed by id, or by "@" and their screen name in lower case */
+
+typedef struct {
+    TwitterUserLookupFunc func;
+    gpointer        data;
+} TwitterUserLookupCallback;
+
+typedef struct {
+    gchar          *key;
+    gboolean        add_missing_buddy;
+    gboolean        resolved;
+    GSList         *callbacks;                   /* TwitterUserLookupCallback */
+} TwitterUserLookupEntry;
+
+typedef struct {
+    TwitterUserLookup *lookup;
+    GPtrArray      *entries;                     /* TwitterUserLookupEntry */
+    gboolean        single;                      /* sent to users/show, the server has no users/lookup */
+} TwitterUserLookupBatch;
+
+struct _TwitterUserLookup {
+    PurpleAccount  *account;
+    GHashTable     *pending;                     /* key: TwitterUserLookupEntry, waiting for the timer */
+    GHashTable     *sending;                     /* key: TwitterUserLookupEntry, owned by its batch */
+    GHashTable     *missing;                     /* key: time_t the server said there was no such user */
+    GHashTable     *fresh;                       /* key: time_t it was last looked up */
+    guint           timer;
+    TwitterRequestScope *requests;
+    gboolean        freeing;                     /* no more lookups are taken */
+};
+
+static void     userlookup_resolve(TwitterUserLookup * lookup, TwitterUserLookupEntry * entry, TwitterUserData * user);
+
+static void userlookup_entry_free(TwitterUserLookupEntry * entry)
+{
+    g_slist_foreach(entry->callbacks, (GFunc) g_free, NULL);
+    g_slist_free(entry->callbacks);
+    g_free(entry->key);
+    g_free(entry);
+}
+
+static gchar   *userlookup_screen_name_key(const gchar * screen_name)
+{
+    gchar          *lower = g_utf8_strdown(screen_name, -1);
+    gchar          *key = g_strconcat("@", lower, NULL);
+
+    g_free(lower);
+    return key;
+}
+
+static gboolean userlookup_time_expired(gpointer key, gpointer value, gpointer user_data)
+{
+    return GPOINTER_TO_SIZE(value) < GPOINTER_TO_SIZE(user_data);
+}
+
+/* Users looked up before this are due again. The friends refresh asks for
+ * all of them each time, so the lookups from the one before must still
+ * count: the interval, with some slack for timer drift and batching */
+static time_t userlookup_fresh_since(TwitterUserLookup * lookup, time_t now)
+{
+    time_t          interval = 60 * twitter_option_user_status_timeout(lookup->account);
+
+    return now - MAX(TWITTER_USERLOOKUP_FRESH_TTL, interval + interval / 10);
+}
+
+TwitterUserLookup *prpltwtr_userlookup_new(PurpleAccount * account)
+{
+    TwitterUserLookup *lookup = g_new0(TwitterUserLookup, 1);
+
+    lookup->account = account;
+    lookup->pending = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) userlookup_entry_free);
+    lookup->sending = g_hash_table_new(g_str_hash, g_str_equal);
+    lookup->missing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    lookup->fresh = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    lookup->requests = twitter_request_scope_new(purple_account_get_requestor(account));
+    twitter_request_scope_set_label(lookup->requests, "users");
+    return lookup;
+}
+
+TwitterUserLookup *prpltwtr_userlookup_get(PurpleAccount * account)
+{
+    TwitterConnectionData *twitter = purple_account_get_connection(account)->proto_data;
+
+    if (!twitter->user_lookup)
+        twitter->user_lookup = prpltwtr_userlookup_new(account);
+    return twitter->user_lookup;
+}
+
+void prpltwtr_userlookup_free(TwitterUserLookup * lookup)
+{
+    GList          *entries;
+    GList          *l;
+
+    lookup->freeing = TRUE;
+    if (lookup->timer)
+        purple_timeout_remove(lookup->timer);
+    /* The batches come back cancelled, call back and free themselves */
+    twitter_request_scope_free(lookup->requests);
+
+    entries = g_hash_table_get_values(lookup->pending);
+    g_hash_table_steal_all(lookup->pending);
+    for (l = entries; l; l = l->next) {
+        userlookup_resolve(lookup, l->data, NULL);
+        userlookup_entry_free(l->data);
+    }
+    g_list_free(entries);
+
+    g_hash_table_destroy(lookup->pending);
+    g_hash_table_destroy(lookup->sending);
+    g_hash_table_destroy(lookup->missing);
+    g_hash_table_destroy(lookup->fresh);
+    g_free(lookup);
+}
+
+static void userlookup_batch_free(TwitterUserLookupBatch * batch)
+{
+    g_ptr_array_free(batch->entries, TRUE);
+    g_free(batch);
+}
+
+/// Calls back whoever waits for the entry, which is done with
+static void userlookup_resolve(TwitterUserLookup * lookup, TwitterUserLookupEntry * entry, TwitterUserData * user)
+{
+    GSList         *l;
+
+    entry->resolved = TRUE;
+    g_hash_table_remove(lookup->sending, entry->key);
+    for (l = entry->callbacks; l; l = l->next) {
+        TwitterUserLookupCallback *callback = l->data;
+        callback->func(lookup->account, user, callback->data);
+    }
+}
+
+/// Resolves the entry as a user the server doesn't have
+static void userlookup_resolve_missing(TwitterUserLookup * lookup, TwitterUserLookupEntry * entry)
+{
+    g_hash_table_replace(lookup->missing, g_strdup(entry->key), GSIZE_TO_POINTER(time(NULL) + TWITTER_USERLOOKUP_MISSING_TTL));
+    userlookup_resolve(lookup, entry, NULL);
+}
+
+/// The entry matching the user under key, if it's in this batch's request
+static TwitterUserLookupEntry *userlookup_batch_find(TwitterUserLookupBatch * batch, const gchar * key)
+{
+    TwitterUserLookupEntry *entry = key ? g_hash_table_lookup(batch->lookup->sending, key) : NULL;
+
+    return entry && !entry->resolved ? entry : NULL;
+}
+
+static void userlookup_got_user(TwitterRequestor * r, TwitterUserLookupBatch * batch, gpointer user_node)
+{
+    TwitterUserLookup *lookup = batch->lookup;
+    TwitterUserData *user = twitter_user_node_parse(r, user_node);
+    TwitterUserLookupEntry *by_id;
+    TwitterUserLookupEntry *by_screen_name;
+    gchar          *screen_name_key;
+    gboolean        add_missing_buddy = FALSE;
+
+    if (!user)
+        return;
+    if (!user->screen_name) {
+        twitter_user_data_free(user);
+        return;
+    }
+
+    screen_name_key = userlookup_screen_name_key(user->screen_name);
+    by_id = userlookup_batch_find(batch, user->id);
+    by_screen_name = userlookup_batch_find(batch, screen_name_key);
+    if (user->id)
+        g_hash_table_replace(lookup->fresh, g_strdup(user->id), GSIZE_TO_POINTER(time(NULL)));
+    g_hash_table_replace(lookup->fresh, screen_name_key, GSIZE_TO_POINTER(time(NULL)));
+
+    if (by_id) {
+        add_missing_buddy |= by_id->add_missing_buddy;
+        userlookup_resolve(lookup, by_id, user);
+    }
+    if (by_screen_name) {
+        add_missing_buddy |= by_screen_name->add_missing_buddy;
+        userlookup_resolve(lookup, by_screen_name, user);
+    }
+    twitter_buddy_set_user_data(lookup->account, user, add_missing_buddy);
+}
+
+static void userlookup_success_cb(TwitterRequestor * r, gpointer node, gpointer user_data)
+{
+    TwitterUserLookupBatch *batch = user_data;
+    guint           i;
+
+    if (batch->single) {
+        userlookup_got_user(r, batch, node);
+    } else {
+        gpointer        iter;
+
+        for (iter = r->format->iter_start(node, NULL); !r->format->iter_done(iter); iter = r->format->iter_next(iter)) {
+            gpointer        user_node = r->format->get_iter_node(iter);
+
+            if (user_node)
+                userlookup_got_user(r, batch, user_node);
+        }
+    }
+
+    /* users/lookup leaves out the users it doesn't have */
+    for (i = 0; i < batch->entries->len; i++) {
+        TwitterUserLookupEntry *entry = g_ptr_array_index(batch->entries, i);
+
+        if (!entry->resolved)
+            userlookup_resolve_missing(batch->lookup, entry);
+    }
+    userlookup_batch_free(batch);
+}
+
+static void userlookup_error_cb(TwitterRequestor * r, const TwitterRequestErrorData * error_data, gpointer user_data)
+{
+    TwitterUserLookupBatch *batch = user_data;
+    TwitterUserLookup *lookup = batch->lookup;
+    /* None of them exist */
+    gboolean        missing = error_data->headers && error_data->headers->status_code == 404;
+    guint           i;
+
+    if (!missing && error_data->type != TWITTER_REQUEST_ERROR_CANCELED)
+        purple_debug_error(purple_account_get_protocol_id(r->account), "Couldn't look up %u users: %s\n", batch->entries->len, error_data->message ? error_data->message : "unknown error");
+    for (i = 0; i < batch->entries->len; i++) {
+        TwitterUserLookupEntry *entry = g_ptr_array_index(batch->entries, i);
+
+        if (missing)
+            userlookup_resolve_missing(lookup, entry);
+        else
+            userlookup_resolve(lookup, entry, NULL);
+    }
+    userlookup_batch_free(batch);
+}
+
+static void userlookup_batch_send(TwitterUserLookupBatch * batch)
+{
+    TwitterUserLookup *lookup = batch->lookup;
+    TwitterRequestor *r = purple_account_get_requestor(lookup->account);
+    TwitterRequestParams *params = twitter_request_params_new();
+    GString        *ids = g_string_new(NULL);
+    GString        *screen_names = g_string_new(NULL);
+    TwitterRequestScope *previous_scope;
+    guint           i;
+
+    for (i = 0; i < batch->entries->len; i++) {
+        TwitterUserLookupEntry *entry = g_ptr_array_index(batch->entries, i);
+        GString        *list = entry->key[0] == '@' ? screen_names : ids;
+
+        if (list->len)
+            g_string_append_c(list, ',');
+        g_string_append(list, entry->key[0] == '@' ? entry->key + 1 : entry->key);
+    }
+    if (ids->len)
+        twitter_request_params_add(params, twitter_request_param_new("user_id", ids->str));
+    if (screen_names->len)
+        twitter_request_params_add(params, twitter_request_param_new("screen_name", screen_names->str));
+    g_string_free(ids, TRUE);
+    g_string_free(screen_names, TRUE);
+
+    purple_debug_info(purple_account_get_protocol_id(lookup->account), "Looking up %u users\n", batch->entries->len);
+    previous_scope = twitter_request_scope_enter(r, lookup->requests);
+    twitter_send_format_request(r, FALSE, batch->single ? r->urls->get_user_info : r->urls->lookup_users, params, userlookup_success_cb, userlookup_error_cb, batch);
+    twitter_request_scope_leave(r, previous_scope);
+    twitter_request_params_free(params);
+}
+
+/// Sends what's pending, in batches as big as the server takes. Users it
+/// said it didn't have a while ago are answered without asking again.
+static gboolean userlookup_flush(gpointer user_data)
+{
+    TwitterUserLookup *lookup = user_data;
+    TwitterRequestor *r = purple_account_get_requestor(lookup->account);
+    gboolean        single = !r->urls->lookup_users;
+    time_t          now = time(NULL);
+    TwitterUserLookupBatch *batch = NULL;
+    GList          *entries;
+    GList          *l;
+
+    lookup->timer = 0;
+    g_hash_table_foreach_remove(lookup->missing, userlookup_time_expired, GSIZE_TO_POINTER(now));
+    g_hash_table_foreach_remove(lookup->fresh, userlookup_time_expired, GSIZE_TO_POINTER(userlookup_fresh_since(lookup, now)));
+
+    /* Taken out first, as callbacks may look up more users */
+    entries = g_hash_table_get_values(lookup->pending);
+    g_hash_table_steal_all(lookup->pending);
+    for (l = entries; l; l = l->next) {
+        TwitterUserLookupEntry *entry = l->data;
+
+        if (g_hash_table_lookup(lookup->missing, entry->key)) {
+            userlookup_resolve(lookup, entry, NULL);
+            userlookup_entry_free(entry);
+            continue;
+        }
+
+        if (!batch) {
+            batch = g_new0(TwitterUserLookupBatch, 1);
+            batch->lookup = lookup;
+            batch->entries = g_ptr_array_new_with_free_func((GDestroyNotify) userlookup_entry_free);
+            batch->single = single;
+        }
+        g_hash_table_insert(lookup->sending, entry->key, entry);
+        g_ptr_array_add(batch->entries, entry);
+        if (single || batch->entries->len == TWITTER_USERLOOKUP_MAX_USERS) {
+            userlookup_batch_send(batch);
+            batch = NULL;
+        }
+    }
+    g_list_free(entries);
+    if (batch)
+        userlookup_batch_send(batch);
+    return FALSE;
+}
+
+static void userlookup_add(TwitterUserLookup * lookup, gchar * key, gboolean add_missing_buddy, TwitterUserLookupFunc func, gpointer data)
+{
+    TwitterUserLookupEntry *entry;
+    gpointer        looked_up;
+
+    /* Asked for by a callback while the service is going away */
+    if (lookup->freeing) {
+        g_free(key);
+        return;
+    }
+
+    if (!func && g_hash_table_lookup_extended(lookup->fresh, key, NULL, &looked_up) && GPOINTER_TO_SIZE(looked_up) >= (gsize) userlookup_fresh_since(lookup, time(NULL))) {
+        g_free(key);
+        return;
+    }
+
+    if (!(entry = g_hash_table_lookup(lookup->sending, key)) && !(entry = g_hash_table_lookup(lookup->pending, key))) {
+        entry = g_new0(TwitterUserLookupEntry, 1);
+        entry->key = key;
+        g_hash_table_insert(lookup->pending, entry->key, entry);
+    } else {
+        g_free(key);
+    }
+    entry->add_missing_buddy |= add_missing_buddy;
+    if (func) {
+        TwitterUserLookupCallback *callback = g_new0(TwitterUserLookupCallback, 1);
+
+        callback->func = func;
+        callback->data = data;
+        entry->callbacks = g_slist_append(entry->callbacks, callback);
+    }
+
+    if (g_hash_table_size(lookup->pending) >= TWITTER_USERLOOKUP_MAX_USERS) {
+        if (lookup->timer)
+            purple_timeout_remove(lookup->timer);
+        lookup->timer = purple_timeout_add(0, userlookup_flush, lookup);
+    } else if (!lookup->timer && g_hash_table_size(lookup->pending)) {
+        lookup->timer = purple_timeout_add(TWITTER_USERLOOKUP_DELAY, userlookup_flush, lookup);
+    }
+}
+
+void prpltwtr_userlookup_by_id(TwitterUserLookup * lookup, const gchar * id, gboolean add_missing_buddy, TwitterUserLookupFunc func, gpointer data)
+{
+    g_return_if_fail(id && id[0]);
+    userlookup_add(lookup, g_strdup(id), add_missing_buddy, func, data);
+}
+
+void prpltwtr_userlookup_by_screen_name(TwitterUserLookup * lookup, const gchar * screen_name, gboolean add_missing_buddy, TwitterUserLookupFunc func, gpointer data)
+{
+    g_return_if_fail(screen_name && screen_name[0]);
+    userlookup_add(lookup, userlookup_screen_name_key(screen_name), add_missing_buddy, func, data);
+}
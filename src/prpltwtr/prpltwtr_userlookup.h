@@ -0,0 +1,66 @@
+/**
+ * TODO: legal stuff
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef _TWITTER_USERLOOKUP_H_
+#define _TWITTER_USERLOOKUP_H_
+
+#include "prpltwtr_conn.h"
+#include "prpltwtr_xml.h"
+
+/* Wait for more users to look up before asking for them (milliseconds) */
+#define TWITTER_USERLOOKUP_DELAY 500
+/* Users asked for in one request, users/lookup's limit */
+#define TWITTER_USERLOOKUP_MAX_USERS 100
+/* Users the server didn't return aren't asked for again for this long
+ * (seconds) */
+#define TWITTER_USERLOOKUP_MISSING_TTL (60 * 60)
+/* Lookups nobody waits for are skipped for users looked up this recently
+ * (seconds), or within the friends refresh interval if that's longer */
+#define TWITTER_USERLOOKUP_FRESH_TTL (30 * 60)
+
+/// Called once the user is known, before it's handed to
+/// twitter_buddy_set_user_data. user is NULL if there's no such user, or
+/// it couldn't be looked up.
+typedef void    (*TwitterUserLookupFunc) (PurpleAccount * account, TwitterUserData * user, gpointer data);
+
+TwitterUserLookup *prpltwtr_userlookup_new(PurpleAccount * account);
+
+/// The connected account's lookup service, created on first use
+TwitterUserLookup *prpltwtr_userlookup_get(PurpleAccount * account);
+
+/// Cancels the lookups being sent and waiting, calling back with a NULL
+/// user, and frees the service. Lookups asked for meanwhile are dropped.
+void            prpltwtr_userlookup_free(TwitterUserLookup * lookup);
+
+/// Looks up a user by id, along with the others asked for within
+/// TWITTER_USERLOOKUP_DELAY, up to TWITTER_USERLOOKUP_MAX_USERS per
+/// request. The user goes to twitter_buddy_set_user_data, which adds it to
+/// the buddy list if add_missing_buddy is set. func may be NULL; it's never
+/// called before this returns.
+void            prpltwtr_userlookup_by_id(TwitterUserLookup * lookup, const gchar * id, gboolean add_missing_buddy, TwitterUserLookupFunc func, gpointer data);
+
+/// Like prpltwtr_userlookup_by_id, for a screen name
+void            prpltwtr_userlookup_by_screen_name(TwitterUserLookup * lookup, const gchar * screen_name, gboolean add_missing_buddy, TwitterUserLookupFunc func, gpointer data);
+
+#endif
@@ -424,24 +424,30 @@ GList          *twitter_users_node_parse(TwitterRequestor * r, gpointer users_no
     return users;
 }
 
+GList          *twitter_users_ids_node_parse(TwitterRequestor * r, gpointer ids_node)
+{
+    GList          *l_users = NULL;
+    gpointer        iter;
+
+    for (iter = r->format->iter_start(ids_node, "ids"); !r->format->iter_done(iter); iter = r->format->iter_next(iter)) {
+        gpointer        id_node = r->format->get_iter_node(iter);
+        gchar          *id = id_node ? r->format->get_value(id_node) : NULL;
+
+        if (id)
+            l_users = g_list_prepend(l_users, id);
+    }
+    return g_list_reverse(l_users);
+}
+
 GList          *twitter_users_ids_nodes_parse(TwitterRequestor * r, GList * nodes)
 {
     GList          *l_users = NULL;
-    /* TODO
-       xmlnode        *ids;
-       xmlnode        *id;
-       if (nodes && nodes->data) {
-       ids = xmlnode_get_child((nodes->data), "ids");
-       if (ids) {
-       for (id = xmlnode_get_child(ids, "id"); id; id = xmlnode_get_next_twin(id)) {
-       l_users = g_list_prepend(l_users, xmlnode_get_data_unescaped(id));
-       }
-       }
-       }
-       if (!l_users) {
-       purple_debug_warning(TWITTER_PROTOCOL_ID, "Empty nodes list!\n");
-       }
-     */
+    GList          *l;
+
+    for (l = nodes; l; l = l->next)
+        l_users = g_list_concat(l_users, twitter_users_ids_node_parse(r, l->data));
+    if (!l_users)
+        purple_debug_warning(purple_account_get_protocol_id(r->account), "Empty nodes list!\n");
     return l_users;
 }
 
@@ -62,6 +62,7 @@ TwitterUserData *twitter_user_node_parse(TwitterRequestor * r, gpointer user_nod
 TwitterTweet   *twitter_status_node_parse(TwitterRequestor * r, gpointer status_node);
 GList          *twitter_users_node_parse(TwitterRequestor * r, gpointer users_node);
 GList          *twitter_users_nodes_parse(TwitterRequestor * r, GList * nodes);
+GList          *twitter_users_ids_node_parse(TwitterRequestor * r, gpointer ids_node);
 GList          *twitter_users_ids_nodes_parse(TwitterRequestor * r, GList * nodes);
 GList          *twitter_statuses_node_parse(TwitterRequestor * r, gpointer statuses_node);
 GList          *twitter_statuses_nodes_parse(TwitterRequestor * r, GList * nodes);